@@ -190,6 +190,7 @@ int32 rlog = 0;                                         /* extend fixup log */
 int32 ind_max = 32;                                     /* nested ind limit */
 int32 xct_max = 32;                                     /* nested XCT limit */
 int32 t20_idlelock = 0;                                 /* TOPS-20 idle lock */
+int32 cpu_astop = 0;                                    /* address stop */
 a10 pcq[PCQ_SIZE] = { 0 };                              /* PC queue */
 int32 pcq_p = 0;                                        /* PC queue ptr */
 REG *pcq_r = NULL;                                      /* PC queue reg ptr */
@@ -700,6 +701,10 @@ pager_PC = PC;                                          /* update pager PC */
 pager_tc = FALSE;                                       /* not in trap cycle */
 pflgs = 0;                                              /* not in PXCT */
 xct_cnt = 0;                                            /* count XCT's */
+if (cpu_astop) {                                        /* data breakpoint? */
+    cpu_astop = 0;
+    ABORT (STOP_ASTOP);
+    }
 if (sim_interval <= 0) {                                /* check clock queue */
     if ((i = sim_process_event ()))                     /* error?  stop sim */
         ABORT (i);
@@ -2289,7 +2294,8 @@ pcq_r = find_reg ("PCQ", NULL, dptr);
 if (pcq_r)
     pcq_r->qptr = 0;
 else return SCPE_IERR;
-sim_brk_types = sim_brk_dflt = SWMASK ('E');
+sim_brk_types = SWMASK ('E') | SIM_BRK_WTYP;
+sim_brk_dflt = SWMASK ('E');
 return SCPE_OK;
 }
 
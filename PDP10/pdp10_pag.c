@@ -109,6 +109,8 @@ extern d10 pcst, quant;
 extern t_bool paging;
 extern UNIT cpu_unit;
 extern jmp_buf save_env;
+extern a10 pager_PC;
+extern int32 cpu_astop;
 extern int32 test_int (void);
 extern int32 pi_eval (void);
 
@@ -159,8 +161,16 @@ DEVICE pag_dev = {
    WriteE - write exec
    WriteP - write physical
    AccChk - test accessibility of virtual address
+
+   Read, ReadM, ReadE, Write and WriteE check memory references to pages
+   holding a data breakpoint; on a hit, the CPU stops after the instruction.
+   Instruction fetches go through Read and count as reads.
 */
 
+#define WATCH(pa,typ,val) \
+    if (SIM_BRK_WATCHED (pa) && sim_brk_wtest (pa, 1, typ, val, pager_PC)) \
+        cpu_astop = 1
+
 d10 Read (a10 ea, int32 prv)
 {
 int32 pa, vpn, xpte;
@@ -174,6 +184,7 @@ if (xpte == 0)
 pa = PAG_XPTEPA (xpte, ea);                             /* calc phys addr */
 if (MEM_ADDR_NXM (pa))                                  /* process nxm */
     pag_nxm (pa, REF_V, PF_TR);
+WATCH (pa, SWMASK ('R'), M[pa]);
 return M[pa];                                           /* return data */
 }
 
@@ -190,6 +201,7 @@ if (xpte >= 0)
 pa = PAG_XPTEPA (xpte, ea);                             /* calc phys addr */
 if (MEM_ADDR_NXM (pa))                                  /* process nxm */
     pag_nxm (pa, REF_V, PF_TR);
+WATCH (pa, SWMASK ('R'), M[pa]);
 return M[pa];                                           /* return data */
 }
 
@@ -199,8 +211,10 @@ int32 pa, vpn, xpte;
 
 if (ea < AC_NUM)                                        /* AC? use current */
     return AC(ea);
-if (!PAGING)                                            /* phys? no mapping */
+if (!PAGING) {                                          /* phys? no mapping */
+    WATCH (ea, SWMASK ('R'), M[ea]);
     return M[ea];
+    }
 vpn = PAG_GETVPN (ea);                                  /* get page num */
 xpte = eptbl[vpn];                                      /* get exp pte, exec tbl */
 if (xpte == 0)
@@ -208,6 +222,7 @@ if (xpte == 0)
 pa = PAG_XPTEPA (xpte, ea);                             /* calc phys addr */
 if (MEM_ADDR_NXM (pa))                                  /* process nxm */
     pag_nxm (pa, REF_V, PF_TR);
+WATCH (pa, SWMASK ('R'), M[pa]);
 return M[pa];                                           /* return data */
 }
 
@@ -237,7 +252,10 @@ else {
     pa = PAG_XPTEPA (xpte, ea);                         /* calc phys addr */
     if (MEM_ADDR_NXM (pa))                              /* process nxm */
         pag_nxm (pa, REF_V, PF_TR);
-    else M[pa] = val;                                   /* write data */
+    else {
+        WATCH (pa, SWMASK ('W'), val);
+        M[pa] = val;                                    /* write data */
+        }
     }
 return;
 }
@@ -248,8 +266,10 @@ int32 pa, vpn, xpte;
 
 if (ea < AC_NUM)                                        /* AC? use current */
     AC(ea) = val;
-else if (!PAGING)                                       /* phys? no mapping */
+else if (!PAGING) {                                     /* phys? no mapping */
+    WATCH (ea, SWMASK ('W'), val);
     M[ea] = val;
+    }
 else {
     vpn = PAG_GETVPN (ea);                              /* get page num */
     xpte = eptbl[vpn];                                  /* get exp pte, exec tbl */
@@ -258,7 +278,10 @@ else {
     pa = PAG_XPTEPA (xpte, ea);                         /* calc phys addr */
     if (MEM_ADDR_NXM (pa))                              /* process nxm */
         pag_nxm (pa, REF_V, PF_TR);
-    else M[pa] = val;                                   /* write data */
+    else {
+        WATCH (pa, SWMASK ('W'), val);
+        M[pa] = val;                                    /* write data */
+        }
     }
 return;
 }
@@ -265,7 +265,7 @@ t_stat tcu_rd (int32 *data, int32 PA, int32 access)
 time_t curtim;
 struct tm *tptr;
 
-curtim = time (NULL);                                   /* get time */
+curtim = sim_get_time (NULL);                           /* get time */
 tptr = localtime (&curtim);                             /* decompose */
 if (tptr == NULL)
     return SCPE_NXM; 
@@ -238,9 +238,6 @@
 #define UNIT_V_MSIZE    (UNIT_V_UF + 0)                 /* dummy */
 #define UNIT_MSIZE      (1u << UNIT_V_MSIZE)
 
-#define HIST_MIN        64
-#define HIST_MAX        (1u << 18)
-#define HIST_VLD        1                               /* make PC odd */
 #define HIST_ILNT       4                               /* max inst length */
 
 typedef struct {
@@ -282,6 +279,7 @@ int32 MMR2 = 0;                                         /* MMR2 - saved PC */
 int32 MMR3 = 0;                                         /* MMR3 - 22b status */
 int32 cpu_bme = 0;                                      /* bus map enable */
 int32 cpu_astop = 0;                                    /* address stop */
+int32 inst_PC = 0;                                      /* PC of current instruction */
 int32 isenable = 0, dsenable = 0;                       /* i, d space flags */
 int32 stop_trap = 1;                                    /* stop on trap */
 int32 stop_vecabort = 1;                                /* stop on vec abort */
@@ -295,9 +293,8 @@ uint16 pcq[PCQ_SIZE] = { 0 };                           /* PC queue */
 int32 pcq_p = 0;                                        /* PC queue ptr */
 REG *pcq_r = NULL;                                      /* PC queue reg ptr */
 jmp_buf save_env;                                       /* abort handler */
-int32 hst_p = 0;                                        /* history pointer */
-int32 hst_lnt = 0;                                      /* history length */
-InstHistory *hst = NULL;                                /* instruction history */
+SIM_HIST hst;                                           /* instruction history */
+SIM_MEM cpu_mem;                                        /* memory dirty map */
 int32 dsmask[4] = { MMR3_KDS, MMR3_SDS, 0, MMR3_UDS };  /* dspace enables */
 t_addr cpu_memsize = INIMEMSIZE;                        /* last mem addr */
 
@@ -612,7 +609,7 @@ MTAB cpu_mod[] = {
       &set_autocon, &show_autocon },
     { MTAB_XTD|MTAB_VDV, 0, NULL, "NOAUTOCONFIG",
       &set_autocon, NULL },
-    { MTAB_XTD|MTAB_VDV|MTAB_NMO|MTAB_SHP, 0, "HISTORY", "HISTORY",
+    { MTAB_XTD|MTAB_VDV|MTAB_NMO|MTAB_SHP|MTAB_NC, 0, "HISTORY", "HISTORY",
       &cpu_set_hist, &cpu_show_hist },
     { MTAB_XTD|MTAB_VDV|MTAB_NMO|MTAB_SHP, 0, "VIRTUAL", NULL,
       NULL, &cpu_show_virt },
@@ -711,9 +708,9 @@ while (reason == 0)  {
     int32 src, src2, dst, ea;
     int32 i, t, sign, oldrs, trapnum;
 
-    if (cpu_astop) {
+    if (cpu_astop) {                                    /* data breakpoint? */
         cpu_astop = 0;
-        reason = SCPE_STOP;
+        reason = STOP_DBKPT;
         break;
 		}
 
@@ -806,7 +803,7 @@ while (reason == 0)  {
         continue;
         }
 
-    if (sim_brk_summ && sim_brk_test (PC, SWMASK ('E'))) { /* breakpoint? */
+    if (sim_brk_summ && SIM_BRK_TEST (PC, SWMASK ('E'))) { /* breakpoint? */
         reason = STOP_IBKPT;                            /* stop simulation */
         continue;
 		}
@@ -815,28 +812,27 @@ while (reason == 0)  {
         MMR1 = 0;
         MMR2 = PC;
         }
+    inst_PC = PC;                                       /* MMR2 may be frozen */
     IR = ReadE (PC | isenable);                         /* fetch instruction */
     sim_interval = sim_interval - 1;
     srcspec = (IR >> 6) & 077;                          /* src, dst specs */
     dstspec = IR & 077;
     srcreg = (srcspec <= 07);                           /* src, dst = rmode? */
     dstreg = (dstspec <= 07);
-    if (hst_lnt) {                                      /* record history? */
+    if (hst.lnt) {                                      /* record history? */
+        InstHistory *h = sim_hist_rec (&hst, InstHistory);
         t_value val;
         uint32 i;
-        hst[hst_p].pc = PC | HIST_VLD;
-        hst[hst_p].psw = get_PSW ();
-        hst[hst_p].src = R[srcspec & 07];
-        hst[hst_p].dst = R[dstspec & 07];
-        hst[hst_p].inst[0] = IR;
+        h->pc = PC;
+        h->psw = get_PSW ();
+        h->src = R[srcspec & 07];
+        h->dst = R[dstspec & 07];
+        h->inst[0] = IR;
         for (i = 1; i < HIST_ILNT; i++) {
             if (cpu_ex (&val, (PC + (i << 1)) & 0177777, &cpu_unit, SWMASK ('V')))
-                hst[hst_p].inst[i] = 0;
-            else hst[hst_p].inst[i] = (uint16) val;
+                h->inst[i] = 0;
+            else h->inst[i] = (uint16) val;
             }
-        hst_p = (hst_p + 1);
-        if (hst_p >= hst_lnt)
-            hst_p = 0;
         }
     PC = (PC + 2) & 0177777;                            /* incr PC, mod 65k */
     switch ((IR >> 12) & 017) {                         /* decode IR<15:12> */
@@ -2267,8 +2263,17 @@ switch (spec >> 3) {                                    /* decode spec<5:3> */
         va      =       virtual address, <18:16> = mode, I/D space
    Outputs:
         data    =       data read from memory or I/O space
+
+   Memory references, but not instruction fetches, are checked for data
+   breakpoints if their page holds one.  They are reported with the PC of
+   the instruction being executed, which MMR2 doesn't hold once an abort
+   has frozen it.
 */
 
+#define WATCH(pa,lnt,typ,val) \
+    if (SIM_BRK_WATCHED (pa) && sim_brk_wtest (pa, lnt, typ, val, inst_PC)) \
+        cpu_astop = 1
+
 int32 ReadE (int32 va)
 {
 int32 pa, data;
@@ -2301,8 +2306,10 @@ if ((va & 1) && CPUT (HAS_ODD)) {                       /* odd address? */
     ABORT (TRAP_ODD);
     }
 pa = relocR (va);                                       /* relocate */
-if (ADDR_IS_MEM (pa))                                   /* memory address? */
+if (ADDR_IS_MEM (pa)) {                                 /* memory address? */
+    WATCH (pa, 2, SWMASK ('R'), M[pa >> 1]);
     return (M[pa >> 1]);
+    }
 if (pa < IOPAGEBASE) {                                  /* not I/O address? */
     setCPUERR (CPUE_NXM);
     ABORT (TRAP_NXM);
@@ -2319,8 +2326,10 @@ int32 ReadB (int32 va)
 int32 pa, data;
 
 pa = relocR (va);                                       /* relocate */
-if (ADDR_IS_MEM (pa))
+if (ADDR_IS_MEM (pa)) {
+    WATCH (pa, 1, SWMASK ('R'), (va & 1? M[pa >> 1] >> 8: M[pa >> 1]) & 0377);
     return (va & 1? M[pa >> 1] >> 8: M[pa >> 1]) & 0377;
+    }
 if (pa < IOPAGEBASE) {                                  /* not I/O address? */
     setCPUERR (CPUE_NXM);
     ABORT (TRAP_NXM);
@@ -2341,8 +2350,10 @@ if ((va & 1) && CPUT (HAS_ODD)) {                       /* odd address? */
     ABORT (TRAP_ODD);
     }
 last_pa = relocW (va);                                  /* reloc, wrt chk */
-if (ADDR_IS_MEM (last_pa))                              /* memory address? */
+if (ADDR_IS_MEM (last_pa)) {                            /* memory address? */
+    WATCH (last_pa, 2, SWMASK ('R'), M[last_pa >> 1]);
     return (M[last_pa >> 1]);
+    }
 if (last_pa < IOPAGEBASE) {                             /* not I/O address? */
     setCPUERR (CPUE_NXM);
     ABORT (TRAP_NXM);
@@ -2359,8 +2370,10 @@ int32 ReadMB (int32 va)
 int32 data;
 
 last_pa = relocW (va);                                  /* reloc, wrt chk */
-if (ADDR_IS_MEM (last_pa))
+if (ADDR_IS_MEM (last_pa)) {
+    WATCH (last_pa, 1, SWMASK ('R'), (va & 1? M[last_pa >> 1] >> 8: M[last_pa >> 1]) & 0377);
     return (va & 1? M[last_pa >> 1] >> 8: M[last_pa >> 1]) & 0377;
+    }
 if (last_pa < IOPAGEBASE) {                             /* not I/O address? */
     setCPUERR (CPUE_NXM);
     ABORT (TRAP_NXM);
@@ -2391,7 +2404,9 @@ if ((va & 1) && CPUT (HAS_ODD)) {                       /* odd address? */
     }
 pa = relocW (va);                                       /* relocate */
 if (ADDR_IS_MEM (pa)) {                                 /* memory address? */
+    WATCH (pa, 2, SWMASK ('W'), data);
     M[pa >> 1] = data;
+    SIM_MEM_DIRTY (&cpu_mem, pa);
     return;
     }
 if (pa < IOPAGEBASE) {                                  /* not I/O address? */
@@ -2411,9 +2426,11 @@ int32 pa;
 
 pa = relocW (va);                                       /* relocate */
 if (ADDR_IS_MEM (pa)) {                                 /* memory address? */
+    WATCH (pa, 1, SWMASK ('W'), data);
     if (va & 1)
         M[pa >> 1] = (M[pa >> 1] & 0377) | (data << 8);
     else M[pa >> 1] = (M[pa >> 1] & ~0377) | data;
+    SIM_MEM_DIRTY (&cpu_mem, pa);
     return;
     }             
 if (pa < IOPAGEBASE) {                                  /* not I/O address? */
@@ -2430,7 +2447,9 @@ return;
 void PWriteW (int32 data, int32 pa)
 {
 if (ADDR_IS_MEM (pa)) {                                 /* memory address? */
+    WATCH (pa, 2, SWMASK ('W'), data);
     M[pa >> 1] = data;
+    SIM_MEM_DIRTY (&cpu_mem, pa);
     return;
     }
 if (pa < IOPAGEBASE) {                                  /* not I/O address? */
@@ -2447,9 +2466,11 @@ return;
 void PWriteB (int32 data, int32 pa)
 {
 if (ADDR_IS_MEM (pa)) {                                 /* memory address? */
+    WATCH (pa, 1, SWMASK ('W'), data);
     if (pa & 1)
         M[pa >> 1] = (M[pa >> 1] & 0377) | (data << 8);
     else M[pa >> 1] = (M[pa >> 1] & ~0377) | data;
+    SIM_MEM_DIRTY (&cpu_mem, pa);
     return;
     }             
 if (pa < IOPAGEBASE) {                                  /* not I/O address? */
@@ -2995,13 +3016,16 @@ trap_req = 0;
 wait_state = 0;
 if (M == NULL)
     M = (uint16 *) calloc (MEMSIZE >> 1, sizeof (uint16));
-if (M == NULL)
+if ((M == NULL) ||
+    (sim_mem_register (&cpu_mem, &cpu_unit, (void **) &M, sizeof (*M),
+        1, MAXMEMSIZE) != SCPE_OK))
     return SCPE_MEM;
 pcq_r = find_reg ("PCQ", NULL, dptr);
 if (pcq_r)
     pcq_r->qptr = 0;
 else return SCPE_IERR;
-sim_brk_types = sim_brk_dflt = SWMASK ('E');
+sim_brk_types = SWMASK ('E') | SIM_BRK_WTYP;
+sim_brk_dflt = SWMASK ('E');
 set_r_display (0, MD_KER);
 return SCPE_OK;
 }
@@ -3046,6 +3070,7 @@ if (sw & SWMASK ('V')) {                                /* -v */
     }
 if (addr < MEMSIZE) {
     M[addr >> 1] = val & 0177777;
+    SIM_MEM_DIRTY (&cpu_mem, addr);
     return SCPE_OK;
     }
 if (addr < IOPAGEBASE)
@@ -3070,80 +3095,62 @@ rptr->loc = (void *) &STACKFILE[cm];
 return;
 }
 
+/* History records */
+
+static t_addr cpu_hist_pc (const void *rec)
+{
+return ((const InstHistory *) rec)->pc;
+}
+
+static t_value cpu_hist_opcode (const void *rec)
+{
+return ((const InstHistory *) rec)->inst[0];
+}
+
+static void cpu_hist_header (FILE *st)
+{
+fprintf (st, "PC     PSW     src    dst     IR\n\n");
+}
+
+static void cpu_hist_print (FILE *st, const void *rec)
+{
+const InstHistory *h = (const InstHistory *) rec;
+int32 j, ir = h->inst[0];
+t_value sim_eval[HIST_ILNT];
+
+fprintf (st, "%06o %06o|", h->pc, h->psw);
+if (((ir & 0070000) != 0) ||                            /* dops, eis, fpp */
+    ((ir & 0177000) == 0004000))                        /* jsr */
+    fprintf (st, "%06o %06o  ", h->src, h->dst);
+else if ((ir >= 0000100) &&                             /* not no opnd */
+    (((ir & 0007700) <  0000300) ||                     /* not branch */
+     ((ir & 0007700) >= 0004000)))
+    fprintf (st, "       %06o  ", h->dst);
+else fprintf (st, "               ");
+for (j = 0; j < HIST_ILNT; j++)
+    sim_eval[j] = h->inst[j];
+if ((fprint_sym (st, h->pc, sim_eval, &cpu_unit, SWMASK ('M'))) > 0)
+    fprintf (st, "(undefined) %06o", h->inst[0]);
+fputc ('\n', st);                                       /* end line */
+}
+
+static const SIM_HIST_SCHEMA cpu_hist_schema = {
+    "PDP-11", sizeof (InstHistory),
+    &cpu_hist_pc, &cpu_hist_opcode, &cpu_hist_header, &cpu_hist_print
+    };
+
 /* Set history */
 
 t_stat cpu_set_hist (UNIT *uptr, int32 val, char *cptr, void *desc)
 {
-int32 i, lnt;
-t_stat r;
-
-if (cptr == NULL) {
-    for (i = 0; i < hst_lnt; i++)
-        hst[i].pc = 0;
-    hst_p = 0;
-    return SCPE_OK;
-    }
-lnt = (int32) get_uint (cptr, 10, HIST_MAX, &r);
-if ((r != SCPE_OK) || (lnt && (lnt < HIST_MIN)))
-    return SCPE_ARG;
-hst_p = 0;
-if (hst_lnt) {
-    free (hst);
-    hst_lnt = 0;
-    hst = NULL;
-    }
-if (lnt) {
-    hst = (InstHistory *) calloc (lnt, sizeof (InstHistory));
-    if (hst == NULL)
-        return SCPE_MEM;
-    hst_lnt = lnt;
-    }
-return SCPE_OK;
+return sim_hist_set (&hst, &cpu_hist_schema, cptr);
 }
 
 /* Show history */
 
 t_stat cpu_show_hist (FILE *st, UNIT *uptr, int32 val, void *desc)
 {
-int32 j, k, di, lnt, ir;
-char *cptr = (char *) desc;
-t_value sim_eval[HIST_ILNT];
-t_stat r;
-InstHistory *h;
-
-if (hst_lnt == 0)                                       /* enabled? */
-    return SCPE_NOFNC;
-if (cptr) {
-    lnt = (int32) get_uint (cptr, 10, hst_lnt, &r);
-    if ((r != SCPE_OK) || (lnt == 0))
-        return SCPE_ARG;
-    }
-else lnt = hst_lnt;
-di = hst_p - lnt;                                       /* work forward */
-if (di < 0)
-    di = di + hst_lnt;
-fprintf (st, "PC     PSW     src    dst     IR\n\n");
-for (k = 0; k < lnt; k++) {                             /* print specified */
-    h = &hst[(di++) % hst_lnt];                         /* entry pointer */
-    if (h->pc & HIST_VLD) {                             /* instruction? */
-        ir = h->inst[0];
-        fprintf (st, "%06o %06o|", h->pc & ~HIST_VLD, h->psw);
-        if (((ir & 0070000) != 0) ||                    /* dops, eis, fpp */
-            ((ir & 0177000) == 0004000))                /* jsr */
-            fprintf (st, "%06o %06o  ", h->src, h->dst);
-        else if ((ir >= 0000100) &&                     /* not no opnd */
-            (((ir & 0007700) <  0000300) ||             /* not branch */
-             ((ir & 0007700) >= 0004000)))
-            fprintf (st, "       %06o  ", h->dst);
-        else fprintf (st, "               ");
-        for (j = 0; j < HIST_ILNT; j++)
-            sim_eval[j] = h->inst[j];
-        if ((fprint_sym (st, h->pc & ~HIST_VLD, sim_eval, &cpu_unit, SWMASK ('M'))) > 0)
-            fprintf (st, "(undefined) %06o", h->inst[0]);
-        fputc ('\n', st);                               /* end line */
-        }                                               /* end else instruction */
-    }                                                   /* end for */
-return SCPE_OK;
+return sim_hist_show (st, &hst, (char *) desc);
 }
 
 /* Virtual address translation */
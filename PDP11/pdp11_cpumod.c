@@ -83,6 +83,7 @@ uint8 toy_data[TOY_LNT] = { 0 };
 static int32 clk_tps_map[4] = { 60, 60, 50, 800 };
 
 extern uint16 *M;
+extern SIM_MEM cpu_mem;
 extern int32 R[8];
 extern DEVICE cpu_dev;
 extern UNIT cpu_unit;
@@ -1028,7 +1029,7 @@ struct tm *ctm;
 int32 bit;
 
 if (toy_state == 0) {
-    curr = time (NULL);                                 /* get curr time */
+    curr = sim_get_time (NULL);                         /* get curr time */
     if (curr == (time_t) -1)                            /* error? */
         return 0;
     ctm = localtime (&curr);                            /* decompose */
@@ -1163,6 +1164,7 @@ for (i = 0; i < clim; i = i + 2)
 free (M);
 M = nM;
 MEMSIZE = val;
+sim_mem_dirty (&cpu_mem, 0, MEMSIZE);                   /* all new */
 if (!(sim_switches & SIM_SW_REST))                      /* unless restore, */
     cpu_set_bus (cpu_opt);                              /* alter periph config */
 return SCPE_OK;
@@ -468,6 +468,7 @@ typedef struct {
 #define STOP_RQ         (TRAP_V_MAX + 6)                /* RQDX3 panic */
 #define STOP_SANITY     (TRAP_V_MAX + 7)                /* sanity timer exp */
 #define STOP_DTOFF      (TRAP_V_MAX + 8)                /* DECtape off reel */
+#define STOP_DBKPT      (TRAP_V_MAX + 9)                /* data breakpoint */
 #define IORETURN(f,v)   ((f)? (v): SCPE_OK)             /* cond error return */
 
 /* Timers */
@@ -757,6 +758,8 @@ int32 Map_ReadB (uint32 ba, int32 bc, uint8 *buf);
 int32 Map_ReadW (uint32 ba, int32 bc, uint16 *buf);
 int32 Map_WriteB (uint32 ba, int32 bc, uint8 *buf);
 int32 Map_WriteW (uint32 ba, int32 bc, uint16 *buf);
+void *Map_Host (uint32 ba, int32 bc, int32 *lbc);
+#define MAP_HOST        1                               /* Map_Host available */
 
 int32 mba_rdbufW (uint32 mbus, int32 bc, uint16 *buf);
 int32 mba_wrbufW (uint32 mbus, int32 bc, uint16 *buf);
@@ -52,6 +52,7 @@
 #include "pdp11_defs.h"
 
 extern uint16 *M;
+extern SIM_MEM cpu_mem;
 extern int32 int_req[IPL_HLVL];
 extern int32 ub_map[UBM_LNT_LW];
 extern uint32 cpu_opt;
@@ -313,6 +314,7 @@ if (cpu_bme) {                                          /* map enabled? */
         if (ma & 1) M[ma >> 1] = (M[ma >> 1] & 0377) |
             ((uint16) *buf++ << 8);
         else M[ma >> 1] = (M[ma >> 1] & ~0377) | *buf++;
+        SIM_MEM_DIRTY (&cpu_mem, ma);
         }
     return 0;
     }
@@ -322,6 +324,7 @@ else {                                                  /* physical */
     else if (ADDR_IS_MEM (ba))                          /* no, strt ok? */
         alim = cpu_memsize;
     else return bc;                                     /* no, err */
+    sim_mem_dirty (&cpu_mem, ba, alim - ba);
     for ( ; ba < alim; ba++) {                          /* by bytes */
         if (ba & 1)
             M[ba >> 1] = (M[ba >> 1] & 0377) | ((uint16) *buf++ << 8);
@@ -343,6 +346,7 @@ if (cpu_bme) {                                          /* map enabled? */
         if (!ADDR_IS_MEM (ma))                          /* NXM? err */
             return (lim - ba);
         M[ma >> 1] = *buf++;
+        SIM_MEM_DIRTY (&cpu_mem, ma);
         }
     return 0;
     }
@@ -352,6 +356,7 @@ else {                                                  /* physical */
     else if (ADDR_IS_MEM (ba))                          /* no, strt ok? */
         alim = cpu_memsize;
     else return bc;                                     /* no, err */
+    sim_mem_dirty (&cpu_mem, ba, alim - ba);
     for ( ; ba < alim; ba = ba + 2) {                   /* by words */
         M[ba >> 1] = *buf++;
         }
@@ -359,6 +364,44 @@ else {                                                  /* physical */
     }
 }
 
+/* Host access to DMA buffers
+
+   Map_Host returns a pointer into M[] for the longest run of bus
+   addresses, starting at ba and at most bc bytes long, which lies in
+   consecutive memory.  The run's byte count is stored in *lbc.  Devices
+   can transfer a run directly without a per word map lookup.  NULL is
+   returned if ba does not address memory; the caller then uses the
+   Map_ routines, which report the error.
+*/
+
+void *Map_Host (uint32 ba, int32 bc, int32 *lbc)
+{
+uint32 lim, ma, pg;
+
+ba = (ba & BUSMASK) & ~01;                              /* trim, align addr */
+lim = ba + (bc & ~01);
+*lbc = 0;
+if (cpu_bme) {                                          /* map enabled? */
+    ma = Map_Addr (ba);                                 /* map addr */
+    for (pg = (ba | UBM_M_OFF) + 1; pg < lim; pg = pg + UBM_PAGSIZE) {
+        if (Map_Addr (pg) != (ma + (pg - ba)))          /* next page elsewhere? */
+            break;
+        }
+    if (pg < lim)
+        lim = pg;
+    }
+else ma = ba;                                           /* physical */
+if (!ADDR_IS_MEM (ma) || (lim <= ba))                   /* NXM? err */
+    return NULL;
+if (!ADDR_IS_MEM (ma + (lim - ba) - 1))                 /* trim at end of mem */
+    lim = ba + (cpu_memsize - ma);
+if (cpu_bme)
+    Map_Addr (lim - 2);                                 /* last addr as per word */
+*lbc = lim - ba;
+sim_mem_dirty (&cpu_mem, ma, lim - ba);                 /* caller may write */
+return &M[ma >> 1];
+}
+
 /* Build tables from device list */
 
 t_stat build_dib_tab (void)
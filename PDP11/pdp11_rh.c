@@ -162,6 +162,7 @@ MBACTX massbus[MBA_NUM];
 extern uint32 cpu_opt;
 extern int32 cpu_bme;
 extern uint16 *M;
+extern SIM_MEM cpu_mem;
 extern int32 int_req[IPL_HLVL];
 extern t_addr cpu_memsize;
 
@@ -561,6 +562,7 @@ for (i = 0; i < bc; i = i + pbc) {                      /* loop by pages */
         pbc = bc - i;
     for (j = 0; j < pbc; j = j + 2) {                   /* loop by words */
         M[pa >> 1] = *buf++;                            /* put word */
+        SIM_MEM_DIRTY (&cpu_mem, pa);
         if (!(massbus[mb].cs2 & CS2_UAI)) {             /* if not inhb */
             ba = ba + 2;                                /* incr ba, pa */
             pa = pa + 2;
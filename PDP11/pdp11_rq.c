@@ -152,6 +152,8 @@ extern uint32 cpu_opt;
 #define RQ_NUMBY        512                             /* bytes per block */
 #define RQ_MAXFR        (1 << 16)                       /* max xfer */
 #define RQ_MAPXFER      (1 << 31)                       /* mapped xfer */
+#define RQ_MAXSG        ((RQ_MAXFR / RQ_NUMBY) + 1)     /* max host segments */
+#define RQ_MAXQD        16                              /* max xfers in flight per unit */
 #define RQ_M_PFN        0x1FFFFF                        /* map entry PFN */
 
 #define UNIT_V_ONL      (UNIT_V_UF + 0)                 /* online */
@@ -173,6 +175,8 @@ extern uint32 cpu_opt;
 #define io_status       u5                              /* io status from callback */
 #define io_complete     u6                              /* io completion flag */
 #define rqxb            filebuf                         /* xfer buffer */
+#define rqsg            up7                             /* host memory segments */
+#define rqsgn           hwmark                          /* segments in use (0 = via rqxb) */
 #define UNIT_WPRT       (UNIT_WLK | UNIT_RO)            /* write prot */
 #define RQ_RMV(u)       ((drv_tab[GET_DTYPE (u->flags)].flgs & RQDF_RMV)? \
                         UF_RMV: 0)
@@ -728,6 +732,16 @@ typedef struct {
     struct uq_ring      cq;                             /* cmd ring */
     struct uq_ring      rq;                             /* rsp ring */
     struct rqpkt        pak[RQ_NPKTS];                  /* packet queue */
+    uint32              qdepth[RQ_NUMDR];               /* xfers in flight per unit */
+    int32               xq[RQ_NUMDR];                   /* xfers started ahead of turn */
+    int32               ioq[RQ_NUMDR][RQ_MAXQD];        /* pkts with disk requests, in order */
+    uint32              ioqh[RQ_NUMDR];                 /* oldest disk request */
+    uint32              ioqn[RQ_NUMDR];                 /* disk requests outstanding */
+    DISK_SG             *xsg[RQ_NPKTS];                 /* early xfer host segments */
+    uint32              xsgn[RQ_NPKTS];                 /* early xfer segments in use */
+    uint32              xstart[RQ_NPKTS];               /* early xfer start time */
+    t_stat              xsts[RQ_NPKTS];                 /* early xfer status */
+    t_bool              xdone[RQ_NPKTS];                /* early xfer complete */
     } MSC;
 
 /* debugging bitmaps */
@@ -798,6 +812,8 @@ t_stat rq_show_ctype (FILE *st, UNIT *uptr, int32 val, void *desc);
 t_stat rq_show_wlk (FILE *st, UNIT *uptr, int32 val, void *desc);
 t_stat rq_show_ctrl (FILE *st, UNIT *uptr, int32 val, void *desc);
 t_stat rq_show_unitq (FILE *st, UNIT *uptr, int32 val, void *desc);
+t_stat rq_set_qdepth (UNIT *uptr, int32 val, char *cptr, void *desc);
+t_stat rq_show_qdepth (FILE *st, UNIT *uptr, int32 val, void *desc);
 t_stat rq_help (FILE *st, DEVICE *dptr, UNIT *uptr, int32 flag, char *cptr);
 char *rq_description (DEVICE *dptr);
 
@@ -825,11 +841,18 @@ t_bool rq_putpkt (MSC *cp, int32 pkt, t_bool qt);
 t_bool rq_getdesc (MSC *cp, struct uq_ring *ring, uint32 *desc);
 t_bool rq_putdesc (MSC *cp, struct uq_ring *ring, uint32 desc);
 int32 rq_rw_valid (MSC *cp, int32 pkt, UNIT *uptr, uint32 cmd);
+void rq_rw_init (MSC *cp, int32 pkt);
+t_bool rq_rw_ahead (MSC *cp, int32 pkt, UNIT *uptr, uint32 cmd);
+void rq_rw_next (MSC *cp, UNIT *uptr);
 t_bool rq_rw_end (MSC *cp, UNIT *uptr, uint32 flg, uint32 sts);
+void rq_io_complete (UNIT *uptr, t_stat status);
+void rq_ioq_add (MSC *cp, UNIT *uptr, int32 pkt);
+void rq_ioq_void (MSC *cp, UNIT *uptr, int32 pkt);
 uint32 rq_map_ba (uint32 ba, uint32 ma);
 int32 rq_readb (uint32 ba, int32 bc, uint32 ma, uint8 *buf);
 int32 rq_readw (uint32 ba, int32 bc, uint32 ma, uint16 *buf);
 int32 rq_writew (uint32 ba, int32 bc, uint32 ma, uint16 *buf);
+uint32 rq_host_sg (uint32 ba, int32 bc, uint32 ma, DISK_SG *sg);
 void rq_putr (MSC *cp, int32 pkt, uint32 cmd, uint32 flg,
     uint32 sts, uint32 lnt, uint32 typ);
 void rq_putr_unit (MSC *cp, int32 pkt, UNIT *uptr, uint32 lu, t_bool all);
@@ -989,7 +1012,17 @@ MTAB rq_mod[] = {
     { UNIT_NOAUTO, UNIT_NOAUTO, "noautosize", "NOAUTOSIZE", NULL, NULL, NULL, "Disables disk autosize on attach" },
     { UNIT_NOAUTO,           0, "autosize",   "AUTOSIZE",   NULL, NULL, NULL, "Enables disk autosize on attach" },
     { MTAB_XTD|MTAB_VUN, 0, "FORMAT", "FORMAT",
-      &sim_disk_set_fmt, &sim_disk_show_fmt, NULL, "Set/Display disk format (SIMH, VHD, RAW)" },
+      &sim_disk_set_fmt, &sim_disk_show_fmt, NULL, "Set/Display disk format (SIMH, VHD, RAW, DEDUP)" },
+    { MTAB_XTD|MTAB_VUN|MTAB_VALR|MTAB_NMO, 0, "IOENGINE", "IOENGINE",
+      &sim_disk_set_ioengine, &sim_disk_show_ioengine, NULL, "Set/Display host transfer engine (STDIO, URING, DIRECT, MMAP)" },
+    { MTAB_XTD|MTAB_VUN|MTAB_VALR|MTAB_NMO, 0, "OVERLAY", "OVERLAY",
+      &sim_disk_set_overlay, &sim_disk_show_overlay, NULL, "Commit or discard (COMMIT, DISCARD)/Display copy-on-write overlay" },
+    { MTAB_XTD|MTAB_VUN|MTAB_NMO, 1, "CACHE", "CACHE",
+      &sim_disk_set_cache, &sim_disk_show_cache, NULL, "Use the host sector cache/Display sector cache statistics" },
+    { MTAB_XTD|MTAB_VUN|MTAB_NMO, 0, NULL, "NOCACHE",
+      &sim_disk_set_cache, NULL, NULL, "Don't use the host sector cache" },
+    { MTAB_XTD|MTAB_VUN|MTAB_VALR, 0, "QDEPTH", "QDEPTH",
+      &rq_set_qdepth, &rq_show_qdepth, NULL, "Set/Display transfers in flight per drive (1 to 16)" },
 #if defined (VM_PDP11)
     { MTAB_XTD|MTAB_VDV|MTAB_VALR, 004, "ADDRESS", "ADDRESS",
       &set_addr, &show_addr, NULL, "Bus address" },
@@ -1604,6 +1637,9 @@ if ((uptr = rq_getucb (cp, lu))) {                      /* get unit */
         tpkt = uptr->cpkt;                              /* save match */
         uptr->cpkt = 0;                                 /* gonzo */
         sim_cancel (uptr);                              /* cancel unit */
+        rq_ioq_void (cp, uptr, tpkt);                   /* ignore its completion */
+        uptr->io_complete = 0;
+        rq_rw_next (cp, uptr);                          /* next xfer in flight */
         sim_activate (dptr->units + RQ_QUEUE, rq_qtime);
         }
     else if (uptr->pktq &&                              /* head of q? */
@@ -1880,6 +1916,10 @@ sim_debug (DBG_TRC, rq_devmap[cp->cnum], "rq_rw(lu=%d, pkt=%d, queue=%s)\n", lu,
 
 if ((uptr = rq_getucb (cp, lu))) {                      /* unit exist? */
     if (q && uptr->cpkt) {                              /* need to queue? */
+        if (rq_rw_ahead (cp, pkt, uptr, cmd)) {         /* or start now? */
+            sim_debug (DBG_TRC, rq_devmap[cp->cnum], "rq_rw - started ahead\n");
+            return OK;
+            }
         sim_debug (DBG_TRC, rq_devmap[cp->cnum], "rq_rw - queued\n");
         rq_enqt (cp, &uptr->pktq, pkt);                 /* do later */
         return OK;
@@ -1887,14 +1927,7 @@ if ((uptr = rq_getucb (cp, lu))) {                      /* unit exist? */
     sts = rq_rw_valid (cp, pkt, uptr, cmd);             /* validity checks */
     if (sts == 0) {                                     /* ok? */
         uptr->cpkt = pkt;                               /* op in progress */
-        cp->pak[pkt].d[RW_WBAL] = cp->pak[pkt].d[RW_BAL];
-        cp->pak[pkt].d[RW_WBAH] = cp->pak[pkt].d[RW_BAH];
-        cp->pak[pkt].d[RW_WBCL] = cp->pak[pkt].d[RW_BCL];
-        cp->pak[pkt].d[RW_WBCH] = cp->pak[pkt].d[RW_BCH];
-        cp->pak[pkt].d[RW_WBLL] = cp->pak[pkt].d[RW_LBNL];
-        cp->pak[pkt].d[RW_WBLH] = cp->pak[pkt].d[RW_LBNH];
-        cp->pak[pkt].d[RW_WMPL] = cp->pak[pkt].d[RW_MAPL];
-        cp->pak[pkt].d[RW_WMPH] = cp->pak[pkt].d[RW_MAPH];
+        rq_rw_init (cp, pkt);                           /* init work fields */
         uptr->iostarttime = sim_grtime();
         sim_activate (uptr, 0);                         /* activate */
         sim_debug (DBG_TRC, rq_devmap[cp->cnum], "rq_rw - started\n");
@@ -1907,6 +1940,95 @@ rq_putr (cp, pkt, cmd | OP_END, 0, sts, RW_LNT_D, UQ_TYP_SEQ);
 return rq_putpkt (cp, pkt, TRUE);
 }
 
+/* Initialize a transfer's work fields */
+
+void rq_rw_init (MSC *cp, int32 pkt)
+{
+cp->pak[pkt].d[RW_WBAL] = cp->pak[pkt].d[RW_BAL];
+cp->pak[pkt].d[RW_WBAH] = cp->pak[pkt].d[RW_BAH];
+cp->pak[pkt].d[RW_WBCL] = cp->pak[pkt].d[RW_BCL];
+cp->pak[pkt].d[RW_WBCH] = cp->pak[pkt].d[RW_BCH];
+cp->pak[pkt].d[RW_WBLL] = cp->pak[pkt].d[RW_LBNL];
+cp->pak[pkt].d[RW_WBLH] = cp->pak[pkt].d[RW_LBNH];
+cp->pak[pkt].d[RW_WMPL] = cp->pak[pkt].d[RW_MAPL];
+cp->pak[pkt].d[RW_WMPH] = cp->pak[pkt].d[RW_MAPH];
+}
+
+/* Start a transfer while the unit is busy with another
+
+   With a queue depth above one, a read or write which can move directly
+   between the disk and memory in a single request is handed to the disk
+   at once, rather than queued, provided nothing is queued ahead of it and
+   a request slot remains for the current transfer.  It is completed when
+   it becomes the current transfer, in the order the commands arrived.
+*/
+
+t_bool rq_rw_ahead (MSC *cp, int32 pkt, UNIT *uptr, uint32 cmd)
+{
+uint32 un = (uint32) (uptr - rq_devmap[cp->cnum]->units);
+uint32 ba = GETP32 (pkt, RW_BAL);                       /* buf addr */
+uint32 bc = GETP32 (pkt, RW_BCL);                       /* byte count */
+uint32 bl = GETP32 (pkt, RW_LBNL);                      /* block addr */
+uint32 ma = GETP32 (pkt, RW_MAPL);                      /* map addr */
+uint32 i, n, nsg;
+
+if ((un >= RQ_NUMDR) || uptr->pktq ||                   /* others waiting? */
+    ((cmd != OP_RD) && (cmd != OP_WR)) ||               /* not rd/wr? */
+    (bc == 0) || (bc > RQ_MAXFR) || (bc % RQ_NUMBY) ||  /* not one whole xfer? */
+    (DBG_DAT & rq_devmap[cp->cnum]->dctrl))             /* tracing data? */
+    return FALSE;
+n = cp->ioqn[un];                                       /* requests in flight */
+for (i = 0; i < cp->ioqn[un]; i++) {                    /* current one among them? */
+    if (cp->ioq[un][(cp->ioqh[un] + i) % RQ_MAXQD] == uptr->cpkt)
+        break;
+    }
+if (i == cp->ioqn[un])                                  /* no, keep it a slot */
+    n = n + 1;
+if ((n >= cp->qdepth[un]) ||                            /* no slot free? */
+    (rq_rw_valid (cp, pkt, uptr, cmd) != 0))            /* let it fail in turn */
+    return FALSE;
+if ((cp->xsg[pkt] == NULL) &&
+    ((cp->xsg[pkt] = (DISK_SG *) malloc (RQ_MAXSG * sizeof (DISK_SG))) == NULL))
+    return FALSE;
+if ((nsg = rq_host_sg (ba, bc, ma, cp->xsg[pkt])) == 0) /* not all in memory? */
+    return FALSE;
+rq_rw_init (cp, pkt);                                   /* init work fields */
+cp->xsgn[pkt] = nsg;
+cp->xstart[pkt] = sim_grtime();
+cp->xdone[pkt] = FALSE;
+rq_enqt (cp, &cp->xq[un], pkt);                         /* in flight, in order */
+rq_ioq_add (cp, uptr, pkt);
+if (cmd == OP_WR)
+    sim_disk_wrsect_sg_a (uptr, bl, cp->xsg[pkt], nsg, NULL, bc / RQ_NUMBY, rq_io_complete);
+else
+    sim_disk_rdsect_sg_a (uptr, bl, cp->xsg[pkt], nsg, NULL, bc / RQ_NUMBY, rq_io_complete);
+return TRUE;
+}
+
+/* Make the oldest transfer started ahead of its turn the current one */
+
+void rq_rw_next (MSC *cp, UNIT *uptr)
+{
+uint32 un = (uint32) (uptr - rq_devmap[cp->cnum]->units);
+int32 pkt;
+void *sg;
+
+if (uptr->cpkt || (un >= RQ_NUMDR) || (cp->xq[un] == 0))
+    return;
+pkt = rq_deqh (cp, &cp->xq[un]);
+uptr->cpkt = pkt;                                       /* op in progress */
+sg = uptr->rqsg;                                        /* take its segments */
+uptr->rqsg = cp->xsg[pkt];
+cp->xsg[pkt] = (DISK_SG *) sg;
+uptr->rqsgn = cp->xsgn[pkt];
+uptr->iostarttime = cp->xstart[pkt];
+if (cp->xdone[pkt]) {                                   /* already done? */
+    uptr->io_status = cp->xsts[pkt];
+    uptr->io_complete = 1;
+    sim_activate_notbefore (uptr, uptr->iostarttime+rq_xtime);
+    }                                                   /* else at callback */
+}
+
 /* Validity checks */
 
 int32 rq_rw_valid (MSC *cp, int32 pkt, UNIT *uptr, uint32 cmd)
@@ -1952,15 +2074,56 @@ return 0;                                               /* success! */
 void rq_io_complete (UNIT *uptr, t_stat status)
 {
 MSC *cp = rq_ctxmap[uptr->cnum];
+uint32 un = (uint32) (uptr - rq_devmap[cp->cnum]->units);
+int32 pkt = uptr->cpkt;
 
 sim_debug (DBG_TRC, rq_devmap[cp->cnum], "rq_io_complete(status=%d)\n", status);
 
+if ((un < RQ_NUMDR) && cp->ioqn[un]) {                  /* whose request? */
+    pkt = cp->ioq[un][cp->ioqh[un]];                    /* oldest, disk keeps order */
+    cp->ioqh[un] = (cp->ioqh[un] + 1) % RQ_MAXQD;
+    cp->ioqn[un] = cp->ioqn[un] - 1;
+    }
+if (pkt == 0)                                           /* aborted? */
+    return;
+if (pkt != uptr->cpkt) {                                /* started ahead of turn? */
+    cp->xsts[pkt] = status;
+    cp->xdone[pkt] = TRUE;
+    return;
+    }
 uptr->io_status = status;
 uptr->io_complete = 1;
 /* Reschedule for the appropriate delay */
 sim_activate_notbefore (uptr, uptr->iostarttime+rq_xtime);
 }
 
+/* Note a packet's disk request; the disk completes requests in order */
+
+void rq_ioq_add (MSC *cp, UNIT *uptr, int32 pkt)
+{
+uint32 un = (uint32) (uptr - rq_devmap[cp->cnum]->units);
+
+if (un >= RQ_NUMDR)
+    return;
+cp->ioq[un][(cp->ioqh[un] + cp->ioqn[un]) % RQ_MAXQD] = pkt;
+cp->ioqn[un] = cp->ioqn[un] + 1;
+}
+
+/* Forget a packet's outstanding disk requests */
+
+void rq_ioq_void (MSC *cp, UNIT *uptr, int32 pkt)
+{
+uint32 un = (uint32) (uptr - rq_devmap[cp->cnum]->units);
+uint32 i;
+
+if (un >= RQ_NUMDR)
+    return;
+for (i = 0; i < cp->ioqn[un]; i++) {
+    if ((pkt == 0) || (cp->ioq[un][(cp->ioqh[un] + i) % RQ_MAXQD] == pkt))
+        cp->ioq[un][(cp->ioqh[un] + i) % RQ_MAXQD] = 0;
+    }
+}
+
 /* Map buffer address */
 
 uint32 rq_map_ba (uint32 ba, uint32 ma)
@@ -2055,6 +2218,51 @@ if (ba & RQ_MAPXFER) {                                  /* mapped xfer? */
 return Map_WriteW (ba, bc, buf);                        /* unmapped xfer */
 }
 
+/* Describe a transfer buffer as runs of host memory
+
+   When every byte of the buffer is in memory, the runs are stored in
+   sg and their number is returned, so that the disk data can move
+   directly between the container and memory.  Otherwise 0 is returned
+   and the transfer goes through the unit's buffer and the Map_ routines.
+*/
+
+uint32 rq_host_sg (uint32 ba, int32 bc, uint32 ma, DISK_SG *sg)
+{
+#if defined (MAP_HOST)
+int32 lbc, hbc, tbc = 0;
+uint32 pba, n = 0;
+uint8 *host;
+
+while (tbc < bc) {
+    pba = ba;
+    lbc = bc - tbc;
+#if defined (VM_VAX)                                    /* VAX version */
+    if (ba & RQ_MAPXFER) {                              /* mapped xfer? */
+        if (!(pba = rq_map_ba (ba, ma)))                /* get physical ba */
+            return 0;
+        lbc = 0x200 - (ba & VA_M_OFF);                  /* bc for this page */
+        if (lbc > (bc - tbc)) lbc = (bc - tbc);
+        }
+#endif
+    if (!(host = (uint8 *) Map_Host (pba, lbc, &hbc)))  /* NXM? */
+        return 0;
+    if (n && (((uint8 *) sg[n - 1].buf) + sg[n - 1].len == host))
+        sg[n - 1].len += hbc;                           /* extends last run */
+    else {
+        if (n == RQ_MAXSG)
+            return 0;
+        sg[n].buf = host;
+        sg[n++].len = hbc;
+        }
+    tbc += hbc;
+    ba += hbc;
+    }
+return n;
+#else
+return 0;
+#endif
+}
+
 /* Unit service for data transfer commands */
 
 t_stat rq_svc (UNIT *uptr)
@@ -2098,10 +2306,23 @@ if ((cmd == OP_ERS) || (cmd == OP_WR)) {                /* write op? */
     }
 
 if (!uptr->io_complete) { /* Top End (I/O Initiation) Processing */
-    if (cmd == OP_ERS) {                                /* erase? */
+    uptr->rqsgn = 0;
+    if (((cmd == OP_WR) || (cmd == OP_RD)) &&           /* whole blocks, not traced? */
+        ((tbc % RQ_NUMBY) == 0) && !(DBG_DAT & rq_devmap[cp->cnum]->dctrl))
+        uptr->rqsgn = rq_host_sg (ba, tbc, ma, (DISK_SG *) uptr->rqsg);
+    if (uptr->rqsgn) {                                  /* direct to memory? */
+        rq_ioq_add (cp, uptr, pkt);
+        if (cmd == OP_WR)
+            err = sim_disk_wrsect_sg_a (uptr, bl, (DISK_SG *) uptr->rqsg, uptr->rqsgn, NULL, tbc / RQ_NUMBY, rq_io_complete);
+        else
+            err = sim_disk_rdsect_sg_a (uptr, bl, (DISK_SG *) uptr->rqsg, uptr->rqsgn, NULL, tbc / RQ_NUMBY, rq_io_complete);
+        }
+
+    else if (cmd == OP_ERS) {                           /* erase? */
         wwc = ((tbc + (RQ_NUMBY - 1)) & ~(RQ_NUMBY - 1)) >> 1;
         memset (uptr->rqxb, 0, wwc * sizeof(uint16));   /* clr buf */
         sim_disk_data_trace(uptr, uptr->rqxb, bl, wwc << 1, "sim_disk_wrsect-ERS", DBG_DAT & rq_devmap[cp->cnum]->dctrl, DBG_REQ);
+        rq_ioq_add (cp, uptr, pkt);
         err = sim_disk_wrsect_a (uptr, bl, uptr->rqxb, NULL, (wwc << 1) / RQ_NUMBY, rq_io_complete);
         }
 
@@ -2112,11 +2333,13 @@ if (!uptr->io_complete) { /* Top End (I/O Initiation) Processing */
             for (i = (abc >> 1); i < wwc; i++)
                 ((uint16 *)(uptr->rqxb))[i] = 0;
             sim_disk_data_trace(uptr, uptr->rqxb, bl, wwc << 1, "sim_disk_wrsect-WR", DBG_DAT & rq_devmap[cp->cnum]->dctrl, DBG_REQ);
+            rq_ioq_add (cp, uptr, pkt);
             err = sim_disk_wrsect_a (uptr, bl, uptr->rqxb, NULL, (wwc << 1) / RQ_NUMBY, rq_io_complete);
             }
         }
 
     else {  /* OP_RD & OP_CMP */
+        rq_ioq_add (cp, uptr, pkt);
         err = sim_disk_rdsect_a (uptr, bl, uptr->rqxb, NULL, (tbc + RQ_NUMBY - 1) / RQ_NUMBY, rq_io_complete);
         }                                               /* end else read */
     return SCPE_OK;                                     /* done for now until callback */    
@@ -2124,7 +2347,12 @@ if (!uptr->io_complete) { /* Top End (I/O Initiation) Processing */
 else { /* Bottom End (After I/O processing) */
     uptr->io_complete = 0;
     err = uptr->io_status;
-    if (cmd == OP_ERS) {                                /* erase? */
+    if ((cmd == OP_ERS) || uptr->rqsgn) {               /* erase or direct? */
+        if (cmd == OP_RD) {                             /* mark memory read into */
+            for (i = 0; i < (uint32) uptr->rqsgn; i++)  /* since a SAVE may have */
+                sim_mem_dirty_host (((DISK_SG *) uptr->rqsg)[i].buf,    /* come between */
+                                    ((DISK_SG *) uptr->rqsg)[i].len);
+            }
         }
 
     else if (cmd == OP_WR) {                            /* write? */
@@ -2202,6 +2430,7 @@ DEVICE *dptr = rq_devmap[uptr->cnum];
 sim_debug (DBG_TRC, rq_devmap[cp->cnum], "rq_rw_end\n");
 
 uptr->cpkt = 0;                                         /* done */
+rq_rw_next (cp, uptr);                                  /* next xfer in flight */
 PUTP32 (pkt, RW_BCL, bc - wbc);                         /* bytes processed */
 cp->pak[pkt].d[RW_WBAL] = 0;                            /* clear temps */
 cp->pak[pkt].d[RW_WBAH] = 0;
@@ -2760,11 +2989,20 @@ return SCPE_OK;
 t_stat rq_attach (UNIT *uptr, char *cptr)
 {
 MSC *cp = rq_ctxmap[uptr->cnum];
+uint32 un = (uint32) (uptr - rq_devmap[cp->cnum]->units);
+char qd[16];
 t_stat r;
 
 r = sim_disk_attach (uptr, cptr, RQ_NUMBY, sizeof (uint16), (uptr->flags & UNIT_NOAUTO), DBG_DSK, drv_tab[GET_DTYPE (uptr->flags)].name, 0, 0);
 if (r != SCPE_OK)
     return r;
+if (un < RQ_NUMDR) {
+    cp->ioqh[un] = cp->ioqn[un] = 0;                    /* no disk requests */
+    if (cp->qdepth[un] > 1) {                           /* several in flight? */
+        sprintf (qd, "%d", cp->qdepth[un]);
+        sim_disk_set_qdepth (uptr, 0, qd, NULL);
+        }
+    }
 
 if ((cp->csta == CST_UP) && sim_disk_isavailable (uptr))
     uptr->flags = uptr->flags | UNIT_ATP;
@@ -2841,6 +3079,9 @@ rq_clrint (cp);                                         /* clr intr req */
 for (i = 0; i < (RQ_NUMDR + 2); i++) {                  /* init units */
     uptr = dptr->units + i;
     sim_cancel (uptr);                                  /* clr activity */
+    rq_ioq_void (cp, uptr, 0);                          /* ignore completions */
+    if (i < RQ_NUMDR)
+        cp->xq[i] = 0;                                  /* nothing in flight */
     sim_disk_reset (uptr);
     uptr->cnum = cidx;                                  /* set ctrl index */
     uptr->flags = uptr->flags & ~(UNIT_ONL | UNIT_ATP);
@@ -2849,6 +3090,9 @@ for (i = 0; i < (RQ_NUMDR + 2); i++) {                  /* init units */
     uptr->rqxb = (uint16 *) realloc (uptr->rqxb, (RQ_MAXFR >> 1) * sizeof (uint16));
     if (uptr->rqxb == NULL)
         return SCPE_MEM;
+    uptr->rqsg = realloc (uptr->rqsg, RQ_MAXSG * sizeof (DISK_SG));
+    if (uptr->rqsg == NULL)
+        return SCPE_MEM;
     }
 return auto_config (0, 0);                              /* run autoconfig */
 }
@@ -3023,6 +3267,12 @@ if ((uptr->flags & UNIT_ONL) == 0) {
 if (uptr->cpkt) {
     fprintf (st, "Unit %d current ", u);
     rq_show_pkt (st, cp, uptr->cpkt);
+    if ((u < RQ_NUMDR) && (pkt = cp->xq[u])) {
+        do {
+            fprintf (st, "Unit %d in flight ", u);
+            rq_show_pkt (st, cp, pkt);
+            } while ((pkt = cp->pak[pkt].link));
+        }
     if ((pkt = uptr->pktq)) {
         do {
             fprintf (st, "Unit %d queued ", u);
@@ -3034,6 +3284,42 @@ else fprintf (st, "Unit %d queues are empty\n", u);
 return SCPE_OK;
 }
 
+/* Set transfers in flight per drive */
+
+t_stat rq_set_qdepth (UNIT *uptr, int32 val, char *cptr, void *desc)
+{
+MSC *cp = rq_ctxmap[uptr->cnum];
+uint32 un = (uint32) (uptr - rq_devmap[cp->cnum]->units);
+uint32 depth;
+t_stat r;
+
+if (un >= RQ_NUMDR)
+    return SCPE_NOFNC;
+if ((cptr == NULL) || (*cptr == 0))
+    return SCPE_ARG;
+depth = (uint32) get_uint (cptr, 10, RQ_MAXQD, &r);
+if ((r != SCPE_OK) || (depth == 0))
+    return SCPE_ARG;
+if ((uptr->flags & UNIT_ATT) &&                         /* attached? tell disk */
+    ((r = sim_disk_set_qdepth (uptr, val, cptr, desc)) != SCPE_OK))
+    return r;
+cp->qdepth[un] = depth;
+return SCPE_OK;
+}
+
+/* Show transfers in flight per drive */
+
+t_stat rq_show_qdepth (FILE *st, UNIT *uptr, int32 val, void *desc)
+{
+MSC *cp = rq_ctxmap[uptr->cnum];
+uint32 un = (uint32) (uptr - rq_devmap[cp->cnum]->units);
+
+if (uptr->flags & UNIT_ATT)
+    return sim_disk_show_qdepth (st, uptr, val, desc);
+fprintf (st, "queue depth=%d", ((un < RQ_NUMDR) && cp->qdepth[un])? cp->qdepth[un]: 1);
+return SCPE_OK;
+}
+
 t_stat rq_show_ctrl (FILE *st, UNIT *uptr, int32 val, void *desc)
 {
 MSC *cp = rq_ctxmap[uptr->cnum];
@@ -198,7 +198,8 @@ const char *sim_stop_messages[] = {
     "Trap stack push abort",
     "RQDX3 consistency error",
     "Sanity timer expired",
-    "DECtape off reel"
+    "DECtape off reel",
+    "Data breakpoint"
     };
 
 /* Binary loader.
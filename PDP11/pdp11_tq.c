@@ -502,9 +502,17 @@ MTAB tq_mod[] = {
     { MTAB_XTD|MTAB_VUN|MTAB_NMO, 0,        "UNITQ", NULL,
         NULL, &tq_show_unitq, NULL, "Display unit queue" },
     { MTAB_XTD|MTAB_VUN|MTAB_VALR, 0,       "FORMAT", "FORMAT",
-        &sim_tape_set_fmt, &sim_tape_show_fmt, NULL, "Set/Display tape format (SIMH, E11, TPC, P7B)" },
+        &sim_tape_set_fmt, &sim_tape_show_fmt, NULL, "Set/Display tape format (SIMH, E11, TPC, P7B, COMPRESSED)" },
     { MTAB_XTD|MTAB_VUN|MTAB_VALR, 0,       "CAPACITY", "CAPACITY",
         &sim_tape_set_capac, &sim_tape_show_capac, NULL, "Set/Display capacity" },
+    { MTAB_XTD|MTAB_VUN|MTAB_NMO, 1,        "INDEX", "INDEX",
+        &sim_tape_set_index, &sim_tape_show_index, NULL, "Index records for fast spacing/Display index statistics" },
+    { MTAB_XTD|MTAB_VUN|MTAB_NMO, 0,        NULL, "NOINDEX",
+        &sim_tape_set_index, NULL, NULL, "Discard the record index" },
+    { MTAB_XTD|MTAB_VUN|MTAB_NMO, 1,        "STREAM", "STREAM",
+        &sim_tape_set_stream, &sim_tape_show_stream, NULL, "Stream tape data through large buffers/Display streaming statistics" },
+    { MTAB_XTD|MTAB_VUN|MTAB_NMO, 0,        NULL, "NOSTREAM",
+        &sim_tape_set_stream, NULL, NULL, "Read and write tape data directly" },
 #if defined (VM_PDP11)
     { MTAB_XTD|MTAB_VDV|MTAB_VALR, 004,     "ADDRESS", "ADDRESS",
         &set_addr, &show_addr, NULL, "Bus address" },
@@ -316,7 +316,7 @@ MTAB tu_mod[] = {
     { UNIT_TYPE, UNIT_TU77, "TU77", "TU77", 
         NULL, NULL, NULL, "Set drive type to TU77" },
     { MTAB_XTD|MTAB_VUN|MTAB_VALR, 0,       "FORMAT", "FORMAT",
-        &sim_tape_set_fmt, &sim_tape_show_fmt, NULL, "Set/Display tape format (SIMH, E11, TPC, P7B)" },
+        &sim_tape_set_fmt, &sim_tape_show_fmt, NULL, "Set/Display tape format (SIMH, E11, TPC, P7B, COMPRESSED)" },
     { MTAB_XTD|MTAB_VUN|MTAB_VALR, 0,       "CAPACITY", "CAPACITY",
         &sim_tape_set_capac, &sim_tape_show_capac, NULL, "Set unit n capacity to arg MB (0 = unlimited)" },
     { MTAB_XTD|MTAB_VUN|MTAB_NMO, 0,        "CAPACITY", NULL,
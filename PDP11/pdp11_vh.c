@@ -757,21 +757,24 @@ static t_stat vh_putc ( int32   vh,
 
 static void vh_getc (   int32   vh  )
 {
-    uint32  i, c;
+    uint32  i;
+    int32   j, n, c[FIFO_SIZE];
     TMLX    *lp;
 
     for (i = 0; i < (uint32)VH_LINES; i++) {
         lp = &vh_parm[(vh * VH_LINES) + i];
-        while ((c = tmxr_getc_ln (lp->tmln)) != 0) {
-            if (c & SCPE_BREAK) {
-                fifo_put (vh, lp,
-                    RBUF_FRAME_ERR | RBUF_PUTLINE (i));
-                /* BUG: check for overflow above */
-            } else {
-                c &= bitmask[(lp->lpr >> LPR_V_CHAR_LGTH) &
-                    LPR_M_CHAR_LGTH];
-                fifo_put (vh, lp, RBUF_PUTLINE (i) | c);
-                /* BUG: check for overflow above */
+        while ((n = tmxr_get_block_ln (lp->tmln, c, FIFO_SIZE)) != 0) {
+            for (j = 0; j < n; j++) {
+                if (c[j] & SCPE_BREAK) {
+                    fifo_put (vh, lp,
+                        RBUF_FRAME_ERR | RBUF_PUTLINE (i));
+                    /* BUG: check for overflow above */
+                } else {
+                    c[j] &= bitmask[(lp->lpr >> LPR_V_CHAR_LGTH) &
+                        LPR_M_CHAR_LGTH];
+                    fifo_put (vh, lp, RBUF_PUTLINE (i) | c[j]);
+                    /* BUG: check for overflow above */
+                }
             }
         }
     }
@@ -1142,18 +1145,54 @@ static t_stat vh_wr (   int32   data,
 static void doDMA ( int32   vh,
             int32   chan    )
 {
-    int32   line, status;
+    int32   line, status, maint;
     uint32  pa;
     TMLX    *lp;
 
     line = (vh * VH_LINES) + chan;
     lp = &vh_parm[line];
+    maint = (lp->lnctrl >> LNCTRL_V_MAINT) & LNCTRL_M_MAINT;
     if ((lp->tbuf2 & TB2_TX_ENA) && (lp->tbuf2 & TB2_TX_DMA_START)) {
 /* BUG: should compare against available xmit buffer space */
         pa = lp->tbuf1;
         pa |= (lp->tbuf2 & TB2_M_TBUFFAD) << 16;
         status = chan << CSR_V_TX_LINE;
-        while (lp->tbuffct) {
+        /* in normal mode move the buffer to the line a block at a time */
+        while (lp->tbuffct && (maint == 0)) {
+            uint8   blk[TMXR_MAXBUF];
+            int32   i, n, nxm, sent;
+            t_stat  r;
+
+            n = (lp->tbuffct < sizeof (blk)) ? lp->tbuffct : sizeof (blk);
+            nxm = Map_ReadB (pa, n, blk);
+            n -= nxm;
+            for (i = 0; i < n; i++)
+                blk[i] &= bitmask[(lp->lpr >> LPR_V_CHAR_LGTH) & LPR_M_CHAR_LGTH];
+            sent = 0;
+            r = n ? tmxr_put_block_ln (lp->tmln, blk, n, &sent) : SCPE_OK;
+            if (r == SCPE_STALL) {
+                int32   more;
+                /* let's flush and try again */
+                tmxr_send_buffered_data (lp->tmln);
+                r = tmxr_put_block_ln (lp->tmln, blk + sent, n - sent, &more);
+                sent += more;
+            }
+            pa = (pa + sent) & ((1 << 22) - 1);
+            lp->tbuffct -= sent;
+            if (r == SCPE_LOST) {
+                tmxr_reset_ln (lp->tmln);
+                HangupModem (vh, lp, chan);
+                break;
+            }
+            if (r != SCPE_OK)
+                break;
+            if (nxm) {
+                status |= CSR_TX_DMA_ERR;
+                lp->tbuffct = 0;
+                break;
+            }
+        }
+        while (lp->tbuffct && (maint != 0)) {
             uint8   buf;
             if (Map_ReadB (pa, 1, &buf)) {
                 status |= CSR_TX_DMA_ERR;
@@ -1512,8 +1512,10 @@ t_stat xq_dispatch_xbdl(CTLR* xq)
   /* When debugging, walk and display the buffer descriptor list */
   xq_show_debug_bdl(xq, xq->var->xbdl_ba);
 
-  /* process xbdl */
+  /* process xbdl (handing the transmitted packets over as one batch) */
+  eth_write_begin(xq->var->etherface);
   status = xq_process_xbdl(xq);
+  eth_write_end(xq->var->etherface);
 
   return status;
 }
@@ -1878,27 +1880,32 @@ t_stat xq_process_local (CTLR* xq, ETH_PACK* pack)
   return SCPE_NOFNC;
 }
 
-void xq_read_callback(CTLR* xq, int status)
+void xq_read_packet(CTLR* xq, ETH_PACK* packet)
 {
   xq->var->stats.recv += 1;
 
   if (DBG_PCK & xq->dev->dctrl)
-    eth_packet_trace_ex(xq->var->etherface, xq->var->read_buffer.msg, xq->var->read_buffer.len, "xq-recvd", DBG_DAT & xq->dev->dctrl, DBG_PCK);
+    eth_packet_trace_ex(xq->var->etherface, packet->msg, packet->len, "xq-recvd", DBG_DAT & xq->dev->dctrl, DBG_PCK);
 
   if ((xq->var->csr & XQ_CSR_RE) || (xq->var->mode == XQ_T_DELQA_PLUS)) { /* receiver enabled */
 
     /* process any packets locally that can be */
-    t_stat status = xq_process_local (xq, &xq->var->read_buffer);
+    t_stat status = xq_process_local (xq, packet);
 
     /* add packet to read queue */
     if (status != SCPE_OK)
-      ethq_insert(&xq->var->ReadQ, 2, &xq->var->read_buffer, status);
+      ethq_insert(&xq->var->ReadQ, 2, packet, status);
   } else {
     xq->var->stats.dropped += 1;
     sim_debug(DBG_WRN, xq->dev, "packet received with receiver disabled\n");
   }
 }
 
+void xq_read_callback(CTLR* xq, int status)
+{
+  xq_read_packet(xq, &xq->var->read_buffer);
+}
+
 void xqa_read_callback(int status)
 {
   xq_read_callback(&xq_ctrl[0], status);
@@ -2331,7 +2338,9 @@ t_stat xq_wr_arqr(CTLR* xq, int32 data)
 
   /* initiate transmit activity when requested */
   if (XQ_ARQR_TRQ & data) {
+    eth_write_begin (xq->var->etherface);
     xq_process_turbo_xbdl (xq);
+    eth_write_end (xq->var->etherface);
   }
   /* initiate transmit activity when requested */
   if (XQ_ARQR_RRQ & data) {
@@ -2621,18 +2630,22 @@ t_stat xq_svc(UNIT* uptr)
 
   /* if the receiver is enabled */
   if ((xq->var->mode == XQ_T_DELQA_PLUS) || (xq->var->csr & XQ_CSR_RE)) {
-    t_stat status;
+    ETH_PACK* packet;
 
     /* First pump any queued packets into the system */
     if ((xq->var->ReadQ.count > 0) && ((xq->var->mode == XQ_T_DELQA_PLUS) || (~xq->var->csr & XQ_CSR_RL)))
       xq_process_rbdl(xq);
 
     /* Now read and queue packets that have arrived */
-    /* This is repeated as long as they are available */
-    do {
-      /* read a packet from the ethernet - processing is via the callback */
-      status = eth_read (xq->var->etherface, &xq->var->read_buffer, xq->var->rcallback);
-    } while (status);
+    /* This is repeated as long as they are available and the read queue */
+    /* has room; the rest wait in the receive ring rather than displace */
+    /* packets already queued */
+    while ((xq->var->ReadQ.count < xq->var->ReadQ.max) &&
+           (NULL != (packet = eth_read_slot (xq->var->etherface)))) {
+      /* process the packet where it was received, then release its slot */
+      xq_read_packet (xq, packet);
+      eth_read_done (xq->var->etherface);
+    }
 
     /* Now pump any still queued packets into the system */
     if ((xq->var->ReadQ.count > 0) && ((xq->var->mode == XQ_T_DELQA_PLUS) || (~xq->var->csr & XQ_CSR_RL)))
@@ -527,17 +527,24 @@ t_stat xu_process_local (CTLR* xu, ETH_PACK* pack)
   return SCPE_NOFNC;
 }
 
-void xu_read_callback(CTLR* xu, int status)
+void xu_read_packet(CTLR* xu, ETH_PACK* packet)
 {
+  t_stat status;
+
   if (DBG_PCK & xu->dev->dctrl)
-	  eth_packet_trace_ex(xu->var->etherface, xu->var->read_buffer.msg, xu->var->read_buffer.len, "xu-recvd", DBG_DAT & xu->dev->dctrl, DBG_PCK);
+	  eth_packet_trace_ex(xu->var->etherface, packet->msg, packet->len, "xu-recvd", DBG_DAT & xu->dev->dctrl, DBG_PCK);
 
   /* process any packets locally that can be */
-  status = xu_process_local (xu, &xu->var->read_buffer);
+  status = xu_process_local (xu, packet);
 
   /* add packet to read queue */
   if (status != SCPE_OK)
-    ethq_insert(&xu->var->ReadQ, 2, &xu->var->read_buffer, 0);
+    ethq_insert(&xu->var->ReadQ, 2, packet, 0);
+}
+
+void xu_read_callback(CTLR* xu, int status)
+{
+  xu_read_packet(xu, &xu->var->read_buffer);
 }
 
 void xua_read_callback(int status)
@@ -616,7 +623,7 @@ t_stat xu_system_id (CTLR* xu, const ETH_MAC dest, uint16 receipt_id)
 
 t_stat xu_svc(UNIT* uptr)
 {
-  int queue_size;
+  ETH_PACK* packet;
   CTLR* xu = xu_unit2ctlr(uptr);
 
   /* First pump any queued packets into the system */
@@ -624,13 +631,15 @@ t_stat xu_svc(UNIT* uptr)
     xu_process_receive(xu);
 
   /* Now read and queue packets that have arrived */
-  /* This is repeated as long as they are available and we have room */
-  do
-    {
-    queue_size = xu->var->ReadQ.count;
-    /* read a packet from the ethernet - processing is via the callback */
-    eth_read (xu->var->etherface, &xu->var->read_buffer, xu->var->rcallback);
-  } while (queue_size != xu->var->ReadQ.count);
+  /* This is repeated as long as they are available and the read queue */
+  /* has room; the rest wait in the receive ring rather than displace */
+  /* packets already queued */
+  while ((xu->var->ReadQ.count < xu->var->ReadQ.max) &&
+         (NULL != (packet = eth_read_slot (xu->var->etherface)))) {
+    /* process the packet where it was received, then release its slot */
+    xu_read_packet (xu, packet);
+    eth_read_done (xu->var->etherface);
+  }
 
   /* Now pump any still queued packets into the system */
   if ((xu->var->ReadQ.count > 0) && ((xu->var->pcsr1 & PCSR1_STATE) == STATE_RUNNING))
@@ -1434,7 +1443,9 @@ void xu_port_command (CTLR* xu)
   switch (command) {  /* cases in order of most used to least used */
     case CMD_PDMD:			/* POLLING DEMAND */
       /* process transmit buffers, receive buffers are done in the service timer */
+      eth_write_begin(xu->var->etherface);
       xu_process_transmit(xu);
+      eth_write_end(xu->var->etherface);
       xu->var->pcsr0 |= PCSR0_DNI;
       break;
 
@@ -60,6 +60,7 @@ int32 autcon_enb = 1;                                   /* autoconfig enable */
 
 extern int32 R[16];
 extern uint32 *M;
+extern SIM_MEM cpu_mem;
 extern UNIT cpu_unit;
 extern int32 PSL, SISR, trpirq, mem_err, hlt_pin;
 extern int32 p1;
@@ -354,6 +355,7 @@ if (qba_map_addr (qa, &ma)) {                           /* map addr */
         val = ((val & mask) << sc) | (t & ~(mask << sc));
         }
     M[ma >> 2] = val;
+    SIM_MEM_DIRTY (&cpu_mem, ma);
     }
 else mem_err = 1;
 return;
@@ -1007,7 +1007,7 @@ int32 todr_rd (void)
 TOY *toy = (TOY *)clk_unit.filebuf;
 struct timespec base, now, val;
 
-clock_gettime(CLOCK_REALTIME, &now);                    /* get curr time */
+sim_clock_gettime (&now);                               /* get curr time */
 base.tv_sec = toy->toy_gmtbase;
 base.tv_nsec = toy->toy_gmtbasemsec * 1000000;
 sim_timespec_diff (&val, &now, &base);
@@ -1023,7 +1023,7 @@ struct timespec now, val, base;
 /* Save the GMT time when set value was 0 to record the base for future 
    read operations in "battery backed-up" state */
 
-if (-1 == clock_gettime(CLOCK_REALTIME, &now))          /* get curr time */
+if (-1 == sim_clock_gettime (&now))                     /* get curr time */
     return;                                             /* error? */
 val.tv_sec = ((uint32)data) / 100;
 val.tv_nsec = (((uint32)data) % 100) * 10000000;
@@ -1045,7 +1045,7 @@ else {                                                  /* Not-Attached means */
     time_t curr;
     struct tm *ctm;
 
-    curr = time (NULL);                                 /* get curr time */
+    curr = sim_get_time (NULL);                         /* get curr time */
     if (curr == (time_t) -1)                            /* error? */
         return SCPE_NOFNC;
     ctm = localtime (&curr);                            /* decompose */
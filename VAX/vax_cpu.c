@@ -228,9 +228,6 @@
                             R[rn + 1] = rh; \
                             }
 
-#define HIST_MIN        64
-#define HIST_MAX        65536
-
 typedef struct {
     int32               iPC;
     int32               PSL;
@@ -265,10 +262,8 @@ int32 crd_err = 0;
 int32 p1 = 0, p2 = 0;                                   /* fault parameters */
 int32 fault_PC;                                         /* fault PC */
 int32 pcq_p = 0;                                        /* PC queue ptr */
-int32 hst_p = 0;                                        /* history pointer */
-int32 hst_lnt = 0;                                      /* history length */
 int32 badabo = 0;
-int32 cpu_astop = 0;
+int32 cpu_astop = 0;                                    /* address stop */
 int32 mchk_va, mchk_ref;                                /* mem ref param */
 int32 ibufl, ibufh;                                     /* prefetch buf */
 int32 ibcnt, ppc;                                       /* prefetch ctl */
@@ -277,7 +272,8 @@ uint32 cpu_idle_type = 1;                               /* default VMS */
 jmp_buf save_env;
 REG *pcq_r = NULL;                                      /* PC queue reg ptr */
 int32 pcq[PCQ_SIZE] = { 0 };                            /* PC queue */
-InstHistory *hst = NULL;                                /* instruction history */
+SIM_HIST hst;                                           /* instruction history */
+SIM_MEM cpu_mem;                                        /* memory dirty map */
 
 const uint32 byte_mask[33] = { 0x00000000,
  0x00000001, 0x00000003, 0x00000007, 0x0000000F,
@@ -392,7 +388,7 @@ char *cpu_description (DEVICE *dptr);
 int32 cpu_get_vsw (int32 sw);
 SIM_INLINE int32 get_istr (int32 lnt, int32 acc);
 int32 ReadOcta (int32 va, int32 *opnd, int32 j, int32 acc);
-t_bool cpu_show_opnd (FILE *st, InstHistory *h, int32 line);
+t_bool cpu_show_opnd (FILE *st, const InstHistory *h, int32 line);
 t_stat cpu_idle_svc (UNIT *uptr);
 void cpu_idle (void);
 
@@ -468,7 +464,7 @@ MTAB cpu_mod[] = {
     { MTAB_XTD|MTAB_VDV, 0, "IDLE", "IDLE={VMS|ULTRIX|NETBSD|OPENBSD|ULTRIXOLD|OPENBSDOLD|QUASIJARUS|32V|ALL}", &cpu_set_idle, &cpu_show_idle, NULL, "Display idle detection mode" },
     { MTAB_XTD|MTAB_VDV, 0, NULL, "NOIDLE", &sim_clr_idle, NULL, NULL,  "Disables idle detection" },
     MEM_MODIFIERS,   /* Model specific memory modifiers from vaxXXX_defs.h */
-    { MTAB_XTD|MTAB_VDV|MTAB_NMO|MTAB_SHP, 0, "HISTORY", "HISTORY",
+    { MTAB_XTD|MTAB_VDV|MTAB_NMO|MTAB_SHP|MTAB_NC, 0, "HISTORY", "HISTORY",
       &cpu_set_hist, &cpu_show_hist, NULL, "Displays instruction history" },
     { MTAB_XTD|MTAB_VDV|MTAB_NMO|MTAB_SHP, 0, "VIRTUAL", NULL,
       NULL, &cpu_show_virt, NULL, "show translation for address arg in KESU mode" },
@@ -636,9 +632,9 @@ for ( ;; ) {
     uint32 va, iad;
     int32 opnd[OPND_SIZE];                              /* operand queue */
 
-    if (cpu_astop) {
+    if (cpu_astop) {                                    /* data breakpoint? */
         cpu_astop = 0;
-        ABORT (SCPE_STOP);
+        ABORT (STOP_DBKPT);
         }
     fault_PC = PC;
     recqptr = 0;                                        /* clr recovery q */
@@ -709,7 +705,7 @@ for ( ;; ) {
         }                                               /* end PSL event */
 
     if (sim_brk_summ &&
-        sim_brk_test ((uint32) PC, SWMASK ('E'))) {     /* breakpoint? */
+        SIM_BRK_TEST ((uint32) PC, SWMASK ('E'))) {     /* breakpoint? */
         ABORT (STOP_IBKPT);                             /* stop simulation */
         }
 
@@ -1531,29 +1527,27 @@ for ( ;; ) {
 
 /* Optionally record instruction history */
 
-    if (hst_lnt) {
+    if (hst.lnt) {
+        InstHistory *h = sim_hist_rec (&hst, InstHistory);
         int32 lim;
         t_value wd;
 
-        hst[hst_p].iPC = fault_PC;
-        hst[hst_p].PSL = PSL | cc;
-        hst[hst_p].opc = opc;
+        h->iPC = fault_PC;
+        h->PSL = PSL | cc;
+        h->opc = opc;
         for (i = 0; i < j; i++)
-            hst[hst_p].opnd[i] = opnd[i];
+            h->opnd[i] = opnd[i];
         lim = PC - fault_PC;
         if ((uint32) lim > INST_SIZE)
             lim = INST_SIZE;
         for (i = 0; i < lim; i++) {
             if ((cpu_ex (&wd, fault_PC + i, &cpu_unit, SWMASK ('V'))) == SCPE_OK)
-                hst[hst_p].inst[i] = (uint8) wd;
+                h->inst[i] = (uint8) wd;
             else {
-                hst[hst_p].inst[0] = hst[hst_p].inst[1] = 0xFF;
+                h->inst[0] = h->inst[1] = 0xFF;
                 break;
                 }
             }
-        hst_p = hst_p + 1;
-        if (hst_p >= hst_lnt)
-            hst_p = 0;
         }
 
 /* Dispatch to instructions */
@@ -3168,7 +3162,8 @@ ASTLVL = 4;
 mapen = 0;
 FLUSH_ISTR;                             /* init I-stream */
 if (M == NULL) {                        /* first time init? */
-    sim_brk_types = sim_brk_dflt = SWMASK ('E');
+    sim_brk_types = SWMASK ('E') | SIM_BRK_WTYP;
+    sim_brk_dflt = SWMASK ('E');
     pcq_r = find_reg ("PCQ", NULL, dptr);
     if (pcq_r == NULL)
         return SCPE_IERR;
@@ -3176,6 +3171,9 @@ if (M == NULL) {                        /* first time init? */
     M = (uint32 *) calloc (((uint32) MEMSIZE) >> 2, sizeof (uint32));
     if (M == NULL)
         return SCPE_MEM;
+    if (sim_mem_register (&cpu_mem, &cpu_unit, (void **) &M, sizeof (*M),
+        1, MAXMEMSIZE_X) != SCPE_OK)
+        return SCPE_MEM;
     auto_config(NULL, 0);               /* do an initial auto configure */
     }
 return build_dib_tab ();
@@ -3250,6 +3248,7 @@ for (i = 0; i < clim; i = i + 4)
 free (M);
 M = nM;
 MEMSIZE = uval; 
+sim_mem_dirty (&cpu_mem, 0, MEMSIZE);                   /* all new */
 return SCPE_OK;
 }
 
@@ -3305,91 +3304,74 @@ else md = PSL_GETCUR (PSL);
 return ACC_MASK (md);
 }
 
-/* Set history */
+/* History records */
 
-t_stat cpu_set_hist (UNIT *uptr, int32 val, char *cptr, void *desc)
+static t_addr cpu_hist_pc (const void *rec)
 {
-int32 i, lnt;
-t_stat r;
+return (uint32) ((const InstHistory *) rec)->iPC;
+}
 
-if (cptr == NULL) {
-    for (i = 0; i < hst_lnt; i++)
-        hst[i].iPC = 0;
-    hst_p = 0;
-    return SCPE_OK;
-    }
-lnt = (int32) get_uint (cptr, 10, HIST_MAX, &r);
-if ((r != SCPE_OK) || (lnt && (lnt < HIST_MIN)))
-    return SCPE_ARG;
-hst_p = 0;
-if (hst_lnt) {
-    free (hst);
-    hst_lnt = 0;
-    hst = NULL;
-    }
-if (lnt) {
-    hst = (InstHistory *) calloc (lnt, sizeof (InstHistory));
-    if (hst == NULL)
-            return SCPE_MEM;
-    hst_lnt = lnt;
-    }
-return SCPE_OK;
+static t_value cpu_hist_opcode (const void *rec)
+{
+return ((const InstHistory *) rec)->opc;
 }
 
-/* Show history */
+static void cpu_hist_header (FILE *st)
+{
+fprintf (st, "PC       PSL       IR\n\n");
+}
 
-t_stat cpu_show_hist (FILE *st, UNIT *uptr, int32 val, void *desc)
+static void cpu_hist_print (FILE *st, const void *rec)
 {
-int32 i, k, di, lnt, numspec;
-char *cptr = (char *) desc;
-t_stat r;
-InstHistory *h;
+const InstHistory *h = (const InstHistory *) rec;
+int32 i, numspec;
 extern const char *opcode[];
 extern t_value *sim_eval;
 
-if (hst_lnt == 0)                                       /* enabled? */
-    return SCPE_NOFNC;
-if (cptr) {
-    lnt = (int32) get_uint (cptr, 10, hst_lnt, &r);
-    if ((r != SCPE_OK) || (lnt == 0))
-        return SCPE_ARG;
-    }
-else lnt = hst_lnt;
-di = hst_p - lnt;                                       /* work forward */
-if (di < 0)
-    di = di + hst_lnt;
-fprintf (st, "PC       PSL       IR\n\n");
-for (k = 0; k < lnt; k++) {                             /* print specified */
-    h = &hst[(di++) % hst_lnt];                         /* entry pointer */
-    if (h->iPC == 0)                                    /* filled in? */
-        continue;
-    fprintf(st, "%08X %08X| ", h->iPC, h->PSL);         /* PC, PSL */
-    numspec = drom[h->opc][0] & DR_NSPMASK;             /* #specifiers */
-    if (opcode[h->opc] == NULL)                         /* undefined? */
+fprintf(st, "%08X %08X| ", h->iPC, h->PSL);             /* PC, PSL */
+numspec = drom[h->opc][0] & DR_NSPMASK;                 /* #specifiers */
+if (opcode[h->opc] == NULL)                             /* undefined? */
+    fprintf (st, "%03X (undefined)", h->opc);
+else if (h->PSL & PSL_FPD)                              /* FPD set? */
+    fprintf (st, "%s FPD set", opcode[h->opc]);
+else {                                                  /* normal */
+    for (i = 0; i < INST_SIZE; i++)
+        sim_eval[i] = h->inst[i];
+    if ((fprint_sym (st, h->iPC, sim_eval, &cpu_unit, SWMASK ('M'))) > 0)
         fprintf (st, "%03X (undefined)", h->opc);
-    else if (h->PSL & PSL_FPD)                          /* FPD set? */
-        fprintf (st, "%s FPD set", opcode[h->opc]);
-    else {                                              /* normal */
-        for (i = 0; i < INST_SIZE; i++)
-            sim_eval[i] = h->inst[i];
-        if ((fprint_sym (st, h->iPC, sim_eval, &cpu_unit, SWMASK ('M'))) > 0)
-            fprintf (st, "%03X (undefined)", h->opc);
-        if ((numspec > 1) ||
-            ((numspec == 1) && (drom[h->opc][1] < BB))) {
-            if (cpu_show_opnd (st, h, 0)) {             /* operands; more? */
-                if (cpu_show_opnd (st, h, 1)) {         /* 2nd line; more? */
-                    cpu_show_opnd (st, h, 2);           /* octa, 3rd/4th */
-                    cpu_show_opnd (st, h, 3);
-                    }
+    if ((numspec > 1) ||
+        ((numspec == 1) && (drom[h->opc][1] < BB))) {
+        if (cpu_show_opnd (st, h, 0)) {                 /* operands; more? */
+            if (cpu_show_opnd (st, h, 1)) {             /* 2nd line; more? */
+                cpu_show_opnd (st, h, 2);               /* octa, 3rd/4th */
+                cpu_show_opnd (st, h, 3);
                 }
             }
-        }                                               /* end else */
-    fputc ('\n', st);                                   /* end line */
-    }                                                   /* end for */
-return SCPE_OK;
+        }
+    }                                                   /* end else */
+fputc ('\n', st);                                       /* end line */
+}
+
+static const SIM_HIST_SCHEMA cpu_hist_schema = {
+    "VAX", sizeof (InstHistory),
+    &cpu_hist_pc, &cpu_hist_opcode, &cpu_hist_header, &cpu_hist_print
+    };
+
+/* Set history */
+
+t_stat cpu_set_hist (UNIT *uptr, int32 val, char *cptr, void *desc)
+{
+return sim_hist_set (&hst, &cpu_hist_schema, cptr);
+}
+
+/* Show history */
+
+t_stat cpu_show_hist (FILE *st, UNIT *uptr, int32 val, void *desc)
+{
+return sim_hist_show (st, &hst, (char *) desc);
 }
 
-t_bool cpu_show_opnd (FILE *st, InstHistory *h, int32 line)
+t_bool cpu_show_opnd (FILE *st, const InstHistory *h, int32 line)
 {
 
 int32 numspec, i, j, disp;
@@ -3579,8 +3561,14 @@ fprintf (st, "This is controlled by the SET CPU HISTORY and SHOW CPU HISTORY com
 fprintf (st, "   sim> SET CPU HISTORY                 clear history buffer\n");
 fprintf (st, "   sim> SET CPU HISTORY=0               disable history\n");
 fprintf (st, "   sim> SET CPU HISTORY=n               enable history, length = n\n");
+fprintf (st, "   sim> SET CPU HISTORY=n;file          enable history, kept in file\n");
 fprintf (st, "   sim> SHOW CPU HISTORY                print CPU history\n");
-fprintf (st, "   sim> SHOW CPU HISTORY=n              print first n entries of CPU history\n\n");
-fprintf (st, "The maximum length for the history is 65536 entries.\n\n");
+fprintf (st, "   sim> SHOW CPU HISTORY=n              print last n entries of CPU history\n");
+fprintf (st, "   sim> SHOW CPU HISTORY=PC=lo-hi       print entries with PC in range\n");
+fprintf (st, "   sim> SHOW CPU HISTORY=OP=x           print entries with opcode x\n\n");
+fprintf (st, "The qualifiers of SHOW CPU HISTORY may be combined, separated by ';'.  The\n");
+fprintf (st, "length is rounded up to a power of two, with a maximum of 2^30 entries.  A\n");
+fprintf (st, "history kept in a file survives a crash of the simulator; setting the same\n");
+fprintf (st, "length and file again shows the instructions which led up to it.\n\n");
 return SCPE_OK;
 }
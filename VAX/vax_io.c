@@ -112,6 +112,7 @@ int32 cq_ipc = 0;                                       /* IPC */
 int32 autcon_enb = 1;                                   /* autoconfig enable */
 
 extern uint32 *M;
+extern SIM_MEM cpu_mem;
 extern UNIT cpu_unit;
 extern int32 PSL, SISR, trpirq, mem_err, crd_err, hlt_pin;
 extern int32 p1;
@@ -479,6 +480,7 @@ if (ADDR_IS_MEM (ma)) {
         val = ((val & mask) << sc) | (t & ~(mask << sc));
         }
     M[ma >> 2] = val;
+    SIM_MEM_DIRTY (&cpu_mem, ma);
     }
 else {
     cq_serr (ma);                                       /* error */
@@ -516,6 +518,7 @@ if (qba_map_addr (qa, &ma)) {                           /* map addr */
         val = ((val & mask) << sc) | (t & ~(mask << sc));
         }
     M[ma >> 2] = val;
+    SIM_MEM_DIRTY (&cpu_mem, ma);
     }
 else mem_err = 1;
 return;
@@ -751,6 +754,39 @@ else {
 return 0;
 }
 
+/* Host access to DMA buffers
+
+   Map_Host returns a pointer into memory for the longest run of Qbus
+   addresses, starting at ba and at most bc bytes long, which the map
+   places in consecutive pages.  The run's byte count is stored in *lbc.
+   M[] only holds memory in Qbus byte order on little endian hosts, so
+   elsewhere, and for invalid or NXM addresses, NULL is returned and the
+   caller falls back on the Map_ routines (which report any error).
+*/
+
+void *Map_Host (uint32 ba, int32 bc, int32 *lbc)
+{
+uint32 ma, pma;
+int32 i;
+
+*lbc = 0;
+if ((sim_end == 0) || ((ba | bc) & 01) || (bc <= 0))
+    return NULL;
+if (!qba_map_addr_c (ba, &ma) || !ADDR_IS_MEM (ma))     /* inv or NXM? */
+    return NULL;
+for (i = VA_PAGSIZE - VA_GETOFF (ba); i < bc; i = i + VA_PAGSIZE) {
+    if (!qba_map_addr_c (ba + i, &pma) || (pma != (ma + i)))
+        break;                                          /* next page elsewhere */
+    }
+if (i > bc)
+    i = bc;
+if (!ADDR_IS_MEM (ma + i - 1))                          /* trim at end of mem */
+    i = MEMSIZE - ma;
+*lbc = i;
+sim_mem_dirty (&cpu_mem, ma, i);                        /* caller may write */
+return ((uint8 *) M) + ma;
+}
+
 /* Memory examine via map (word only) */
 
 t_stat qba_ex (t_value *vptr, t_addr exta, UNIT *uptr, int32 sw)
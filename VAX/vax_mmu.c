@@ -57,6 +57,7 @@ typedef struct {
     } TLBENT;
 
 extern uint32 *M;
+extern SIM_MEM cpu_mem;
 extern const uint32 align[4];
 extern int32 PSL;
 extern int32 mapen;
@@ -67,6 +68,8 @@ extern int32 SBR, SLR;
 extern int32 SISR;
 extern jmp_buf save_env;
 extern UNIT cpu_unit;
+extern int32 fault_PC;
+extern int32 cpu_astop;
 
 int32 d_p0br, d_p0lr;                                   /* dynamic copies */
 int32 d_p1br, d_p1lr;                                   /* altered per ucode */
@@ -151,8 +154,27 @@ DEVICE tlb_dev = {
         a longword, unaligned word crossing a longword boundary.
 
    Note that these routines do not handle quad or octa references.
+
+   A reference to a page holding a data breakpoint is checked against the
+   breakpoint table once its value is known; on a hit, the CPU stops at
+   the end of the instruction.
 */
 
+#define WATCH(pa,lnt,typ,val) \
+    if (SIM_BRK_WATCHED (pa) && sim_brk_wtest (pa, lnt, typ, (uint32) (val), (uint32) fault_PC)) \
+        cpu_astop = 1
+
+/* An unaligned reference crossing a page is checked on each physical page */
+
+#define WATCH_CROSS(pa,pa1,off,lnt,typ,val) \
+    if (mapen && ((uint32)((off) + (lnt)) > VA_PAGSIZE)) { \
+        WATCH (pa, VA_PAGSIZE - (off), typ, val); \
+        WATCH ((pa1) & ~VA_M_OFF, (off) + (lnt) - VA_PAGSIZE, typ, val); \
+        } \
+    else { \
+        WATCH (pa, lnt, typ, val); \
+        }
+
 /* Read virtual
 
    Inputs:
@@ -166,7 +188,7 @@ DEVICE tlb_dev = {
 int32 Read (uint32 va, int32 lnt, int32 acc)
 {
 int32 vpn, off, tbi, pa;
-int32 pa1, bo, sc, wl, wh;
+int32 pa1, bo, sc, wl, wh, val;
 TLBENT xpte;
 
 mchk_va = va;
@@ -186,10 +208,12 @@ else {
     }
 if ((pa & (lnt - 1)) == 0) {                            /* aligned? */
     if (lnt >= L_LONG)                                  /* long, quad? */
-        return ReadL (pa);
-    if (lnt == L_WORD)                                  /* word? */
-        return ReadW (pa);
-    return ReadB (pa);                                  /* byte */
+        val = ReadL (pa);
+    else if (lnt == L_WORD)                             /* word? */
+        val = ReadW (pa);
+    else val = ReadB (pa);                              /* byte */
+    WATCH (pa, lnt, SWMASK ('R'), val);
+    return val;
     }
 if (mapen && ((uint32)(off + lnt) > VA_PAGSIZE)) {      /* cross page? */
     vpn = VA_GETVPN (va + lnt);                         /* vpn 2nd page */
@@ -206,15 +230,17 @@ if (lnt >= L_LONG) {                                    /* lw unaligned? */
     sc = bo << 3;
     wl = ReadL (pa);                                    /* read both lw */
     wh = ReadL (pa1);                                   /* extract */
-    return ((((wl >> sc) & align[bo]) | (wh << (32 - sc))) & LMASK);
+    val = ((((wl >> sc) & align[bo]) | (wh << (32 - sc))) & LMASK);
     }
 else if (bo == 1)
-    return ((ReadL (pa) >> 8) & WMASK);
+    val = ((ReadL (pa) >> 8) & WMASK);
 else {
     wl = ReadL (pa);                                    /* word cross lw */
     wh = ReadL (pa1);                                   /* read, extract */
-    return (((wl >> 24) & 0xFF) | ((wh & 0xFF) << 8));
+    val = (((wl >> 24) & 0xFF) | ((wh & 0xFF) << 8));
     }
+WATCH_CROSS (pa, pa1, off, lnt, SWMASK ('R'), val);
+return val;
 }
 
 /* Write virtual
@@ -250,6 +276,7 @@ else {
     off = 0;
     }
 if ((pa & (lnt - 1)) == 0) {                            /* aligned? */
+    WATCH (pa, lnt, SWMASK ('W'), val);
     if (lnt >= L_LONG)                                  /* long, quad? */
         WriteL (pa, val);
     else if (lnt == L_WORD)                             /* word? */
@@ -267,6 +294,7 @@ if (mapen && ((uint32)(off + lnt) > VA_PAGSIZE)) {
     pa1 = (xpte.pte & TLB_PFN) | VA_GETOFF (va + 4);
     }
 else pa1 = (pa + 4) & PAMASK;
+WATCH_CROSS (pa, pa1, off, lnt, SWMASK ('W'), val);
 bo = pa & 3;
 wl = ReadL (pa);
 if (lnt >= L_LONG) {
@@ -388,6 +416,7 @@ if (ADDR_IS_MEM (pa)) {
     int32 sc = (pa & 3) << 3;
     int32 mask = 0xFF << sc;
     M[id] = (M[id] & ~mask) | (val << sc);
+    SIM_MEM_DIRTY (&cpu_mem, pa);
     }
 else {
     mchk_ref = REF_V;
@@ -404,6 +433,7 @@ if (ADDR_IS_MEM (pa)) {
     int32 id = pa >> 2;
     M[id] = (pa & 2)? (M[id] & 0xFFFF) | (val << 16):
         (M[id] & ~0xFFFF) | val;
+    SIM_MEM_DIRTY (&cpu_mem, pa);
     }
 else {
     mchk_ref = REF_V;
@@ -416,8 +446,10 @@ return;
 
 SIM_INLINE void WriteL (uint32 pa, int32 val)
 {
-if (ADDR_IS_MEM (pa))
+if (ADDR_IS_MEM (pa)) {
     M[pa >> 2] = val;
+    SIM_MEM_DIRTY (&cpu_mem, pa);
+    }
 else {
     mchk_ref = REF_V;
     if (ADDR_IS_IO (pa))
@@ -429,8 +461,10 @@ return;
 
 void WriteLP (uint32 pa, int32 val)
 {
-if (ADDR_IS_MEM (pa))
+if (ADDR_IS_MEM (pa)) {
     M[pa >> 2] = val;
+    SIM_MEM_DIRTY (&cpu_mem, pa);
+    }
 else {
     mchk_va = pa;
     mchk_ref = REF_P;
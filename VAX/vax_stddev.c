@@ -470,7 +470,7 @@ if (0 == todr_reg)                                      /* clock running? */
    in the 32bit TODR.  This is the 33bit value 0x100000000/100 to get seconds */
 #define TOY_MAX_SECS (0x40000000/25)
 
-clock_gettime(CLOCK_REALTIME, &now);                    /* get curr time */
+sim_clock_gettime (&now);                               /* get curr time */
 base.tv_sec = toy->toy_gmtbase;
 base.tv_nsec = toy->toy_gmtbasemsec * 1000000;
 sim_timespec_diff (&val, &now, &base);
@@ -490,7 +490,7 @@ struct timespec now, val, base;
 /* Save the GMT time when set value was 0 to record the base for future 
    read operations in "battery backed-up" state */
 
-if (-1 == clock_gettime(CLOCK_REALTIME, &now))          /* get curr time */
+if (-1 == sim_clock_gettime (&now))                     /* get curr time */
     return;                                             /* error? */
 val.tv_sec = ((uint32)data) / 100;
 val.tv_nsec = (((uint32)data) % 100) * 10000000;
@@ -517,7 +517,7 @@ else {                                                  /* Not-Attached means */
     time_t curr;
     struct tm *ctm;
 
-    curr = time (NULL);                                 /* get curr time */
+    curr = sim_get_time (NULL);                         /* get curr time */
     if (curr == (time_t) -1)                            /* error? */
         return SCPE_NOFNC;
     ctm = localtime (&curr);                            /* decompose */
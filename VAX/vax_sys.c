@@ -102,7 +102,8 @@ const char *sim_stop_messages[] = {
     "Software done",
     "Reboot request failed",
     "Unknown error",
-    "Unknown abort code"
+    "Unknown abort code",
+    "Data breakpoint"
     };
 
 /* Dispatch/decoder table
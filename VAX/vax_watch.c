@@ -102,7 +102,7 @@ time_t curr;
 struct tm *ctm = NULL;
 
 if (rg < 10) {                                          /* time reg? */
-    curr = time (NULL);                                 /* get curr time */
+    curr = sim_get_time (NULL);                         /* get curr time */
     if (curr == (time_t) -1)                            /* error? */
         return 0;
     ctm = localtime (&curr);                            /* decompose */
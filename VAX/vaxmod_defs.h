@@ -432,6 +432,8 @@ int32 Map_ReadB (uint32 ba, int32 bc, uint8 *buf);
 int32 Map_ReadW (uint32 ba, int32 bc, uint16 *buf);
 int32 Map_WriteB (uint32 ba, int32 bc, uint8 *buf);
 int32 Map_WriteW (uint32 ba, int32 bc, uint16 *buf);
+void *Map_Host (uint32 ba, int32 bc, int32 *lbc);
+#define MAP_HOST        1                               /* Map_Host available */
 
 #include "pdp11_io_lib.h"
 
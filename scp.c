@@ -262,16 +262,11 @@
     if (1) {                                                    \
         int32 _x;                                               \
         AIO_LOCK;                                               \
-        if (sim_clock_queue == QUEUE_LIST_END)                  \
-            _x = noqueue_time;                                  \
-        else                                                    \
-            _x = sim_clock_queue->time;                         \
+        _x = sim_interval_base;                                 \
         sim_time = sim_time + (_x - sim_interval);              \
         sim_rtime = sim_rtime + ((uint32) (_x - sim_interval)); \
-        if (sim_clock_queue == QUEUE_LIST_END)                  \
-            noqueue_time = sim_interval;                        \
-        else                                                    \
-            sim_clock_queue->time = sim_interval;               \
+        sim_queue_time = sim_queue_time + (_x - sim_interval);  \
+        sim_interval_base = sim_interval;                       \
         AIO_UNLOCK;                                             \
         }                                                       \
     else                                                        \
@@ -320,7 +315,14 @@ pthread_mutex_t sim_tmxr_poll_lock = PTHREAD_MUTEX_INITIALIZER;
 pthread_cond_t sim_tmxr_poll_cond  = PTHREAD_COND_INITIALIZER;
 int32 sim_tmxr_poll_count;
 pthread_t sim_asynch_main_threadid;
-UNIT * volatile sim_asynch_queue;
+AIO_COMPLETION sim_asynch_ring[AIO_RING_SIZE];
+volatile uint32 sim_asynch_ring_tail;
+uint32 sim_asynch_ring_head;
+static AIO_COMPLETION *sim_asynch_spill;                /* records posted while the ring was full */
+static uint32 sim_asynch_spill_max;
+volatile uint32 sim_asynch_spill_cnt;
+volatile int32 sim_asynch_inflight;
+UNIT *sim_aio_activating = NULL;
 UNIT * volatile sim_wallclock_queue;
 UNIT * volatile sim_wallclock_entry;
 UNIT * volatile sim_clock_cosched_queue;
@@ -376,6 +378,10 @@ t_stat show_one_mod (FILE *st, DEVICE *dptr, UNIT *uptr, MTAB *mptr, char *cptr,
 t_stat sim_check_console (int32 sec);
 t_stat sim_save (FILE *sfile);
 t_stat sim_rest (FILE *rfile);
+static void sim_mem_dirty_all (void);
+static t_stat sim_rest_mem (FILE *rfile);
+static t_stat sim_rest_size (DEVICE *dptr, UNIT *uptr, t_addr high, t_addr old_capac);
+static t_stat sim_rest_words (FILE *rfile, DEVICE *dptr, UNIT *uptr, t_addr high, t_bool dep);
 
 /* Breakpoint package */
 
@@ -421,6 +427,8 @@ t_stat assign_device (DEVICE *dptr, char *cptr);
 t_stat deassign_device (DEVICE *dptr);
 t_stat ssh_break_one (FILE *st, int32 flg, t_addr lo, int32 cnt, char *aptr);
 t_stat run_boot_prep (void);
+static t_stat _sim_clock_heap_insert (UNIT *uptr);
+static void _sim_clock_heap_remove (UNIT *uptr);
 t_stat exdep_reg_loop (FILE *ofile, SCHTAB *schptr, int32 flag, char *cptr,
     REG *lowr, REG *highr, uint32 lows, uint32 highs);
 t_stat ex_reg (FILE *ofile, t_value val, int32 flag, REG *rptr, uint32 idx);
@@ -466,12 +474,23 @@ int32 sim_brk_ent = 0;
 int32 sim_brk_lnt = 0;
 int32 sim_brk_ins = 0;
 t_bool sim_brk_pend[SIM_BKPT_N_SPC] = { FALSE };
+uint32 sim_brk_filt[SIM_BRK_FILT_BITS / 32] = { 0 };
+uint32 sim_brk_wmap[SIM_BRK_WMAP_BITS / 32] = { 0 };
+uint32 sim_brk_whit = 0;                                /* watchpoint types hit */
+t_addr sim_brk_wloc = 0;                                /* and reference */
+t_value sim_brk_wval = 0;
+t_addr sim_brk_wpc = 0;
 t_addr sim_brk_ploc[SIM_BKPT_N_SPC] = { 0 };
 int32 sim_quiet = 0;
 int32 sim_step = 0;
 static double sim_time;
 static uint32 sim_rtime;
-static int32 noqueue_time;
+static int32 sim_interval_base;                         /* sim_interval at last time update */
+static double sim_queue_time;                           /* event queue time base */
+static UNIT **sim_clock_heap = NULL;                    /* event heap (1 based) */
+static uint32 sim_clock_heap_cnt = 0;                   /* event heap entries */
+static uint32 sim_clock_heap_lnt = 0;                   /* event heap allocated length */
+static uint32 sim_clock_seq = 0;                        /* event insertion sequence */
 volatile int32 stop_cpu = 0;
 t_value *sim_eval = NULL;
 FILE *sim_log = NULL;                                   /* log file */
@@ -514,7 +533,8 @@ static const char *sim_snet = "no Ethernet";
 
 /* Tables and strings */
 
-const char save_vercur[] = "V3.5";
+const char save_vercur[] = "V4.0";
+const char save_ver35[] = "V3.5";
 const char save_ver32[] = "V3.2";
 const char save_ver30[] = "V3.0";
 const struct scp_error {
@@ -620,7 +640,8 @@ static CTAB cmd_table[] = {
     { "BOOT", &run_cmd, RU_BOOT,
       "b{oot} <unit>            bootstrap unit\n", &run_cmd_message },
     { "BREAK", &brk_cmd, SSH_ST,
-      "br{eak} <list>           set breakpoints\n" },
+      "br{eak} <list>           set breakpoints\n"
+      "br{eak} -r|-w <list>     set physical memory read|write watchpoints\n" },
     { "NOBREAK", &brk_cmd, SSH_CL,
       "nobr{eak} <list>         clear breakpoints\n" },
     { "ATTACH", &attach_cmd, 0,
@@ -633,7 +654,9 @@ static CTAB cmd_table[] = {
     { "DEASSIGN", &deassign_cmd, 0,
       "dea{ssign} <device>      deassign logical name for device\n" },
     { "SAVE", &save_cmd, 0,
-      "sa{ve} <file>            save simulator to file\n" },
+      "sa{ve} <file>            save simulator to file\n"
+      "sa{ve} -i <file>         save memory changed since last save or restore\n"
+      "sa{ve} -z <file>         save with memory compressed\n" },
     { "RESTORE", &restore_cmd, 0,
       "rest{ore}|ge{t} <file>   restore simulator from file\n" },
     { "GET", &restore_cmd, 0, NULL },
@@ -682,14 +705,21 @@ static CTAB cmd_table[] = {
       "set nolog                disables any currently active logging\n"
       "set debug debug_file     specify the debug destination\n"
       "                         (STDOUT,STDERR,LOG or filename)\n"
+      "set debug -b trace_file  record debug output in binary form, for\n"
+      "                         rendering by TraceDecode\n"
       "set nodebug              disables any currently active debug output\n"
       "set break <list>         set breakpoints\n"
       "set nobreak <list>       clear breakpoints\n"
       "set throttle {x{M|K|%}}|{x/t}\n"
       "                         set simulation rate\n"
       "set nothrottle           set simulation rate to maximum\n"
+      "set clock FASTFORWARD    skip idle time instead of waiting for it\n"
+      "set clock NOFASTFORWARD  idle in real time\n"
       "set asynch               enable asynchronous I/O\n"
       "set noasynch             disable asynchronous I/O\n"
+      "set diskcache SIZE=n{,WRITEBACK|WRITETHROUGH}{,SHARED|NOSHARED}{,FLUSH}\n"
+      "                         configure the host disk sector cache (n in MB)\n"
+      "set nodiskcache          disable the host disk sector cache\n"
       "set environment name=val set environment variable\n"
       "set on                   enables error checking after command execution\n"
       "set noon                 disables error checking after command execution\n"
@@ -727,6 +757,7 @@ static CTAB cmd_table[] = {
       "sh{ow} ti{me}            show simulated time\n"
       "sh{ow} th{rottle}        show simulation rate\n" 
       "sh{ow} a{synch}          show asynchronouse I/O state\n" 
+      "sh{ow} diskcache         show host disk sector cache statistics\n" 
       "sh{ow} ve{rsion}         show simulator version\n" 
       "sh{ow} def{ault}         show current directory\n" 
       "sh{ow} <dev> RADIX       show device display radix\n"
@@ -848,7 +879,8 @@ setenv ("SIM_NAME", sim_name, 1);                       /* Publish simulator nam
 stop_cpu = 0;
 sim_interval = 0;
 sim_time = sim_rtime = 0;
-noqueue_time = 0;
+sim_interval_base = 0;
+sim_queue_time = 0;
 sim_clock_queue = QUEUE_LIST_END;
 sim_is_running = 0;
 sim_log = NULL;
@@ -2214,8 +2246,11 @@ static CTAB set_glob_tab[] = {
     { "NODEBUG", &sim_set_deboff, 0 },                  /* deprecated */
     { "THROTTLE", &sim_set_throt, 1 },
     { "NOTHROTTLE", &sim_set_throt, 0 },
+    { "CLOCK", &sim_set_clock, 0 },
     { "ASYNCH", &sim_set_asynch, 1 },
     { "NOASYNCH", &sim_set_asynch, 0 },
+    { "DISKCACHE", &sim_disk_set_diskcache, 1 },
+    { "NODISKCACHE", &sim_disk_set_diskcache, 0 },
     { "ENVIRONMENT", &sim_set_environment, 1 },
     { "ON", &set_on, 1 },
     { "NOON", &set_on, 0 },
@@ -2507,6 +2542,7 @@ static SHTAB show_glob_tab[] = {
     { "DEBUG", &sim_show_debug, 0 },                    /* deprecated */
     { "THROTTLE", &sim_show_throt, 0 },
     { "ASYNCH", &sim_show_asynch, 0 },
+    { "DISKCACHE", &sim_disk_show_diskcache, 0 },
     { "ETHERNET", &eth_show_devices, 0 },
     { "SERIAL", &sim_show_serial, 0 },
     { "MULTIPLEXER", &tmxr_show_open_devices, 0 },
@@ -2815,11 +2851,22 @@ else if (!flag)
 return SCPE_OK;
 }
 
+static int _sim_clock_cmp (const void *pa, const void *pb)
+{
+UNIT *a = *(UNIT * const *)pa;
+UNIT *b = *(UNIT * const *)pb;
+
+if (a->q_due != b->q_due)
+    return (a->q_due < b->q_due) ? -1 : 1;
+return (((int32)(a->q_seq - b->q_seq)) < 0) ? -1 : 1;
+}
+
 t_stat show_queue (FILE *st, DEVICE *dnotused, UNIT *unotused, int32 flag, char *cptr)
 {
 DEVICE *dptr;
 UNIT *uptr;
-int32 accum;
+UNIT **order;
+uint32 i;
 
 if (cptr && (*cptr != 0))
     return SCPE_2MARG;
@@ -2829,8 +2876,13 @@ if (sim_clock_queue == QUEUE_LIST_END)
 else {
     fprintf (st, "%s event queue status, time = %.0f, executing %.0f instructions/sec\n",
              sim_name, sim_time, sim_timer_inst_per_sec ());
-    accum = 0;
-    for (uptr = sim_clock_queue; uptr != QUEUE_LIST_END; uptr = uptr->next) {
+    order = (UNIT **)malloc (sim_clock_heap_cnt * sizeof (*order));
+    if (order == NULL)
+        return SCPE_MEM;
+    memcpy (order, &sim_clock_heap[1], sim_clock_heap_cnt * sizeof (*order));
+    qsort (order, sim_clock_heap_cnt, sizeof (*order), _sim_clock_cmp);
+    for (i = 0; i < sim_clock_heap_cnt; i++) {
+        uptr = order[i];
         if (uptr == &sim_step_unit)
             fprintf (st, "  Step timer");
         else if ((dptr = find_dev_from_unit (uptr)) != NULL) {
@@ -2839,9 +2891,9 @@ else {
                 fprintf (st, " unit %d", (int32) (uptr - dptr->units));
             }
         else fprintf (st, "  Unknown");
-        fprintf (st, " at %d\n", accum + uptr->time);
-        accum = accum + uptr->time;
+        fprintf (st, " at %d\n", (int32)(uptr->q_due - sim_queue_time));
         }
+    free (order);
     }
 #if defined (SIM_ASYNCH_IO)
 pthread_mutex_lock (&sim_timer_lock);
@@ -2877,17 +2929,32 @@ if (sim_clock_cosched_queue != QUEUE_LIST_END) {
 pthread_mutex_unlock (&sim_timer_lock);
 pthread_mutex_lock (&sim_asynch_lock);
 fprintf (st, "asynchronous pending event queue\n");
-if (sim_asynch_queue == QUEUE_LIST_END)
+if (!AIO_RING_PENDING)
     fprintf (st, "  Empty\n");
 else {
-    for (uptr = sim_asynch_queue; uptr != QUEUE_LIST_END; uptr = uptr->a_next) {
+    uint32 pos;
+
+    for (pos = sim_asynch_ring_head;
+         sim_asynch_ring[pos & AIO_RING_MASK].seq == pos + 1;
+         pos++) {
+        uptr = sim_asynch_ring[pos & AIO_RING_MASK].uptr;
+        if ((dptr = find_dev_from_unit (uptr)) != NULL) {
+            fprintf (st, "  %s", sim_dname (dptr));
+            if (dptr->numunits > 1) fprintf (st, " unit %d",
+                (int32) (uptr - dptr->units));
+            }
+        else fprintf (st, "  Unknown");
+        fprintf (st, " event delay %d\n", sim_asynch_ring[pos & AIO_RING_MASK].event_time);
+        }
+    for (pos = 0; pos < sim_asynch_spill_cnt; pos++) {
+        uptr = sim_asynch_spill[pos].uptr;
         if ((dptr = find_dev_from_unit (uptr)) != NULL) {
             fprintf (st, "  %s", sim_dname (dptr));
             if (dptr->numunits > 1) fprintf (st, " unit %d",
                 (int32) (uptr - dptr->units));
             }
         else fprintf (st, "  Unknown");
-        fprintf (st, " event delay %d\n", uptr->a_event_time);
+        fprintf (st, " event delay %d (spilled)\n", sim_asynch_spill[pos].event_time);
         }
     }
 fprintf (st, "asynch latency: %d nanoseconds\n", sim_asynch_latency);
@@ -3273,6 +3340,8 @@ loadfile = sim_fopen (gbuf, flag? "wb": "rb");          /* open for wr/rd */
 if (loadfile == NULL)
     return SCPE_OPENERR;
 GET_SWITCHES (cptr);                                    /* get switches */
+if (flag == 0)                                          /* load changes memory */
+    sim_mem_dirty_all ();
 reason = sim_load (loadfile, cptr, gbuf, flag);         /* load or dump */
 fclose (loadfile);
 return reason;
@@ -3599,9 +3668,486 @@ sprintf (uname, "%s%d", sim_dname (d), (int)(uptr-d->units));
 return uname;
 }
 
+/* Memory snapshots
+
+   A simulator registers its main memory with sim_mem_register.  SAVE then
+   writes the memory array in bulk, page by page, instead of a word at a
+   time through the examine routine; pages of zeroes are omitted.  The
+   VM's memory write paths, including DMA, mark the pages they change in
+   the unit's dirty map, which is cleared by each SAVE and RESTORE.  A
+   device handed a pointer into memory for an asynchronous transfer marks
+   the pages again, with sim_mem_dirty_host, when the transfer completes,
+   since a SAVE may have cleared the map while it was in flight.
+
+   SAVE -I writes only the pages marked since the last SAVE or RESTORE,
+   and records that file's name as its base.  RESTORE of an incremental
+   file first restores its base, and so on back to a full save, then
+   applies the changed pages.  Registers and other units are saved in
+   full every time.  SAVE -Z passes memory through zlib.
+
+   A registered unit's memory in the save file is
+
+        int32   format          SNAP_FULL or SNAP_INCR
+        uint32  elsize          bytes per array element
+        uint32  pgsize          bytes per page
+        uint32  zlib            memory follows compressed
+
+   followed by runs of pages, each a starting page and a count, negated
+   for a run of zero pages, and then the data of a run of data pages; a
+   starting page of -1 ends the memory.  Compressed runs are written in
+   chunks, each preceded by its length, ending with a length of zero.
+   Values are little endian in the file.
+*/
+
+#if defined (HAVE_ZLIB)
+#include <zlib.h>
+#endif
+
+#define SIM_MEM_MAX     4                               /* registered memories */
+#define SIM_SNAP_CHAIN  64                              /* max incremental depth */
+#define SNAP_WORDS      0                               /* memory via examine */
+#define SNAP_FULL       1                               /* bulk, all pages */
+#define SNAP_INCR       2                               /* bulk, changed pages */
+#define SNAP_SKIP       0                               /* page not saved */
+#define SNAP_ZERO       1                               /* page of zeroes */
+#define SNAP_DATA       2                               /* page with data */
+#define SNAP_ZCHUNK     65536                           /* compressed chunk */
+
+typedef struct {
+    FILE                *f;
+    t_bool              z;                              /* compressed */
+#if defined (HAVE_ZLIB)
+    z_stream            zs;
+    uint8               *buf;
+#endif
+    } SNAP_IO;
+
+static SIM_MEM *sim_mem_tab[SIM_MEM_MAX];
+static uint32 sim_mem_cnt = 0;
+static char sim_snap_last[CBUFSIZE] = "";               /* last file saved or restored */
+
+t_stat sim_mem_register (SIM_MEM *m, UNIT *uptr, void **mem, uint32 elsize,
+    uint32 abytes, t_addr maxcap)
+{
+uint32 i, words;
+
+for (i = 0; i < sim_mem_cnt; i++) {                     /* already known? */
+    if (sim_mem_tab[i] == m)
+        return SCPE_OK;
+    }
+if (sim_mem_cnt >= SIM_MEM_MAX)
+    return SCPE_IERR;
+m->npg = (uint32) ((maxcap * abytes + SIM_MEM_PGSIZE - 1) >> SIM_MEM_PG_V);
+words = (m->npg + 31) >> 5;
+if ((m->dirty = (uint32 *) malloc (words * sizeof (uint32))) == NULL)
+    return SCPE_MEM;
+memset (m->dirty, 0xFF, words * sizeof (uint32));       /* nothing saved yet */
+m->uptr = uptr;
+m->mem = mem;
+m->elsize = elsize;
+m->abytes = abytes;
+sim_mem_tab[sim_mem_cnt++] = m;
+return SCPE_OK;
+}
+
+/* Mark lnt bytes of memory at byte offset off as written */
+
+void sim_mem_dirty (SIM_MEM *m, t_addr off, t_addr lnt)
+{
+uint32 pg, lim;
+
+if ((m->dirty == NULL) || (lnt == 0))
+    return;
+pg = (uint32) (off >> SIM_MEM_PG_V);
+lim = (uint32) ((off + lnt - 1) >> SIM_MEM_PG_V);
+if (lim >= m->npg)
+    lim = m->npg - 1;
+for ( ; pg <= lim; pg++)
+    m->dirty[pg >> 5] |= 1u << (pg & 31);
+}
+
+/* Mark lnt bytes of memory at host address p as written */
+
+void sim_mem_dirty_host (const void *p, size_t lnt)
+{
+uint32 i;
+const uint8 *base;
+SIM_MEM *m;
+
+for (i = 0; i < sim_mem_cnt; i++) {
+    m = sim_mem_tab[i];
+    base = (const uint8 *) *m->mem;
+    if ((base != NULL) && ((const uint8 *) p >= base) &&
+        ((size_t) ((const uint8 *) p - base) < ((size_t) m->npg << SIM_MEM_PG_V))) {
+        sim_mem_dirty (m, (t_addr) ((const uint8 *) p - base), (t_addr) lnt);
+        return;
+        }
+    }
+}
+
+static SIM_MEM *sim_mem_find (UNIT *uptr)
+{
+uint32 i;
+
+for (i = 0; i < sim_mem_cnt; i++) {
+    if (sim_mem_tab[i]->uptr == uptr)
+        return sim_mem_tab[i];
+    }
+return NULL;
+}
+
+/* Mark all memory written, for changes made behind the VM's back (BOOT, LOAD) */
+
+static void sim_mem_dirty_all (void)
+{
+uint32 i;
+
+for (i = 0; i < sim_mem_cnt; i++)
+    memset (sim_mem_tab[i]->dirty, 0xFF, ((sim_mem_tab[i]->npg + 31) >> 5) * sizeof (uint32));
+}
+
+/* A snapshot has been saved or restored: it becomes the base for SAVE -I */
+
+static void sim_snap_done (const char *fname)
+{
+uint32 i;
+
+for (i = 0; i < sim_mem_cnt; i++)
+    memset (sim_mem_tab[i]->dirty, 0, ((sim_mem_tab[i]->npg + 31) >> 5) * sizeof (uint32));
+strncpy (sim_snap_last, fname, sizeof (sim_snap_last) - 1);
+sim_snap_last[sizeof (sim_snap_last) - 1] = '\0';
+}
+
+/* Test whether fname is the base of the next incremental save or one of its bases */
+
+static t_bool sim_snap_in_chain (const char *fname)
+{
+char name[CBUFSIZE], buf[CBUFSIZE];
+FILE *f;
+int32 i, l;
+
+strcpy (name, sim_snap_last);
+for (i = 0; (name[0] != '\0') && (i < SIM_SNAP_CHAIN); i++) {
+    if (strcmp (name, fname) == 0)
+        return TRUE;
+    if ((f = sim_fopen (name, "rb")) == NULL)
+        break;
+    l = 0;
+    if (read_line (buf, sizeof (buf), f) && (strcmp (buf, save_vercur) == 0)) {
+        for (l = 1; (l < 6) && read_line (buf, sizeof (buf), f); l++) ;
+        }
+    fclose (f);
+    if (l < 6)                                          /* not V4.0, no base */
+        break;
+    strcpy (name, buf);                                 /* its base */
+    }
+return FALSE;
+}
+
+/* Snapshot memory streams, optionally compressed */
+
+static t_stat snap_open (SNAP_IO *s, FILE *f, t_bool z, t_bool wr)
+{
+s->f = f;
+s->z = z;
+if (!z)
+    return SCPE_OK;
+#if defined (HAVE_ZLIB)
+memset (&s->zs, 0, sizeof (s->zs));
+if ((s->buf = (uint8 *) malloc (SNAP_ZCHUNK)) == NULL)
+    return SCPE_MEM;
+if ((wr? deflateInit (&s->zs, Z_BEST_SPEED): inflateInit (&s->zs)) == Z_OK)
+    return SCPE_OK;
+free (s->buf);
+return SCPE_MEM;
+#else
+return SCPE_NOFNC;
+#endif
+}
+
+#if defined (HAVE_ZLIB)
+static t_bool snap_deflate (SNAP_IO *s, int flush)
+{
+uint32 lnt;
+int st;
+
+do {
+    s->zs.next_out = s->buf;
+    s->zs.avail_out = SNAP_ZCHUNK;
+    st = deflate (&s->zs, flush);
+    if (st == Z_STREAM_ERROR)
+        return FALSE;
+    lnt = SNAP_ZCHUNK - s->zs.avail_out;
+    if (lnt && ((sim_fwrite (&lnt, sizeof (lnt), 1, s->f) != 1) ||
+                (fwrite (s->buf, 1, lnt, s->f) != lnt)))
+        return FALSE;
+    } while ((s->zs.avail_out == 0) || ((flush == Z_FINISH) && (st != Z_STREAM_END)));
+return TRUE;
+}
+#endif
+
+static t_bool snap_put (SNAP_IO *s, void *buf, size_t lnt)
+{
+#if defined (HAVE_ZLIB)
+if (s->z) {
+    s->zs.next_in = (Bytef *) buf;
+    s->zs.avail_in = (uInt) lnt;
+    return snap_deflate (s, Z_NO_FLUSH);
+    }
+#endif
+return (fwrite (buf, 1, lnt, s->f) == lnt);
+}
+
+static t_bool snap_get (SNAP_IO *s, void *buf, size_t lnt)
+{
+#if defined (HAVE_ZLIB)
+uint32 clnt;
+int st;
+
+if (s->z) {
+    s->zs.next_out = (Bytef *) buf;
+    s->zs.avail_out = (uInt) lnt;
+    while (s->zs.avail_out) {
+        if (s->zs.avail_in == 0) {                      /* next chunk */
+            if ((sim_fread (&clnt, sizeof (clnt), 1, s->f) != 1) ||
+                (clnt == 0) || (clnt > SNAP_ZCHUNK) ||
+                (fread (s->buf, 1, clnt, s->f) != clnt))
+                return FALSE;
+            s->zs.next_in = s->buf;
+            s->zs.avail_in = clnt;
+            }
+        st = inflate (&s->zs, Z_NO_FLUSH);
+        if ((st != Z_OK) && ((st != Z_STREAM_END) || s->zs.avail_out))
+            return FALSE;
+        }
+    return TRUE;
+    }
+#endif
+return (fread (buf, 1, lnt, s->f) == lnt);
+}
+
+/* Put or get elements of elsize bytes, little endian in the file */
+
+static t_bool snap_put_el (SNAP_IO *s, void *buf, uint32 elsize, size_t cnt)
+{
+uint8 tbuf[SIM_MEM_PGSIZE], *p = (uint8 *) buf;
+size_t n, lim = sizeof (tbuf) / elsize;
+
+if (sim_end || (elsize == 1))
+    return snap_put (s, buf, elsize * cnt);
+for ( ; cnt; cnt = cnt - n, p = p + n * elsize) {
+    n = (cnt < lim)? cnt: lim;
+    sim_buf_copy_swapped (tbuf, p, elsize, n);
+    if (!snap_put (s, tbuf, n * elsize))
+        return FALSE;
+    }
+return TRUE;
+}
+
+static t_bool snap_get_el (SNAP_IO *s, void *buf, uint32 elsize, size_t cnt)
+{
+if (!snap_get (s, buf, elsize * cnt))
+    return FALSE;
+sim_buf_swap_data (buf, elsize, cnt);
+return TRUE;
+}
+
+static t_stat snap_close (SNAP_IO *s, t_bool wr)
+{
+t_bool ok = TRUE;
+#if defined (HAVE_ZLIB)
+uint32 clnt = 0;
+
+if (!s->z)
+    return SCPE_OK;
+if (wr) {
+    ok = snap_deflate (s, Z_FINISH) &&                  /* flush, end chunks */
+        (sim_fwrite (&clnt, sizeof (clnt), 1, s->f) == 1);
+    deflateEnd (&s->zs);
+    }
+else {
+    while (ok) {                                        /* skip to end of chunks */
+        if (sim_fread (&clnt, sizeof (clnt), 1, s->f) != 1)
+            ok = FALSE;
+        else if (clnt == 0)
+            break;
+        else ok = (sim_fseek (s->f, clnt, SEEK_CUR) == 0);
+        }
+    inflateEnd (&s->zs);
+    }
+free (s->buf);
+#endif
+return ok? SCPE_OK: SCPE_IOERR;
+}
+
+/* Classify a page for saving */
+
+static int32 snap_page (SIM_MEM *m, const uint8 *mem, t_addr size, uint32 pg, t_bool incr)
+{
+t_addr off = (t_addr) pg << SIM_MEM_PG_V;
+t_addr i, lnt = ((size - off) < SIM_MEM_PGSIZE)? size - off: SIM_MEM_PGSIZE;
+size_t w;
+
+if (incr && !(m->dirty[pg >> 5] & (1u << (pg & 31))))
+    return SNAP_SKIP;
+for (i = 0; (i + sizeof (size_t)) <= lnt; i = i + sizeof (size_t)) {
+    memcpy (&w, mem + off + i, sizeof (w));
+    if (w)
+        return SNAP_DATA;
+    }
+for ( ; i < lnt; i++) {
+    if (mem[off + i])
+        return SNAP_DATA;
+    }
+return incr? SNAP_ZERO: SNAP_SKIP;                      /* full restore clears */
+}
+
+/* Save a registered memory */
+
+static t_stat sim_mem_save (FILE *sfile, SIM_MEM *m, t_bool incr, t_bool z)
+{
+SNAP_IO s;
+uint8 *mem = (uint8 *) *m->mem;
+t_addr off, lnt, size = m->uptr->capac * m->abytes;
+uint32 pg, n, npg = (uint32) ((size + SIM_MEM_PGSIZE - 1) >> SIM_MEM_PG_V);
+uint32 hdr[3];
+int32 fmt = incr? SNAP_INCR: SNAP_FULL;
+int32 kind, nkind, run[2];
+t_stat r;
+
+if (npg > m->npg)                                       /* beyond dirty map? */
+    return SCPE_IERR;
+hdr[0] = m->elsize;
+hdr[1] = SIM_MEM_PGSIZE;
+hdr[2] = z;
+if ((sim_fwrite (&fmt, sizeof (fmt), 1, sfile) != 1) ||
+    (sim_fwrite (hdr, sizeof (hdr[0]), 3, sfile) != 3))
+    return SCPE_IOERR;
+if ((r = snap_open (&s, sfile, z, TRUE)) != SCPE_OK)
+    return r;
+kind = nkind = snap_page (m, mem, size, 0, incr);
+for (pg = 0; pg < npg; pg = pg + n) {                   /* loop thru runs */
+    for (n = 1; (pg + n) < npg; n++) {
+        nkind = snap_page (m, mem, size, pg + n, incr);
+        if (nkind != kind)
+            break;
+        }
+    if (kind != SNAP_SKIP) {
+        run[0] = (int32) pg;
+        run[1] = (kind == SNAP_ZERO)? -((int32) n): (int32) n;
+        if (!snap_put_el (&s, run, sizeof (run[0]), 2))
+            break;
+        if (kind == SNAP_DATA) {
+            off = (t_addr) pg << SIM_MEM_PG_V;
+            lnt = (((t_addr) n << SIM_MEM_PG_V) < (size - off))?
+                ((t_addr) n << SIM_MEM_PG_V): size - off;
+            if (!snap_put_el (&s, mem + off, m->elsize, lnt / m->elsize))
+                break;
+            }
+        }
+    kind = nkind;
+    }
+run[0] = -1;                                            /* end of runs */
+run[1] = 0;
+if ((pg < npg) || !snap_put_el (&s, run, sizeof (run[0]), 2)) {
+    snap_close (&s, TRUE);
+    return SCPE_IOERR;
+    }
+return snap_close (&s, TRUE);
+}
+
+/* Restore a registered memory */
+
+static t_stat sim_mem_rest (FILE *rfile, SIM_MEM *m, UNIT *uptr, int32 fmt)
+{
+SNAP_IO s;
+uint8 *mem;
+t_addr off, lnt, size;
+uint32 hdr[3];
+int32 run[2];
+t_stat r;
+
+if ((m == NULL) || ((fmt != SNAP_FULL) && (fmt != SNAP_INCR))) {
+    printf ("Can't restore memory: %s\n", sim_uname (uptr));
+    if (sim_log)
+        fprintf (sim_log, "Can't restore memory: %s\n", sim_uname (uptr));
+    return SCPE_INCOMP;
+    }
+if (sim_fread (hdr, sizeof (hdr[0]), 3, rfile) != 3)
+    return SCPE_IOERR;
+mem = (uint8 *) *m->mem;
+size = uptr->capac * m->abytes;
+if ((hdr[0] != m->elsize) || (hdr[1] != SIM_MEM_PGSIZE) ||
+    (((size + SIM_MEM_PGSIZE - 1) >> SIM_MEM_PG_V) > m->npg)) {
+    printf ("Incompatible memory layout: %s\n", sim_uname (uptr));
+    if (sim_log)
+        fprintf (sim_log, "Incompatible memory layout: %s\n", sim_uname (uptr));
+    return SCPE_INCOMP;
+    }
+if ((r = snap_open (&s, rfile, hdr[2] != 0, FALSE)) != SCPE_OK) {
+    if (r == SCPE_NOFNC) {
+        printf ("Compressed memory needs zlib support: %s\n", sim_uname (uptr));
+        if (sim_log)
+            fprintf (sim_log, "Compressed memory needs zlib support: %s\n", sim_uname (uptr));
+        r = SCPE_INCOMP;
+        }
+    return r;
+    }
+if (fmt == SNAP_FULL)                                   /* omitted pages are 0 */
+    memset (mem, 0, (size_t) size);
+for (r = SCPE_IOERR; snap_get_el (&s, run, sizeof (run[0]), 2); ) {
+    if (run[0] < 0) {                                   /* end of runs? */
+        r = SCPE_OK;
+        break;
+        }
+    off = (t_addr) run[0] << SIM_MEM_PG_V;
+    lnt = (t_addr) ((run[1] < 0)? -run[1]: run[1]) << SIM_MEM_PG_V;
+    if (off >= size)                                    /* outside memory? */
+        break;
+    if (lnt > (size - off))
+        lnt = size - off;
+    if (run[1] < 0)
+        memset (mem + off, 0, (size_t) lnt);
+    else if (!snap_get_el (&s, mem + off, m->elsize, lnt / m->elsize))
+        break;
+    }
+if (r != SCPE_OK) {
+    snap_close (&s, FALSE);
+    return r;
+    }
+return snap_close (&s, FALSE);
+}
+
+/* Restore the base of an incremental snapshot */
+
+static t_stat sim_rest_base (char *fname)
+{
+static int32 depth = 0;
+FILE *bfile;
+t_stat r;
+
+if (depth >= SIM_SNAP_CHAIN) {
+    printf ("Too many incremental saves: %s\n", fname);
+    if (sim_log)
+        fprintf (sim_log, "Too many incremental saves: %s\n", fname);
+    return SCPE_INCOMP;
+    }
+if ((bfile = sim_fopen (fname, "rb")) == NULL) {
+    printf ("Can't open base save file: %s\n", fname);
+    if (sim_log)
+        fprintf (sim_log, "Can't open base save file: %s\n", fname);
+    return SCPE_OPENERR;
+    }
+++depth;
+r = sim_rest_mem (bfile);
+--depth;
+fclose (bfile);
+return r;
+}
+
 /* Save command
 
-   sa[ve] filename              save state to specified file
+   sa[ve] {-i} {-z} filename    save state to specified file
 */
 
 t_stat save_cmd (int32 flag, char *cptr)
@@ -3612,10 +4158,30 @@ GET_SWITCHES (cptr);                                    /* get switches */
 if (*cptr == 0)                                         /* must be more */
     return SCPE_2FARG;
 sim_trim_endspc (cptr);
+if (sim_switches & SWMASK ('I')) {                      /* incremental? */
+    if (sim_snap_last[0] == '\0') {
+        printf ("No previous SAVE or RESTORE for an incremental save\n");
+        if (sim_log)
+            fprintf (sim_log, "No previous SAVE or RESTORE for an incremental save\n");
+        return SCPE_ARG;
+        }
+    if (sim_snap_in_chain (cptr)) {                     /* would lose a base */
+        printf ("Incremental save can't replace one of its bases: %s\n", cptr);
+        if (sim_log)
+            fprintf (sim_log, "Incremental save can't replace one of its bases: %s\n", cptr);
+        return SCPE_ARG;
+        }
+    }
+#if !defined (HAVE_ZLIB)
+if (sim_switches & SWMASK ('Z'))                        /* no compression */
+    return SCPE_NOFNC;
+#endif
 if ((sfile = sim_fopen (cptr, "wb")) == NULL)
     return SCPE_OPENERR;
 r = sim_save (sfile);
 fclose (sfile);
+if (r == SCPE_OK)
+    sim_snap_done (cptr);
 return r;
 }
 
@@ -3628,17 +4194,21 @@ t_addr k, high;
 t_value val;
 t_stat r;
 t_bool zeroflg;
+t_bool incr = (sim_switches & SWMASK ('I')) != 0;
+t_bool zflg = (sim_switches & SWMASK ('Z')) != 0;
 size_t sz;
 DEVICE *dptr;
 UNIT *uptr;
 REG *rptr;
+SIM_MEM *m;
 
 #define WRITE_I(xx) sim_fwrite (&(xx), sizeof (xx), 1, sfile)
 
-fprintf (sfile, "%s\n%s\n%s\n%s\n%s\n%.0f\n",
+fprintf (sfile, "%s\n%s\n%s\n%s\n%s\n%s\n%.0f\n",
     save_vercur,                                        /* [V2.5] save format */
     sim_name,                                           /* sim name */
     sim_si64, sim_sa64, sim_snet,                       /* [V3.5] options */
+    incr? sim_snap_last: "",                            /* [V4.0] base save file */
     sim_time);                                          /* [V3.2] sim time */
 WRITE_I (sim_rtime);                                    /* [V2.6] sim rel time */
 
@@ -3678,6 +4248,14 @@ for (i = 0; (dptr = sim_devices[i]) != NULL; i++) {     /* loop thru devices */
              (dptr->examine != NULL) &&
              ((high = uptr->capac) != 0)) {             /* memory-like unit? */
             WRITE_I (high);                             /* [V2.5] write size */
+            if ((m = sim_mem_find (uptr)) != NULL) {    /* [V4.0] registered? */
+                r = sim_mem_save (sfile, m, incr, zflg);/* save in bulk */
+                if (r != SCPE_OK)
+                    return r;
+                continue;
+                }
+            t = SNAP_WORDS;                             /* [V4.0] via examine */
+            WRITE_I (t);
             sz = SZ_D (dptr);
             if ((mbuf = calloc (SRBSIZ, sz)) == NULL) {
                 fclose (sfile);
@@ -3747,6 +4325,9 @@ if ((rfile = sim_fopen (cptr, "rb")) == NULL)
     return SCPE_OPENERR;
 r = sim_rest (rfile);
 fclose (rfile);
+if (r == SCPE_OK)
+    sim_snap_done (cptr);
+else sim_mem_dirty_all ();                              /* memory partly restored */
 return r;
 }
 
@@ -3757,14 +4338,12 @@ char **attnames = NULL;
 UNIT **attunits = NULL;
 int32 *attswitches = NULL;
 int32 attcnt = 0;
-void *mbuf;
-int32 j, blkcnt, limit, unitno, time, flg;
+int32 j, unitno, time, flg, fmt;
 uint32 us, depth;
-t_addr k, high, old_capac;
+t_addr high, old_capac;
 t_value val, mask;
 t_stat r;
-size_t sz;
-t_bool v35, v32;
+t_bool v40, v35, v32;
 DEVICE *dptr;
 UNIT *uptr;
 REG *rptr;
@@ -3778,8 +4357,10 @@ t_bool force_restore = sim_switches & SWMASK ('F');
 
 fstat (fileno (rfile), &rstat);
 READ_S (buf);                                           /* [V2.5+] read version */
-v35 = v32 = FALSE;
-if (strcmp (buf, save_vercur) == 0)                     /* version 3.5? */
+v40 = v35 = v32 = FALSE;
+if (strcmp (buf, save_vercur) == 0)                     /* version 4.0? */
+    v40 = v35 = v32 = TRUE;
+else if (strcmp (buf, save_ver35) == 0)                 /* version 3.5? */
     v35 = v32 = TRUE;  
 else if (strcmp (buf, save_ver32) == 0)                 /* version 3.2? */
     v32 = TRUE;
@@ -3813,6 +4394,12 @@ if (v35) {                                              /* [V3.5+] options */
         }
     READ_S (buf);                                       /* Ethernet */
     }
+if (v40) {                                              /* [V4.0+] base save file */
+    READ_S (buf);
+    if ((buf[0] != '\0') &&                             /* incremental? */
+        ((r = sim_rest_base (buf)) != SCPE_OK))         /* base's memory first */
+        return r;
+    }
 if (v32) {                                              /* [V3.2+] time as string */
     READ_S (buf);
     sscanf (buf, "%lf", &sim_time);
@@ -3903,55 +4490,21 @@ for ( ;; ) {                                            /* device loop */
                     fprintf (sim_log, "Can't restore memory: %s%d\n", sim_dname (dptr), unitno);
                 return SCPE_INCOMP;
                 }
-            if (high != old_capac) {                    /* size change? */
-                uptr->capac = old_capac;                /* temp restore old */
-                if ((dptr->flags & DEV_DYNM) &&
-                    ((dptr->msize == NULL) ||
-                     (dptr->msize (uptr, (int32) high, NULL, NULL) != SCPE_OK))) {
-                    printf ("Can't change memory size: %s%d\n",
-                        sim_dname (dptr), unitno);
-                    if (sim_log)
-                        fprintf (sim_log, "Can't change memory size: %s%d\n",
-                            sim_dname (dptr), unitno);
-                    return SCPE_INCOMP;
-                    }
-                uptr->capac = high;                     /* new memory size */
-                printf ("Memory size changed: %s%d = ", sim_dname (dptr), unitno);
-                fprint_capac (stdout, dptr, uptr);
-                printf ("\n");
-                if (sim_log) {
-                    fprintf (sim_log, "Memory size changed: %s%d = ", sim_dname (dptr), unitno);
-                    fprint_capac (sim_log, dptr, uptr);
-                    fprintf (sim_log, "\n");
+            if ((high != old_capac) &&                  /* size change? */
+                ((r = sim_rest_size (dptr, uptr, high, old_capac)) != SCPE_OK))
+                return r;
+            if (v40) {                                  /* [V4.0+] memory format */
+                READ_I (fmt);
+                if (fmt != SNAP_WORDS) {                /* saved in bulk? */
+                    r = sim_mem_rest (rfile, sim_mem_find (uptr), uptr, fmt);
+                    if (r != SCPE_OK)
+                        return r;
+                    continue;
                     }
                 }
-            sz = SZ_D (dptr);                           /* allocate buffer */
-            if ((mbuf = calloc (SRBSIZ, sz)) == NULL)
-                return SCPE_MEM;
-            for (k = 0; k < high; ) {                   /* loop thru mem */
-                if (sim_fread (&blkcnt, sizeof (blkcnt), 1, rfile) == 0) {/* block count */
-                    free (mbuf);
-                    return SCPE_IOERR;
-                    }
-                if (blkcnt < 0)                         /* compressed? */
-                    limit = -blkcnt;
-                else limit = (int32)sim_fread (mbuf, sz, blkcnt, rfile);
-                if (limit <= 0) {                       /* invalid or err? */
-                    free (mbuf);
-                    return SCPE_IOERR;
-                    }
-                for (j = 0; j < limit; j++, k = k + (dptr->aincr)) {
-                    if (blkcnt < 0)                     /* compressed? */
-                        val = 0;
-                    else SZ_LOAD (sz, val, mbuf, j);    /* saved value */
-                    r = dptr->deposit (val, k, uptr, SIM_SW_REST);
-                    if (r != SCPE_OK) {
-                        free (mbuf);
-                        return r;
-                        }
-                    }                                   /* end for j */
-                }                                       /* end for k */
-            free (mbuf);                                /* dealloc buffer */
+            r = sim_rest_words (rfile, dptr, uptr, high, TRUE);
+            if (r != SCPE_OK)
+                return r;
             }                                           /* end if high */
         }                                               /* end unit loop */
     for ( ;; ) {                                        /* register loop */
@@ -4024,33 +4577,217 @@ free (attswitches);
 return r;
 }
 
-/* Run, go, cont, step commands
+/* Change a memory unit's size to that of a save file */
 
-   ru[n] [new PC]       reset and start simulation
-   go [new PC]          start simulation
-   co[nt]               start simulation
-   s[tep] [step limit]  start simulation for 'limit' instructions
-   b[oot] device        bootstrap from device and start simulation
-*/
+static t_stat sim_rest_size (DEVICE *dptr, UNIT *uptr, t_addr high, t_addr old_capac)
+{
+uptr->capac = old_capac;                                /* temp restore old */
+if ((dptr->flags & DEV_DYNM) &&
+    ((dptr->msize == NULL) ||
+     (dptr->msize (uptr, (int32) high, NULL, NULL) != SCPE_OK))) {
+    printf ("Can't change memory size: %s\n", sim_uname (uptr));
+    if (sim_log)
+        fprintf (sim_log, "Can't change memory size: %s\n", sim_uname (uptr));
+    return SCPE_INCOMP;
+    }
+uptr->capac = high;                                     /* new memory size */
+printf ("Memory size changed: %s = ", sim_uname (uptr));
+fprint_capac (stdout, dptr, uptr);
+printf ("\n");
+if (sim_log) {
+    fprintf (sim_log, "Memory size changed: %s = ", sim_uname (uptr));
+    fprint_capac (sim_log, dptr, uptr);
+    fprintf (sim_log, "\n");
+    }
+return SCPE_OK;
+}
 
-t_stat run_cmd (int32 flag, char *cptr)
+/* Read memory saved a word at a time, depositing it if dep is set */
+
+static t_stat sim_rest_words (FILE *rfile, DEVICE *dptr, UNIT *uptr, t_addr high, t_bool dep)
 {
-char *tptr, gbuf[CBUFSIZE];
-uint32 i, j;
-int32 unitno;
-t_value pcv;
+void *mbuf;
+int32 j, blkcnt, limit;
+t_addr k;
+t_value val;
 t_stat r;
-DEVICE *dptr;
-UNIT *uptr;
+size_t sz;
 
-GET_SWITCHES (cptr);                                    /* get switches */
-sim_step = 0;
-if ((flag == RU_RUN) || (flag == RU_GO)) {              /* run or go */
-    if (*cptr != 0) {                                   /* argument? */
-        cptr = get_glyph (cptr, gbuf, 0);               /* get next glyph */
-        if (*cptr != 0)                                 /* should be end */
-            return SCPE_2MARG;
-        if (sim_vm_parse_addr)                          /* address parser? */
+sz = SZ_D (dptr);                                       /* allocate buffer */
+if ((mbuf = calloc (SRBSIZ, sz)) == NULL)
+    return SCPE_MEM;
+for (k = 0; k < high; ) {                               /* loop thru mem */
+    if (sim_fread (&blkcnt, sizeof (blkcnt), 1, rfile) == 0) {/* block count */
+        free (mbuf);
+        return SCPE_IOERR;
+        }
+    if (blkcnt < 0)                                     /* compressed? */
+        limit = -blkcnt;
+    else limit = (int32)sim_fread (mbuf, sz, blkcnt, rfile);
+    if (limit <= 0) {                                   /* invalid or err? */
+        free (mbuf);
+        return SCPE_IOERR;
+        }
+    for (j = 0; j < limit; j++, k = k + (dptr->aincr)) {
+        if (!dep)
+            continue;
+        if (blkcnt < 0)                                 /* compressed? */
+            val = 0;
+        else SZ_LOAD (sz, val, mbuf, j);                /* saved value */
+        r = dptr->deposit (val, k, uptr, SIM_SW_REST);
+        if (r != SCPE_OK) {
+            free (mbuf);
+            return r;
+            }
+        }                                               /* end for j */
+    }                                                   /* end for k */
+free (mbuf);                                            /* dealloc buffer */
+return SCPE_OK;
+}
+
+/* Restore only the registered memories from the base of an incremental
+   save file.  Everything else comes from the incremental file itself, so
+   the rest of the base is read and discarded: its devices, registers and
+   attachments are not restored. */
+
+static t_stat sim_rest_mem (FILE *rfile)
+{
+char buf[CBUFSIZE];
+int32 unitno, i32;
+uint32 us, depth;
+t_addr high, capac;
+t_value val;
+double tm;
+t_bool v40, v35, v32;
+DEVICE *dptr;
+UNIT *uptr;
+SIM_MEM *m;
+t_stat r;
+
+READ_S (buf);                                           /* version */
+v40 = (strcmp (buf, save_vercur) == 0);
+v35 = v40 || (strcmp (buf, save_ver35) == 0);
+v32 = v35 || (strcmp (buf, save_ver32) == 0);
+if (!v32 && (strcmp (buf, save_ver30) != 0)) {
+    printf ("Invalid file version: %s\n", buf);
+    if (sim_log)
+        fprintf (sim_log, "Invalid file version: %s\n", buf);
+    return SCPE_INCOMP;
+    }
+READ_S (buf);                                           /* sim name */
+if (strcmp (buf, sim_name)) {
+    printf ("Wrong system type: %s\n", buf);
+    if (sim_log)
+        fprintf (sim_log, "Wrong system type: %s\n", buf);
+    return SCPE_INCOMP;
+    }
+if (v35) {                                              /* options */
+    READ_S (buf);
+    if (strcmp (buf, sim_si64) != 0)
+        return SCPE_INCOMP;
+    READ_S (buf);
+    if (strcmp (buf, sim_sa64) != 0)
+        return SCPE_INCOMP;
+    READ_S (buf);
+    }
+if (v40) {                                              /* base save file */
+    READ_S (buf);
+    if ((buf[0] != '\0') &&
+        ((r = sim_rest_base (buf)) != SCPE_OK))
+        return r;
+    }
+if (v32) {                                              /* sim time */
+    READ_S (buf);
+    }
+else READ_I (tm);
+READ_I (us);                                            /* sim rel time */
+for ( ;; ) {                                            /* device loop */
+    READ_S (buf);                                       /* device name */
+    if (buf[0] == 0)
+        break;
+    if ((dptr = find_dev (buf)) == NULL) {
+        printf ("Invalid device name: %s\n", buf);
+        if (sim_log)
+            fprintf (sim_log, "Invalid device name: %s\n", buf);
+        return SCPE_INCOMP;
+        }
+    READ_S (buf);                                       /* logical name */
+    READ_I (i32);                                       /* ctlr flags */
+    for ( ;; ) {                                        /* unit loop */
+        READ_I (unitno);
+        if (unitno < 0)
+            break;
+        if ((uint32) unitno >= dptr->numunits)
+            return SCPE_INCOMP;
+        uptr = (dptr->units) + unitno;
+        READ_I (i32);                                   /* event time */
+        READ_I (i32);                                   /* u3 - u6 */
+        READ_I (i32);
+        READ_I (i32);
+        READ_I (i32);
+        READ_I (i32);                                   /* flags */
+        READ_I (us);                                    /* dynflags */
+        if (v35) {
+            READ_I (capac);
+            }
+        READ_S (buf);                                   /* attached file */
+        READ_I (high);                                  /* memory capacity */
+        if (high == 0)
+            continue;
+        m = sim_mem_find (uptr);
+        if (m && (high != uptr->capac) &&               /* registered, size change? */
+            ((r = sim_rest_size (dptr, uptr, high, uptr->capac)) != SCPE_OK))
+            return r;
+        i32 = SNAP_WORDS;
+        if (v40) {
+            READ_I (i32);                               /* memory format */
+            }
+        if (i32 != SNAP_WORDS)
+            r = sim_mem_rest (rfile, m, uptr, i32);
+        else r = sim_rest_words (rfile, dptr, uptr, high, m != NULL);
+        if (r != SCPE_OK)
+            return r;
+        }
+    for ( ;; ) {                                        /* register loop */
+        READ_S (buf);
+        if (buf[0] == 0)
+            break;
+        READ_I (depth);
+        for (us = 0; us < depth; us++) {
+            READ_I (val);
+            }
+        }
+    }
+return SCPE_OK;
+}
+
+/* Run, go, cont, step commands
+
+   ru[n] [new PC]       reset and start simulation
+   go [new PC]          start simulation
+   co[nt]               start simulation
+   s[tep] [step limit]  start simulation for 'limit' instructions
+   b[oot] device        bootstrap from device and start simulation
+*/
+
+t_stat run_cmd (int32 flag, char *cptr)
+{
+char *tptr, gbuf[CBUFSIZE];
+uint32 i, j;
+int32 unitno;
+t_value pcv;
+t_stat r;
+DEVICE *dptr;
+UNIT *uptr;
+
+GET_SWITCHES (cptr);                                    /* get switches */
+sim_step = 0;
+if ((flag == RU_RUN) || (flag == RU_GO)) {              /* run or go */
+    if (*cptr != 0) {                                   /* argument? */
+        cptr = get_glyph (cptr, gbuf, 0);               /* get next glyph */
+        if (*cptr != 0)                                 /* should be end */
+            return SCPE_2MARG;
+        if (sim_vm_parse_addr)                          /* address parser? */
             pcv = sim_vm_parse_addr (sim_dflt_dev, gbuf, &tptr);
         else pcv = strtotv (gbuf, &tptr, sim_PC->radix);/* parse PC */
         if ((tptr == gbuf) || (*tptr != 0) ||           /* error? */
@@ -4096,6 +4833,7 @@ else if (flag == RU_BOOT) {                             /* boot */
     unitno = (int32) (uptr - dptr->units);              /* recover unit# */
     if ((r = run_boot_prep ()) != SCPE_OK)              /* reset sim */
         return r;
+    sim_mem_dirty_all ();                               /* bootstraps write memory */
     if ((r = dptr->boot (unitno, dptr)) != SCPE_OK)     /* boot device */
         return r;
     }
@@ -4146,6 +4884,7 @@ if (sim_log)                                            /* flush log if enabled
     fflush (sim_log);
 sim_throt_sched ();                                     /* set throttle */
 sim_brk_clract ();                                      /* defang actions */
+sim_brk_whit = 0;                                       /* no watchpoint hit */
 sim_rtcn_init_all ();                                   /* re-init clocks */
 sim_start_timer_services ();                            /* enable wall clock timing */
 r = sim_instr();
@@ -4162,6 +4901,7 @@ if (sim_log)                                            /* flush console log */
     fflush (sim_log);
 if (sim_deb)                                            /* flush debug log */
     fflush (sim_deb);
+sim_debug_trace_flush ();                               /* and any binary trace */
 for (i = 1; (dptr = sim_devices[i]) != NULL; i++) {     /* flush attached files */
     for (j = 0; j < dptr->numunits; j++) {              /* if not buffered in mem */
         uptr = dptr->units + j;
@@ -4210,10 +4950,13 @@ UNIT *uptr;
 
 sim_interval = 0;                                       /* reset queue */
 sim_time = sim_rtime = 0;
-noqueue_time = 0;
-for (uptr = sim_clock_queue; uptr != QUEUE_LIST_END; uptr = sim_clock_queue) {
-    sim_clock_queue = uptr->next;
+sim_interval_base = 0;
+sim_queue_time = 0;
+while (sim_clock_queue != QUEUE_LIST_END) {
+    uptr = sim_clock_queue;
+    _sim_clock_heap_remove (uptr);
     uptr->next = NULL;
+    uptr->time = 0;
     }
 return reset_all (0);
 }
@@ -4231,7 +4974,7 @@ if (v >= SCPE_BASE)
     fprintf (st, "\n%s, %s: ", sim_error_text (v), pc->name);
 else
     fprintf (st, "\n%s, %s: ", sim_stop_messages[v], pc->name);
-pcval = get_rval (pc, 0);
+pcval = (sim_brk_whit)? sim_brk_wpc: get_rval (pc, 0);   /* watchpoint? its instr */
 if (sim_vm_fprint_addr)
     sim_vm_fprint_addr (st, dptr, (t_addr) pcval);
 else fprint_val (st, pcval, pc->radix, pc->width,
@@ -4251,6 +4994,15 @@ if ((dptr != NULL) && (dptr->examine != NULL)) {
         }
     }
 fprintf (st, "\n");
+if (sim_brk_whit && (dptr != NULL)) {                   /* watchpoint reference */
+    fprintf (st, "%s ", (sim_brk_whit & SWMASK ('W'))? "Write of": "Read of");
+    if (sim_vm_fprint_addr)
+        sim_vm_fprint_addr (st, dptr, sim_brk_wloc);
+    else fprint_val (st, sim_brk_wloc, dptr->aradix, dptr->awidth, PV_LEFT);
+    fprintf (st, ": ");
+    fprint_val (st, sim_brk_wval, dptr->dradix, dptr->dwidth, PV_LEFT);
+    fprintf (st, "\n");
+    }
 return;
 }
 
@@ -5762,8 +6514,13 @@ return SCPE_OK;
    and to see if further events need to be processed, or sim_interval
    reset to count the next one.
 
-   The event queue is maintained in clock order; entry timeouts are
-   RELATIVE to the time in the previous entry.
+   The event queue is an indexed binary min-heap ordered by absolute due
+   time (in queue time units), with ties broken by insertion order so that
+   events due at the same time are processed first in, first out.  Each
+   unit records its slot in the heap, which makes activate and cancel
+   O(log n) operations.  sim_clock_queue always points to the entry that
+   will fire next (or is QUEUE_LIST_END when the queue is empty) and
+   sim_interval counts down the instructions remaining until it is due.
 
    sim_process_event - process event
 
@@ -5785,19 +6542,20 @@ AIO_UPDATE_QUEUE;
 UPDATE_SIM_TIME;                                        /* update sim time */
 
 if (sim_clock_queue == QUEUE_LIST_END) {                /* queue empty? */
-    sim_interval = noqueue_time = NOQUEUE_WAIT;         /* flag queue empty */
+    sim_interval = sim_interval_base = NOQUEUE_WAIT;    /* flag queue empty */
     sim_debug (SIM_DBG_EVENT, sim_dflt_dev, "Queue Emptry New Interval = %d\n", sim_interval);
     return SCPE_OK;
     }
 do {
     uptr = sim_clock_queue;                             /* get first */
-    sim_clock_queue = uptr->next;                       /* remove first */
+    _sim_clock_heap_remove (uptr);                      /* remove first */
+    sim_queue_time = uptr->q_due;                       /* queue time is now its due time */
     uptr->next = NULL;                                  /* hygiene */
     uptr->time = 0;
     if (sim_clock_queue != QUEUE_LIST_END)
-        sim_interval = sim_clock_queue->time;
+        sim_interval = sim_interval_base = (int32)(sim_clock_queue->q_due - sim_queue_time);
     else
-        sim_interval = noqueue_time = NOQUEUE_WAIT;
+        sim_interval = sim_interval_base = NOQUEUE_WAIT;
     sim_debug (SIM_DBG_EVENT, sim_dflt_dev, "Processing Event for %s\n", sim_uname (uptr));
     AIO_EVENT_BEGIN(uptr);
     if (uptr->action != NULL)
@@ -5810,7 +6568,7 @@ do {
              (sim_clock_queue != QUEUE_LIST_END));
 
 if (sim_clock_queue == QUEUE_LIST_END) {                /* queue empty? */
-    sim_interval = noqueue_time = NOQUEUE_WAIT;         /* flag queue empty */
+    sim_interval = sim_interval_base = NOQUEUE_WAIT;    /* flag queue empty */
     sim_debug (SIM_DBG_EVENT, sim_dflt_dev, "Processing Queue Complete New Interval = %d\n", sim_interval);
     }
 else
@@ -5835,8 +6593,7 @@ return _sim_activate (uptr, event_time);
 
 t_stat _sim_activate (UNIT *uptr, int32 event_time)
 {
-UNIT *cptr, *prvptr;
-int32 accum;
+t_stat r;
 
 AIO_ACTIVATE (_sim_activate, uptr, event_time);
 if (sim_is_active (uptr))                               /* already active? */
@@ -5845,26 +6602,14 @@ UPDATE_SIM_TIME;                                        /* update sim time */
 
 sim_debug (SIM_DBG_ACTIVATE, sim_dflt_dev, "Activating %s delay=%d\n", sim_uname (uptr), event_time);
 
-prvptr = NULL;
-accum = 0;
-for (cptr = sim_clock_queue; cptr != QUEUE_LIST_END; cptr = cptr->next) {
-    if (event_time < (accum + cptr->time))
-        break;
-    accum = accum + cptr->time;
-    prvptr = cptr;
-    }
-if (prvptr == NULL) {                                   /* insert at head */
-    cptr = uptr->next = sim_clock_queue;
-    sim_clock_queue = uptr;
-    }
-else {
-    cptr = uptr->next = prvptr->next;                   /* insert at prvptr */
-    prvptr->next = uptr;
-    }
-uptr->time = event_time - accum;
-if (cptr != QUEUE_LIST_END)
-    cptr->time = cptr->time - uptr->time;
-sim_interval = sim_clock_queue->time;
+uptr->q_due = sim_queue_time + event_time;
+uptr->q_seq = sim_clock_seq++;
+uptr->time = event_time;
+r = _sim_clock_heap_insert (uptr);
+if (r != SCPE_OK)
+    return r;
+uptr->next = QUEUE_LIST_END;                            /* mark as queued */
+sim_interval = sim_interval_base = (int32)(sim_clock_queue->q_due - sim_queue_time);
 return SCPE_OK;
 }
 
@@ -5941,35 +6686,20 @@ return sim_timer_activate_after (uptr, usec_delay);
 
 t_stat sim_cancel (UNIT *uptr)
 {
-UNIT *cptr, *nptr;
-
 AIO_VALIDATE;
 AIO_CANCEL(uptr);
 AIO_UPDATE_QUEUE;
 if (sim_clock_queue == QUEUE_LIST_END)
     return SCPE_OK;
 UPDATE_SIM_TIME;                                        /* update sim time */
-if (!sim_is_active (uptr))
+if (uptr->q_index == 0)                                 /* not on clock queue? */
     return SCPE_OK;
-nptr = QUEUE_LIST_END;
-
-if (sim_clock_queue == uptr)
-    nptr = sim_clock_queue = uptr->next;
-else {
-    for (cptr = sim_clock_queue; cptr != QUEUE_LIST_END; cptr = cptr->next) {
-        if (cptr->next == uptr) {
-            nptr = cptr->next = uptr->next;
-            break;                                      /* end queue scan */
-            }
-        }
-    }
-if (nptr != QUEUE_LIST_END)
-    nptr->time = nptr->time + uptr->time;
+_sim_clock_heap_remove (uptr);
 uptr->next = NULL;                                      /* hygiene */
 uptr->time = 0;
 if (sim_clock_queue != QUEUE_LIST_END)
-    sim_interval = sim_clock_queue->time;
-else sim_interval = noqueue_time = NOQUEUE_WAIT;
+    sim_interval = sim_interval_base = (int32)(sim_clock_queue->q_due - sim_queue_time);
+else sim_interval = sim_interval_base = NOQUEUE_WAIT;
 return SCPE_OK;
 }
 
@@ -5998,21 +6728,16 @@ return (((uptr->next) || AIO_IS_ACTIVE(uptr)) ? TRUE : FALSE);
 
 int32 sim_activate_time (UNIT *uptr)
 {
-UNIT *cptr;
 int32 accum = 0;
 
 AIO_VALIDATE;
 AIO_RETURN_TIME(uptr);
-for (cptr = sim_clock_queue; cptr != QUEUE_LIST_END; cptr = cptr->next) {
-    if (cptr == sim_clock_queue) {
-        if (sim_interval > 0)
-            accum = accum + sim_interval;
-        }
-    else accum = accum + cptr->time;
-    if (cptr == uptr)
-        return accum + 1;
-    }
-return 0;
+if (uptr->q_index == 0)                                 /* not on clock queue? */
+    return 0;
+if (sim_interval > 0)
+    accum = sim_interval;
+accum = accum + (int32)(uptr->q_due - sim_clock_queue->q_due);
+return accum + 1;
 }
 
 /* sim_gtime - return global time
@@ -6044,13 +6769,242 @@ return sim_rtime;
 
 int32 sim_qcount (void)
 {
-int32 cnt;
-UNIT *uptr;
+return (int32)sim_clock_heap_cnt;
+}
+
+#if defined (SIM_ASYNCH_IO)
+/* Asynchronous completion ring
+
+   sim_aio_post         post a completion from an I/O thread
+   sim_aio_drain        activate posted completions on the simulator thread
+
+   sim_aio_post is reached through AIO_ACTIVATE when a unit is activated
+   from a thread other than the simulator thread, or directly by an I/O
+   thread that has a completion status to deliver.  If the ring is full
+   the record is appended to the spill list instead; once anything has
+   been spilled later records follow it there, so that completions are
+   still activated in the order they were posted.
+*/
+
+void sim_aio_post (t_stat (*caller)(UNIT *, int32), UNIT *uptr, int32 event_time, t_stat status)
+{
+AIO_COMPLETION *slot;
+uint32 pos;
+t_bool posted = FALSE;
+
+sim_debug (SIM_DBG_AIO_QUEUE, sim_dflt_dev, "Queueing Asynch event for %s after %d instructions\n", sim_uname(uptr), event_time);
+AIO_PENDING_ADJUST (uptr, 1);
+uptr->a_event_time = event_time;
+while (!posted) {
+    if (sim_asynch_spill_cnt == 0) {                    /* nothing spilled ahead of us? */
+        AIO_RING_LOCK;
+        pos = sim_asynch_ring_tail;
+        slot = &sim_asynch_ring[pos & AIO_RING_MASK];
+        if ((slot->seq == pos) && AIO_RING_CLAIM (pos)) {/* slot free and ours? */
+            slot->uptr = uptr;
+            slot->event_time = event_time;
+            slot->status = status;
+            slot->activate_call = caller;
+            AIO_MEMORY_BARRIER;
+            slot->seq = pos + 1;                        /* publish */
+            AIO_RING_UNLOCK;
+            break;
+            }
+        AIO_RING_UNLOCK;
+        if (((int32)(slot->seq - pos)) >= 0)            /* raced for a free slot? */
+            continue;
+        }
+    pthread_mutex_lock (&sim_asynch_lock);
+    if (sim_asynch_spill_cnt == sim_asynch_spill_max) {
+        uint32 max = sim_asynch_spill_max ? 2 * sim_asynch_spill_max : AIO_RING_SIZE;
+        AIO_COMPLETION *spill = (AIO_COMPLETION *)realloc (sim_asynch_spill, max * sizeof (*spill));
+
+        if (spill == NULL) {                            /* out of memory? */
+            pthread_mutex_unlock (&sim_asynch_lock);
+            sim_os_ms_sleep (1);                        /* wait for the ring to drain */
+            continue;
+            }
+        sim_asynch_spill = spill;
+        sim_asynch_spill_max = max;
+        }
+    slot = &sim_asynch_spill[sim_asynch_spill_cnt];
+    slot->uptr = uptr;
+    slot->event_time = event_time;
+    slot->status = status;
+    slot->activate_call = caller;
+    AIO_MEMORY_BARRIER;
+    sim_asynch_spill_cnt = sim_asynch_spill_cnt + 1;
+    pthread_mutex_unlock (&sim_asynch_lock);
+    posted = TRUE;
+    }
+sim_asynch_check = 0;                                   /* try to force check */
+AIO_MEMORY_BARRIER;                                     /* published before looking for an idler */
+if (sim_idle_wait) {
+    sim_debug (TIMER_DBG_IDLE, &sim_timer_dev, "waking due to event on %s after %d instructions\n", sim_uname(uptr), event_time);
+    pthread_mutex_lock (&sim_asynch_lock);              /* idler is either not yet waiting */
+    pthread_cond_signal (&sim_asynch_wake);             /* and will see the event, or is waiting */
+    pthread_mutex_unlock (&sim_asynch_lock);
+    }
+}
+
+/* Activate one posted completion.  Each record is activated on its own,
+   with the unit still counted in a_pending until its a_check_completion
+   has run. */
+
+static void _sim_aio_activate (AIO_COMPLETION *rec)
+{
+UNIT *uptr = rec->uptr;
+UNIT *save_activating = sim_aio_activating;
+int32 a_event_time;
+
+sim_debug (SIM_DBG_AIO_QUEUE, sim_dflt_dev, "Found Asynch event for %s after %d instructions\n", sim_uname(uptr), rec->event_time);
+if (rec->activate_call != &sim_activate_notbefore) {
+    a_event_time = rec->event_time-((sim_asynch_inst_latency+1)/2);
+    if (a_event_time < 0)
+        a_event_time = 0;
+    }
+else
+    a_event_time = rec->event_time;
+uptr->a_status = rec->status;
+sim_aio_activating = uptr;
+rec->activate_call (uptr, a_event_time);
+if (uptr->a_check_completion)
+    uptr->a_check_completion (uptr);
+sim_aio_activating = save_activating;
+AIO_PENDING_ADJUST (uptr, -1);
+}
+
+void sim_aio_drain (void)
+{
+AIO_COMPLETION batch[AIO_RING_BATCH];
+uint32 i, count;
+
+do {
+    AIO_RING_LOCK;
+    for (count = 0; count < AIO_RING_BATCH; count++) {
+        AIO_COMPLETION *slot = &sim_asynch_ring[sim_asynch_ring_head & AIO_RING_MASK];
+
+        if (slot->seq != sim_asynch_ring_head + 1)      /* nothing more published? */
+            break;
+        AIO_MEMORY_BARRIER;
+        batch[count] = *slot;
+        AIO_MEMORY_BARRIER;
+        slot->seq = sim_asynch_ring_head + AIO_RING_SIZE;/* release slot */
+        sim_asynch_ring_head = sim_asynch_ring_head + 1;
+        }
+    AIO_RING_UNLOCK;
+    for (i = 0; i < count; i++)
+        _sim_aio_activate (&batch[i]);
+    if ((count < AIO_RING_BATCH) &&                     /* ring drained */
+        (sim_asynch_spill_cnt != 0)) {                  /* and some spilled? */
+        AIO_COMPLETION *spill;
+        uint32 spilled;
+
+        pthread_mutex_lock (&sim_asynch_lock);
+        spill = sim_asynch_spill;
+        spilled = sim_asynch_spill_cnt;
+        sim_asynch_spill = NULL;
+        sim_asynch_spill_max = 0;
+        sim_asynch_spill_cnt = 0;                       /* ring usable again */
+        pthread_mutex_unlock (&sim_asynch_lock);
+        for (i = 0; i < spilled; i++)
+            _sim_aio_activate (&spill[i]);
+        free (spill);
+        count = AIO_RING_BATCH;                         /* look at the ring again */
+        }
+    } while (count == AIO_RING_BATCH);
+}
+#endif /* SIM_ASYNCH_IO */
 
-cnt = 0;
-for (uptr = sim_clock_queue; uptr != QUEUE_LIST_END; uptr = uptr->next)
-    cnt++;
-return cnt;
+/* Event heap primitives
+
+   The heap is stored 1 based in sim_clock_heap[1..sim_clock_heap_cnt].
+   Each queued unit's q_index holds its heap slot so that an arbitrary
+   entry can be removed without searching.  An entry sorts before another
+   if it is due earlier or, when due at the same time, if it was queued
+   first.
+*/
+
+static t_bool _sim_clock_before (UNIT *a, UNIT *b)
+{
+if (a->q_due != b->q_due)
+    return (a->q_due < b->q_due);
+return (((int32)(a->q_seq - b->q_seq)) < 0);
+}
+
+static void _sim_clock_heap_set (uint32 slot, UNIT *uptr)
+{
+sim_clock_heap[slot] = uptr;
+uptr->q_index = slot;
+}
+
+static void _sim_clock_heap_up (uint32 slot)
+{
+UNIT *uptr = sim_clock_heap[slot];
+
+while (slot > 1) {
+    uint32 parent = slot >> 1;
+
+    if (!_sim_clock_before (uptr, sim_clock_heap[parent]))
+        break;
+    _sim_clock_heap_set (slot, sim_clock_heap[parent]);
+    slot = parent;
+    }
+_sim_clock_heap_set (slot, uptr);
+}
+
+static void _sim_clock_heap_down (uint32 slot)
+{
+UNIT *uptr = sim_clock_heap[slot];
+
+while ((slot << 1) <= sim_clock_heap_cnt) {
+    uint32 child = slot << 1;
+
+    if ((child < sim_clock_heap_cnt) &&
+        _sim_clock_before (sim_clock_heap[child + 1], sim_clock_heap[child]))
+        child = child + 1;
+    if (!_sim_clock_before (sim_clock_heap[child], uptr))
+        break;
+    _sim_clock_heap_set (slot, sim_clock_heap[child]);
+    slot = child;
+    }
+_sim_clock_heap_set (slot, uptr);
+}
+
+static t_stat _sim_clock_heap_insert (UNIT *uptr)
+{
+if (sim_clock_heap_cnt + 1 >= sim_clock_heap_lnt) {     /* need more room? */
+    uint32 lnt = (sim_clock_heap_lnt == 0) ? 64 : 2 * sim_clock_heap_lnt;
+    UNIT **heap = (UNIT **)realloc (sim_clock_heap, lnt * sizeof (*heap));
+
+    if (heap == NULL)
+        return SCPE_MEM;
+    sim_clock_heap = heap;
+    sim_clock_heap_lnt = lnt;
+    }
+sim_clock_heap_cnt = sim_clock_heap_cnt + 1;
+_sim_clock_heap_set (sim_clock_heap_cnt, uptr);
+_sim_clock_heap_up (sim_clock_heap_cnt);
+sim_clock_queue = sim_clock_heap[1];
+return SCPE_OK;
+}
+
+static void _sim_clock_heap_remove (UNIT *uptr)
+{
+uint32 slot = uptr->q_index;
+UNIT *last;
+
+uptr->q_index = 0;
+last = sim_clock_heap[sim_clock_heap_cnt];
+sim_clock_heap_cnt = sim_clock_heap_cnt - 1;
+if (last != uptr) {                                     /* fill hole with last entry */
+    _sim_clock_heap_set (slot, last);
+    if ((slot > 1) && _sim_clock_before (last, sim_clock_heap[slot >> 1]))
+        _sim_clock_heap_up (slot);
+    else
+        _sim_clock_heap_down (slot);
+    }
+sim_clock_queue = (sim_clock_heap_cnt) ? sim_clock_heap[1] : QUEUE_LIST_END;
 }
 
 /* Breakpoint package.  This module replaces the VM-implemented one
@@ -6070,6 +7024,22 @@ return cnt;
    is the bitwise OR of all the type fields).  A simulator need only check for
    a breakpoint of type X if bit SWMASK('X') is set in sim_brk_sum.
 
+   sim_brk_filt is a bitmap with one bit set for each hash of a breakpoint
+   address.  An address whose bit is clear has no breakpoint, so sim_brk_test
+   rejects almost every location it is given with one load and mask, and
+   only the few that pass go on to search the table.  Bits are set as
+   breakpoints are, and the map is rebuilt from the table when an entry is
+   removed, since other addresses may share a bit.  Because testing is
+   cheap, a simulator may also test data addresses on each memory reference.
+
+   Read (R) and write (W) breakpoints are data watchpoints on physical
+   addresses.  sim_brk_wmap has a bit for each page which holds one, or
+   which a reference starting on it could reach.  A simulator tests the
+   bit on the memory paths of its CPU, so references to other pages cost
+   one load and mask, and calls sim_brk_wtest for the rest.  On a hit, the
+   simulator finishes the instruction and stops; the stop message shows
+   the PC of the instruction, and the address and value of the reference.
+
    The package contains the following public routines:
 
         sim_brk_init            initialize
@@ -6093,6 +7063,8 @@ sim_brk_tab = (BRKTAB *) calloc (sim_brk_lnt, sizeof (BRKTAB));
 if (sim_brk_tab == NULL)
     return SCPE_MEM;
 sim_brk_ent = sim_brk_ins = 0;
+memset (sim_brk_filt, 0, sizeof (sim_brk_filt));
+memset (sim_brk_wmap, 0, sizeof (sim_brk_wmap));
 sim_brk_act[sim_do_depth] = NULL;
 sim_brk_npc (0);
 return SCPE_OK;
@@ -6160,6 +7132,16 @@ sim_brk_ent = sim_brk_ent + 1;
 return bp;
 }
 
+/* Mark the pages from which a reference can reach a watched address */
+
+static void sim_brk_wmap_set (t_addr loc)
+{
+t_addr first = (loc < (SIM_BRK_WMAXREF - 1))? 0: loc - (SIM_BRK_WMAXREF - 1);
+
+sim_brk_wmap[SIM_BRK_WPG (loc) >> 5] |= 1u << (SIM_BRK_WPG (loc) & 31);
+sim_brk_wmap[SIM_BRK_WPG (first) >> 5] |= 1u << (SIM_BRK_WPG (first) & 31);
+}
+
 /* Set a breakpoint of type sw */
 
 t_stat sim_brk_set (t_addr loc, int32 sw, int32 ncnt, char *act)
@@ -6188,6 +7170,9 @@ if ((act != NULL) && (*act != 0)) {                     /* new action? */
     bp->act = newp;                                     /* set pointer */
     }
 sim_brk_summ = sim_brk_summ | sw;
+SIM_BRK_FILT_SET (loc);
+if (sw & SIM_BRK_WTYP)
+    sim_brk_wmap_set (loc);
 return SCPE_OK;
 }
 
@@ -6210,8 +7195,14 @@ for ( ; bp < (sim_brk_tab + sim_brk_ent - 1); bp++)     /* erase entry */
     *bp = *(bp + 1);
 sim_brk_ent = sim_brk_ent - 1;                          /* decrement count */
 sim_brk_summ = 0;                                       /* recalc summary */
-for (bp = sim_brk_tab; bp < (sim_brk_tab + sim_brk_ent); bp++)
+memset (sim_brk_filt, 0, sizeof (sim_brk_filt));        /* and filters */
+memset (sim_brk_wmap, 0, sizeof (sim_brk_wmap));
+for (bp = sim_brk_tab; bp < (sim_brk_tab + sim_brk_ent); bp++) {
     sim_brk_summ = sim_brk_summ | bp->typ;
+    SIM_BRK_FILT_SET (bp->addr);
+    if (bp->typ & SIM_BRK_WTYP)
+        sim_brk_wmap_set (bp->addr);
+    }
 return SCPE_OK;
 }
 
@@ -6287,6 +7278,10 @@ uint32 sim_brk_test (t_addr loc, uint32 btyp)
 BRKTAB *bp;
 uint32 spc = (btyp >> SIM_BKPT_V_SPC) & (SIM_BKPT_N_SPC - 1);
 
+if (!SIM_BRK_FILT_TST (loc)) {                          /* surely not in table? */
+    sim_brk_pend[spc] = FALSE;
+    return 0;
+    }
 if ((bp = sim_brk_fnd (loc)) && (btyp & bp->typ)) {     /* in table, type match? */
     if ((sim_brk_pend[spc] && (loc == sim_brk_ploc[spc])) || /* previous location? */
         (--bp->cnt > 0))                                /* count > 0? */
@@ -6301,6 +7296,44 @@ sim_brk_pend[spc] = FALSE;
 return 0;
 }
 
+/* Test for a data watchpoint
+
+   Inputs:
+        loc     =       physical address of the reference
+        lnt     =       length of the reference, in address units
+        btyp    =       reference type, SWMASK ('R') or SWMASK ('W')
+        val     =       value read or written
+        pc      =       PC of the referencing instruction
+   Outputs:
+        types of the watchpoint hit, 0 if none
+
+   The caller stops the simulator after the current instruction when the
+   result is non-zero.  Only the first hit of an instruction is reported.
+*/
+
+uint32 sim_brk_wtest (t_addr loc, uint32 lnt, uint32 btyp, t_value val, t_addr pc)
+{
+BRKTAB *bp;
+uint32 i;
+
+for (i = 0; i < lnt; i++) {
+    if ((bp = sim_brk_fnd (loc + i)) && (btyp & bp->typ)) {
+        if (--bp->cnt > 0)                              /* count > 0? */
+            return 0;
+        bp->cnt = 0;                                    /* reset count */
+        if (sim_brk_whit == 0) {                        /* first hit? */
+            sim_brk_whit = btyp & bp->typ;
+            sim_brk_wloc = loc;
+            sim_brk_wval = val;
+            sim_brk_wpc = pc;
+            sim_brk_act[sim_do_depth] = bp->act;        /* set up actions */
+            }
+        return (btyp & bp->typ);
+        }
+    }
+return 0;
+}
+
 /* Get next pending action, if any */
 
 char *sim_brk_getact (char *buf, int32 size)
@@ -6495,6 +7528,574 @@ if (sim_deb && (dptr->dctrl & dbits)) {
     }
 }
 
+/* Binary debug traces
+
+   SET DEBUG -B file records sim_debug output in binary form instead of
+   formatting it as it happens.  Each message is kept as the simulated
+   time, the identities of the device, debug flag name and format string,
+   and the raw argument values, in a memory ring belonging to the calling
+   thread, so tracing costs little more than a handful of stores.  The
+   rings are written to the file by a flush thread when asynchronous I/O
+   is available, and otherwise whenever a ring is half full; they are
+   always flushed when the simulator stops.  The strings which identify a
+   message are written once, the first time they are seen, while %s
+   arguments are copied into each record.  Anything written directly to
+   sim_deb is kept as text.  TraceDecode (sim_TraceDecode.c) renders a
+   trace file as the text SET DEBUG would have produced.
+
+   The file holds a header followed by records in host byte order:
+
+        char    magic[8]        "SIMHTRC" and the format version
+        uint32  byte order      0x01020304
+
+        uint16  type            record type (TRC_xxx)
+        uint16  length          of the whole record, including type and length
+
+        TRC_DEFINE      uint32 id, then the NUL terminated string
+        TRC_EVENT       uint32 flags, device name id, debug flag id, format id,
+                        double time, then the arguments in format order:
+                        8 bytes for integers, floating point values and
+                        pointers, uint16 length and the text for strings
+        TRC_TEXT        text written directly to the debug file
+        TRC_LOST        uint32 count of records dropped by a full ring
+*/
+
+#define TRC_MAGIC           "SIMHTRC\1"
+#define TRC_DEFINE          1
+#define TRC_EVENT           2
+#define TRC_TEXT            3
+#define TRC_LOST            4
+#define TRC_EV_THREAD       1                           /* logged by a non main thread */
+#define TRC_EV_UNTERM       2                           /* continues an unterminated line */
+#define TRC_RING_SIZE       (4*1024*1024)               /* per thread ring bytes (power of 2) */
+#define TRC_RING_MASK       (TRC_RING_SIZE - 1)
+#define TRC_MAXREC          4096                        /* largest record */
+#define TRC_STRS            8192                        /* interned strings (power of 2) */
+#define TRC_MAXARGS         32                          /* arguments per message */
+
+typedef struct SIM_TRACE_RING {
+    uint8               *buf;
+    volatile uint32     head;                           /* producer offset (free running) */
+    volatile uint32     tail;                           /* consumer offset (free running) */
+    uint32              lost;                           /* records dropped while full */
+    t_bool              signaled;                       /* flusher already asked to run */
+    volatile t_bool     owned;                          /* in use by a live thread */
+    struct SIM_TRACE_RING *next;
+    } SIM_TRACE_RING;
+
+typedef struct {
+    const void          *volatile key;                  /* string address */
+    char                *sig;                           /* argument types, formats only */
+    } SIM_TRACE_STR;
+
+t_bool sim_deb_trace = FALSE;                           /* binary trace active */
+static FILE *sim_trace_file = NULL;                     /* trace file */
+static char sim_trace_name[CBUFSIZE];
+static SIM_TRACE_RING *sim_trace_rings = NULL;          /* all rings */
+static AIO_TLS SIM_TRACE_RING *sim_trace_ring_self = NULL; /* calling thread's ring */
+static SIM_TRACE_STR sim_trace_strs[TRC_STRS];
+static char sim_trace_nosig[] = "";                     /* format can't be recorded */
+static uint32 sim_trace_records = 0;
+
+#if defined (SIM_ASYNCH_IO)
+static pthread_mutex_t sim_trace_lock = PTHREAD_MUTEX_INITIALIZER;  /* strings, flusher wakeup */
+static pthread_mutex_t sim_trace_io_lock = PTHREAD_MUTEX_INITIALIZER;/* ring list, file writes */
+static pthread_cond_t sim_trace_wake = PTHREAD_COND_INITIALIZER;
+static pthread_t sim_trace_thread;
+static t_bool sim_trace_thread_run = FALSE;
+static pthread_key_t sim_trace_key;                     /* releases a ring at thread exit */
+static pthread_once_t sim_trace_key_once = PTHREAD_ONCE_INIT;
+#if defined (USE_AIO_INTRINSICS)
+#define TRC_BARRIER AIO_MEMORY_BARRIER
+#else
+static pthread_mutex_t sim_trace_barrier_lock = PTHREAD_MUTEX_INITIALIZER;
+#define TRC_BARRIER pthread_mutex_lock (&sim_trace_barrier_lock); pthread_mutex_unlock (&sim_trace_barrier_lock)
+#endif
+#define TRC_LOCK pthread_mutex_lock (&sim_trace_lock)
+#define TRC_UNLOCK pthread_mutex_unlock (&sim_trace_lock)
+#else
+#define TRC_BARRIER
+#define TRC_LOCK
+#define TRC_UNLOCK
+#endif
+
+/* Write whatever the rings hold to the trace file */
+
+static void sim_trace_drain (void)
+{
+SIM_TRACE_RING *r;
+uint32 h, t, n;
+
+#if defined (SIM_ASYNCH_IO)
+pthread_mutex_lock (&sim_trace_io_lock);
+#endif
+for (r = sim_trace_rings; r != NULL; r = r->next) {
+    h = r->head;
+    TRC_BARRIER;                                        /* records complete before head moved */
+    for (t = r->tail; t != h; t = t + n) {
+        n = TRC_RING_SIZE - (t & TRC_RING_MASK);        /* contiguous bytes */
+        if (n > h - t)
+            n = h - t;
+        if (sim_trace_file)
+            fwrite (&r->buf[t & TRC_RING_MASK], 1, n, sim_trace_file);
+        }
+    TRC_BARRIER;
+    r->tail = h;                                        /* space can be reused */
+    r->signaled = FALSE;
+    }
+if (sim_trace_file)
+    fflush (sim_trace_file);
+#if defined (SIM_ASYNCH_IO)
+pthread_mutex_unlock (&sim_trace_io_lock);
+#endif
+}
+
+#if defined (SIM_ASYNCH_IO)
+static void *_sim_trace_flush (void *arg)
+{
+struct timespec due;
+
+pthread_mutex_lock (&sim_trace_lock);
+while (sim_trace_thread_run) {
+    clock_gettime (CLOCK_REALTIME, &due);
+    due.tv_nsec = due.tv_nsec + 100000000;              /* flush at least every 100ms */
+    if (due.tv_nsec >= 1000000000) {
+        due.tv_nsec = due.tv_nsec - 1000000000;
+        due.tv_sec = due.tv_sec + 1;
+        }
+    pthread_cond_timedwait (&sim_trace_wake, &sim_trace_lock, &due);
+    pthread_mutex_unlock (&sim_trace_lock);
+    sim_trace_drain ();
+    pthread_mutex_lock (&sim_trace_lock);
+    }
+pthread_mutex_unlock (&sim_trace_lock);
+return NULL;
+}
+
+/* A thread which exits leaves its ring for the next thread which traces */
+
+static void _sim_trace_ring_release (void *arg)
+{
+SIM_TRACE_RING *r = (SIM_TRACE_RING *) arg;
+
+pthread_mutex_lock (&sim_trace_io_lock);
+r->owned = FALSE;
+pthread_mutex_unlock (&sim_trace_io_lock);
+}
+
+static void _sim_trace_key_create (void)
+{
+pthread_key_create (&sim_trace_key, &_sim_trace_ring_release);
+}
+#endif
+
+/* Append a record to the calling thread's ring */
+
+static void sim_trace_put (const void *rec, uint32 len)
+{
+SIM_TRACE_RING *r = sim_trace_ring_self;
+uint32 h, n;
+uint8 lost[8];
+
+if (r == NULL) {                                        /* first record from this thread? */
+#if defined (SIM_ASYNCH_IO)
+    pthread_mutex_lock (&sim_trace_io_lock);
+    for (r = sim_trace_rings; r != NULL; r = r->next)   /* one an exited thread left? */
+        if (!r->owned)
+            break;
+    if (r != NULL)
+        r->owned = TRUE;
+    pthread_mutex_unlock (&sim_trace_io_lock);
+#endif
+    if (r == NULL) {
+        r = (SIM_TRACE_RING *) calloc (1, sizeof (*r));
+        if (r == NULL)
+            return;
+        r->buf = (uint8 *) malloc (TRC_RING_SIZE);
+        if (r->buf == NULL) {
+            free (r);
+            return;
+            }
+        r->owned = TRUE;
+#if defined (SIM_ASYNCH_IO)
+        pthread_mutex_lock (&sim_trace_io_lock);
+#endif
+        r->next = sim_trace_rings;
+        sim_trace_rings = r;
+#if defined (SIM_ASYNCH_IO)
+        pthread_mutex_unlock (&sim_trace_io_lock);
+#endif
+        }
+    sim_trace_ring_self = r;
+#if defined (SIM_ASYNCH_IO)
+    pthread_setspecific (sim_trace_key, r);
+#endif
+    }
+if ((TRC_RING_SIZE - (r->head - r->tail)) < (len + sizeof (lost))) {/* full? */
+#if defined (SIM_ASYNCH_IO)
+    if (!AIO_MAIN_THREAD || sim_trace_thread_run) {     /* flusher will catch up */
+        ++r->lost;
+        return;
+        }
+#endif
+    sim_trace_drain ();                                 /* make room */
+    }
+h = r->head;
+if (r->lost) {                                          /* report earlier drops first */
+    *(uint16 *)&lost[0] = TRC_LOST;
+    *(uint16 *)&lost[2] = sizeof (lost);
+    memcpy (&lost[4], &r->lost, sizeof (r->lost));
+    r->lost = 0;
+    n = TRC_RING_SIZE - (h & TRC_RING_MASK);
+    if (n >= sizeof (lost))
+        memcpy (&r->buf[h & TRC_RING_MASK], lost, sizeof (lost));
+    else {
+        memcpy (&r->buf[h & TRC_RING_MASK], lost, n);
+        memcpy (r->buf, &lost[n], sizeof (lost) - n);
+        }
+    h = h + sizeof (lost);
+    }
+n = TRC_RING_SIZE - (h & TRC_RING_MASK);                /* room before the wrap */
+if (n >= len)
+    memcpy (&r->buf[h & TRC_RING_MASK], rec, len);
+else {
+    memcpy (&r->buf[h & TRC_RING_MASK], rec, n);
+    memcpy (r->buf, ((const uint8 *) rec) + n, len - n);
+    }
+TRC_BARRIER;                                            /* record before head */
+r->head = h + len;
+++sim_trace_records;
+if ((r->head - r->tail) > (TRC_RING_SIZE / 2)) {        /* half full? */
+#if defined (SIM_ASYNCH_IO)
+    if (sim_trace_thread_run) {
+        if (!r->signaled) {
+            r->signaled = TRUE;
+            pthread_cond_signal (&sim_trace_wake);
+            }
+        return;
+        }
+#endif
+    if (AIO_MAIN_THREAD)
+        sim_trace_drain ();
+    }
+}
+
+/* Work out the argument types a format string consumes */
+
+static char *sim_trace_signature (const char *fmt)
+{
+char sig[TRC_MAXARGS + 1];
+int32 n = 0;
+char len;
+
+while (*fmt) {
+    if (*fmt++ != '%')
+        continue;
+    if (*fmt == '%') {
+        ++fmt;
+        continue;
+        }
+    while (*fmt && strchr ("-+ #0'", *fmt))             /* flags */
+        ++fmt;
+    if (*fmt == '*') {                                  /* width argument */
+        sig[n++] = 'i';
+        ++fmt;
+        }
+    while (isdigit (*fmt))
+        ++fmt;
+    if (*fmt == '.') {                                  /* precision */
+        if (*++fmt == '*') {
+            sig[n++] = 'i';
+            ++fmt;
+            }
+        while (isdigit (*fmt))
+            ++fmt;
+        }
+    len = 0;                                            /* length modifier */
+    if ((*fmt == 'h') || (*fmt == 'L') || (*fmt == 'j') || (*fmt == 'z') || (*fmt == 't'))
+        len = *fmt++;
+    else if (*fmt == 'l') {
+        len = *fmt++;
+        if (*fmt == 'l') {
+            len = 'q';
+            ++fmt;
+            }
+        }
+    else if ((*fmt == 'q') || ((fmt[0] == 'I') && (fmt[1] == '6') && (fmt[2] == '4'))) {
+        len = 'q';
+        fmt += (*fmt == 'q') ? 1 : 3;
+        }
+    if (*fmt == 'h')                                    /* hh */
+        ++fmt;
+    if (n >= TRC_MAXARGS)
+        return sim_trace_nosig;
+    switch (*fmt++) {
+        case 'd': case 'i': case 'o': case 'u': case 'x': case 'X': case 'c':
+            sig[n++] = ((len == 'l') || (len == 'q') || (len == 'j') || (len == 'z') || (len == 't')) ? len : 'i';
+            break;
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+            sig[n++] = (len == 'L') ? 'D' : 'd';
+            break;
+        case 's':
+            if (len == 'l')                             /* wide strings aren't recorded */
+                return sim_trace_nosig;
+            sig[n++] = 's';
+            break;
+        case 'p': case 'n':
+            sig[n++] = 'p';
+            break;
+        default:
+            return sim_trace_nosig;
+        }
+    }
+sig[n] = '\0';
+return strdup (sig);
+}
+
+/* Find the id of a string, defining it in the trace the first time it's seen */
+
+static uint32 sim_trace_id (const char *str, t_bool isfmt)
+{
+uint32 slot = (uint32) ((((size_t) str) >> 2) * 2654435761u) & (TRC_STRS - 1);
+uint32 i, len;
+uint8 rec[TRC_MAXREC];
+
+for (i = 0; i < TRC_STRS; i++, slot = (slot + 1) & (TRC_STRS - 1)) {
+    if (sim_trace_strs[slot].key == str)
+        return slot + 1;
+    if (sim_trace_strs[slot].key == NULL)
+        break;
+    }
+if (i == TRC_STRS)                                      /* table full */
+    return 0;
+TRC_LOCK;
+for (; i < TRC_STRS; i++, slot = (slot + 1) & (TRC_STRS - 1)) {
+    if (sim_trace_strs[slot].key == str)                /* another thread got here first */
+        break;
+    if (sim_trace_strs[slot].key == NULL) {
+        len = (uint32) strlen (str) + 1;
+        if (len > TRC_MAXREC - 8)
+            len = TRC_MAXREC - 8;
+        *(uint16 *)&rec[0] = TRC_DEFINE;
+        *(uint16 *)&rec[2] = (uint16) (len + 8);
+        *(uint32 *)&rec[4] = slot + 1;
+        memcpy (&rec[8], str, len);
+        rec[len + 7] = '\0';
+        sim_trace_put (rec, len + 8);
+        sim_trace_strs[slot].sig = isfmt ? sim_trace_signature (str) : NULL;
+        TRC_BARRIER;                                    /* published last */
+        sim_trace_strs[slot].key = str;
+        break;
+        }
+    }
+TRC_UNLOCK;
+return (i == TRC_STRS) ? 0 : slot + 1;
+}
+
+/* Record a sim_debug message.  Returns FALSE if the message can't be
+   recorded in binary form and must be written as text instead. */
+
+static t_bool sim_trace_event (uint32 dbits, DEVICE *dptr, const char *fmt, va_list arglist)
+{
+uint8 rec[TRC_MAXREC];
+uint32 fmt_id = sim_trace_id (fmt, TRUE);
+uint32 flags, len, slen;
+const char *sig, *s = NULL;
+double d;
+t_int64 v = 0;
+int32 c = 0;
+
+if (fmt_id == 0)
+    return FALSE;
+sig = sim_trace_strs[fmt_id - 1].sig;
+if ((sig == NULL) || (sig == sim_trace_nosig))
+    return FALSE;
+flags = (AIO_MAIN_THREAD ? 0 : TRC_EV_THREAD) | (debug_unterm ? TRC_EV_UNTERM : 0);
+*(uint16 *)&rec[0] = TRC_EVENT;
+*(uint32 *)&rec[4] = flags;
+*(uint32 *)&rec[8] = sim_trace_id (dptr->name, FALSE);
+*(uint32 *)&rec[12] = sim_trace_id (get_dbg_verb (dbits, dptr), FALSE);
+*(uint32 *)&rec[16] = fmt_id;
+d = sim_gtime ();
+memcpy (&rec[20], &d, sizeof (d));
+len = 28;
+for (; *sig; sig++) {
+    switch (*sig) {
+        case 'i': v = va_arg (arglist, int); c = (int32) v; break;
+        case 'l': v = va_arg (arglist, long); break;
+        case 'q': case 'j': v = va_arg (arglist, t_int64); break;
+        case 'z': case 't': v = (t_int64) va_arg (arglist, size_t); break;
+        case 'p': v = (t_int64) (size_t) va_arg (arglist, void *); break;
+        case 'd': d = va_arg (arglist, double); memcpy (&v, &d, sizeof (v)); break;
+        case 'D': d = (double) va_arg (arglist, long double); memcpy (&v, &d, sizeof (v)); break;
+        case 's':
+            s = va_arg (arglist, const char *);
+            if (s == NULL)
+                s = "(null)";
+            slen = (uint32) strlen (s);
+            if (len + 2 > TRC_MAXREC)                   /* no room for the length */
+                return FALSE;
+            if (slen > TRC_MAXREC - 2 - len)            /* truncate what won't fit */
+                slen = TRC_MAXREC - 2 - len;
+            *(uint16 *)&rec[len] = (uint16) slen;
+            memcpy (&rec[len + 2], s, slen);
+            len = len + 2 + slen;
+            continue;
+        }
+    if (len + sizeof (v) > TRC_MAXREC)
+        return FALSE;
+    memcpy (&rec[len], &v, sizeof (v));
+    len = len + sizeof (v);
+    }
+*(uint16 *)&rec[2] = (uint16) len;
+sim_trace_put (rec, len);
+slen = (uint32) strlen (fmt);                           /* does the output end a line? */
+if ((slen > 1) && (fmt[slen - 2] == '%') && ((fmt[slen - 1] == 's') || (fmt[slen - 1] == 'c')))
+    debug_unterm = (fmt[slen - 1] == 's') ? ((*s == '\0') || (s[strlen (s) - 1] != '\n')) : (c != '\n');
+else debug_unterm = (slen == 0) || (fmt[slen - 1] != '\n');
+return TRUE;
+}
+
+/* Text written directly to sim_deb */
+
+static void sim_trace_text (const char *buf, size_t size)
+{
+uint8 rec[TRC_MAXREC];
+uint32 n;
+
+while (size) {
+    n = (size > TRC_MAXREC - 4) ? TRC_MAXREC - 4 : (uint32) size;
+    *(uint16 *)&rec[0] = TRC_TEXT;
+    *(uint16 *)&rec[2] = (uint16) (n + 4);
+    memcpy (&rec[4], buf, n);
+    sim_trace_put (rec, n + 4);
+    buf = buf + n;
+    size = size - n;
+    }
+}
+
+#if defined (__GLIBC__)
+static ssize_t sim_trace_cookie_write (void *cookie, const char *buf, size_t size)
+{
+sim_trace_text (buf, size);
+return size;
+}
+#define HAVE_TRACE_TEXT_STREAM
+#elif defined (__APPLE__) || defined (__FreeBSD__) || defined (__NetBSD__) || defined (__OpenBSD__)
+static int sim_trace_cookie_write (void *cookie, const char *buf, int size)
+{
+sim_trace_text (buf, (size_t) size);
+return size;
+}
+#define HAVE_TRACE_TEXT_STREAM
+#endif
+
+/* Open and close binary traces */
+
+t_stat sim_debug_trace_open (char *filename)
+{
+FILE *text = NULL;
+uint32 order = 0x01020304;
+SIM_TRACE_RING *r;
+int32 i;
+
+#if defined (__GLIBC__)
+cookie_io_functions_t fns = { NULL, &sim_trace_cookie_write, NULL, NULL };
+
+text = fopencookie (NULL, "w", fns);
+#elif defined (HAVE_TRACE_TEXT_STREAM)
+text = funopen (NULL, NULL, &sim_trace_cookie_write, NULL, NULL);
+#endif
+if (text == NULL)
+    return SCPE_NOFNC;
+setvbuf (text, NULL, _IONBF, 0);                        /* keep text in order with events */
+sim_trace_file = sim_fopen (filename, "wb");
+if (sim_trace_file == NULL) {
+    fclose (text);
+    return SCPE_OPENERR;
+    }
+strncpy (sim_trace_name, filename, sizeof (sim_trace_name) - 1);
+fwrite (TRC_MAGIC, 1, 8, sim_trace_file);
+fwrite (&order, sizeof (order), 1, sim_trace_file);
+for (r = sim_trace_rings; r != NULL; r = r->next) {     /* discard anything stale */
+    r->tail = r->head;
+    r->lost = 0;
+    }
+for (i = 0; i < TRC_STRS; i++) {                        /* strings get defined afresh */
+    if (sim_trace_strs[i].sig != sim_trace_nosig)
+        free (sim_trace_strs[i].sig);
+    sim_trace_strs[i].sig = NULL;
+    sim_trace_strs[i].key = NULL;
+    }
+sim_trace_records = 0;
+debug_unterm = 0;
+#if defined (SIM_ASYNCH_IO)
+pthread_once (&sim_trace_key_once, &_sim_trace_key_create);
+sim_trace_thread_run = TRUE;
+if (pthread_create (&sim_trace_thread, NULL, _sim_trace_flush, NULL))
+    sim_trace_thread_run = FALSE;                       /* flush inline instead */
+#endif
+sim_deb = text;
+sim_deb_trace = TRUE;
+return SCPE_OK;
+}
+
+/* Rings still owned by other live threads are kept for their next records;
+   the caller's ring and those left by exited threads are freed. */
+
+void sim_debug_trace_close (void)
+{
+SIM_TRACE_RING *r, **rp;
+
+if (!sim_deb_trace)
+    return;
+#if defined (SIM_ASYNCH_IO)
+if (sim_trace_thread_run) {
+    pthread_mutex_lock (&sim_trace_lock);
+    sim_trace_thread_run = FALSE;
+    pthread_cond_signal (&sim_trace_wake);
+    pthread_mutex_unlock (&sim_trace_lock);
+    pthread_join (sim_trace_thread, NULL);
+    }
+#endif
+sim_trace_drain ();                                     /* write what's recorded */
+sim_deb_trace = FALSE;                                  /* before recording stops */
+fclose (sim_deb);
+sim_deb = NULL;
+sim_trace_drain ();                                     /* and what raced the close */
+fclose (sim_trace_file);
+sim_trace_file = NULL;
+#if defined (SIM_ASYNCH_IO)
+pthread_mutex_lock (&sim_trace_io_lock);
+#endif
+for (rp = &sim_trace_rings; (r = *rp) != NULL; ) {
+    if (r->owned && (r != sim_trace_ring_self)) {
+        rp = &r->next;
+        continue;
+        }
+    *rp = r->next;
+    free (r->buf);
+    free (r);
+    }
+sim_trace_ring_self = NULL;
+#if defined (SIM_ASYNCH_IO)
+pthread_setspecific (sim_trace_key, NULL);
+pthread_mutex_unlock (&sim_trace_io_lock);
+#endif
+}
+
+void sim_debug_trace_flush (void)
+{
+if (sim_deb_trace)
+    sim_trace_drain ();
+}
+
+t_stat sim_debug_trace_show (FILE *st)
+{
+fprintf (st, "Debug output recorded to binary trace \"%s\", %u records\n", sim_trace_name, sim_trace_records);
+return SCPE_OK;
+}
+
 #if defined (_WIN32)
 #define vsnprintf _vsnprintf
 #endif
@@ -6518,6 +8119,16 @@ if (sim_deb && (dptr->dctrl & dbits)) {
  
 void _sim_debug (uint32 dbits, DEVICE* dptr, const char* fmt, ...)
 {
+if (sim_deb_trace && (dptr->dctrl & dbits)) {           /* binary trace? */
+    va_list arglist;
+    t_bool done;
+
+    va_start (arglist, fmt);
+    done = sim_trace_event (dbits, dptr, fmt, arglist);
+    va_end (arglist);
+    if (done)
+        return;
+    }
 if (sim_deb && (dptr->dctrl & dbits)) {
 
     char stackbuf[STACKBUFSIZE];
@@ -6596,3 +8207,215 @@ if (sim_deb && (dptr->dctrl & dbits)) {
     }
 return;
 }
+
+/* Instruction history
+
+   A CPU keeps its instruction history in a SIM_HIST, and describes its
+   records with a SIM_HIST_SCHEMA: the record size, how to find a record's
+   PC and opcode, and how to print one.  The ring always holds a power of
+   two records and the count of records written runs freely, so recording
+   is sim_hist_rec plus the stores of the record's fields, with no test
+   for the end of the ring.
+
+   SET CPU HISTORY=n;file places the ring in a file mapped into memory.
+   Records and the count then go to the host's page cache as they are
+   written and survive a crash of the simulator; a later SET CPU HISTORY
+   with the same length and file picks them up again.
+
+   SHOW CPU HISTORY takes qualifiers separated by semicolons:
+
+        n               consider only the last n records
+        PC=addr{-addr}  records whose PC is in a range
+        OP=value        records with an opcode
+*/
+
+#if !defined (_WIN32) && !defined (VMS)
+#define SIM_HIST_MMAP 1
+#include <sys/mman.h>
+#include <fcntl.h>
+#endif
+
+#define SIM_HIST_MAGIC      "SIMHHIST"
+#define SIM_HIST_HDR        4096                        /* file header, precedes records */
+
+typedef struct {
+    char                magic[8];
+    char                schema[32];                     /* schema name */
+    uint32              size;                           /* record size */
+    uint32              pad;
+    t_uint64            lnt;                            /* records */
+    t_uint64            count;                          /* records written */
+    } SIM_HIST_FHDR;
+
+static void sim_hist_release (SIM_HIST *h)
+{
+#if defined (SIM_HIST_MMAP)
+if (h->map) {
+    munmap (h->map, (size_t) h->map_size);
+    h->map = NULL;
+    }
+else
+#endif
+    free (h->rec);
+h->rec = NULL;
+h->lnt = h->mask = 0;
+h->next = &h->count;
+h->count = 0;
+h->file[0] = '\0';
+}
+
+#if defined (SIM_HIST_MMAP)
+static t_stat sim_hist_map (SIM_HIST *h, const SIM_HIST_SCHEMA *s, t_uint64 lnt, const char *file)
+{
+SIM_HIST_FHDR *fh;
+t_uint64 size;
+struct stat st;
+t_bool keep;
+int fd;
+void *map;
+
+if (lnt > (((t_uint64) ((size_t) -1)) - SIM_HIST_HDR) / s->size)
+    return SCPE_ARG;                                    /* can't map that much */
+size = SIM_HIST_HDR + lnt * s->size;
+if ((t_uint64) ((off_t) size) != size)                  /* nor make the file that big */
+    return SCPE_ARG;
+fd = open (file, O_RDWR | O_CREAT, 0644);
+if (fd < 0)
+    return SCPE_OPENERR;
+if (fstat (fd, &st) ||
+    (((t_uint64) st.st_size != size) && ftruncate (fd, (off_t) size))) {
+    close (fd);
+    return SCPE_IOERR;
+    }
+map = mmap (NULL, (size_t) size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+close (fd);                                             /* mapping stays valid */
+if (map == MAP_FAILED)
+    return SCPE_MEM;
+fh = (SIM_HIST_FHDR *) map;
+keep = ((t_uint64) st.st_size == size) &&               /* same history as before? */
+       (memcmp (fh->magic, SIM_HIST_MAGIC, sizeof (fh->magic)) == 0) &&
+       (strncmp (fh->schema, s->name, sizeof (fh->schema)) == 0) &&
+       (fh->size == s->size) && (fh->lnt == lnt);
+if (!keep) {
+    memset (fh, 0, sizeof (*fh));
+    memcpy (fh->magic, SIM_HIST_MAGIC, sizeof (fh->magic));
+    strncpy (fh->schema, s->name, sizeof (fh->schema) - 1);
+    fh->size = s->size;
+    fh->lnt = lnt;
+    }
+else if (fh->count) {
+    printf ("Using %.0f records of history already in %s\n",
+            (double) ((fh->count > lnt) ? lnt : fh->count), file);
+    if (sim_log)
+        fprintf (sim_log, "Using %.0f records of history already in %s\n",
+                 (double) ((fh->count > lnt) ? lnt : fh->count), file);
+    }
+h->map = map;
+h->map_size = size;
+h->rec = (uint8 *) map + SIM_HIST_HDR;
+h->next = &fh->count;
+strncpy (h->file, file, sizeof (h->file) - 1);
+return SCPE_OK;
+}
+#endif
+
+/* Set history: clear it, change its length, or place it in a file */
+
+t_stat sim_hist_set (SIM_HIST *h, const SIM_HIST_SCHEMA *s, char *cptr)
+{
+char gbuf[CBUFSIZE];
+t_uint64 n, lnt;
+t_stat r;
+
+h->schema = s;
+if (h->next == NULL)
+    h->next = &h->count;
+if (cptr == NULL) {                                     /* clear */
+    *h->next = 0;
+    return SCPE_OK;
+    }
+cptr = get_glyph_nc (cptr, gbuf, ';');
+n = get_uint (gbuf, 10, SIM_HIST_MAX, &r);
+if ((r != SCPE_OK) || (n && (n < SIM_HIST_MIN)))
+    return SCPE_ARG;
+for (lnt = SIM_HIST_MIN; lnt < n; lnt = lnt << 1) ;     /* round up to a power of 2 */
+sim_hist_release (h);
+if (n == 0)                                             /* disable */
+    return (*cptr == 0) ? SCPE_OK : SCPE_2MARG;
+if (*cptr) {                                            /* in a file? */
+#if defined (SIM_HIST_MMAP)
+    r = sim_hist_map (h, s, lnt, cptr);
+    if (r != SCPE_OK)
+        return r;
+#else
+    return SCPE_NOFNC;
+#endif
+    }
+else {
+    h->rec = (uint8 *) calloc ((size_t) lnt, s->size);
+    if (h->rec == NULL)
+        return SCPE_MEM;
+    }
+h->mask = lnt - 1;
+h->lnt = lnt;
+return SCPE_OK;
+}
+
+/* Show history, optionally selecting records */
+
+t_stat sim_hist_show (FILE *st, SIM_HIST *h, char *cptr)
+{
+char gbuf[CBUFSIZE], *tptr;
+t_uint64 k, lnt, end, recs;
+t_addr lo = 0, hi = 0, pc;
+t_value op = 0;
+t_bool bypc = FALSE, byop = FALSE;
+const SIM_HIST_SCHEMA *s = h->schema;
+const void *rec;
+DEVICE *dptr = sim_dflt_dev;
+t_stat r;
+
+if (h->lnt == 0)                                        /* enabled? */
+    return SCPE_NOFNC;
+end = *h->next;                                         /* records written */
+recs = (end > h->lnt) ? h->lnt : end;                   /* records held */
+lnt = recs;
+while (cptr && *cptr) {
+    cptr = get_glyph (cptr, gbuf, ';');
+    if ((tptr = strchr (gbuf, '=')))
+        *tptr++ = '\0';
+    if (tptr == NULL) {                                 /* count */
+        lnt = get_uint (gbuf, 10, h->lnt, &r);
+        if ((r != SCPE_OK) || (lnt == 0))
+            return SCPE_ARG;
+        if (lnt > recs)
+            lnt = recs;
+        }
+    else if (strcmp (gbuf, "PC") == 0) {                /* PC range */
+        tptr = get_range (dptr, tptr, &lo, &hi, dptr->aradix, (t_addr) -1, 0);
+        if ((tptr == NULL) || (*tptr != 0) || (s->pc == NULL))
+            return SCPE_ARG;
+        bypc = TRUE;
+        }
+    else if (strcmp (gbuf, "OP") == 0) {                /* opcode */
+        op = get_uint (tptr, dptr->dradix, (t_value) -1, &r);
+        if ((r != SCPE_OK) || (s->opcode == NULL))
+            return SCPE_ARG;
+        byop = TRUE;
+        }
+    else return SCPE_ARG;
+    }
+s->header (st);
+for (k = end - lnt; k != end; k++) {                    /* oldest first */
+    rec = h->rec + (size_t) (k & h->mask) * s->size;
+    if (bypc) {
+        pc = s->pc (rec);
+        if ((pc < lo) || (pc > hi))
+            continue;
+        }
+    if (byop && (s->opcode (rec) != op))
+        continue;
+    s->print (st, rec);
+    }
+return SCPE_OK;
+}
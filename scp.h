@@ -107,6 +107,7 @@ char *sim_dname (DEVICE *dptr);
 char *sim_uname (UNIT *dptr);
 t_stat get_yn (char *ques, t_stat deflt);
 char *get_sim_opt (int32 opt, char *cptr, t_stat *st);
+char *get_sim_sw (char *cptr);
 char *get_glyph (char *iptr, char *optr, char mchar);
 char *get_glyph_nc (char *iptr, char *optr, char mchar);
 t_value get_uint (char *cptr, uint32 radix, t_value max, t_stat *status);
@@ -128,6 +129,10 @@ C1TAB *find_c1tab (C1TAB *tab, char *gbuf);
 SHTAB *find_shtab (SHTAB *tab, char *gbuf);
 BRKTAB *sim_brk_fnd (t_addr loc);
 uint32 sim_brk_test (t_addr bloc, uint32 btyp);
+#define SIM_BRK_TEST(loc, btyp)     /* sim_brk_test, filter inline; loc used twice */ \
+    (SIM_BRK_FILT_TST (loc) ? sim_brk_test ((loc), (btyp)) :                      \
+     (sim_brk_pend[((btyp) >> SIM_BKPT_V_SPC) & (SIM_BKPT_N_SPC - 1)] = FALSE, 0u))
+uint32 sim_brk_wtest (t_addr loc, uint32 lnt, uint32 btyp, t_value val, t_addr pc);
 void sim_brk_clrspc (uint32 spc);
 char *match_ext (char *fnam, char *ext);
 t_stat set_dev_debug (DEVICE *dptr, UNIT *uptr, int32 flag, char *cptr);
@@ -148,6 +153,67 @@ void _sim_debug (uint32 dbits, DEVICE* dptr, const char* fmt, ...);
 #define sim_debug(dbits, dptr, ...) if (sim_deb && ((dptr)->dctrl & dbits)) _sim_debug (dbits, dptr, __VA_ARGS__); else (void)0
 #endif
 void fprint_stopped_gen (FILE *st, t_stat v, REG *pc, DEVICE *dptr);
+t_stat sim_debug_trace_open (char *filename);
+void sim_debug_trace_close (void);
+void sim_debug_trace_flush (void);
+t_stat sim_debug_trace_show (FILE *st);
+
+/* Instruction history */
+
+#define SIM_HIST_MIN    64                              /* min records */
+#define SIM_HIST_MAX    (1u << 30)                      /* max records */
+
+typedef struct {
+    const char          *name;                          /* recorded in history files */
+    uint32              size;                           /* record size */
+    t_addr              (*pc)(const void *rec);         /* PC of a record */
+    t_value             (*opcode)(const void *rec);     /* opcode of a record */
+    void                (*header)(FILE *st);            /* print column headings */
+    void                (*print)(FILE *st, const void *rec); /* print a record */
+    } SIM_HIST_SCHEMA;
+
+typedef struct {
+    const SIM_HIST_SCHEMA *schema;
+    uint8               *rec;                           /* records */
+    t_uint64            lnt;                            /* records, 0 if disabled */
+    t_uint64            mask;                           /* lnt - 1 */
+    t_uint64            *next;                          /* records written (free running) */
+    t_uint64            count;                          /* next, when not in a file */
+    void                *map;                           /* file mapping */
+    t_uint64            map_size;
+    char                file[PATH_MAX];
+    } SIM_HIST;
+
+/* Claim the next record of a history: (type *) sim_hist_rec (&hist, type) */
+
+#define sim_hist_rec(h, type) (((type *) (h)->rec) + (size_t) ((*(h)->next)++ & (h)->mask))
+
+t_stat sim_hist_set (SIM_HIST *h, const SIM_HIST_SCHEMA *s, char *cptr);
+t_stat sim_hist_show (FILE *st, SIM_HIST *h, char *cptr);
+
+/* Snapshot memory */
+
+#define SIM_MEM_PG_V    12                              /* log2 dirty page size, bytes */
+#define SIM_MEM_PGSIZE  (1u << SIM_MEM_PG_V)
+
+typedef struct {
+    UNIT                *uptr;                          /* memory unit */
+    void                **mem;                          /* memory array */
+    uint32              elsize;                         /* bytes per array element */
+    uint32              abytes;                         /* bytes per address unit */
+    uint32              *dirty;                         /* pages written since last snapshot */
+    uint32              npg;                            /* pages in dirty map */
+    } SIM_MEM;
+
+/* Mark the page holding byte offset off as written: SIM_MEM_DIRTY (&mem, off) */
+
+#define SIM_MEM_DIRTY(m, off) ((m)->dirty[(uint32) (off) >> (SIM_MEM_PG_V + 5)] |= \
+                                 1u << (((uint32) (off) >> SIM_MEM_PG_V) & 31))
+
+t_stat sim_mem_register (SIM_MEM *m, UNIT *uptr, void **mem, uint32 elsize,
+    uint32 abytes, t_addr maxcap);
+void sim_mem_dirty (SIM_MEM *m, t_addr off, t_addr lnt);
+void sim_mem_dirty_host (const void *p, size_t lnt);
 
 /* Global data */
 
@@ -160,12 +226,16 @@ extern FILE *sim_log;                                   /* log file */
 extern FILEREF *sim_log_ref;                            /* log file file reference */
 extern FILE *sim_deb;                                   /* debug file */
 extern FILEREF *sim_deb_ref;                            /* debug file file reference */
+extern t_bool sim_deb_trace;                            /* debug file is a binary trace */
 extern UNIT *sim_clock_queue;
 extern int32 sim_is_running;
 extern volatile int32 stop_cpu;
 extern uint32 sim_brk_types;                            /* breakpoint info */
 extern uint32 sim_brk_dflt;
 extern uint32 sim_brk_summ;
+extern uint32 sim_brk_filt[SIM_BRK_FILT_BITS / 32];     /* breakpoint address filter */
+extern t_bool sim_brk_pend[SIM_BKPT_N_SPC];
+extern uint32 sim_brk_wmap[SIM_BRK_WMAP_BITS / 32];     /* watched pages */
 extern t_bool sim_asynch_enabled;
 
 /* VM interface */
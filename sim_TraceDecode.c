@@ -0,0 +1,366 @@
+/* sim_TraceDecode.c: render a binary debug trace as text
+
+   Copyright (c) 2026, SIMH contributors
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+   THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+   IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+   Except as contained in this notice, the name of Robert M Supnik shall not be
+   used in advertising or otherwise to promote the sale, use or other dealings
+   in this Software without prior written authorization from Robert M Supnik.
+
+*/
+/*
+
+   This program reads a trace file recorded by SET DEBUG -B and writes the
+   text which SET DEBUG would have produced for the same messages:
+
+        TraceDecode trace_file {output_file}
+
+   The record layout is described with the trace routines in scp.c; the
+   definitions here must match them.  Traces are decoded on a host with
+   the byte order of the one which recorded them.
+
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRC_MAGIC           "SIMHTRC\1"
+#define TRC_DEFINE          1
+#define TRC_EVENT           2
+#define TRC_TEXT            3
+#define TRC_LOST            4
+#define TRC_EV_THREAD       1                           /* logged by a non main thread */
+#define TRC_EV_UNTERM       2                           /* continues an unterminated line */
+
+typedef unsigned short uint16;
+typedef unsigned int uint32;
+#if defined (_WIN32)
+typedef __int64 int64;
+#else
+typedef long long int64;
+#endif
+
+static char **strs = NULL;                              /* defined strings, by id */
+static uint32 nstrs = 0;
+static int unterm = 0;
+
+static uint16 get16 (const unsigned char *p)
+{
+uint16 v;
+
+memcpy (&v, p, sizeof (v));
+return v;
+}
+
+static uint32 get32 (const unsigned char *p)
+{
+uint32 v;
+
+memcpy (&v, p, sizeof (v));
+return v;
+}
+
+static const char *str (uint32 id)
+{
+return ((id < nstrs) && strs[id]) ? strs[id] : "?";
+}
+
+static void define (uint32 id, const char *s)
+{
+if (id >= nstrs) {
+    uint32 n = (id + 1) * 2;
+
+    strs = (char **) realloc (strs, n * sizeof (*strs));
+    if (strs == NULL) {
+        fprintf (stderr, "Out of memory\n");
+        exit (1);
+        }
+    memset (&strs[nstrs], 0, (n - nstrs) * sizeof (*strs));
+    nstrs = n;
+    }
+free (strs[id]);
+strs[id] = (char *) malloc (strlen (s) + 1);
+if (strs[id])
+    strcpy (strs[id], s);
+}
+
+/* Append formatted text to a growing buffer */
+
+static char *out = NULL;
+static size_t out_len = 0, out_size = 0;
+
+static void emit (const char *s, size_t n)
+{
+if (out_len + n + 1 > out_size) {
+    out_size = (out_len + n + 1) * 2;
+    out = (char *) realloc (out, out_size);
+    if (out == NULL) {
+        fprintf (stderr, "Out of memory\n");
+        exit (1);
+        }
+    }
+memcpy (out + out_len, s, n);
+out_len = out_len + n;
+}
+
+/* Reformat an event's message from its format and recorded arguments */
+
+static void format (const char *fmt, const unsigned char *arg, const unsigned char *end)
+{
+char spec[64], buf[256], *tmp;
+int64 v, stars[2];
+double d;
+int nstars, n, len;
+const char *start;
+size_t sl;
+
+while (*fmt) {
+    if (*fmt != '%') {
+        start = fmt;
+        while (*fmt && (*fmt != '%'))
+            ++fmt;
+        emit (start, fmt - start);
+        continue;
+        }
+    start = fmt++;
+    if (*fmt == '%') {
+        emit ("%", 1);
+        ++fmt;
+        continue;
+        }
+    nstars = 0;
+    len = 0;
+    while (*fmt && strchr ("-+ #0'", *fmt))
+        ++fmt;
+    for (n = 0; n < 2; n++) {                           /* width, then precision */
+        if (n && (*fmt == '.'))
+            ++fmt;
+        else if (n)
+            break;
+        if (*fmt == '*') {
+            if (arg + 8 > end)
+                return;
+            memcpy (&stars[nstars++], arg, 8);
+            arg = arg + 8;
+            ++fmt;
+            }
+        while ((*fmt >= '0') && (*fmt <= '9'))
+            ++fmt;
+        }
+    if ((*fmt == 'h') || (*fmt == 'L') || (*fmt == 'j') || (*fmt == 'z') || (*fmt == 't'))
+        len = *fmt++;
+    else if (*fmt == 'l') {
+        len = *fmt++;
+        if (*fmt == 'l') {
+            len = 'q';
+            ++fmt;
+            }
+        }
+    else if ((*fmt == 'q') || ((fmt[0] == 'I') && (fmt[1] == '6') && (fmt[2] == '4'))) {
+        len = 'q';
+        fmt += (*fmt == 'q') ? 1 : 3;
+        }
+    if (*fmt == 'h')
+        ++fmt;
+    if (*fmt == '\0')
+        break;
+    ++fmt;
+    sl = fmt - start;
+    if (sl >= sizeof (spec))
+        return;
+    memcpy (spec, start, sl);
+    spec[sl] = '\0';
+    switch (fmt[-1]) {
+        case 's':
+            if (arg + 2 > end)
+                return;
+            sl = get16 (arg);
+            tmp = (char *) malloc (sl + 1);
+            if (tmp == NULL)
+                return;
+            memcpy (tmp, arg + 2, sl);
+            tmp[sl] = '\0';
+            arg = arg + 2 + sl;
+            n = (nstars == 2) ? snprintf (NULL, 0, spec, (int) stars[0], (int) stars[1], tmp) :
+                (nstars == 1) ? snprintf (NULL, 0, spec, (int) stars[0], tmp) : snprintf (NULL, 0, spec, tmp);
+            if (n > 0) {
+                char *o = (char *) malloc (n + 1);
+
+                if (o) {
+                    if (nstars == 2)
+                        snprintf (o, n + 1, spec, (int) stars[0], (int) stars[1], tmp);
+                    else if (nstars == 1)
+                        snprintf (o, n + 1, spec, (int) stars[0], tmp);
+                    else snprintf (o, n + 1, spec, tmp);
+                    emit (o, n);
+                    free (o);
+                    }
+                }
+            free (tmp);
+            continue;
+        case 'n':                                       /* produces no output */
+            arg = arg + 8;
+            continue;
+        }
+    if (arg + 8 > end)
+        return;
+    memcpy (&v, arg, 8);
+    arg = arg + 8;
+#define PRINT(val)                                                                  \
+    n = (nstars == 2) ? snprintf (buf, sizeof (buf), spec, (int) stars[0], (int) stars[1], val) : \
+        (nstars == 1) ? snprintf (buf, sizeof (buf), spec, (int) stars[0], val) :   \
+                        snprintf (buf, sizeof (buf), spec, val)
+    switch (fmt[-1]) {
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+            memcpy (&d, &v, sizeof (d));
+            if (len == 'L') {
+                PRINT ((long double) d);
+                }
+            else {
+                PRINT (d);
+                }
+            break;
+        case 'p':
+            PRINT ((void *) (size_t) v);
+            break;
+        default:
+            if (len == 'l') {
+                PRINT ((long) v);
+                }
+            else if ((len == 'q') || (len == 'j')) {
+                PRINT (v);
+                }
+            else if ((len == 'z') || (len == 't')) {
+                PRINT ((size_t) v);
+                }
+            else {
+                PRINT ((int) v);
+                }
+            break;
+        }
+    if (n >= (int) sizeof (buf))
+        n = sizeof (buf) - 1;
+    if (n > 0)
+        emit (buf, n);
+    }
+}
+
+/* Write a message the way _sim_debug does, prefixing each completed line */
+
+static void event (FILE *o, const unsigned char *rec, uint32 len)
+{
+uint32 flags = get32 (rec + 4);
+const char *dev = str (get32 (rec + 8));
+const char *verb = str (get32 (rec + 12));
+const char *fmt = str (get32 (rec + 16));
+double t;
+size_t i, j;
+
+memcpy (&t, rec + 20, sizeof (t));
+out_len = 0;
+format (fmt, rec + 28, rec + len);
+unterm = (flags & TRC_EV_UNTERM) != 0;
+for (i = j = 0; i < out_len; ++i) {
+    if ('\n' == out[i]) {
+        if (i > j) {
+            if (unterm)
+                fprintf (o, "%.*s\r\n", (int) (i - j), &out[j]);
+            else
+                fprintf (o, "DBG(%.0f)%s> %s %s: %.*s\r\n", t, (flags & TRC_EV_THREAD) ? "+" : "",
+                                                             dev, verb, (int) (i - j), &out[j]);
+            unterm = 0;
+            }
+        j = i + 1;
+        }
+    }
+if (i > j)
+    fwrite (&out[j], 1, i - j, o);
+}
+
+int main (int argc, char **argv)
+{
+FILE *f, *o = stdout;
+unsigned char hdr[12], *buf;
+long size, pos;
+uint32 order = 0x01020304, type, len;
+int pass;
+
+if ((argc < 2) || (argc > 3)) {
+    fprintf (stderr, "Usage: %s trace_file {output_file}\n", argv[0]);
+    return 1;
+    }
+f = fopen (argv[1], "rb");
+if (f == NULL) {
+    fprintf (stderr, "Can't open %s\n", argv[1]);
+    return 1;
+    }
+if ((fread (hdr, 1, sizeof (hdr), f) != sizeof (hdr)) || memcmp (hdr, TRC_MAGIC, 8)) {
+    fprintf (stderr, "%s is not a SIMH debug trace\n", argv[1]);
+    return 1;
+    }
+if (get32 (hdr + 8) != order) {
+    fprintf (stderr, "%s was recorded on a host with a different byte order\n", argv[1]);
+    return 1;
+    }
+fseek (f, 0, SEEK_END);
+size = ftell (f) - sizeof (hdr);
+fseek (f, sizeof (hdr), SEEK_SET);
+buf = (unsigned char *) malloc (size + 1);
+if ((buf == NULL) || (fread (buf, 1, size, f) != (size_t) size)) {
+    fprintf (stderr, "Can't read %s\n", argv[1]);
+    return 1;
+    }
+fclose (f);
+if ((argc == 3) && ((o = fopen (argv[2], "wb")) == NULL)) {
+    fprintf (stderr, "Can't create %s\n", argv[2]);
+    return 1;
+    }
+for (pass = 0; pass < 2; pass++) {                      /* strings may be defined by */
+    for (pos = 0; pos + 4 <= size; pos = pos + len) {   /* another thread's later records */
+        type = get16 (buf + pos);
+        len = get16 (buf + pos + 2);
+        if ((len < 4) || (pos + len > size)) {
+            fprintf (stderr, "Trace is damaged at offset %ld\n", pos + (long) sizeof (hdr));
+            break;
+            }
+        if (pass == 0) {
+            if (type == TRC_DEFINE) {
+                buf[pos + len - 1] = '\0';
+                define (get32 (buf + pos + 4), (char *) buf + pos + 8);
+                }
+            continue;
+            }
+        switch (type) {
+            case TRC_EVENT:
+                if (len >= 28)
+                    event (o, buf + pos, len);
+                break;
+            case TRC_TEXT:
+                fwrite (buf + pos + 4, 1, len - 4, o);
+                break;
+            case TRC_LOST:
+                fprintf (o, "*** %u debug records lost ***\r\n", get32 (buf + pos + 4));
+                break;
+            }
+        }
+    }
+if (o != stdout)
+    fclose (o);
+return 0;
+}
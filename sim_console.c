@@ -426,9 +426,27 @@ t_stat r;
 
 if ((cptr == NULL) || (*cptr == 0))                     /* need arg */
     return SCPE_2FARG;
+if ((cptr = get_sim_sw (cptr)) == NULL)                 /* -B may follow DEBUG */
+    return SCPE_INVSW;
 cptr = get_glyph_nc (cptr, gbuf, 0);                    /* get file name */
 if (*cptr != 0)                                         /* now eol? */
     return SCPE_2MARG;
+if (sim_deb_trace)                                      /* replacing a binary trace? */
+    sim_debug_trace_close ();
+if (sim_switches & SWMASK ('B')) {                      /* binary trace? */
+    sim_close_logfile (&sim_deb_ref);
+    sim_deb = NULL;
+    r = sim_debug_trace_open (gbuf);
+    if (r == SCPE_NOFNC)
+        printf ("Binary debug traces are not available on this host\n");
+    if (r != SCPE_OK)
+        return r;
+    if (!sim_quiet)
+        printf ("Debug output recorded to binary trace \"%s\"\n", gbuf);
+    if (sim_log)
+        fprintf (sim_log, "Debug output recorded to binary trace \"%s\"\n", gbuf);
+    return SCPE_OK;
+    }
 r = sim_open_logfile (gbuf, FALSE, &sim_deb, &sim_deb_ref);
 
 if (r != SCPE_OK)
@@ -450,7 +468,9 @@ if (cptr && (*cptr != 0))                               /* now eol? */
     return SCPE_2MARG;
 if (sim_deb == NULL)                                    /* no log? */
     return SCPE_OK;
-sim_close_logfile (&sim_deb_ref);
+if (sim_deb_trace)                                      /* binary trace? */
+    sim_debug_trace_close ();
+else sim_close_logfile (&sim_deb_ref);
 sim_deb = NULL;
 if (!sim_quiet)
     printf ("Debug output disabled\n");
@@ -465,7 +485,9 @@ t_stat sim_show_debug (FILE *st, DEVICE *dptr, UNIT *uptr, int32 flag, char *cpt
 {
 if (cptr && (*cptr != 0))
     return SCPE_2MARG;
-if (sim_deb)
+if (sim_deb_trace)
+    sim_debug_trace_show (st);
+else if (sim_deb)
     fprintf (st, "Debug output enabled to \"%s\"\n", 
                  sim_logfile_name (sim_deb, sim_deb_ref));
 else fprintf (st, "Debug output disabled\n");
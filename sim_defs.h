@@ -196,6 +196,24 @@ typedef uint32          t_addr;
 #define SIM_BKPT_N_SPC  64                              /* max number spaces */
 #define SIM_BKPT_V_SPC  26                              /* location in arg */
 
+/* Breakpoint address filter: a bit per hash of a breakpoint address */
+
+#define SIM_BRK_FILT_W      16                          /* log2 filter bits */
+#define SIM_BRK_FILT_BITS   (1u << SIM_BRK_FILT_W)
+#define SIM_BRK_FILT_HASH(a) ((((uint32) (a) ^ (uint32) ((a) >> 16 >> 16)) * 0x9E3779B1u) >> (32 - SIM_BRK_FILT_W))
+#define SIM_BRK_FILT_SET(a) sim_brk_filt[SIM_BRK_FILT_HASH (a) >> 5] |= 1u << (SIM_BRK_FILT_HASH (a) & 31)
+#define SIM_BRK_FILT_TST(a) ((sim_brk_filt[SIM_BRK_FILT_HASH (a) >> 5] >> (SIM_BRK_FILT_HASH (a) & 31)) & 1)
+
+/* Data watchpoints: a bit per page of addresses holding a read or write breakpoint */
+
+#define SIM_BRK_WTYP        (SWMASK ('R') | SWMASK ('W'))   /* data reference types */
+#define SIM_BRK_WMAXREF     8                           /* longest reference, units */
+#define SIM_BRK_WPG_V       9                           /* log2 page size */
+#define SIM_BRK_WMAP_W      16                          /* log2 map bits */
+#define SIM_BRK_WMAP_BITS   (1u << SIM_BRK_WMAP_W)
+#define SIM_BRK_WPG(a)      ((uint32) ((a) >> SIM_BRK_WPG_V) & (SIM_BRK_WMAP_BITS - 1))
+#define SIM_BRK_WATCHED(a)  ((sim_brk_wmap[SIM_BRK_WPG (a) >> 5] >> (SIM_BRK_WPG (a) & 31)) & 1)
+
 /* Extended switch definitions (bits >= 26) */
 
 #define SIM_SW_HIDE     (1u << 26)                      /* enable hiding */
@@ -397,11 +415,15 @@ struct sim_unit {
     int32               u6;                             /* device specific */
     void                *up7;                           /* device specific */
     void                *up8;                           /* device specific */
+    double              q_due;                          /* event queue due time */
+    uint32              q_seq;                          /* event queue insertion order */
+    uint32              q_index;                        /* event heap slot (0 = not queued) */
 #ifdef SIM_ASYNCH_IO
     void                (*a_check_completion)(struct sim_unit *);
     t_bool              (*a_is_active)(struct sim_unit *);
     void                (*a_cancel)(struct sim_unit *);
-    struct sim_unit     *a_next;                        /* next asynch active */
+    volatile int32      a_pending;                      /* completions outstanding in ring */
+    t_stat              a_status;                       /* status of completion being delivered */
     int32               a_event_time;
     t_stat              (*a_activate_call)(struct sim_unit *, int32);
     /* Asynchronous Polling control */
@@ -690,7 +712,6 @@ extern int32 sim_tmxr_poll_count;
 extern pthread_cond_t sim_tmxr_poll_cond;
 extern pthread_mutex_t sim_tmxr_poll_lock;
 extern pthread_t sim_asynch_main_threadid;
-extern UNIT * volatile sim_asynch_queue;
 extern UNIT * volatile sim_wallclock_queue;
 extern UNIT * volatile sim_wallclock_entry;
 extern UNIT * volatile sim_clock_cosched_queue;
@@ -698,6 +719,7 @@ extern volatile t_bool sim_idle_wait;
 extern int32 sim_asynch_check;
 extern int32 sim_asynch_latency;
 extern int32 sim_asynch_inst_latency;
+extern UNIT *sim_aio_activating;
 
 /* Thread local storage */
 #if defined(__GNUC__) && !defined(__APPLE__)
@@ -715,7 +737,8 @@ extern int32 sim_asynch_inst_latency;
     pthread_mutex_lock(&sim_asynch_lock)
 #define AIO_UNLOCK                                                \
     pthread_mutex_unlock(&sim_asynch_lock)
-#define AIO_IS_ACTIVE(uptr) (((uptr)->a_is_active ? (uptr)->a_is_active (uptr) : FALSE) || ((uptr)->a_next))
+#define AIO_IS_ACTIVE(uptr) (((uptr)->a_is_active ? (uptr)->a_is_active (uptr) : FALSE) || \
+                             (((uptr)->a_pending) && ((uptr) != sim_aio_activating)))
 #if !defined(SIM_ASYNCH_MUX) && !defined(SIM_ASYNCH_CLOCKS)
 #define AIO_CANCEL(uptr)                                          \
     if ((uptr)->a_cancel)                                         \
@@ -729,7 +752,7 @@ extern int32 sim_asynch_inst_latency;
         (uptr)->a_cancel (uptr);                                  \
     else {                                                        \
         if (((uptr)->dynflags & UNIT_TM_POLL) &&                  \
-            !((uptr)->next) && !((uptr)->a_next)) {               \
+            !((uptr)->next) && !((uptr)->a_pending)) {            \
             (uptr)->a_polling_now = FALSE;                        \
             sim_tmxr_poll_count -= (uptr)->a_poll_waiter_count;   \
             (uptr)->a_poll_waiter_count = 0;                      \
@@ -742,7 +765,7 @@ extern int32 sim_asynch_inst_latency;
         (uptr)->a_cancel (uptr);                                  \
     else {                                                        \
         if (((uptr)->dynflags & UNIT_TM_POLL) &&                  \
-            !((uptr)->next) && !((uptr)->a_next)) {               \
+            !((uptr)->next) && !((uptr)->a_pending)) {            \
             (uptr)->a_polling_now = FALSE;                        \
             sim_tmxr_poll_count -= (uptr)->a_poll_waiter_count;   \
             (uptr)->a_poll_waiter_count = 0;                      \
@@ -794,6 +817,8 @@ extern int32 sim_asynch_inst_latency;
         }
 #define AIO_RETURN_TIME(uptr)                                     \
     if (1) {                                                      \
+        UNIT *cptr;                                               \
+                                                                  \
         pthread_mutex_lock (&sim_timer_lock);                     \
         for (cptr = sim_wallclock_queue;                          \
              cptr != QUEUE_LIST_END;                              \
@@ -809,7 +834,7 @@ extern int32 sim_asynch_inst_latency;
                 return result + 1;                                \
                 }                                                 \
         pthread_mutex_unlock (&sim_timer_lock);                   \
-        if ((uptr)->a_next) /* On asynch queue? */                \
+        if ((uptr)->a_pending) /* On asynch ring? */              \
             return (uptr)->a_event_time + 1;                      \
         }                                                         \
     else                                                          \
@@ -849,107 +874,115 @@ extern int32 sim_asynch_inst_latency;
 #if defined(DONT_USE_AIO_INTRINSICS) && defined(USE_AIO_INTRINSICS)
 #undef USE_AIO_INTRINSICS
 #endif
+
+/* Asynchronous completion ring
+
+   Worker threads (disk, tape, ethernet, multiplexer and timer) report
+   completions by posting a record to sim_asynch_ring, a bounded
+   multi-producer, single-consumer ring.  Every slot carries a sequence
+   number: a producer may fill slot (pos % AIO_RING_SIZE) when its sequence
+   equals pos and publishes it by storing pos + 1.  The simulator thread
+   consumes the slot when its sequence equals head + 1 and hands it back
+   for the next lap by storing head + AIO_RING_SIZE.  Since records, rather
+   than the units themselves, are queued, a unit may have any number of
+   completions outstanding; a_pending counts them until each has been
+   activated, and keeps the unit active meanwhile.  While a record is
+   being activated its unit is sim_aio_activating, which is not counted
+   as active on account of its pending records.  A record's status is handed to the unit in a_status while
+   its activation and a_check_completion run.  Should the ring fill, further
+   records are spilled to a list under sim_asynch_lock until the simulator
+   thread has drained it, so a posting thread never waits for a slot.
+*/
+
+#define AIO_RING_SIZE   1024                            /* completion slots (power of 2) */
+#define AIO_RING_MASK   (AIO_RING_SIZE - 1)
+#define AIO_RING_BATCH  64                              /* records drained per pass */
+
+typedef struct {
+    volatile uint32     seq;                            /* slot sequence */
+    UNIT                *uptr;                          /* completing unit */
+    int32               event_time;                     /* activation delay */
+    t_stat              status;                         /* completion status */
+    t_stat              (*activate_call)(UNIT *, int32);/* activation routine */
+    } AIO_COMPLETION;
+
+extern AIO_COMPLETION sim_asynch_ring[AIO_RING_SIZE];
+extern volatile uint32 sim_asynch_ring_tail;
+extern uint32 sim_asynch_ring_head;
+extern volatile uint32 sim_asynch_spill_cnt;
+extern volatile int32 sim_asynch_inflight;                  /* I/O requests not yet completed */
+
+void sim_aio_post (t_stat (*caller)(UNIT *, int32), UNIT *uptr, int32 event_time, t_stat status);
+void sim_aio_drain (void);
+
 #ifdef USE_AIO_INTRINSICS
-/* This approach uses intrinsics to manage access to the link list head     */
-/* sim_asynch_queue.  This implementation is a completely lock free design  */
-/* which avoids the potential ABA issues.                                   */
+/* This approach uses intrinsics to claim ring slots.  Producers never     */
+/* block each other and the simulator thread drains without any locking.   */
 #define AIO_QUEUE_MODE "Lock free asynchronous event queue access"
+#ifdef _WIN32
+#define AIO_CAS32(Destination, Exchange, Comparand) (uint32)InterlockedCompareExchange((LONG volatile *)(Destination), (LONG)(Exchange), (LONG)(Comparand))
+#define AIO_PENDING_ADJUST(uptr, val) InterlockedExchangeAdd((LONG volatile *)&(uptr)->a_pending, (LONG)(val))
+#define AIO_INFLIGHT_ADJUST(val) InterlockedExchangeAdd((LONG volatile *)&sim_asynch_inflight, (LONG)(val))
+#define AIO_MEMORY_BARRIER MemoryBarrier()
+#elif defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_4) || defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_8)
+#define AIO_CAS32(Destination, Exchange, Comparand) __sync_val_compare_and_swap(Destination, Comparand, Exchange)
+#define AIO_PENDING_ADJUST(uptr, val) __sync_fetch_and_add(&(uptr)->a_pending, (val))
+#define AIO_INFLIGHT_ADJUST(val) __sync_fetch_and_add(&sim_asynch_inflight, (val))
+#define AIO_MEMORY_BARRIER __sync_synchronize()
+#elif defined(__DECC_VER)
+#define AIO_CAS32(Destination, Exchange, Comparand) (uint32)_InterlockedCompareExchange((volatile int *)(Destination), (int)(Exchange), (int)(Comparand))
+#define AIO_PENDING_ADJUST(uptr, val) __ATOMIC_ADD_LONG(&(uptr)->a_pending, (val))
+#define AIO_INFLIGHT_ADJUST(val) __ATOMIC_ADD_LONG(&sim_asynch_inflight, (val))
+#define AIO_MEMORY_BARRIER __MB()
+#else
+#error "Implementation of AIO_CAS32() is needed to build with USE_AIO_INTRINSICS"
+#endif
+#define AIO_RING_LOCK
+#define AIO_RING_UNLOCK
+#define AIO_RING_CLAIM(pos) ((pos) == AIO_CAS32(&sim_asynch_ring_tail, (pos) + 1, (pos)))
 #define AIO_INIT                                                  \
     if (1) {                                                      \
+      int _i;                                                     \
+                                                                  \
       sim_asynch_main_threadid = pthread_self();                  \
       /* Empty list/list end uses the point value (void *)1.      \
-         This allows NULL in an entry's a_next pointer to         \
+         This allows NULL in an entry's next pointer to           \
          indicate that the entry is not currently in any list */  \
-      sim_asynch_queue = QUEUE_LIST_END;                          \
+      for (_i = 0; _i < AIO_RING_SIZE; _i++)                      \
+        sim_asynch_ring[_i].seq = _i;                             \
+      sim_asynch_ring_head = sim_asynch_ring_tail = 0;            \
       sim_wallclock_queue = QUEUE_LIST_END;                       \
       sim_wallclock_entry = NULL;                                 \
       sim_clock_cosched_queue = QUEUE_LIST_END;                   \
       }                                                           \
     else                                                          \
       (void)0
-#define AIO_CLEANUP                                               \
-    if (1) {                                                      \
-      pthread_mutex_destroy(&sim_asynch_lock);                    \
-      pthread_cond_destroy(&sim_asynch_wake);                     \
-      pthread_mutex_destroy(&sim_timer_lock);                     \
-      pthread_cond_destroy(&sim_timer_wake);                      \
-      pthread_mutex_destroy(&sim_tmxr_poll_lock);                 \
-      pthread_cond_destroy(&sim_tmxr_poll_cond);                  \
-      }                                                           \
-    else                                                          \
-      (void)0
-#ifdef _WIN32
-#elif defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_4) || defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_8)
-#define InterlockedCompareExchangePointer(Destination, Exchange, Comparand) __sync_val_compare_and_swap(Destination, Comparand, Exchange)
-#elif defined(__DECC_VER)
-#define InterlockedCompareExchangePointer(Destination, Exchange, Comparand) (void *)((int32)_InterlockedCompareExchange64(Destination, Exchange, Comparand))
-#else
-#error "Implementation of function InterlockedCompareExchangePointer() is needed to build with USE_AIO_INTRINSICS"
-#endif
-#define AIO_QUEUE_VAL InterlockedCompareExchangePointer(&sim_asynch_queue, sim_asynch_queue, NULL)
-#define AIO_QUEUE_SET(val, queue) InterlockedCompareExchangePointer(&sim_asynch_queue, val, queue)
-#define AIO_UPDATE_QUEUE                                                         \
-    if (AIO_QUEUE_VAL != QUEUE_LIST_END) { /* List !Empty */                     \
-      UNIT *q, *uptr;                                                            \
-      int32 a_event_time;                                                        \
-      do                                                                         \
-        q = AIO_QUEUE_VAL;                                                       \
-        while (q != AIO_QUEUE_SET(QUEUE_LIST_END, q));                           \
-      sim_debug (SIM_DBG_AIO_QUEUE, sim_dflt_dev, "Found Asynch event for %s after %d instructions\n", sim_uname(q), q->a_event_time);\
-      while (q != QUEUE_LIST_END) {   /* List !Empty */                          \
-        uptr = q;                                                                \
-        q = q->a_next;                                                           \
-        uptr->a_next = NULL;        /* hygiene */                                \
-        if (uptr->a_activate_call != &sim_activate_notbefore) {                  \
-          a_event_time = uptr->a_event_time-((sim_asynch_inst_latency+1)/2);     \
-          if (a_event_time < 0)                                                  \
-            a_event_time = 0;                                                    \
-          }                                                                      \
-        else                                                                     \
-          a_event_time = uptr->a_event_time;                                     \
-        uptr->a_activate_call (uptr, a_event_time);                              \
-        if (uptr->a_check_completion)                                            \
-          uptr->a_check_completion (uptr);                                       \
-      }                                                                          \
-    } else (void)0
-#define AIO_ACTIVATE(caller, uptr, event_time)                                   \
-    if (!pthread_equal ( pthread_self(), sim_asynch_main_threadid )) {           \
-      UNIT *ouptr = (uptr);                                                      \
-      sim_debug (SIM_DBG_AIO_QUEUE, sim_dflt_dev, "Queueing Asynch event for %s after %d instructions\n", sim_uname(ouptr), event_time);\
-      if (ouptr->a_next) {                                                       \
-        ouptr->a_activate_call = sim_activate_abs;                               \
-      } else {                                                                   \
-        UNIT *q, *qe;                                                            \
-        ouptr->a_event_time = event_time;                                        \
-        uptr->a_activate_call = caller;                                          \
-        uptr->a_next = QUEUE_LIST_END;                  /* Mark as on list */    \
-        do {                                                                     \
-          do                                                                     \
-            q = AIO_QUEUE_VAL;                                                   \
-            while (q != AIO_QUEUE_SET(QUEUE_LIST_END, q));/* Grab current list */\
-          for (qe = ouptr; qe->a_next != QUEUE_LIST_END; qe = qe->a_next);       \
-          qe->a_next = q;                               /* append current list */\
-          do                                                                     \
-            q = AIO_QUEUE_VAL;                                                   \
-            while (q != AIO_QUEUE_SET(ouptr, q));                                \
-          ouptr = q;                                                             \
-          } while (ouptr != QUEUE_LIST_END);                                     \
-      }                                                                          \
-      sim_asynch_check = 0;                             /* try to force check */ \
-      if (sim_idle_wait) {                                                       \
-        sim_debug (TIMER_DBG_IDLE, &sim_timer_dev, "waking due to event on %s after %d instructions\n", sim_uname(ouptr), event_time);\
-        pthread_cond_signal (&sim_asynch_wake);                                  \
-        }                                                                        \
-      return SCPE_OK;                                                            \
-    } else (void)0
 #else /* !USE_AIO_INTRINSICS */
-/* This approach uses a pthread mutex to manage access to the link list     */
-/* head sim_asynch_queue.  It will always work, but may be slower than the  */
-/* lock free approach when using USE_AIO_INTRINSICS                         */
+/* This approach uses the sim_asynch_lock mutex to claim ring slots and to */
+/* drain them.  It will always work, but may be slower than the lock free  */
+/* approach when using USE_AIO_INTRINSICS.  The simulator thread takes the */
+/* lock once per batch of completions rather than once per completion.     */
 #define AIO_QUEUE_MODE "Lock based asynchronous event queue access"
+#define AIO_PENDING_ADJUST(uptr, val)                             \
+    do {                                                          \
+      AIO_LOCK;                                                   \
+      (uptr)->a_pending += (val);                                 \
+      AIO_UNLOCK;                                                 \
+      } while (0)
+#define AIO_INFLIGHT_ADJUST(val)                                  \
+    do {                                                          \
+      AIO_LOCK;                                                   \
+      sim_asynch_inflight += (val);                               \
+      AIO_UNLOCK;                                                 \
+      } while (0)
+#define AIO_MEMORY_BARRIER
+#define AIO_RING_LOCK AIO_LOCK
+#define AIO_RING_UNLOCK AIO_UNLOCK
+#define AIO_RING_CLAIM(pos) ((sim_asynch_ring_tail = (pos) + 1), TRUE)
 #define AIO_INIT                                                  \
     if (1) {                                                      \
       pthread_mutexattr_t attr;                                   \
+      int _i;                                                     \
                                                                   \
       pthread_mutexattr_init (&attr);                             \
       pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);  \
@@ -957,15 +990,18 @@ extern int32 sim_asynch_inst_latency;
       pthread_mutexattr_destroy (&attr);                          \
       sim_asynch_main_threadid = pthread_self();                  \
       /* Empty list/list end uses the point value (void *)1.      \
-         This allows NULL in an entry's a_next pointer to         \
+         This allows NULL in an entry's next pointer to           \
          indicate that the entry is not currently in any list */  \
-      sim_asynch_queue = QUEUE_LIST_END;                          \
+      for (_i = 0; _i < AIO_RING_SIZE; _i++)                      \
+        sim_asynch_ring[_i].seq = _i;                             \
+      sim_asynch_ring_head = sim_asynch_ring_tail = 0;            \
       sim_wallclock_queue = QUEUE_LIST_END;                       \
       sim_wallclock_entry = NULL;                                 \
       sim_clock_cosched_queue = QUEUE_LIST_END;                   \
       }                                                           \
     else                                                          \
       (void)0
+#endif /* USE_AIO_INTRINSICS */
 #define AIO_CLEANUP                                               \
     if (1) {                                                      \
       pthread_mutex_destroy(&sim_asynch_lock);                    \
@@ -977,51 +1013,18 @@ extern int32 sim_asynch_inst_latency;
       }                                                           \
     else                                                          \
       (void)0
+#define AIO_RING_PENDING                                                         \
+    ((sim_asynch_spill_cnt != 0) ||                                              \
+     (sim_asynch_ring[sim_asynch_ring_head & AIO_RING_MASK].seq == sim_asynch_ring_head + 1))
 #define AIO_UPDATE_QUEUE                                                         \
-    if (1) {                                                                     \
-      UNIT *uptr;                                                                \
-      AIO_LOCK;                                                                  \
-      while (sim_asynch_queue != QUEUE_LIST_END) { /* List !Empty */             \
-        int32 a_event_time;                                                      \
-        uptr = sim_asynch_queue;                                                 \
-        sim_debug (SIM_DBG_AIO_QUEUE, sim_dflt_dev, "found asynch event for %s after %d instructions\n", sim_uname(uptr), uptr->a_event_time);\
-        sim_asynch_queue = uptr->a_next;                                         \
-        uptr->a_next = NULL;            /* hygiene */                            \
-        if (uptr->a_activate_call != &sim_activate_notbefore) {                  \
-          a_event_time = uptr->a_event_time-((sim_asynch_inst_latency+1)/2);     \
-          if (a_event_time < 0)                                                  \
-            a_event_time = 0;                                                    \
-          }                                                                      \
-        else                                                                     \
-          a_event_time = uptr->a_event_time;                                     \
-        AIO_UNLOCK;                                                              \
-        sim_debug (SIM_DBG_AIO_QUEUE, sim_dflt_dev, "calling completion check for asynch event on %s\n", sim_uname(uptr));\
-        uptr->a_activate_call (uptr, a_event_time);                              \
-        if (uptr->a_check_completion)                                            \
-          uptr->a_check_completion (uptr);                                       \
-        AIO_LOCK;                                                                \
-      }                                                                          \
-      AIO_UNLOCK;                                                                \
-    } else (void)0
-#define AIO_ACTIVATE(caller, uptr, event_time)                         \
-    if (!pthread_equal ( pthread_self(), sim_asynch_main_threadid )) { \
-      sim_debug (SIM_DBG_AIO_QUEUE, sim_dflt_dev, "queueing asynch event for %s after %d instructions\n", sim_uname(uptr), event_time);\
-      AIO_UNLOCK;                                                      \
-      if (uptr->a_next) {                       /* already queued? */  \
-        uptr->a_activate_call = sim_activate_abs;                      \
-      } else {                                                         \
-        uptr->a_next = sim_asynch_queue;                               \
-        uptr->a_event_time = event_time;                               \
-        uptr->a_activate_call = caller;                                \
-        sim_asynch_queue = uptr;                                       \
-      }                                                                \
-      if (sim_idle_wait)                                               \
-        pthread_cond_signal (&sim_asynch_wake);                        \
-      AIO_UNLOCK;                                                      \
-      sim_asynch_check = 0;                                            \
-      return SCPE_OK;                                                  \
+    if (AIO_RING_PENDING)                                                        \
+      sim_aio_drain ();                                                          \
+    else (void)0
+#define AIO_ACTIVATE(caller, uptr, event_time)                                   \
+    if (!pthread_equal ( pthread_self(), sim_asynch_main_threadid )) {           \
+      sim_aio_post (caller, uptr, event_time, SCPE_OK);                          \
+      return SCPE_OK;                                                            \
     } else (void)0
-#endif /* USE_AIO_INTRINSICS */
 #define AIO_VALIDATE if (!pthread_equal ( pthread_self(), sim_asynch_main_threadid )) abort()
 #define AIO_CHECK_EVENT                                                \
     if (0 > --sim_asynch_check) {                                      \
@@ -1049,6 +1052,7 @@ extern int32 sim_asynch_inst_latency;
 #define AIO_EVENT_BEGIN(uptr)
 #define AIO_EVENT_COMPLETE(uptr, reason)
 #define AIO_IS_ACTIVE(uptr) FALSE
+#define AIO_INFLIGHT_ADJUST(val)
 #define AIO_CANCEL(uptr)
 #define AIO_SET_INTERRUPT_LATENCY(instpersec)
 #define AIO_TLS
@@ -50,6 +50,10 @@ Public routines:
    sim_disk_show_capac       show disk capacity
    sim_disk_set_async        enable asynchronous operation
    sim_disk_clr_async        disable asynchronous operation
+   sim_disk_set_qdepth       set asynchronous request queue depth
+   sim_disk_show_qdepth      show asynchronous request queue depth
+   sim_disk_set_ioengine     set host transfer engine
+   sim_disk_show_ioengine    show host transfer engine
    sim_disk_data_trace       debug support
 
 Internal routines:
@@ -69,6 +73,12 @@ Internal routines:
    sim_vhd_disk_rdsect       platform independent read virtual disk sectors
    sim_vhd_disk_wrsect       platform independent write virtual disk sectors
 
+   sim_dedup_disk_open       open deduplicating disk container
+   sim_dedup_disk_create     create deduplicating disk container
+   sim_dedup_disk_close      close deduplicating disk container
+   sim_dedup_disk_rdsect     read deduplicating disk container sectors
+   sim_dedup_disk_wrsect     write deduplicating disk container sectors
+
 
 */
 
@@ -77,11 +87,38 @@ Internal routines:
 #include <ctype.h>
 #include <sys/stat.h>
 
+#if defined (HAVE_IO_URING)
+#include <sys/syscall.h>
+#if !defined (__NR_io_uring_setup)                      /* headers without the system calls? */
+#undef HAVE_IO_URING
+#endif
+#endif
+#if !defined (_WIN32) && !defined (VMS)
+#define DISK_MMAP_SUPPORT 1
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 #ifdef _WIN32
 #include <windows.h>
 #endif
 #if defined SIM_ASYNCH_IO
 #include <pthread.h>
+
+#define DISK_MAX_QDEPTH     64      /* max outstanding asynchronous requests per unit */
+#define DISK_MAX_IO_THREADS 8       /* max I/O threads per unit */
+
+struct disk_request {
+    int                 dop;                /* operation */
+    t_lba               lba;
+    uint8               *buf;
+    t_seccnt            *rsects;
+    t_seccnt            sects;
+    DISK_SG             *sg;                /* host segments (scatter/gather ops) */
+    uint32              nsg;
+    DISK_PCALLBACK      callback;
+    t_stat              io_status;
+    t_bool              done;               /* operation has completed */
+    };
 #endif
 
 struct disk_context {
@@ -96,703 +133,2727 @@ struct disk_context {
 #if defined _WIN32
     HANDLE              disk_handle;        /* OS specific Raw device handle */
 #endif
+#if defined (HAVE_IO_URING)
+    struct disk_uring   *uring;             /* io_uring transfer engine state (NULL if unused) */
+#endif
+#if defined (DISK_MMAP_SUPPORT)
+    uint8               *map;               /* memory mapped container (NULL if unused) */
+    size_t              map_size;           /* size of mapping */
+    t_addr              map_fsize;          /* size of container file */
+#endif
+    struct disk_overlay *overlay;           /* copy-on-write overlay (NULL if none) */
+    struct disk_cache_image *cache;         /* sector cache image (NULL if not cached) */
+    t_bool              nocache;            /* unit excluded from the sector cache */
+    uint32              cache_hits;         /* sectors read from the sector cache */
+    uint32              cache_misses;       /* sectors read from the container */
 #if defined SIM_ASYNCH_IO
     int                 asynch_io;          /* Asynchronous Interrupt scheduling enabled */
     int                 asynch_io_latency;  /* instructions to delay pending interrupt */
     pthread_mutex_t     lock;
-    pthread_t           io_thread;          /* I/O Thread Id */
+    uint32              io_threads;         /* number of I/O threads */
+    pthread_t           io_thread[DISK_MAX_IO_THREADS];/* I/O Thread Ids */
     pthread_mutex_t     io_lock;
     pthread_cond_t      io_cond;
     pthread_cond_t      io_done;
     pthread_cond_t      startup_cond;
-    int                 io_dop;
-    uint8               *buf;
-    t_seccnt            *rsects;
-    t_seccnt            sects;
-    t_lba               lba;
-    DISK_PCALLBACK      callback;
-    t_stat              io_status;
+    uint32              queue_depth;        /* max outstanding requests */
+    uint32              req_submitted;      /* requests queued */
+    uint32              req_started;        /* requests taken by an I/O thread */
+    uint32              req_completed;      /* requests performed */
+    uint32              req_delivered;      /* requests whose callback has run */
+    struct disk_request req[DISK_MAX_QDEPTH];/* request ring */
 #endif
     };
 
 #define disk_ctx up8                        /* Field in Unit structure which points to the disk_context */
 
-#if defined SIM_ASYNCH_IO
-#define AIO_CALLSETUP                                               \
-struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;   \
-                                                                    \
-if ((!callback) || !ctx->asynch_io)
+#if defined (HAVE_IO_URING)
+/* Linux io_uring transfer engine
 
-#define AIO_CALL(op, _lba, _buf, _rsects, _sects,  _callback)   \
-    if (ctx->asynch_io) {                                       \
-        struct disk_context *ctx =                              \
-                      (struct disk_context *)uptr->disk_ctx;    \
-                                                                \
-        pthread_mutex_lock (&ctx->io_lock);                     \
-                                                                \
-        sim_debug (ctx->dbit, ctx->dptr,                        \
-      "sim_disk AIO_CALL(op=%d, unit=%d, lba=0x%X, sects=%d)\n",\
-                op, (int)(uptr-ctx->dptr->units), _lba, _sects);\
-                                                                \
-        if (ctx->callback)                                      \
-            abort(); /* horrible mistake, stop */               \
-        ctx->io_dop = op;                                       \
-        ctx->lba = _lba;                                        \
-        ctx->buf = _buf;                                        \
-        ctx->sects = _sects;                                    \
-        ctx->rsects = _rsects;                                  \
-        ctx->callback = _callback;                              \
-        pthread_cond_signal (&ctx->io_cond);                    \
-        pthread_mutex_unlock (&ctx->io_lock);                   \
-        }                                                       \
-    else                                                        \
-        if (_callback)                                          \
-            (_callback) (uptr, r);
+   When selected for a unit, transfers to a SIMH format container or a
+   raw device are performed as io_uring submissions against a separate
+   descriptor for the container rather than through stdio or pread/pwrite.
+   Consecutive queued asynchronous requests which don't overlap a queued
+   write are submitted together with a single io_uring_enter() call.  With
+   the direct option the descriptor is opened with O_DIRECT, bypassing the
+   host's page cache, and transfers move through aligned bounce buffers.
+*/
 
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
 
-#define DOP_DONE  0             /* close */
-#define DOP_RSEC  1             /* sim_disk_rdsect_a */
-#define DOP_WSEC  2             /* sim_disk_wrsect_a */
-#define DOP_IAVL  3             /* sim_disk_isavailable_a */
+#define DISK_URING_ENTRIES  64                  /* submission queue size */
+#define DISK_DIRECT_ALIGN   4096                /* O_DIRECT buffer alignment */
+#define DISK_DIRECT_BLOCK   512                 /* O_DIRECT offset and length granularity */
 
-static void *
-_disk_io(void *arg)
-{
-UNIT* volatile uptr = (UNIT*)arg;
-int sched_policy;
-struct sched_param sched_priority;
-struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_uring_xfer {
+    t_bool              write;
+    t_lba               lba;
+    uint8               *buf;
+    t_seccnt            sects;
+    uint32              element_size;       /* element size to byte swap (1 = no swapping) */
+    size_t              xfered;             /* bytes transferred */
+    t_stat              status;
+    };
 
-/* Boost Priority for this I/O thread vs the CPU instruction execution 
-   thread which in general won't be readily yielding the processor when 
-   this thread needs to run */
-pthread_getschedparam (pthread_self(), &sched_policy, &sched_priority);
-++sched_priority.sched_priority;
-pthread_setschedparam (pthread_self(), sched_policy, &sched_priority);
+struct disk_uring {
+    int                 ring_fd;            /* io_uring instance */
+    int                 fd;                 /* container descriptor */
+    int                 dfd;                /* O_DIRECT container descriptor (-1 if none) */
+    void                *sq_ptr;            /* submission queue ring mapping */
+    size_t              sq_size;
+    void                *cq_ptr;            /* completion queue ring mapping */
+    size_t              cq_size;
+    struct io_uring_sqe *sqes;              /* submission queue entries mapping */
+    size_t              sqes_size;
+    unsigned            *sq_head;
+    unsigned            *sq_tail;
+    unsigned            *sq_mask;
+    unsigned            *sq_array;
+    unsigned            *cq_head;
+    unsigned            *cq_tail;
+    unsigned            *cq_mask;
+    struct io_uring_cqe *cqes;
+    uint8               *bounce[DISK_URING_ENTRIES];     /* aligned bounce buffers */
+    size_t              bounce_size[DISK_URING_ENTRIES];
+    uint32              submits;            /* io_uring_enter calls made */
+    uint32              xfers;              /* transfers performed */
+#if defined (SIM_ASYNCH_IO)
+    pthread_mutex_t     lock;               /* serializes use of the rings */
+#endif
+    };
 
-sim_debug (ctx->dbit, ctx->dptr, "_disk_io(unit=%d) starting\n", (int)(uptr-ctx->dptr->units));
+static void _disk_uring_close (UNIT *uptr);
 
-pthread_mutex_lock (&ctx->io_lock);
-pthread_cond_signal (&ctx->startup_cond);   /* Signal we're ready to go */
-while (ctx->asynch_io) {
-    pthread_cond_wait (&ctx->io_cond, &ctx->io_lock);
-    if (ctx->io_dop == DOP_DONE)
-        break;
-    pthread_mutex_unlock (&ctx->io_lock);
-    switch (ctx->io_dop) {
-        case DOP_RSEC:
-            ctx->io_status = sim_disk_rdsect (uptr, ctx->lba, ctx->buf, ctx->rsects, ctx->sects);
-            break;
-        case DOP_WSEC:
-            ctx->io_status = sim_disk_wrsect (uptr, ctx->lba, ctx->buf, ctx->rsects, ctx->sects);
-            break;
-        case DOP_IAVL:
-            ctx->io_status = sim_disk_isavailable (uptr);
-            break;
-        }
-    pthread_mutex_lock (&ctx->io_lock);
-    ctx->io_dop = DOP_DONE;
-    pthread_cond_signal (&ctx->io_done);
-    sim_activate (uptr, ctx->asynch_io_latency);
-    }
-pthread_mutex_unlock (&ctx->io_lock);
+static t_stat _disk_uring_open (UNIT *uptr, t_bool direct)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_uring *u;
+struct io_uring_params p;
+int mode = (uptr->flags & UNIT_RO) ? O_RDONLY : O_RDWR;
 
-sim_debug (ctx->dbit, ctx->dptr, "_disk_io(unit=%d) exiting\n", (int)(uptr-ctx->dptr->units));
+sim_debug (ctx->dbit, ctx->dptr, "_disk_uring_open(unit=%d, direct=%d)\n", (int)(uptr-ctx->dptr->units), direct);
 
-return NULL;
+if ((DK_GET_FMT (uptr) != DKUF_F_STD) && (DK_GET_FMT (uptr) != DKUF_F_RAW))
+    return SCPE_NOFNC;
+u = (struct disk_uring *)calloc (1, sizeof (*u));
+if (u == NULL)
+    return SCPE_MEM;
+u->fd = u->dfd = -1;
+#if defined (SIM_ASYNCH_IO)
+pthread_mutex_init (&u->lock, NULL);
+#endif
+memset (&p, 0, sizeof (p));
+u->ring_fd = (int)syscall (__NR_io_uring_setup, DISK_URING_ENTRIES, &p);
+if (u->ring_fd < 0) {
+#if defined (SIM_ASYNCH_IO)
+    pthread_mutex_destroy (&u->lock);
+#endif
+    free (u);
+    return SCPE_NOFNC;
+    }
+ctx->uring = u;
+u->sq_size = p.sq_off.array + p.sq_entries * sizeof (unsigned);
+u->cq_size = p.cq_off.cqes + p.cq_entries * sizeof (struct io_uring_cqe);
+u->sqes_size = p.sq_entries * sizeof (struct io_uring_sqe);
+u->sq_ptr = mmap (NULL, u->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQ_RING);
+u->cq_ptr = mmap (NULL, u->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_CQ_RING);
+u->sqes = (struct io_uring_sqe *)mmap (NULL, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQES);
+if ((u->sq_ptr == MAP_FAILED) || (u->cq_ptr == MAP_FAILED) || (u->sqes == MAP_FAILED)) {
+    _disk_uring_close (uptr);
+    return SCPE_NOFNC;
+    }
+u->sq_head = (unsigned *)((char *)u->sq_ptr + p.sq_off.head);
+u->sq_tail = (unsigned *)((char *)u->sq_ptr + p.sq_off.tail);
+u->sq_mask = (unsigned *)((char *)u->sq_ptr + p.sq_off.ring_mask);
+u->sq_array = (unsigned *)((char *)u->sq_ptr + p.sq_off.array);
+u->cq_head = (unsigned *)((char *)u->cq_ptr + p.cq_off.head);
+u->cq_tail = (unsigned *)((char *)u->cq_ptr + p.cq_off.tail);
+u->cq_mask = (unsigned *)((char *)u->cq_ptr + p.cq_off.ring_mask);
+u->cqes = (struct io_uring_cqe *)((char *)u->cq_ptr + p.cq_off.cqes);
+if (DK_GET_FMT (uptr) == DKUF_F_STD)
+    fflush (uptr->fileref);                             /* push out anything stdio has buffered */
+u->fd = open (uptr->filename, mode, 0);
+if (u->fd < 0) {
+    _disk_uring_close (uptr);
+    return SCPE_OPENERR;
+    }
+#if defined (O_DIRECT)
+if (direct) {
+    u->dfd = open (uptr->filename, mode | O_DIRECT, 0);
+    if ((u->dfd < 0) && !sim_quiet)
+        printf ("%s%d: direct I/O not supported by host file system, using cached I/O\n", sim_dname (ctx->dptr), (int)(uptr-ctx->dptr->units));
+    }
+#endif
+return SCPE_OK;
 }
 
-/* This routine is called in the context of the main simulator thread before 
-   processing events for any unit. It is only called when an asynchronous 
-   thread has called sim_activate() to activate a unit.  The job of this 
-   routine is to put the unit in proper condition to digest what may have
-   occurred in the asynchrconous thread.
-   
-   Since disk processing only handles a single I/O at a time to a 
-   particular disk device (due to using stdio for the SimH Disk format
-   and stdio doesn't have an atomic seek+(read|write) operation), 
-   we have the opportunity to possibly detect improper attempts to 
-   issue multiple concurrent I/O requests. */
-static void _disk_completion_dispatch (UNIT *uptr)
+static void _disk_uring_close (UNIT *uptr)
 {
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
-DISK_PCALLBACK callback = ctx->callback;
+struct disk_uring *u = ctx->uring;
+int i;
 
-sim_debug (ctx->dbit, ctx->dptr, "_disk_completion_dispatch(unit=%d, dop=%d, callback=%p)\n", (int)(uptr-ctx->dptr->units), ctx->io_dop, ctx->callback);
+if (u == NULL)
+    return;
+sim_debug (ctx->dbit, ctx->dptr, "_disk_uring_close(unit=%d)\n", (int)(uptr-ctx->dptr->units));
+ctx->uring = NULL;
+if (u->sq_ptr && (u->sq_ptr != MAP_FAILED))
+    munmap (u->sq_ptr, u->sq_size);
+if (u->cq_ptr && (u->cq_ptr != MAP_FAILED))
+    munmap (u->cq_ptr, u->cq_size);
+if (u->sqes && (u->sqes != MAP_FAILED))
+    munmap (u->sqes, u->sqes_size);
+if (u->dfd >= 0)
+    close (u->dfd);
+if (u->fd >= 0) {
+    if (u->dfd >= 0)
+        fdatasync (u->fd);
+    close (u->fd);
+    /* Anything the stdio stream read before or during the time the 
+       descriptor was in use may now be stale. */
+    if (DK_GET_FMT (uptr) == DKUF_F_STD)
+        fflush (uptr->fileref);
+    }
+close (u->ring_fd);
+#if defined (SIM_ASYNCH_IO)
+pthread_mutex_destroy (&u->lock);
+#endif
+for (i = 0; i < DISK_URING_ENTRIES; i++)
+    free (u->bounce[i]);
+free (u);
+}
 
-if (ctx->io_dop != DOP_DONE)
-    abort();                                            /* horribly wrong, stop */
+/* Return an aligned bounce buffer of at least size bytes for slot */
 
-if (ctx->callback && ctx->io_dop == DOP_DONE) {
-    ctx->callback = NULL;
-    callback (uptr, ctx->io_status);
-    }
+static uint8 *_disk_uring_bounce (struct disk_uring *u, int slot, size_t size)
+{
+void *b;
+
+if (u->bounce_size[slot] >= size)
+    return u->bounce[slot];
+free (u->bounce[slot]);
+u->bounce[slot] = NULL;
+u->bounce_size[slot] = 0;
+if (posix_memalign (&b, DISK_DIRECT_ALIGN, size))
+    return NULL;
+u->bounce[slot] = (uint8 *)b;
+u->bounce_size[slot] = size;
+return u->bounce[slot];
 }
 
-static t_bool _disk_is_active (UNIT *uptr)
+/* Perform n (<= DISK_URING_ENTRIES) transfers with one submission
+
+   The transfers must not depend on each other's ordering since the kernel 
+   may perform them concurrently.  Short reads are zero filled. */
+
+static void _disk_uring_transfer (UNIT *uptr, struct disk_uring_xfer *x, int n)
 {
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_uring *u = ctx->uring;
+uint8 *xbuf[DISK_URING_ENTRIES];
+int xfd[DISK_URING_ENTRIES];
+t_bool reaped[DISK_URING_ENTRIES];
+t_bool broken = FALSE;
+unsigned tail, head;
+int i, submitted, done;
 
-if (ctx) {
-    sim_debug (ctx->dbit, ctx->dptr, "_disk_is_active(unit=%d, dop=%d)\n", uptr-ctx->dptr->units, ctx->io_dop);
-    return (ctx->io_dop != DOP_DONE);
+#if defined (SIM_ASYNCH_IO)
+pthread_mutex_lock (&u->lock);
+#endif
+tail = *u->sq_tail;
+for (i = submitted = 0; i < n; i++) {
+    size_t tbc = x[i].sects * ctx->sector_size;
+    off_t addr = ((off_t)x[i].lba) * ctx->sector_size;
+    t_bool swap = (!sim_end && (x[i].element_size > 1));
+    unsigned idx = tail & *u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[idx];
+
+    x[i].xfered = 0;
+    x[i].status = SCPE_OK;
+    reaped[i] = FALSE;
+    xfd[i] = u->fd;
+    xbuf[i] = x[i].buf;
+    if ((u->dfd >= 0) && 
+        (0 == (addr & (DISK_DIRECT_BLOCK - 1))) && 
+        (0 == (tbc & (DISK_DIRECT_BLOCK - 1))))
+        xfd[i] = u->dfd;
+    if (swap || ((xfd[i] == u->dfd) && (((size_t)x[i].buf) & (DISK_DIRECT_ALIGN - 1)))) {
+        xbuf[i] = _disk_uring_bounce (u, i, tbc);
+        if (xbuf[i] == NULL) {
+            x[i].status = SCPE_MEM;
+            continue;
+            }
+        }
+    if (x[i].write && (xbuf[i] != x[i].buf)) {
+        if (swap)
+            sim_buf_copy_swapped (xbuf[i], x[i].buf, x[i].element_size, tbc / x[i].element_size);
+        else
+            memcpy (xbuf[i], x[i].buf, tbc);
+        }
+    memset (sqe, 0, sizeof (*sqe));
+    sqe->opcode = x[i].write ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd = xfd[i];
+    sqe->off = (t_uint64)addr;
+    sqe->addr = (t_uint64)((size_t)xbuf[i]);
+    sqe->len = (uint32)tbc;
+    sqe->user_data = (t_uint64)i;
+    u->sq_array[idx] = idx;
+    ++tail;
+    ++submitted;
+    }
+__atomic_store_n (u->sq_tail, tail, __ATOMIC_RELEASE);
+for (done = 0; done < submitted; ) {
+    if (!broken) {
+        unsigned to_submit = tail - __atomic_load_n (u->sq_head, __ATOMIC_ACQUIRE);
+        int r = (int)syscall (__NR_io_uring_enter, u->ring_fd, to_submit, submitted - done, IORING_ENTER_GETEVENTS, NULL, 0);
+
+        ++u->submits;
+        if ((r < 0) && (errno != EINTR) && (errno != EAGAIN) && (errno != EBUSY)) {
+            unsigned consumed = __atomic_load_n (u->sq_head, __ATOMIC_ACQUIRE);
+
+            /* The ring is unusable.  Take back the entries the kernel 
+               hasn't consumed.  Those it has consumed still use their 
+               buffers, so wait for each of them to complete anyway. */
+            submitted -= (int)(tail - consumed);
+            tail = consumed;
+            __atomic_store_n (u->sq_tail, tail, __ATOMIC_RELEASE);
+            broken = TRUE;
+            }
+        }
+    else
+        sim_os_ms_sleep (1);                            /* completions post without entering */
+    head = *u->cq_head;
+    while (head != __atomic_load_n (u->cq_tail, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+        int res = cqe->res;
+
+        i = (int)cqe->user_data;
+        ++head;
+        ++done;
+        reaped[i] = TRUE;
+        if ((res == -EINVAL) && (xfd[i] == u->dfd)) {   /* direct I/O refused? */
+            size_t tbc = x[i].sects * ctx->sector_size;
+            off_t addr = ((off_t)x[i].lba) * ctx->sector_size;
+
+            res = (int)(x[i].write ? pwrite (u->fd, xbuf[i], tbc, addr) : pread (u->fd, xbuf[i], tbc, addr));
+            if (res < 0)
+                res = -errno;
+            }
+        if (res < 0) {
+            errno = -res;
+            x[i].status = SCPE_IOERR;
+            }
+        else
+            x[i].xfered = (size_t)res;
+        }
+    __atomic_store_n (u->cq_head, head, __ATOMIC_RELEASE);
+    }
+u->xfers += submitted;
+#if defined (SIM_ASYNCH_IO)
+pthread_mutex_unlock (&u->lock);
+#endif
+if (broken)
+    for (i = 0; i < n; i++)                             /* fail whatever never went */
+        if ((x[i].status == SCPE_OK) && !reaped[i])
+            x[i].status = SCPE_IOERR;
+for (i = 0; i < n; i++) {
+    size_t tbc = x[i].sects * ctx->sector_size;
+
+    if (x[i].write || (x[i].status != SCPE_OK))
+        continue;
+    if (xbuf[i] != x[i].buf) {                          /* bounced? */
+        if (!sim_end && (x[i].element_size > 1))
+            sim_buf_copy_swapped (x[i].buf, xbuf[i], x[i].element_size, x[i].xfered / x[i].element_size);
+        else
+            memcpy (x[i].buf, xbuf[i], x[i].xfered);
+        }
+    if (x[i].xfered < tbc)                              /* fill */
+        memset (&x[i].buf[x[i].xfered], 0, tbc - x[i].xfered);
     }
-return FALSE;
 }
 
-static void _disk_cancel (UNIT *uptr)
+/* Perform a single transfer */
+
+static t_stat _disk_uring_rw (UNIT *uptr, t_bool write, t_lba lba, uint8 *buf, t_seccnt *sectsxfered, t_seccnt sects, uint32 element_size)
 {
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
-
-if (ctx) {
-    sim_debug (ctx->dbit, ctx->dptr, "_disk_cancel(unit=%d, dop=%d)\n", uptr-ctx->dptr->units, ctx->io_dop);
-    if (ctx->asynch_io) {
-        pthread_mutex_lock (&ctx->io_lock);
-        while (ctx->io_dop != DOP_DONE)
-            pthread_cond_wait (&ctx->io_done, &ctx->io_lock);
-        pthread_mutex_unlock (&ctx->io_lock);
-        }
-    }
+struct disk_uring_xfer x;
+
+x.write = write;
+x.lba = lba;
+x.buf = buf;
+x.sects = sects;
+x.element_size = element_size;
+_disk_uring_transfer (uptr, &x, 1);
+if (sectsxfered)
+    *sectsxfered = (x.status == SCPE_OK) ? (t_seccnt)((x.xfered + ctx->sector_size - 1) / ctx->sector_size) : 0;
+return x.status;
 }
-#else
-#define AIO_CALLSETUP
-#define AIO_CALL(op, _lba, _buf, _rsects, _sects,  _callback)   \
-    if (_callback)                                              \
-        (_callback) (uptr, r);
 #endif
 
-/* Forward declarations */
+#if defined (DISK_MMAP_SUPPORT)
+/* Memory mapped transfer engine
+
+   When selected for a unit attached to a SIMH format container, the 
+   container is mapped shared into the simulator's address space and 
+   transfers are copies to and from the mapping.  Reads come straight 
+   out of the host's page cache, so several simulators attached to the 
+   same read-mostly image share a single copy of it.  The mapping covers 
+   the whole simulated drive, even when the container file is shorter; 
+   reads beyond the end of the file return zeros and writes beyond it 
+   extend the file first.
+*/
 
-static t_stat sim_vhd_disk_implemented (void);
-static FILE *sim_vhd_disk_open (const char *rawdevicename, const char *openmode);
-static FILE *sim_vhd_disk_create (const char *szVHDPath, t_addr desiredsize);
-static FILE *sim_vhd_disk_create_diff (const char *szVHDPath, const char *szParentVHDPath);
-static FILE *sim_vhd_disk_merge (const char *szVHDPath, char **ParentVHD);
-static int sim_vhd_disk_close (FILE *f);
-static void sim_vhd_disk_flush (FILE *f);
-static t_addr sim_vhd_disk_size (FILE *f);
-static t_stat sim_vhd_disk_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects);
-static t_stat sim_vhd_disk_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects);
-static t_stat sim_vhd_disk_clearerr (UNIT *uptr);
-static t_stat sim_vhd_disk_set_dtype (FILE *f, const char *dtype);
-static const char *sim_vhd_disk_get_dtype (FILE *f);
-static t_stat sim_os_disk_implemented_raw (void);
-static FILE *sim_os_disk_open_raw (const char *rawdevicename, const char *openmode);
-static int sim_os_disk_close_raw (FILE *f);
-static void sim_os_disk_flush_raw (FILE *f);
-static t_addr sim_os_disk_size_raw (FILE *f);
-static t_stat sim_os_disk_unload_raw (FILE *f);
-static t_bool sim_os_disk_isavailable_raw (FILE *f);
-static t_stat sim_os_disk_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects);
-static t_stat sim_os_disk_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects);
-static t_stat sim_os_disk_info_raw (FILE *f, uint32 *sector_size, uint32 *removable);
-static t_stat sim_disk_pdp11_bad_block (UNIT *uptr, int32 sec);
-static char *HostPathToVhdPath (const char *szHostPath, char *szVhdPath, size_t VhdPathSize);
-static char *VhdPathToHostPath (const char *szVhdPath, char *szHostPath, size_t HostPathSize);
+static t_stat _disk_mmap_map (UNIT *uptr, t_addr size)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+void *map;
+
+if (((t_addr)((size_t)size) != size) || (size == 0))   /* beyond the host's address space? */
+    return SCPE_NOFNC;
+map = mmap (NULL, (size_t)size, (uptr->flags & UNIT_RO) ? PROT_READ : (PROT_READ | PROT_WRITE), MAP_SHARED, fileno (uptr->fileref), 0);
+if (map == MAP_FAILED)
+    return SCPE_NOFNC;
+ctx->map = (uint8 *)map;
+ctx->map_size = (size_t)size;
+return SCPE_OK;
+}
 
-struct sim_disk_fmt {
-    char                *name;                          /* name */
-    int32               uflags;                         /* unit flags */
-    int32               fmtval;                         /* Format type value */
-    t_stat              (*impl_fnc)(void);              /* Implemented Test Function */
-    };
+static t_stat _disk_mmap_open (UNIT *uptr)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct stat statb;
+t_addr size = uptr->capac*ctx->capac_factor;
 
-static struct sim_disk_fmt fmts[DKUF_N_FMT] = {
-    { "SIMH", 0, DKUF_F_STD, NULL},
-    { "RAW",  0, DKUF_F_RAW, sim_os_disk_implemented_raw},
-    { "VHD",  0, DKUF_F_VHD, sim_vhd_disk_implemented},
-    { NULL,   0, 0}
-    };
+sim_debug (ctx->dbit, ctx->dptr, "_disk_mmap_open(unit=%d)\n", (int)(uptr-ctx->dptr->units));
 
-/* Set disk format */
+if (DK_GET_FMT (uptr) != DKUF_F_STD)
+    return SCPE_NOFNC;
+fflush (uptr->fileref);                                 /* push out anything stdio has buffered */
+if (fstat (fileno (uptr->fileref), &statb))
+    return SCPE_IOERR;
+ctx->map_fsize = (t_addr)statb.st_size;
+if (size < ctx->map_fsize)
+    size = ctx->map_fsize;
+return _disk_mmap_map (uptr, size);
+}
 
-t_stat sim_disk_set_fmt (UNIT *uptr, int32 val, char *cptr, void *desc)
+static void _disk_mmap_close (UNIT *uptr)
 {
-uint32 f;
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
 
-if (uptr == NULL)
-    return SCPE_IERR;
-if (cptr == NULL)
-    return SCPE_ARG;
-for (f = 0; f < DKUF_N_FMT && fmts[f].name; f++) {
-    if (fmts[f].name && (strcmp (cptr, fmts[f].name) == 0)) {
-        if ((fmts[f].impl_fnc) && (fmts[f].impl_fnc() != SCPE_OK))
-            return SCPE_NOFNC;
-        uptr->flags = (uptr->flags & ~DKUF_FMT) |
-            (fmts[f].fmtval << DKUF_V_FMT) | fmts[f].uflags;
-        return SCPE_OK;
-        }
-    }
-return SCPE_ARG;
+if (ctx->map == NULL)
+    return;
+sim_debug (ctx->dbit, ctx->dptr, "_disk_mmap_close(unit=%d)\n", (int)(uptr-ctx->dptr->units));
+msync (ctx->map, ctx->map_size, MS_SYNC);
+munmap (ctx->map, ctx->map_size);
+ctx->map = NULL;
+ctx->map_size = 0;
+fflush (uptr->fileref);                                 /* discard any stale stdio buffer */
 }
 
-/* Show disk format */
+/* Grow the container and its mapping to at least size bytes */
 
-t_stat sim_disk_show_fmt (FILE *st, UNIT *uptr, int32 val, void *desc)
+static t_stat _disk_mmap_grow (UNIT *uptr, t_addr size)
 {
-int32 f = DK_GET_FMT (uptr);
-size_t i;
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
 
-for (i = 0; i < DKUF_N_FMT; i++)
-    if (fmts[i].fmtval == f) {
-        fprintf (st, "%s format", fmts[i].name);
-        return SCPE_OK;
+sim_debug (ctx->dbit, ctx->dptr, "_disk_mmap_grow(unit=%d, sectors=%u)\n", (int)(uptr-ctx->dptr->units), (uint32)(size / ctx->sector_size));
+
+if (ftruncate (fileno (uptr->fileref), (off_t)size))
+    return SCPE_IOERR;
+ctx->map_fsize = size;
+if (size <= ctx->map_size)
+    return SCPE_OK;
+munmap (ctx->map, ctx->map_size);
+ctx->map = NULL;
+ctx->map_size = 0;
+if (size < uptr->capac*ctx->capac_factor)
+    size = uptr->capac*ctx->capac_factor;
+return (_disk_mmap_map (uptr, size) == SCPE_OK) ? SCPE_OK : SCPE_IOERR;
+}
+
+static t_stat _disk_mmap_xfer (UNIT *uptr, t_bool write, t_addr da, uint8 *buf, size_t tbc, size_t *xfered)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+size_t avail;
+
+*xfered = 0;
+if (write) {
+    if (uptr->flags & UNIT_RO)                          /* mapping is read only */
+        return SCPE_IOERR;
+    if ((da + tbc) > ctx->map_fsize) {                  /* extending the container? */
+        t_stat r = _disk_mmap_grow (uptr, da + tbc);
+
+        if (r != SCPE_OK)
+            return r;
         }
-fprintf (st, "invalid format");
+    sim_buf_copy_swapped (ctx->map + da, buf, ctx->xfer_element_size, tbc / ctx->xfer_element_size);
+    avail = tbc;
+    }
+else {
+    avail = (da >= ctx->map_fsize) ? 0 : (size_t)(ctx->map_fsize - da);
+    if (avail > tbc)
+        avail = tbc;
+    avail -= avail % ctx->xfer_element_size;
+    sim_buf_copy_swapped (buf, ctx->map + da, ctx->xfer_element_size, avail / ctx->xfer_element_size);
+    if (avail < tbc)                                    /* fill */
+        memset (&buf[avail], 0, tbc - avail);
+    }
+*xfered = avail;
 return SCPE_OK;
 }
 
-/* Set disk capacity */
-
-t_stat sim_disk_set_capac (UNIT *uptr, int32 val, char *cptr, void *desc)
+static t_stat _disk_mmap_rw (UNIT *uptr, t_bool write, t_lba lba, uint8 *buf, t_seccnt *sectsxfered, t_seccnt sects)
 {
-t_addr cap;
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+size_t xfered;
 t_stat r;
 
-if ((cptr == NULL) || (*cptr == 0))
-    return SCPE_ARG;
-if (uptr->flags & UNIT_ATT)
-    return SCPE_ALATT;
-cap = (t_addr) get_uint (cptr, 10, sim_taddr_64? 2000000: 2000, &r);
-if (r != SCPE_OK)
-    return SCPE_ARG;
-uptr->capac = cap * ((t_addr) 1000000);
-return SCPE_OK;
+if (sectsxfered)
+    *sectsxfered = 0;
+r = _disk_mmap_xfer (uptr, write, ((t_addr)lba) * ctx->sector_size, buf, sects * ctx->sector_size, &xfered);
+if ((r == SCPE_OK) && sectsxfered)
+    *sectsxfered = (t_seccnt)((xfered + ctx->sector_size - 1) / ctx->sector_size);
+return r;
 }
+#endif
 
-/* Show disk capacity */
+/* Select the engine by which a unit's transfers are performed */
 
-t_stat sim_disk_show_capac (FILE *st, UNIT *uptr, int32 val, void *desc)
-{
-struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
-char *cap_units = "B";
+#define DISK_ENGINE_STDIO   0                   /* stdio (or pread/pwrite) */
+#define DISK_ENGINE_URING   1                   /* io_uring */
+#define DISK_ENGINE_DIRECT  2                   /* io_uring with O_DIRECT */
+#define DISK_ENGINE_MMAP    3                   /* memory mapped */
 
-if (ctx->capac_factor == 2)
-    cap_units = "W";
-if (uptr->capac) {
-    if (uptr->capac >= (t_addr) 1000000)
-        fprintf (st, "capacity=%dM%s", (uint32) (uptr->capac / ((t_addr) 1000000)), cap_units);
-    else if (uptr->capac >= (t_addr) 1000)
-        fprintf (st, "capacity=%dK%s", (uint32) (uptr->capac / ((t_addr) 1000)), cap_units);
-    else fprintf (st, "capacity=%d%s", (uint32) uptr->capac, cap_units);
-    }
-else fprintf (st, "undefined capacity");
-return SCPE_OK;
-}
+static const char *disk_engines[] = {"STDIO", "URING", "DIRECT", "MMAP", NULL};
 
-/* Test for available */
+static void _disk_engine_close (UNIT *uptr)
+{
+#if defined (HAVE_IO_URING)
+_disk_uring_close (uptr);
+#endif
+#if defined (DISK_MMAP_SUPPORT)
+_disk_mmap_close (uptr);
+#endif
+}
 
-t_bool sim_disk_isavailable (UNIT *uptr)
+static t_stat _disk_engine_open (UNIT *uptr, int engine)
 {
-if (!(uptr->flags & UNIT_ATT))                          /* attached? */
-    return FALSE;
-switch (DK_GET_FMT (uptr)) {                            /* case on format */
-    case DKUF_F_STD:                                    /* SIMH format */
-        return TRUE;
-    case DKUF_F_VHD:                                    /* VHD format */
-        return TRUE;
-        break;
-    case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
-        return sim_os_disk_isavailable_raw (uptr->fileref);
-        break;
+switch (engine) {
+    case DISK_ENGINE_STDIO:
+        return SCPE_OK;
+#if defined (HAVE_IO_URING)
+    case DISK_ENGINE_URING:
+        return _disk_uring_open (uptr, FALSE);
+    case DISK_ENGINE_DIRECT:
+        return _disk_uring_open (uptr, TRUE);
+#endif
+#if defined (DISK_MMAP_SUPPORT)
+    case DISK_ENGINE_MMAP:
+        return _disk_mmap_open (uptr);
+#endif
     default:
-        return FALSE;
+        return SCPE_NOFNC;
     }
 }
 
-t_bool sim_disk_isavailable_a (UNIT *uptr, DISK_PCALLBACK callback)
+/* Copy-on-write overlay
+
+   A SIMH format container can be attached read only beneath a writable 
+   overlay file (ATTACH -S unit overlay base).  The simulated drive is 
+   divided into blocks; the overlay holds a map with one entry per block 
+   and a store of the blocks which have been written.  The first write to 
+   a block copies it from the base container into the next free slot of 
+   the store and all later transfers for that block go to the overlay.  
+   Unwritten blocks are read from the base, so any number of simulators 
+   can share one read only base image.
+
+   Overlay file layout (integers are little endian):
+
+      0     "SIMHCOW1"
+      8     sector size
+      12    sectors per block
+      16    blocks in the map
+      20    blocks in use in the store
+      24    base container size (low and high 32 bits)
+      32    base container modification time
+      64    base container name
+      512   block map, 0 for blocks not in the store, otherwise slot+1
+      ...   block store, starting on a 4096 byte boundary
+
+   The map is kept in memory and written back when the unit is flushed or 
+   detached.  SET unit OVERLAY=COMMIT writes the stored blocks into the 
+   base container and SET unit OVERLAY=DISCARD empties the overlay.
+*/
+
+#define DISK_OVL_MAGIC      "SIMHCOW1"
+#define DISK_OVL_HDR_SIZE   512                 /* header size */
+#define DISK_OVL_NAME       64                  /* offset of the base name */
+#define DISK_OVL_BLKSECTS   128                 /* sectors per block */
+#define DISK_OVL_ALIGN      4096                /* block store alignment */
+
+struct disk_overlay {
+    FILE                *file;              /* overlay container */
+    char                path[CBUFSIZE];     /* overlay container name */
+    uint32              hdr[7];             /* sector size, block sectors, blocks, used, base size (2), base time */
+    uint32              blksize;            /* bytes per block */
+    uint32              blocks;             /* blocks in the map */
+    uint32              used;               /* blocks in the store */
+    uint32              *map;               /* block map */
+    t_bool              dirty;              /* map or header changed since written */
+    t_addr              store;              /* offset of block store */
+    uint8               *buf;               /* copy up buffer */
+    uint32              copyups;            /* blocks copied from the base */
+    };
+
+/* Identify the base container, to detect changes made behind the overlay's back */
+
+static void _disk_overlay_base_id (UNIT *uptr, uint32 *id)
 {
-t_bool r = FALSE;
-AIO_CALLSETUP
-    r = sim_disk_isavailable (uptr);
-AIO_CALL(DOP_IAVL, 0, NULL, NULL, 0, callback);
-return r;
+struct stat statb;
+
+memset (id, 0, 3*sizeof (*id));
+if (stat (uptr->filename, &statb))
+    return;
+id[0] = (uint32)statb.st_size;
+id[1] = (uint32)(((t_uint64)statb.st_size) >> 32);
+id[2] = (uint32)statb.st_mtime;
 }
 
-/* Test for write protect */
+/* Write the header and the block map */
 
-t_bool sim_disk_wrp (UNIT *uptr)
+static t_stat _disk_overlay_write_map (UNIT *uptr)
 {
-return (uptr->flags & DKUF_WRP)? TRUE: FALSE;
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_overlay *ovl = ctx->overlay;
+char name[DISK_OVL_HDR_SIZE - DISK_OVL_NAME];
+
+ovl->hdr[3] = ovl->used;
+memset (name, 0, sizeof (name));
+strncpy (name, uptr->filename, sizeof (name) - 1);
+if ((sim_fseek (ovl->file, 0, SEEK_SET)) ||
+    (fwrite (DISK_OVL_MAGIC, 1, 8, ovl->file) != 8) ||
+    (sim_fwrite (ovl->hdr, sizeof (*ovl->hdr), 7, ovl->file) != 7) ||
+    (sim_fseek (ovl->file, DISK_OVL_NAME, SEEK_SET)) ||
+    (fwrite (name, 1, sizeof (name), ovl->file) != sizeof (name)) ||
+    (sim_fwrite (ovl->map, sizeof (*ovl->map), ovl->blocks, ovl->file) != ovl->blocks))
+    return SCPE_IOERR;
+ovl->dirty = FALSE;
+return SCPE_OK;
 }
 
-/* Get Disk size */
+static t_stat _disk_overlay_flush (UNIT *uptr)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_overlay *ovl = ctx->overlay;
+t_stat r = SCPE_OK;
 
-t_addr sim_disk_size (UNIT *uptr)
+if (ovl->dirty)
+    r = _disk_overlay_write_map (uptr);
+fflush (ovl->file);
+return r;
+}
+
+static void _disk_overlay_close (UNIT *uptr)
 {
-switch (DK_GET_FMT (uptr)) {                            /* case on format */
-    case DKUF_F_STD:                                    /* SIMH format */
-        return sim_fsize_ex (uptr->fileref);
-    case DKUF_F_VHD:                                    /* VHD format */
-        return sim_vhd_disk_size (uptr->fileref);
-        break;
-    case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
-        return sim_os_disk_size_raw (uptr->fileref);
-        break;
-    default:
-        return (t_addr)-1;
-    }
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_overlay *ovl = ctx->overlay;
+
+if (ovl == NULL)
+    return;
+sim_debug (ctx->dbit, ctx->dptr, "_disk_overlay_close(unit=%d)\n", (int)(uptr-ctx->dptr->units));
+_disk_overlay_flush (uptr);
+fclose (ovl->file);
+free (ovl->map);
+free (ovl->buf);
+free (ovl);
+ctx->overlay = NULL;
 }
 
-/* Enable asynchronous operation */
+/* Open (or create) the overlay for a unit whose base container is attached */
 
-t_stat sim_disk_set_async (UNIT *uptr, int latency)
+static t_stat _disk_overlay_open (UNIT *uptr, const char *path, t_bool override)
 {
-#if !defined(SIM_ASYNCH_IO)
-char *msg = "Disk: can't operate asynchronously\r\n";
-printf ("%s", msg);
-if (sim_log) fprintf (sim_log, "%s", msg);
-return SCPE_NOFNC;
-#else
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
-pthread_attr_t attr;
+struct disk_overlay *ovl;
+char magic[8];
+uint32 i, id[3];
 
-sim_debug (ctx->dbit, ctx->dptr, "sim_disk_set_async(unit=%d)\n", (int)(uptr-ctx->dptr->units));
+sim_debug (ctx->dbit, ctx->dptr, "_disk_overlay_open(unit=%d, overlay=%s)\n", (int)(uptr-ctx->dptr->units), path);
 
-ctx->asynch_io = sim_asynch_enabled;
-ctx->asynch_io_latency = latency;
-if (ctx->asynch_io) {
-    pthread_mutex_init (&ctx->io_lock, NULL);
-    pthread_cond_init (&ctx->io_cond, NULL);
-    pthread_cond_init (&ctx->io_done, NULL);
-    pthread_cond_init (&ctx->startup_cond, NULL);
-    pthread_attr_init(&attr);
-    pthread_attr_setscope(&attr, PTHREAD_SCOPE_SYSTEM);
-    pthread_mutex_lock (&ctx->io_lock);
-    pthread_create (&ctx->io_thread, &attr, _disk_io, (void *)uptr);
-    pthread_attr_destroy(&attr);
-    pthread_cond_wait (&ctx->startup_cond, &ctx->io_lock); /* Wait for thread to stabilize */
-    pthread_mutex_unlock (&ctx->io_lock);
-    pthread_cond_destroy (&ctx->startup_cond);
+if (DK_GET_FMT (uptr) != DKUF_F_STD)
+    return SCPE_NOFNC;
+ctx->overlay = ovl = (struct disk_overlay *)calloc (1, sizeof (*ovl));
+if (ovl == NULL)
+    return SCPE_MEM;
+snprintf (ovl->path, sizeof (ovl->path), "%s", path);
+ovl->blksize = DISK_OVL_BLKSECTS * ctx->sector_size;
+ovl->blocks = (uint32)((uptr->capac*ctx->capac_factor + ovl->blksize - 1) / ovl->blksize);
+ovl->store = ((DISK_OVL_HDR_SIZE + ovl->blocks*sizeof (*ovl->map) + DISK_OVL_ALIGN - 1) / DISK_OVL_ALIGN) * DISK_OVL_ALIGN;
+ovl->map = (uint32 *)calloc (ovl->blocks, sizeof (*ovl->map));
+ovl->buf = (uint8 *)malloc (ovl->blksize);
+if ((ovl->map == NULL) || (ovl->buf == NULL)) {
+    _disk_overlay_close (uptr);
+    return SCPE_MEM;
+    }
+_disk_overlay_base_id (uptr, id);
+ovl->file = sim_fopen (path, "rb+");
+if (ovl->file == NULL) {                                /* new overlay */
+    ovl->file = sim_fopen (path, "wb+");
+    if (ovl->file == NULL) {
+        _disk_overlay_close (uptr);
+        return SCPE_OPENERR;
+        }
+    ovl->hdr[0] = ctx->sector_size;
+    ovl->hdr[1] = DISK_OVL_BLKSECTS;
+    ovl->hdr[2] = ovl->blocks;
+    memcpy (&ovl->hdr[4], id, sizeof (id));
+    if (_disk_overlay_write_map (uptr) != SCPE_OK) {
+        _disk_overlay_close (uptr);
+        remove (path);
+        return SCPE_OPENERR;
+        }
+    return SCPE_OK;
+    }
+if ((fread (magic, 1, sizeof (magic), ovl->file) != sizeof (magic)) ||
+    (memcmp (magic, DISK_OVL_MAGIC, sizeof (magic))) ||
+    (sim_fread (ovl->hdr, sizeof (*ovl->hdr), 7, ovl->file) != 7) ||
+    (ovl->hdr[0] != ctx->sector_size) ||
+    (ovl->hdr[1] != DISK_OVL_BLKSECTS) ||
+    (ovl->hdr[2] != ovl->blocks) ||
+    (sim_fseek (ovl->file, DISK_OVL_HDR_SIZE, SEEK_SET)) ||
+    (sim_fread (ovl->map, sizeof (*ovl->map), ovl->blocks, ovl->file) != ovl->blocks)) {
+    if (!sim_quiet)
+        printf ("%s%d: '%s' is not an overlay for this drive\n", sim_dname (ctx->dptr), (int)(uptr-ctx->dptr->units), path);
+    _disk_overlay_close (uptr);
+    return SCPE_OPENERR;
+    }
+ovl->used = ovl->hdr[3];
+for (i = 0; i < ovl->blocks; i++)
+    if (ovl->map[i] > ovl->used) {
+        _disk_overlay_close (uptr);
+        return SCPE_OPENERR;
+        }
+if (memcmp (&ovl->hdr[4], id, sizeof (id))) {
+    if (!override) {
+        if (!sim_quiet)
+            printf ("%s%d: base '%s' has changed since overlay '%s' was written\n", sim_dname (ctx->dptr), (int)(uptr-ctx->dptr->units), uptr->filename, path);
+        _disk_overlay_close (uptr);
+        return SCPE_OPENERR;
+        }
+    memcpy (&ovl->hdr[4], id, sizeof (id));
+    ovl->dirty = TRUE;
     }
-uptr->a_check_completion = _disk_completion_dispatch;
-uptr->a_is_active = _disk_is_active;
-uptr->a_cancel = _disk_cancel;
-#endif
 return SCPE_OK;
 }
 
-/* Disable asynchronous operation */
+/* Transfer sectors through the overlay */
 
-t_stat sim_disk_clr_async (UNIT *uptr)
+static t_stat _disk_overlay_rw (UNIT *uptr, t_bool write, t_lba lba, uint8 *buf, t_seccnt *sectsxfered, t_seccnt sects)
 {
-#if !defined(SIM_ASYNCH_IO)
-return SCPE_NOFNC;
-#else
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_overlay *ovl = ctx->overlay;
+uint32 elem = ctx->xfer_element_size;
+t_seccnt done = 0;
+
+if (sectsxfered)
+    *sectsxfered = 0;
+while (done < sects) {
+    uint32 block = (lba + done) / DISK_OVL_BLKSECTS;
+    uint32 offset = ((lba + done) % DISK_OVL_BLKSECTS) * ctx->sector_size;
+    t_seccnt count = DISK_OVL_BLKSECTS - (lba + done) % DISK_OVL_BLKSECTS;
+    uint8 *data = buf + done * ctx->sector_size;
+    size_t tbc, i;
+
+    if (count > sects - done)
+        count = sects - done;
+    tbc = count * ctx->sector_size;
+    if (block >= ovl->blocks)                           /* beyond the drive */
+        return SCPE_IOERR;
+    if (ovl->map[block]) {                              /* block in the store */
+        if (sim_fseek (ovl->file, ovl->store + ((t_addr)(ovl->map[block] - 1)) * ovl->blksize + offset, SEEK_SET))
+            return SCPE_IOERR;
+        if (write)
+            i = sim_fwrite (data, elem, tbc / elem, ovl->file);
+        else
+            i = sim_fread (data, elem, tbc / elem, ovl->file);
+        if (i < tbc / elem) {
+            if (write || ferror (ovl->file))
+                return SCPE_IOERR;
+            memset (&data[i * elem], 0, tbc - i * elem);
+            }
+        }
+    else if (!write) {                                  /* unwritten block comes from the base */
+        if (sim_fseek (uptr->fileref, ((t_addr)block) * ovl->blksize + offset, SEEK_SET))
+            return SCPE_IOERR;
+        i = sim_fread (data, elem, tbc / elem, uptr->fileref);
+        if (ferror (uptr->fileref))
+            return SCPE_IOERR;
+        if (i < tbc / elem)                             /* fill */
+            memset (&data[i * elem], 0, tbc - i * elem);
+        }
+    else {                                              /* first write copies the block up */
+        i = 0;
+        if (tbc < ovl->blksize) {
+            if (sim_fseek (uptr->fileref, ((t_addr)block) * ovl->blksize, SEEK_SET))
+                return SCPE_IOERR;
+            i = fread (ovl->buf, 1, ovl->blksize, uptr->fileref);
+            if (ferror (uptr->fileref))
+                return SCPE_IOERR;
+            }
+        memset (ovl->buf + i, 0, ovl->blksize - i);
+        sim_buf_copy_swapped (ovl->buf + offset, data, elem, tbc / elem);
+        if ((sim_fseek (ovl->file, ovl->store + ((t_addr)ovl->used) * ovl->blksize, SEEK_SET)) ||
+            (fwrite (ovl->buf, 1, ovl->blksize, ovl->file) != ovl->blksize))
+            return SCPE_IOERR;
+        ovl->map[block] = ++ovl->used;
+        ovl->dirty = TRUE;
+        ++ovl->copyups;
+        }
+    done += count;
+    if (sectsxfered)
+        *sectsxfered = done;
+    }
+return SCPE_OK;
+}
 
-/* make sure device exists */
-if (!ctx) return SCPE_UNATT;
+/* Write the stored blocks into the base container */
 
-sim_debug (ctx->dbit, ctx->dptr, "sim_disk_clr_async(unit=%d)\n", (int)(uptr-ctx->dptr->units));
+static t_stat _disk_overlay_commit (UNIT *uptr)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_overlay *ovl = ctx->overlay;
+t_addr capac = uptr->capac*ctx->capac_factor;
+FILE *base, *rbase;
+uint32 block;
+t_stat r = SCPE_OK;
 
-if (ctx->asynch_io) {
-    pthread_mutex_lock (&ctx->io_lock);
-    ctx->asynch_io = 0;
-    pthread_cond_signal (&ctx->io_cond);
-    pthread_mutex_unlock (&ctx->io_lock);
-    pthread_join (ctx->io_thread, NULL);
-    pthread_mutex_destroy (&ctx->io_lock);
-    pthread_cond_destroy (&ctx->io_cond);
-    pthread_cond_destroy (&ctx->io_done);
+sim_debug (ctx->dbit, ctx->dptr, "_disk_overlay_commit(unit=%d, blocks=%u)\n", (int)(uptr-ctx->dptr->units), ovl->used);
+
+base = sim_fopen (uptr->filename, "rb+");
+if (base == NULL)
+    return SCPE_RO;
+for (block = 0; (block < ovl->blocks) && (r == SCPE_OK); block++) {
+    t_addr da = ((t_addr)block) * ovl->blksize;
+    size_t tbc = ovl->blksize;
+
+    if (ovl->map[block] == 0)
+        continue;
+    if (da + tbc > capac)
+        tbc = (size_t)(capac - da);
+    if ((sim_fseek (ovl->file, ovl->store + ((t_addr)(ovl->map[block] - 1)) * ovl->blksize, SEEK_SET)) ||
+        (fread (ovl->buf, 1, tbc, ovl->file) != tbc) ||
+        (sim_fseek (base, da, SEEK_SET)) ||
+        (fwrite (ovl->buf, 1, tbc, base) != tbc))
+        r = SCPE_IOERR;
     }
-return SCPE_OK;
-#endif
+if ((fclose (base) == EOF) && (r == SCPE_OK))
+    r = SCPE_IOERR;
+if (r != SCPE_OK)                                       /* overlay is still intact */
+    return r;
+rbase = sim_fopen (uptr->filename, "rb");               /* don't read through stale buffers */
+if (rbase == NULL)
+    return SCPE_OPENERR;
+fclose (uptr->fileref);
+uptr->fileref = rbase;
+_disk_overlay_base_id (uptr, &ovl->hdr[4]);             /* the base changed under the overlay */
+return _disk_overlay_write_map (uptr);
 }
 
-/* Read Sectors */
+/* Empty the overlay */
 
-static t_stat _sim_disk_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects)
+static t_stat _disk_overlay_discard (UNIT *uptr)
 {
-t_addr da;
-uint32 err, tbc;
-size_t i;
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_overlay *ovl = ctx->overlay;
+FILE *file;
+
+sim_debug (ctx->dbit, ctx->dptr, "_disk_overlay_discard(unit=%d)\n", (int)(uptr-ctx->dptr->units));
+
+file = sim_fopen (ovl->path, "wb+");                    /* truncate the block store */
+if (file == NULL)
+    return SCPE_OPENERR;
+fclose (ovl->file);
+ovl->file = file;
+memset (ovl->map, 0, ovl->blocks*sizeof (*ovl->map));
+ovl->used = 0;
+_disk_overlay_base_id (uptr, &ovl->hdr[4]);
+return _disk_overlay_write_map (uptr);
+}
 
-sim_debug (ctx->dbit, ctx->dptr, "_sim_disk_rdsect(unit=%d, lba=0x%X, sects=%d)\n", (int)(uptr-ctx->dptr->units), lba, sects);
+#if defined SIM_ASYNCH_IO
+#define AIO_CALLSETUP                                               \
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;   \
+                                                                    \
+if ((!callback) || !ctx->asynch_io)
 
-da = ((t_addr)lba) * ctx->sector_size;
-tbc = sects * ctx->sector_size;
-if (sectsread)
-    *sectsread = 0;
-err = sim_fseek (uptr->fileref, da, SEEK_SET);          /* set pos */
-if (!err) {
-    i = sim_fread (buf, ctx->xfer_element_size, tbc/ctx->xfer_element_size, uptr->fileref);
-    if (i < tbc/ctx->xfer_element_size)                 /* fill */
-        memset (&buf[i*ctx->xfer_element_size], 0, tbc-(i*ctx->xfer_element_size));
-    err = ferror (uptr->fileref);
-    if ((!err) && (sectsread))
-        *sectsread = (t_seccnt)((i*ctx->xfer_element_size+ctx->sector_size-1)/ctx->sector_size);
+#define AIO_CALL(op, _lba, _buf, _sg, _nsg, _rsects, _sects,  _callback) \
+    if (ctx->asynch_io) {                                       \
+        struct disk_context *ctx =                              \
+                      (struct disk_context *)uptr->disk_ctx;    \
+                                                                \
+        struct disk_request *req;                               \
+                                                                \
+        pthread_mutex_lock (&ctx->io_lock);                     \
+                                                                \
+        sim_debug (ctx->dbit, ctx->dptr,                        \
+      "sim_disk AIO_CALL(op=%d, unit=%d, lba=0x%X, sects=%d)\n",\
+                op, (int)(uptr-ctx->dptr->units), _lba, _sects);\
+                                                                \
+        if ((ctx->req_submitted - ctx->req_delivered) >=        \
+            ctx->queue_depth)                                   \
+            abort(); /* horrible mistake, stop */               \
+        req = &ctx->req[ctx->req_submitted % DISK_MAX_QDEPTH];  \
+        req->dop = op;                                          \
+        req->lba = _lba;                                        \
+        req->buf = _buf;                                        \
+        req->sg = _sg;                                          \
+        req->nsg = _nsg;                                        \
+        req->sects = _sects;                                    \
+        req->rsects = _rsects;                                  \
+        req->callback = _callback;                              \
+        req->done = FALSE;                                      \
+        ++ctx->req_submitted;                                   \
+        AIO_INFLIGHT_ADJUST (1);                                \
+        pthread_cond_signal (&ctx->io_cond);                    \
+        pthread_mutex_unlock (&ctx->io_lock);                   \
+        }                                                       \
+    else                                                        \
+        if (_callback)                                          \
+            (_callback) (uptr, r);
+
+
+#define DOP_DONE  0             /* no operation */
+#define DOP_RSEC  1             /* sim_disk_rdsect_a */
+#define DOP_WSEC  2             /* sim_disk_wrsect_a */
+#define DOP_IAVL  3             /* sim_disk_isavailable_a */
+#define DOP_RSG   4             /* sim_disk_rdsect_sg_a */
+#define DOP_WSG   5             /* sim_disk_wrsect_sg_a */
+
+#if defined (HAVE_IO_URING)
+/* Count the queued requests, starting with the oldest one not yet started, 
+   which can be handed to io_uring in one submission.  These are sector 
+   transfers which don't overlap a write ahead of them in the batch and, 
+   if they are writes, don't overlap any transfer ahead of them.  Called 
+   with io_lock held. */
+static uint32 _disk_uring_batch_size (UNIT *uptr)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+t_lba capac_sects = (t_lba)((uptr->capac*ctx->capac_factor)/ctx->sector_size);
+uint32 n, i;
+
+for (n = 0; (n < DISK_URING_ENTRIES) && ((ctx->req_started + n) != ctx->req_submitted); n++) {
+    struct disk_request *req = &ctx->req[(ctx->req_started + n) % DISK_MAX_QDEPTH];
+
+    if ((req->dop != DOP_RSEC) && (req->dop != DOP_WSEC))
+        break;
+    if ((req->dop == DOP_RSEC) && (req->sects == 1) && (req->lba >= capac_sects))
+        break;                                          /* bad block probe */
+    if ((DK_GET_FMT (uptr) == DKUF_F_RAW) &&            /* partial storage sectors? */
+        (0 != (ctx->sector_size & (ctx->storage_sector_size - 1))) &&
+        ((0 != ((req->lba*ctx->sector_size) & (ctx->storage_sector_size - 1))) ||
+         (0 != ((req->sects*ctx->sector_size) & (ctx->storage_sector_size - 1)))))
+        break;
+    for (i = 0; i < n; i++) {
+        struct disk_request *prev = &ctx->req[(ctx->req_started + i) % DISK_MAX_QDEPTH];
+
+        if (((req->dop == DOP_WSEC) || (prev->dop == DOP_WSEC)) &&
+            (req->lba < prev->lba + prev->sects) && 
+            (prev->lba < req->lba + req->sects))
+            break;
+        }
+    if (i < n)                                          /* ordering matters? */
+        break;
     }
-return err;
+return n;
 }
 
-t_stat sim_disk_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects)
+/* Perform n queued requests, starting at first, with one submission */
+
+static void _disk_uring_requests (UNIT *uptr, uint32 first, uint32 n)
 {
-t_stat r;
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
-t_seccnt sread;
+struct disk_uring_xfer x[DISK_URING_ENTRIES];
+uint32 i;
 
-sim_debug (ctx->dbit, ctx->dptr, "sim_disk_rdsect(unit=%d, lba=0x%X, sects=%d)\n", (int)(uptr-ctx->dptr->units), lba, sects);
+sim_debug (ctx->dbit, ctx->dptr, "_disk_uring_requests(unit=%d, requests=%d)\n", (int)(uptr-ctx->dptr->units), n);
 
-if ((sects == 1) &&                                     /* Single sector reads */
-    (lba >= (uptr->capac*ctx->capac_factor)/ctx->sector_size)) {/* beyond the end of the disk */
-    memset (buf, '\0', ctx->sector_size);               /* are bad block management efforts - zero buffer */
-    if (sectsread)
-        *sectsread = 1;
-    return SCPE_OK;                                     /* return success */
+for (i = 0; i < n; i++) {
+    struct disk_request *req = &ctx->req[(first + i) % DISK_MAX_QDEPTH];
+
+    x[i].write = (req->dop == DOP_WSEC);
+    x[i].lba = req->lba;
+    x[i].buf = req->buf;
+    x[i].sects = req->sects;
+    x[i].element_size = ctx->xfer_element_size;
     }
+_disk_uring_transfer (uptr, x, (int)n);
+for (i = 0; i < n; i++) {
+    struct disk_request *req = &ctx->req[(first + i) % DISK_MAX_QDEPTH];
 
-if ((0 == (ctx->sector_size & (ctx->storage_sector_size - 1))) ||   /* Sector Aligned & whole sector transfers */
-    ((0 == ((lba*ctx->sector_size) & (ctx->storage_sector_size - 1))) &&
-     (0 == ((sects*ctx->sector_size) & (ctx->storage_sector_size - 1))))) {
-    switch (DK_GET_FMT (uptr)) {                        /* case on format */
-        case DKUF_F_STD:                                /* SIMH format */
-            return _sim_disk_rdsect (uptr, lba, buf, sectsread, sects);
-        case DKUF_F_VHD:                                /* VHD format */
-            r = sim_vhd_disk_rdsect (uptr, lba, buf, &sread, sects);
-            break;
-        case DKUF_F_RAW:                                /* Raw Physical Disk Access */
-            r = sim_os_disk_rdsect (uptr, lba, buf, &sread, sects);
-            break;
-        default:
-            return SCPE_NOFNC;
-        }
-    if (sectsread)
-        *sectsread = sread;
-    if (r != SCPE_OK)
-        return r;
-    sim_buf_swap_data (buf, ctx->xfer_element_size, (sread * ctx->sector_size) / ctx->xfer_element_size);
-    return r;
-    }
-else { /* Unaligned and/or partial sector transfers */
-    uint8 *tbuf = (uint8*) malloc (sects*ctx->sector_size + 2*ctx->storage_sector_size);
-    t_lba sspsts = ctx->storage_sector_size/ctx->sector_size; /* sim sectors in a storage sector */
-    t_lba tlba = lba & ~(sspsts - 1);
-    t_seccnt tsects = sects + (lba - tlba);
-
-    tsects = (tsects + (sspsts - 1)) & ~(sspsts - 1);
-    if (sectsread)
-        *sectsread = 0;
-    if (tbuf == NULL)
-        return SCPE_MEM;
-    switch (DK_GET_FMT (uptr)) {                        /* case on format */
-        case DKUF_F_STD:                                /* SIMH format */
-            r = _sim_disk_rdsect (uptr, tlba, tbuf, &sread, tsects);
-            break;
-        case DKUF_F_VHD:                                /* VHD format */
-            r = sim_vhd_disk_rdsect (uptr, tlba, tbuf, &sread, tsects);
-            if (r == SCPE_OK)
-                sim_buf_swap_data (tbuf, ctx->xfer_element_size, (sread * ctx->sector_size) / ctx->xfer_element_size);
-            break;
-        case DKUF_F_RAW:                                /* Raw Physical Disk Access */
-            r = sim_os_disk_rdsect (uptr, tlba, tbuf, &sread, tsects);
-            if (r == SCPE_OK)
-                sim_buf_swap_data (tbuf, ctx->xfer_element_size, (sread * ctx->sector_size) / ctx->xfer_element_size);
-            break;
-        default:
-            free (tbuf);
-            return SCPE_NOFNC;
-        }
-    if (r == SCPE_OK) {
-        memcpy (buf, tbuf + ((lba - tlba) * ctx->sector_size), sects * ctx->sector_size);
-        if (sectsread) {
-            *sectsread = sread - (lba - tlba);
-            if (*sectsread > sects)
-                *sectsread = sects;
-            }
-        }
-    free (tbuf);
-    return r;
-    }
-}
-
-t_stat sim_disk_rdsect_a (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects, DISK_PCALLBACK callback)
-{
-t_stat r = SCPE_OK;
-AIO_CALLSETUP
-    r = sim_disk_rdsect (uptr, lba, buf, sectsread, sects);
-AIO_CALL(DOP_RSEC, lba, buf, sectsread, sects, callback);
-return r;
-}
-
-/* Write Sectors */
-
-static t_stat _sim_disk_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects)
-{
-t_addr da;
-uint32 err, tbc;
-size_t i;
-struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
-
-sim_debug (ctx->dbit, ctx->dptr, "_sim_disk_wrsect(unit=%d, lba=0x%X, sects=%d)\n", (int)(uptr-ctx->dptr->units), lba, sects);
-
-da = ((t_addr)lba) * ctx->sector_size;
-tbc = sects * ctx->sector_size;
-if (sectswritten)
-    *sectswritten = 0;
-err = sim_fseek (uptr->fileref, da, SEEK_SET);          /* set pos */
-if (!err) {
-    i = sim_fwrite (buf, ctx->xfer_element_size, tbc/ctx->xfer_element_size, uptr->fileref);
-    err = ferror (uptr->fileref);
-    if ((!err) && (sectswritten))
-        *sectswritten = (t_seccnt)((i*ctx->xfer_element_size+ctx->sector_size-1)/ctx->sector_size);
+    req->io_status = x[i].status;
+    if (req->rsects)
+        *req->rsects = (x[i].status == SCPE_OK) ? (t_seccnt)((x[i].xfered + ctx->sector_size - 1) / ctx->sector_size) : 0;
     }
-return err;
 }
+#endif
 
-t_stat sim_disk_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects)
+static void *
+_disk_io(void *arg)
 {
+UNIT* volatile uptr = (UNIT*)arg;
+int sched_policy;
+struct sched_param sched_priority;
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
-uint32 f = DK_GET_FMT (uptr);
-t_stat r;
-uint8 *tbuf = NULL;
-
-sim_debug (ctx->dbit, ctx->dptr, "sim_disk_wrsect(unit=%d, lba=0x%X, sects=%d)\n", (int)(uptr-ctx->dptr->units), lba, sects);
 
-if (f == DKUF_F_STD)
-    return _sim_disk_wrsect (uptr, lba, buf, sectswritten, sects);
-if ((0 == (ctx->sector_size & (ctx->storage_sector_size - 1))) ||   /* Sector Aligned & whole sector transfers */
-    ((0 == ((lba*ctx->sector_size) & (ctx->storage_sector_size - 1))) &&
-     (0 == ((sects*ctx->sector_size) & (ctx->storage_sector_size - 1))))) {
+/* Boost Priority for this I/O thread vs the CPU instruction execution 
+   thread which in general won't be readily yielding the processor when 
+   this thread needs to run */
+pthread_getschedparam (pthread_self(), &sched_policy, &sched_priority);
+++sched_priority.sched_priority;
+pthread_setschedparam (pthread_self(), sched_policy, &sched_priority);
 
-    if (sim_end || (ctx->xfer_element_size == sizeof (char)))
-        switch (DK_GET_FMT (uptr)) {                            /* case on format */
-            case DKUF_F_VHD:                                    /* VHD format */
-                return sim_vhd_disk_wrsect  (uptr, lba, buf, sectswritten, sects);
-            case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
-                return sim_os_disk_wrsect  (uptr, lba, buf, sectswritten, sects);
-            default:
-                return SCPE_NOFNC;
-            }
+sim_debug (ctx->dbit, ctx->dptr, "_disk_io(unit=%d) starting\n", (int)(uptr-ctx->dptr->units));
 
-    tbuf = (uint8*) malloc (sects * ctx->sector_size);
-    if (NULL == tbuf)
-        return SCPE_MEM;
-    sim_buf_copy_swapped (tbuf, buf, ctx->xfer_element_size, (sects * ctx->sector_size) / ctx->xfer_element_size);
+pthread_mutex_lock (&ctx->io_lock);
+pthread_cond_signal (&ctx->startup_cond);   /* Signal we're ready to go */
+while (1) {
+    struct disk_request *req;
 
-    switch (DK_GET_FMT (uptr)) {                            /* case on format */
-        case DKUF_F_VHD:                                    /* VHD format */
-            r = sim_vhd_disk_wrsect (uptr, lba, tbuf, sectswritten, sects);
-            break;
-        case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
-            r = sim_os_disk_wrsect (uptr, lba, tbuf, sectswritten, sects);
-            break;
-        default:
-            r = SCPE_NOFNC;
+    if (ctx->req_started == ctx->req_submitted) {   /* nothing queued? */
+        if (!ctx->asynch_io)
             break;
+        pthread_cond_wait (&ctx->io_cond, &ctx->io_lock);
+        continue;
         }
-    }
-else { /* Unaligned and/or partial sector transfers */
-    t_lba sspsts = ctx->storage_sector_size/ctx->sector_size; /* sim sectors in a storage sector */
-    t_lba tlba = lba & ~(sspsts - 1);
-    t_seccnt tsects = sects + (lba - tlba);
-
-    tbuf = (uint8*) malloc (sects*ctx->sector_size + 2*ctx->storage_sector_size);
-    tsects = (tsects + (sspsts - 1)) & ~(sspsts - 1);
-    if (sectswritten)
-        *sectswritten = 0;
-    if (tbuf == NULL)
-        return SCPE_MEM;
-    /* Partial Sector writes require a read-modify-write sequence for the partial sectors */
-    if ((lba & (sspsts - 1)) ||
-        (sects < sspsts))
-        switch (DK_GET_FMT (uptr)) {                            /* case on format */
-            case DKUF_F_VHD:                                    /* VHD format */
-                sim_vhd_disk_rdsect (uptr, tlba, tbuf, NULL, sspsts);
-                break;
-            case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
-                sim_os_disk_rdsect (uptr, tlba, tbuf, NULL, sspsts);
-                break;
-            default:
-                r = SCPE_NOFNC;
-                break;
-            }
-    if ((tsects > sspsts) &&
-        ((sects + lba - tlba) & (sspsts - 1)))
-        switch (DK_GET_FMT (uptr)) {                            /* case on format */
-            case DKUF_F_VHD:                                    /* VHD format */
-                sim_vhd_disk_rdsect (uptr, tlba + tsects - sspsts, 
-                                     tbuf + (tsects - sspsts) * ctx->sector_size, 
-                                     NULL, sspsts);
-                break;
-            case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
-                sim_os_disk_rdsect (uptr, tlba + tsects - sspsts, 
-                                    tbuf + (tsects - sspsts) * ctx->sector_size, 
-                                    NULL, sspsts);
-                break;
-            default:
-                r = SCPE_NOFNC;
-                break;
+#if defined (HAVE_IO_URING)
+    if (ctx->uring && (ctx->cache == NULL) && ((ctx->req_submitted - ctx->req_started) > 1)) {
+        uint32 first = ctx->req_started;
+        uint32 i, n = _disk_uring_batch_size (uptr);
+
+        if (n > 1) {                                    /* several can go at once? */
+            ctx->req_started += n;
+            pthread_mutex_unlock (&ctx->io_lock);
+            _disk_uring_requests (uptr, first, n);
+            pthread_mutex_lock (&ctx->io_lock);
+            for (i = 0; i < n; i++)
+                ctx->req[(first + i) % DISK_MAX_QDEPTH].done = TRUE;
+            ctx->req_completed += n;
+            pthread_cond_broadcast (&ctx->io_done);
+            sim_activate (uptr, ctx->asynch_io_latency);
+            AIO_INFLIGHT_ADJUST (-(int32)n);
+            continue;
             }
-    sim_buf_copy_swapped (tbuf + (lba & (sspsts - 1)) * ctx->sector_size, 
-                          buf, ctx->xfer_element_size, (sects * ctx->sector_size) / ctx->xfer_element_size);
-    switch (DK_GET_FMT (uptr)) {                            /* case on format */
-        case DKUF_F_VHD:                                    /* VHD format */
-            r = sim_vhd_disk_wrsect (uptr, tlba, tbuf, sectswritten, tsects);
+        }
+#endif
+    req = &ctx->req[ctx->req_started % DISK_MAX_QDEPTH];
+    ++ctx->req_started;
+    pthread_mutex_unlock (&ctx->io_lock);
+    switch (req->dop) {
+        case DOP_RSEC:
+            req->io_status = sim_disk_rdsect (uptr, req->lba, req->buf, req->rsects, req->sects);
             break;
-        case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
-            r = sim_os_disk_wrsect (uptr, tlba, tbuf, sectswritten, tsects);
+        case DOP_WSEC:
+            req->io_status = sim_disk_wrsect (uptr, req->lba, req->buf, req->rsects, req->sects);
             break;
-        default:
-            r = SCPE_NOFNC;
+        case DOP_IAVL:
+            req->io_status = sim_disk_isavailable (uptr);
+            break;
+        case DOP_RSG:
+            req->io_status = sim_disk_rdsect_sg (uptr, req->lba, req->sg, req->nsg, req->rsects, req->sects);
+            break;
+        case DOP_WSG:
+            req->io_status = sim_disk_wrsect_sg (uptr, req->lba, req->sg, req->nsg, req->rsects, req->sects);
             break;
         }
-    if ((r == SCPE_OK) && sectswritten) {
-        *sectswritten -= (lba - tlba);
-        if (*sectswritten > sects)
-            *sectswritten = sects;
-        }
+    pthread_mutex_lock (&ctx->io_lock);
+    req->done = TRUE;
+    ++ctx->req_completed;
+    pthread_cond_broadcast (&ctx->io_done);
+    sim_activate (uptr, ctx->asynch_io_latency);
+    AIO_INFLIGHT_ADJUST (-1);
     }
-free (tbuf);
-return r;
-}
+pthread_mutex_unlock (&ctx->io_lock);
 
-t_stat sim_disk_wrsect_a (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects, DISK_PCALLBACK callback)
-{
-t_stat r = SCPE_OK;
-AIO_CALLSETUP
-    r =  sim_disk_wrsect (uptr, lba, buf, sectswritten, sects);
-AIO_CALL(DOP_WSEC, lba, buf, sectswritten, sects, callback);
-return r;
+sim_debug (ctx->dbit, ctx->dptr, "_disk_io(unit=%d) exiting\n", (int)(uptr-ctx->dptr->units));
+
+return NULL;
 }
 
-t_stat sim_disk_unload (UNIT *uptr)
+/* This routine is called in the context of the main simulator thread before 
+   processing events for any unit. It is only called when an asynchronous 
+   thread has called sim_activate() to activate a unit.  The job of this 
+   routine is to put the unit in proper condition to digest what may have
+   occurred in the asynchrconous thread.
+   
+   A unit may have up to queue_depth requests outstanding.  When several 
+   I/O threads serve a unit, requests may complete in any order, but their 
+   callbacks are always delivered in the order the requests were issued 
+   so that a device can match each callback to the request it made. */
+static void _disk_completion_dispatch (UNIT *uptr)
 {
-switch (DK_GET_FMT (uptr)) {                            /* case on format */
-    case DKUF_F_STD:                                    /* Simh */
-    case DKUF_F_VHD:                                    /* VHD format */
-        return sim_disk_detach (uptr);
-    case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
-        return sim_os_disk_unload_raw (uptr->fileref);  /* remove/eject disk */
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+
+sim_debug (ctx->dbit, ctx->dptr, "_disk_completion_dispatch(unit=%d, outstanding=%d)\n", (int)(uptr-ctx->dptr->units), ctx->req_submitted - ctx->req_delivered);
+
+pthread_mutex_lock (&ctx->io_lock);
+while (ctx->req_delivered != ctx->req_submitted) {
+    struct disk_request *req = &ctx->req[ctx->req_delivered % DISK_MAX_QDEPTH];
+    DISK_PCALLBACK callback = req->callback;
+    t_stat status = req->io_status;
+
+    if (!req->done)                                     /* oldest still in progress? */
         break;
-    default:
-        return SCPE_NOFNC;
+    req->done = FALSE;
+    req->callback = NULL;
+    ++ctx->req_delivered;
+    pthread_mutex_unlock (&ctx->io_lock);
+    if (callback)
+        callback (uptr, status);
+    pthread_mutex_lock (&ctx->io_lock);
     }
+pthread_mutex_unlock (&ctx->io_lock);
 }
 
-/* 
-   This routine is called when the simulator stops and any time
-   the asynch mode is changed (enabled or disabled)
-*/
-static void _sim_disk_io_flush (UNIT *uptr)
+static t_bool _disk_is_active (UNIT *uptr)
 {
-uint32 f = DK_GET_FMT (uptr);
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
 
-#if defined (SIM_ASYNCH_IO)
+if (ctx) {
+    sim_debug (ctx->dbit, ctx->dptr, "_disk_is_active(unit=%d, in progress=%d)\n", uptr-ctx->dptr->units, ctx->req_submitted - ctx->req_completed);
+    return (ctx->req_completed != ctx->req_submitted);
+    }
+return FALSE;
+}
+
+static void _disk_cancel (UNIT *uptr)
+{
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
 
-sim_disk_clr_async (uptr);
-if (sim_asynch_enabled)
+if (ctx) {
+    sim_debug (ctx->dbit, ctx->dptr, "_disk_cancel(unit=%d, in progress=%d)\n", uptr-ctx->dptr->units, ctx->req_submitted - ctx->req_completed);
+    if (ctx->asynch_io) {
+        pthread_mutex_lock (&ctx->io_lock);
+        while (ctx->req_completed != ctx->req_submitted)
+            pthread_cond_wait (&ctx->io_done, &ctx->io_lock);
+        pthread_mutex_unlock (&ctx->io_lock);
+        }
+    }
+}
+#else
+#define AIO_CALLSETUP
+#define AIO_CALL(op, _lba, _buf, _sg, _nsg, _rsects, _sects,  _callback) \
+    if (_callback)                                              \
+        (_callback) (uptr, r);
+#endif
+
+/* Forward declarations */
+
+static t_stat sim_vhd_disk_implemented (void);
+static FILE *sim_vhd_disk_open (const char *rawdevicename, const char *openmode);
+static FILE *sim_vhd_disk_create (const char *szVHDPath, t_addr desiredsize);
+static FILE *sim_vhd_disk_create_diff (const char *szVHDPath, const char *szParentVHDPath);
+static FILE *sim_vhd_disk_merge (const char *szVHDPath, char **ParentVHD);
+static int sim_vhd_disk_close (FILE *f);
+static void sim_vhd_disk_flush (FILE *f);
+static t_addr sim_vhd_disk_size (FILE *f);
+static t_stat sim_vhd_disk_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects);
+static t_stat sim_vhd_disk_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects);
+static t_stat sim_vhd_disk_clearerr (UNIT *uptr);
+static t_stat sim_vhd_disk_set_dtype (FILE *f, const char *dtype);
+static const char *sim_vhd_disk_get_dtype (FILE *f);
+static t_stat sim_dedup_disk_implemented (void);
+static t_bool sim_dedup_disk_probe (const char *filename);
+static FILE *sim_dedup_disk_open (const char *filename, const char *openmode);
+static FILE *sim_dedup_disk_create (const char *filename, t_addr desiredsize);
+static int sim_dedup_disk_close (FILE *f);
+static void sim_dedup_disk_flush (FILE *f);
+static t_addr sim_dedup_disk_size (FILE *f);
+static t_stat sim_dedup_disk_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects);
+static t_stat sim_dedup_disk_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects);
+static t_stat sim_dedup_disk_clearerr (UNIT *uptr);
+static t_stat sim_dedup_disk_set_dtype (FILE *f, const char *dtype);
+static const char *sim_dedup_disk_get_dtype (FILE *f);
+static void sim_dedup_disk_info (FILE *st, FILE *f);
+static t_stat sim_os_disk_implemented_raw (void);
+static FILE *sim_os_disk_open_raw (const char *rawdevicename, const char *openmode);
+static int sim_os_disk_close_raw (FILE *f);
+static void sim_os_disk_flush_raw (FILE *f);
+static t_addr sim_os_disk_size_raw (FILE *f);
+static t_stat sim_os_disk_unload_raw (FILE *f);
+static t_bool sim_os_disk_isavailable_raw (FILE *f);
+static t_stat sim_os_disk_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects);
+static t_stat sim_os_disk_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects);
+static t_stat sim_os_disk_info_raw (FILE *f, uint32 *sector_size, uint32 *removable);
+static t_stat sim_disk_pdp11_bad_block (UNIT *uptr, int32 sec);
+static char *HostPathToVhdPath (const char *szHostPath, char *szVhdPath, size_t VhdPathSize);
+static char *VhdPathToHostPath (const char *szVhdPath, char *szHostPath, size_t HostPathSize);
+
+struct sim_disk_fmt {
+    char                *name;                          /* name */
+    int32               uflags;                         /* unit flags */
+    int32               fmtval;                         /* Format type value */
+    t_stat              (*impl_fnc)(void);              /* Implemented Test Function */
+    };
+
+static struct sim_disk_fmt fmts[DKUF_N_FMT] = {
+    { "SIMH", 0, DKUF_F_STD, NULL},
+    { "RAW",  0, DKUF_F_RAW, sim_os_disk_implemented_raw},
+    { "VHD",  0, DKUF_F_VHD, sim_vhd_disk_implemented},
+    { "DEDUP",0, DKUF_F_DDC, sim_dedup_disk_implemented},
+    { NULL,   0, 0}
+    };
+
+/* Set disk format */
+
+t_stat sim_disk_set_fmt (UNIT *uptr, int32 val, char *cptr, void *desc)
+{
+uint32 f;
+
+if (uptr == NULL)
+    return SCPE_IERR;
+if (cptr == NULL)
+    return SCPE_ARG;
+for (f = 0; f < DKUF_N_FMT && fmts[f].name; f++) {
+    if (fmts[f].name && (strcmp (cptr, fmts[f].name) == 0)) {
+        if ((fmts[f].impl_fnc) && (fmts[f].impl_fnc() != SCPE_OK))
+            return SCPE_NOFNC;
+        uptr->flags = (uptr->flags & ~DKUF_FMT) |
+            (fmts[f].fmtval << DKUF_V_FMT) | fmts[f].uflags;
+        return SCPE_OK;
+        }
+    }
+return SCPE_ARG;
+}
+
+/* Show disk format */
+
+t_stat sim_disk_show_fmt (FILE *st, UNIT *uptr, int32 val, void *desc)
+{
+int32 f = DK_GET_FMT (uptr);
+size_t i;
+
+for (i = 0; i < DKUF_N_FMT; i++)
+    if (fmts[i].fmtval == f) {
+        fprintf (st, "%s format", fmts[i].name);
+        return SCPE_OK;
+        }
+fprintf (st, "invalid format");
+return SCPE_OK;
+}
+
+/* Set disk capacity */
+
+t_stat sim_disk_set_capac (UNIT *uptr, int32 val, char *cptr, void *desc)
+{
+t_addr cap;
+t_stat r;
+
+if ((cptr == NULL) || (*cptr == 0))
+    return SCPE_ARG;
+if (uptr->flags & UNIT_ATT)
+    return SCPE_ALATT;
+cap = (t_addr) get_uint (cptr, 10, sim_taddr_64? 2000000: 2000, &r);
+if (r != SCPE_OK)
+    return SCPE_ARG;
+uptr->capac = cap * ((t_addr) 1000000);
+return SCPE_OK;
+}
+
+/* Show disk capacity */
+
+t_stat sim_disk_show_capac (FILE *st, UNIT *uptr, int32 val, void *desc)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+char *cap_units = "B";
+
+if (ctx->capac_factor == 2)
+    cap_units = "W";
+if (uptr->capac) {
+    if (uptr->capac >= (t_addr) 1000000)
+        fprintf (st, "capacity=%dM%s", (uint32) (uptr->capac / ((t_addr) 1000000)), cap_units);
+    else if (uptr->capac >= (t_addr) 1000)
+        fprintf (st, "capacity=%dK%s", (uint32) (uptr->capac / ((t_addr) 1000)), cap_units);
+    else fprintf (st, "capacity=%d%s", (uint32) uptr->capac, cap_units);
+    }
+else fprintf (st, "undefined capacity");
+return SCPE_OK;
+}
+
+/* Test for available */
+
+t_bool sim_disk_isavailable (UNIT *uptr)
+{
+if (!(uptr->flags & UNIT_ATT))                          /* attached? */
+    return FALSE;
+switch (DK_GET_FMT (uptr)) {                            /* case on format */
+    case DKUF_F_STD:                                    /* SIMH format */
+        return TRUE;
+    case DKUF_F_VHD:                                    /* VHD format */
+    case DKUF_F_DDC:                                    /* DEDUP format */
+        return TRUE;
+        break;
+    case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
+        return sim_os_disk_isavailable_raw (uptr->fileref);
+        break;
+    default:
+        return FALSE;
+    }
+}
+
+t_bool sim_disk_isavailable_a (UNIT *uptr, DISK_PCALLBACK callback)
+{
+t_bool r = FALSE;
+AIO_CALLSETUP
+    r = sim_disk_isavailable (uptr);
+AIO_CALL(DOP_IAVL, 0, NULL, NULL, 0, NULL, 0, callback);
+return r;
+}
+
+/* Test for write protect */
+
+t_bool sim_disk_wrp (UNIT *uptr)
+{
+return (uptr->flags & DKUF_WRP)? TRUE: FALSE;
+}
+
+/* Get Disk size */
+
+t_addr sim_disk_size (UNIT *uptr)
+{
+switch (DK_GET_FMT (uptr)) {                            /* case on format */
+    case DKUF_F_STD:                                    /* SIMH format */
+        return sim_fsize_ex (uptr->fileref);
+    case DKUF_F_VHD:                                    /* VHD format */
+        return sim_vhd_disk_size (uptr->fileref);
+        break;
+    case DKUF_F_DDC:                                    /* DEDUP format */
+        return sim_dedup_disk_size (uptr->fileref);
+    case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
+        return sim_os_disk_size_raw (uptr->fileref);
+        break;
+    default:
+        return (t_addr)-1;
+    }
+}
+
+/* Enable asynchronous operation */
+
+t_stat sim_disk_set_async (UNIT *uptr, int latency)
+{
+#if !defined(SIM_ASYNCH_IO)
+char *msg = "Disk: can't operate asynchronously\r\n";
+printf ("%s", msg);
+if (sim_log) fprintf (sim_log, "%s", msg);
+return SCPE_NOFNC;
+#else
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+pthread_attr_t attr;
+uint32 i;
+
+sim_debug (ctx->dbit, ctx->dptr, "sim_disk_set_async(unit=%d)\n", (int)(uptr-ctx->dptr->units));
+
+ctx->asynch_io = sim_asynch_enabled;
+ctx->asynch_io_latency = latency;
+if (ctx->queue_depth == 0)
+    ctx->queue_depth = 1;
+/* Only raw devices (positioned reads and writes) can safely have several 
+   transfers in progress at once.  Other formats share a single stdio 
+   stream position, so one I/O thread works through their queue in order. */
+ctx->io_threads = 1;
+if (DK_GET_FMT (uptr) == DKUF_F_RAW)
+    ctx->io_threads = (ctx->queue_depth < DISK_MAX_IO_THREADS) ? ctx->queue_depth : DISK_MAX_IO_THREADS;
+#if defined (HAVE_IO_URING)
+if (ctx->uring)                                         /* io_uring keeps several in flight */
+    ctx->io_threads = 1;
+#endif
+if (ctx->asynch_io) {
+    pthread_mutex_init (&ctx->io_lock, NULL);
+    pthread_cond_init (&ctx->io_cond, NULL);
+    pthread_cond_init (&ctx->io_done, NULL);
+    pthread_cond_init (&ctx->startup_cond, NULL);
+    pthread_attr_init(&attr);
+    pthread_attr_setscope(&attr, PTHREAD_SCOPE_SYSTEM);
+    pthread_mutex_lock (&ctx->io_lock);
+    for (i = 0; i < ctx->io_threads; i++) {
+        pthread_create (&ctx->io_thread[i], &attr, _disk_io, (void *)uptr);
+        pthread_cond_wait (&ctx->startup_cond, &ctx->io_lock); /* Wait for thread to stabilize */
+        }
+    pthread_attr_destroy(&attr);
+    pthread_mutex_unlock (&ctx->io_lock);
+    pthread_cond_destroy (&ctx->startup_cond);
+    }
+uptr->a_check_completion = _disk_completion_dispatch;
+uptr->a_is_active = _disk_is_active;
+uptr->a_cancel = _disk_cancel;
+#endif
+return SCPE_OK;
+}
+
+/* Disable asynchronous operation */
+
+t_stat sim_disk_clr_async (UNIT *uptr)
+{
+#if !defined(SIM_ASYNCH_IO)
+return SCPE_NOFNC;
+#else
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+
+/* make sure device exists */
+if (!ctx) return SCPE_UNATT;
+
+sim_debug (ctx->dbit, ctx->dptr, "sim_disk_clr_async(unit=%d)\n", (int)(uptr-ctx->dptr->units));
+
+if (ctx->asynch_io) {
+    uint32 i;
+
+    pthread_mutex_lock (&ctx->io_lock);
+    ctx->asynch_io = 0;
+    pthread_cond_broadcast (&ctx->io_cond);
+    pthread_mutex_unlock (&ctx->io_lock);
+    for (i = 0; i < ctx->io_threads; i++)
+        pthread_join (ctx->io_thread[i], NULL);
+    pthread_mutex_destroy (&ctx->io_lock);
+    pthread_cond_destroy (&ctx->io_cond);
+    pthread_cond_destroy (&ctx->io_done);
+    }
+return SCPE_OK;
+#endif
+}
+
+/* Set asynchronous request queue depth
+
+   The depth is the number of asynchronous requests a device may have 
+   outstanding on a unit at once.  It takes effect immediately on an 
+   attached unit and is retained until the unit is detached.
+*/
+
+t_stat sim_disk_set_qdepth (UNIT *uptr, int32 val, char *cptr, void *desc)
+{
+#if !defined(SIM_ASYNCH_IO)
+return SCPE_NOFNC;
+#else
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+uint32 depth;
+t_stat r;
+
+if ((cptr == NULL) || (*cptr == 0))
+    return SCPE_ARG;
+depth = (uint32) get_uint (cptr, 10, DISK_MAX_QDEPTH, &r);
+if ((r != SCPE_OK) || (depth == 0))
+    return SCPE_ARG;
+if (!(uptr->flags & UNIT_ATT) || (ctx == NULL))
+    return SCPE_UNATT;
+if (ctx->asynch_io) {
+    _disk_cancel (uptr);                                /* let transfers finish */
+    _disk_completion_dispatch (uptr);                   /* and be delivered */
+    sim_disk_clr_async (uptr);
+    ctx->queue_depth = depth;
+    return sim_disk_set_async (uptr, ctx->asynch_io_latency);
+    }
+ctx->queue_depth = depth;
+return SCPE_OK;
+#endif
+}
+
+/* Show asynchronous request queue depth */
+
+t_stat sim_disk_show_qdepth (FILE *st, UNIT *uptr, int32 val, void *desc)
+{
+#if !defined(SIM_ASYNCH_IO)
+fprintf (st, "synchronous");
+#else
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+
+if ((ctx == NULL) || !ctx->asynch_io)
+    fprintf (st, "synchronous");
+else
+    fprintf (st, "queue depth=%d, %d I/O thread%s", ctx->queue_depth, ctx->io_threads, (ctx->io_threads == 1) ? "" : "s");
+#endif
+return SCPE_OK;
+}
+
+/* Set host transfer engine
+
+   STDIO, the default, transfers with the host's standard I/O (or with 
+   pread and pwrite for raw devices).  URING transfers with Linux io_uring
+   and DIRECT transfers with io_uring on a descriptor opened with O_DIRECT
+   so that the host's page cache is bypassed.  MMAP maps a SIMH format
+   container into memory.  The engine may be changed on an attached unit 
+   and is retained until the unit is detached.
+*/
+
+t_stat sim_disk_set_ioengine (UNIT *uptr, int32 val, char *cptr, void *desc)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+int engine;
+t_stat r;
+#if defined (SIM_ASYNCH_IO)
+int asynch_io;
+#endif
+
+if ((cptr == NULL) || (*cptr == 0))
+    return SCPE_ARG;
+for (engine = 0; disk_engines[engine] && MATCH_CMD (cptr, disk_engines[engine]); engine++)
+    ;
+if (disk_engines[engine] == NULL)
+    return SCPE_ARG;
+if (!(uptr->flags & UNIT_ATT) || (ctx == NULL))
+    return SCPE_UNATT;
+if (ctx->overlay && (engine != DISK_ENGINE_STDIO))      /* overlay transfers use stdio */
+    return SCPE_NOFNC;
+#if defined (SIM_ASYNCH_IO)
+asynch_io = ctx->asynch_io;
+if (asynch_io) {
+    _disk_cancel (uptr);                                /* let transfers finish */
+    _disk_completion_dispatch (uptr);                   /* and be delivered */
+    sim_disk_clr_async (uptr);
+    }
+#endif
+_disk_engine_close (uptr);
+r = _disk_engine_open (uptr, engine);
+#if defined (SIM_ASYNCH_IO)
+if (asynch_io)
+    sim_disk_set_async (uptr, ctx->asynch_io_latency);
+#endif
+return r;
+}
+
+/* Show host transfer engine */
+
+t_stat sim_disk_show_ioengine (FILE *st, UNIT *uptr, int32 val, void *desc)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+
+#if defined (HAVE_IO_URING)
+if (ctx && ctx->uring) {
+    struct disk_uring *u = ctx->uring;
+
+    fprintf (st, "io_uring%s, %u submissions, %u transfers\n", (u->dfd >= 0) ? " direct" : "", u->submits, u->xfers);
+    return SCPE_OK;
+    }
+#endif
+#if defined (DISK_MMAP_SUPPORT)
+if (ctx && ctx->map) {
+    fprintf (st, "memory mapped, %uMB\n", (uint32)(ctx->map_size / 1000000));
+    return SCPE_OK;
+    }
+#endif
+fprintf (st, "stdio\n");
+return SCPE_OK;
+}
+
+/* Host sector cache
+
+   Sectors transferred to and from attached disks can be kept in a least 
+   recently used cache in host memory, enabled with SET DISKCACHE SIZE=n 
+   (n in MB).  Cached sectors are identified by their container and 
+   logical block address.  When the cache is shared (the default) units 
+   attached read only to the same container with the same sector and 
+   transfer element sizes use the same cached sectors.  Writable units 
+   and units with an overlay have an image of their own, since other 
+   units' views of their containers may be stale.  In write-through mode 
+   (the default) writes go to the container and replace the cached copy.  
+   In write-back mode written sectors stay in the cache until they are 
+   evicted or the unit is flushed, which happens whenever the simulator 
+   stops.  Sectors are held in the byte order presented to the simulator.
+
+   A dirty sector is written back through the unit which owns its image, 
+   so it can only be evicted to make room for a sector of the same image.  
+   Write backs are done with the cache lock held.
+*/
+
+#define DISK_CACHE_SCAN     64                  /* LRU entries examined for a victim */
+#define DISK_CACHE_RUN      128                 /* max sectors per write back transfer */
+
+struct disk_cache_image {
+    struct disk_cache_image *next;
+    UNIT                *uptr;              /* owning unit (NULL if shared) */
+    t_uint64            dev;                /* container identity */
+    t_uint64            ino;
+    char                *name;              /* container name */
+    uint32              sector_size;
+    uint32              xfer_element_size;
+    uint32              refs;               /* units using the image */
+    uint32              gen;                /* changes whenever the container is written */
+    uint32              dirty;              /* dirty sectors */
+    };
+
+struct disk_cache_entry {
+    struct disk_cache_image *img;
+    t_lba               lba;
+    t_bool              dirty;              /* newer than the container */
+    struct disk_cache_entry *hnext;         /* hash chain */
+    struct disk_cache_entry *prev;          /* LRU list, most recently used first */
+    struct disk_cache_entry *next;
+    uint8               *data;
+    };
+
+static struct {
+    size_t              size;               /* bytes allowed (0 if disabled) */
+    size_t              used;               /* bytes allocated */
+    t_bool              writeback;          /* write-back mode */
+    t_bool              noshare;            /* each unit has its own image */
+    struct disk_cache_entry **hash;
+    uint32              hash_mask;
+    struct disk_cache_entry *head;          /* most recently used */
+    struct disk_cache_entry *tail;          /* least recently used */
+    struct disk_cache_image *images;
+    uint32              entries;            /* sectors cached */
+    uint32              hits;               /* sectors read from the cache */
+    uint32              misses;             /* sectors read from containers */
+    uint32              writes;             /* sectors written */
+    uint32              writebacks;         /* dirty sectors written to containers */
+    uint32              evictions;
+    } disk_cache;
+
+#if defined (SIM_ASYNCH_IO)
+static pthread_mutex_t disk_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#define DISK_CACHE_LOCK     pthread_mutex_lock (&disk_cache_lock)
+#define DISK_CACHE_UNLOCK   pthread_mutex_unlock (&disk_cache_lock)
+#else
+#define DISK_CACHE_LOCK
+#define DISK_CACHE_UNLOCK
+#endif
+
+static t_stat _sim_disk_rdsect_fmt (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects);
+static t_stat _sim_disk_wrsect_fmt (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects);
+static void _sim_disk_io_flush (UNIT *uptr);
+
+static uint32 _disk_cache_hash (struct disk_cache_image *img, t_lba lba)
+{
+return (((uint32)(((size_t)img) >> 4)) ^ (lba * 2654435761u)) & disk_cache.hash_mask;
+}
+
+static void _disk_cache_unlink (struct disk_cache_entry *e)
+{
+if (e->prev)
+    e->prev->next = e->next;
+else
+    disk_cache.head = e->next;
+if (e->next)
+    e->next->prev = e->prev;
+else
+    disk_cache.tail = e->prev;
+}
+
+static void _disk_cache_push (struct disk_cache_entry *e)
+{
+e->prev = NULL;
+e->next = disk_cache.head;
+if (disk_cache.head)
+    disk_cache.head->prev = e;
+else
+    disk_cache.tail = e;
+disk_cache.head = e;
+}
+
+/* Look up a sector, making it the most recently used */
+
+static struct disk_cache_entry *_disk_cache_find (struct disk_cache_image *img, t_lba lba)
+{
+struct disk_cache_entry *e;
+
+for (e = disk_cache.hash[_disk_cache_hash (img, lba)]; e; e = e->hnext)
+    if ((e->img == img) && (e->lba == lba)) {
+        if (e != disk_cache.head) {
+            _disk_cache_unlink (e);
+            _disk_cache_push (e);
+            }
+        return e;
+        }
+return NULL;
+}
+
+static void _disk_cache_free (struct disk_cache_entry *e)
+{
+struct disk_cache_entry **pe = &disk_cache.hash[_disk_cache_hash (e->img, e->lba)];
+
+while (*pe != e)
+    pe = &(*pe)->hnext;
+*pe = e->hnext;
+_disk_cache_unlink (e);
+if (e->dirty)
+    --e->img->dirty;
+disk_cache.used -= sizeof (*e) + e->img->sector_size;
+--disk_cache.entries;
+free (e);
+}
+
+/* Allocate an entry for a sector which isn't cached, evicting the least 
+   recently used sectors the unit is able to evict.  Returns NULL when no 
+   room can be made. */
+
+static struct disk_cache_entry *_disk_cache_insert (UNIT *uptr, struct disk_cache_image *img, t_lba lba)
+{
+size_t need = sizeof (struct disk_cache_entry) + img->sector_size;
+struct disk_cache_entry *e;
+uint32 h;
+
+while (disk_cache.used + need > disk_cache.size) {
+    int scan = DISK_CACHE_SCAN;
+
+    for (e = disk_cache.tail; e && scan; e = e->prev, --scan)
+        if ((!e->dirty) || (e->img == img))
+            break;
+    if ((e == NULL) || (scan == 0))
+        return NULL;
+    if (e->dirty) {                                     /* write it back first */
+        if (_sim_disk_wrsect_fmt (uptr, e->lba, e->data, NULL, 1) != SCPE_OK)
+            return NULL;
+        ++img->gen;
+        ++disk_cache.writebacks;
+        }
+    _disk_cache_free (e);
+    ++disk_cache.evictions;
+    }
+e = (struct disk_cache_entry *)malloc (need);
+if (e == NULL)
+    return NULL;
+e->img = img;
+e->lba = lba;
+e->dirty = FALSE;
+e->data = (uint8 *)(e + 1);
+h = _disk_cache_hash (img, lba);
+e->hnext = disk_cache.hash[h];
+disk_cache.hash[h] = e;
+_disk_cache_push (e);
+disk_cache.used += need;
+++disk_cache.entries;
+return e;
+}
+
+/* Forget all of an image's sectors */
+
+static void _disk_cache_drop (struct disk_cache_image *img)
+{
+struct disk_cache_entry *e, *next;
+
+for (e = disk_cache.head; e; e = next) {
+    next = e->next;
+    if (e->img == img)
+        _disk_cache_free (e);
+    }
+}
+
+static int _disk_cache_lba_cmp (const void *a, const void *b)
+{
+t_lba la = (*(struct disk_cache_entry * const *)a)->lba;
+t_lba lb = (*(struct disk_cache_entry * const *)b)->lba;
+
+return (la < lb) ? -1 : (la > lb);
+}
+
+/* Write back a unit's dirty sectors, adjacent sectors in one transfer */
+
+static t_stat _disk_cache_flush (UNIT *uptr)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_cache_image *img = ctx->cache;
+struct disk_cache_entry **list = NULL, *e;
+uint8 *tbuf = NULL;
+uint32 n = 0, i, j;
+t_stat r = SCPE_OK;
+
+if (img == NULL)
+    return SCPE_OK;
+DISK_CACHE_LOCK;
+if (img->dirty) {
+    sim_debug (ctx->dbit, ctx->dptr, "_disk_cache_flush(unit=%d, dirty=%u)\n", (int)(uptr-ctx->dptr->units), img->dirty);
+    list = (struct disk_cache_entry **)malloc (img->dirty * sizeof (*list));
+    tbuf = (uint8 *)malloc (DISK_CACHE_RUN * img->sector_size);
+    if ((list == NULL) || (tbuf == NULL))
+        r = SCPE_MEM;
+    else {
+        for (e = disk_cache.head; e; e = e->next)
+            if (e->dirty && (e->img == img))
+                list[n++] = e;
+        qsort (list, n, sizeof (*list), _disk_cache_lba_cmp);
+        for (i = 0; (i < n) && (r == SCPE_OK); i = j) {
+            for (j = i; (j < n) && ((j - i) < DISK_CACHE_RUN) && (list[j]->lba == list[i]->lba + (j - i)); j++)
+                memcpy (tbuf + (j - i) * img->sector_size, list[j]->data, img->sector_size);
+            r = _sim_disk_wrsect_fmt (uptr, list[i]->lba, tbuf, NULL, j - i);
+            if (r == SCPE_OK)
+                for (; i < j; i++) {
+                    list[i]->dirty = FALSE;
+                    --img->dirty;
+                    ++disk_cache.writebacks;
+                    }
+            }
+        ++img->gen;
+        }
+    free (list);
+    free (tbuf);
+    }
+DISK_CACHE_UNLOCK;
+return r;
+}
+
+static void _disk_cache_id (const char *filename, t_uint64 *dev, t_uint64 *ino)
+{
+struct stat statb;
+
+*dev = *ino = 0;
+if (stat (filename, &statb) == 0) {
+    *dev = (t_uint64)statb.st_dev;
+    *ino = (t_uint64)statb.st_ino;
+    }
+}
+
+static t_bool _disk_cache_same (struct disk_cache_image *img, const char *filename, t_uint64 dev, t_uint64 ino)
+{
+if (ino || img->ino)                                    /* file system has inode numbers? */
+    return ((img->dev == dev) && (img->ino == ino));
+return (0 == strcmp (img->name, filename));
+}
+
+/* Start caching a unit's sectors */
+
+static t_stat _disk_cache_join (UNIT *uptr)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_cache_image *img = NULL;
+t_bool shared = (!disk_cache.noshare) && (ctx->overlay == NULL) && (uptr->flags & UNIT_RO);
+t_uint64 dev, ino;
+
+if ((disk_cache.size == 0) || ctx->nocache || ctx->cache)
+    return SCPE_OK;
+_disk_cache_id (uptr->filename, &dev, &ino);
+DISK_CACHE_LOCK;
+if (shared)
+    for (img = disk_cache.images; img; img = img->next)
+        if ((img->uptr == NULL) && 
+            (img->sector_size == ctx->sector_size) && 
+            (img->xfer_element_size == ctx->xfer_element_size) && 
+            _disk_cache_same (img, uptr->filename, dev, ino))
+            break;
+if (img == NULL) {
+    img = (struct disk_cache_image *)calloc (1, sizeof (*img));
+    if (img)
+        img->name = (char *)malloc (1 + strlen (uptr->filename));
+    if ((img == NULL) || (img->name == NULL)) {
+        free (img);
+        DISK_CACHE_UNLOCK;
+        return SCPE_MEM;
+        }
+    strcpy (img->name, uptr->filename);
+    img->uptr = shared ? NULL : uptr;
+    img->dev = dev;
+    img->ino = ino;
+    img->sector_size = ctx->sector_size;
+    img->xfer_element_size = ctx->xfer_element_size;
+    img->next = disk_cache.images;
+    disk_cache.images = img;
+    }
+++img->refs;
+ctx->cache = img;
+ctx->cache_hits = ctx->cache_misses = 0;
+DISK_CACHE_UNLOCK;
+return SCPE_OK;
+}
+
+/* Stop caching a unit's sectors */
+
+static t_stat _disk_cache_leave (UNIT *uptr)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_cache_image *img = ctx->cache, **pimg;
+t_stat r;
+
+if (img == NULL)
+    return SCPE_OK;
+r = _disk_cache_flush (uptr);
+DISK_CACHE_LOCK;
+ctx->cache = NULL;
+if (--img->refs == 0) {
+    _disk_cache_drop (img);
+    for (pimg = &disk_cache.images; *pimg != img; pimg = &(*pimg)->next)
+        ;
+    *pimg = img->next;
+    free (img->name);
+    free (img);
+    }
+DISK_CACHE_UNLOCK;
+return r;
+}
+
+/* Forget a unit's cached sectors and, if its container was changed 
+   behind their backs, those of the other units attached to it */
+
+static void _disk_cache_invalidate (UNIT *uptr, t_bool container)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_cache_image *img;
+t_uint64 dev, ino;
+
+if (disk_cache.size == 0)
+    return;
+_disk_cache_id (uptr->filename, &dev, &ino);
+DISK_CACHE_LOCK;
+for (img = disk_cache.images; img; img = img->next)
+    if ((img == ctx->cache) || 
+        (container && (img->uptr == NULL) && _disk_cache_same (img, uptr->filename, dev, ino)))
+        _disk_cache_drop (img);
+DISK_CACHE_UNLOCK;
+}
+
+/* Write back and release a unit's sectors, flushing its container */
+
+static t_stat _disk_cache_release (UNIT *uptr)
+{
+_sim_disk_io_flush (uptr);
+return _disk_cache_leave (uptr);
+}
+
+static t_stat _disk_cache_flush_unit (UNIT *uptr)
+{
+_sim_disk_io_flush (uptr);
+return SCPE_OK;
+}
+
+/* Apply an action to every attached disk unit */
+
+static void _disk_cache_units (t_stat (*action)(UNIT *uptr))
+{
+DEVICE *dptr;
+uint32 i, u;
+
+for (i = 0; (dptr = sim_devices[i]) != NULL; i++)
+    for (u = 0; u < dptr->numunits; u++) {
+        UNIT *uptr = &dptr->units[u];
+
+        if ((uptr->flags & UNIT_ATT) && 
+            (uptr->io_flush == _sim_disk_io_flush) && 
+            (uptr->disk_ctx != NULL))
+            action (uptr);
+        }
+}
+
+/* Read sectors through the cache.  If any sector isn't cached the whole 
+   range is read from the container.  Cached copies of sectors take 
+   precedence since they may be newer, and are merged before anything is 
+   inserted since an insertion may write back and evict one of them. */
+
+static t_stat _disk_cache_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_cache_image *img = ctx->cache;
+struct disk_cache_entry *e;
+uint32 ss = img->sector_size, gen;
+t_seccnt i, sread = 0;
+t_stat r;
+
+DISK_CACHE_LOCK;
+for (i = 0; i < sects; i++) {
+    if ((e = _disk_cache_find (img, lba + i)) == NULL)
+        break;
+    memcpy (buf + i*ss, e->data, ss);
+    }
+if (i == sects) {                                       /* all cached? */
+    ctx->cache_hits += sects;
+    disk_cache.hits += sects;
+    DISK_CACHE_UNLOCK;
+    if (sectsread)
+        *sectsread = sects;
+    return SCPE_OK;
+    }
+do {
+    gen = img->gen;
+    DISK_CACHE_UNLOCK;
+    r = _sim_disk_rdsect_fmt (uptr, lba, buf, &sread, sects);
+    DISK_CACHE_LOCK;
+    } while ((r == SCPE_OK) && (gen != img->gen));      /* written meanwhile? */
+if (r == SCPE_OK) {
+    ctx->cache_misses += sects;
+    disk_cache.misses += sects;
+    for (i = 0; i < sects; i++)
+        if ((e = _disk_cache_find (img, lba + i)))
+            memcpy (buf + i*ss, e->data, ss);
+    for (i = 0; i < sread; i++)
+        if ((_disk_cache_find (img, lba + i) == NULL) && 
+            (e = _disk_cache_insert (uptr, img, lba + i)))
+            memcpy (e->data, buf + i*ss, ss);
+    }
+DISK_CACHE_UNLOCK;
+if (sectsread)
+    *sectsread = sread;
+return r;
+}
+
+/* Write sectors through the cache */
+
+static t_stat _disk_cache_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_cache_image *img = ctx->cache;
+struct disk_cache_entry *e;
+uint32 ss = img->sector_size;
+t_seccnt i, swritten = 0;
+t_stat r = SCPE_OK;
+
+DISK_CACHE_LOCK;
+disk_cache.writes += sects;
+if (disk_cache.writeback) {
+    for (i = 0; (i < sects) && (r == SCPE_OK); i++) {
+        if ((e = _disk_cache_find (img, lba + i)) == NULL)
+            e = _disk_cache_insert (uptr, img, lba + i);
+        if (e) {
+            memcpy (e->data, buf + i*ss, ss);
+            if (!e->dirty) {
+                e->dirty = TRUE;
+                ++img->dirty;
+                }
+            }
+        else {                                          /* no room, write it now */
+            ++img->gen;
+            r = _sim_disk_wrsect_fmt (uptr, lba + i, buf + i*ss, NULL, 1);
+            }
+        }
+    DISK_CACHE_UNLOCK;
+    if (sectswritten)
+        *sectswritten = (r == SCPE_OK) ? sects : 0;
+    return r;
+    }
+++img->gen;
+DISK_CACHE_UNLOCK;
+r = _sim_disk_wrsect_fmt (uptr, lba, buf, &swritten, sects);
+DISK_CACHE_LOCK;
+++img->gen;
+for (i = 0; i < sects; i++) {
+    if (((e = _disk_cache_find (img, lba + i)) == NULL) && (r == SCPE_OK))
+        e = _disk_cache_insert (uptr, img, lba + i);
+    if (e == NULL)
+        continue;
+    if (r == SCPE_OK)
+        memcpy (e->data, buf + i*ss, ss);
+    else
+        _disk_cache_free (e);                           /* container contents unknown */
+    }
+DISK_CACHE_UNLOCK;
+if (sectswritten)
+    *sectswritten = swritten;
+return r;
+}
+
+/* Configure the sector cache
+
+   SET DISKCACHE SIZE=n,WRITEBACK|WRITETHROUGH,SHARED|NOSHARED,FLUSH
+   SET NODISKCACHE
+*/
+
+t_stat sim_disk_set_diskcache (int32 flag, char *cptr)
+{
+char gbuf[CBUFSIZE], *vptr;
+size_t size = disk_cache.size;
+t_bool writeback = disk_cache.writeback;
+t_bool noshare = disk_cache.noshare;
+t_bool flush = FALSE;
+t_stat r;
+
+if (flag == 0) {                                        /* SET NODISKCACHE */
+    if ((cptr != NULL) && (*cptr != 0))
+        return SCPE_2MARG;
+    size = 0;
+    }
+else {
+    if ((cptr == NULL) || (*cptr == 0))
+        return SCPE_2FARG;
+    while (*cptr != 0) {
+        cptr = get_glyph (cptr, gbuf, ',');
+        if ((vptr = strchr (gbuf, '=')))
+            *vptr++ = 0;
+        if (MATCH_CMD (gbuf, "SIZE") == 0) {
+            if ((vptr == NULL) || (*vptr == 0))
+                return SCPE_MISVAL;
+            size = ((size_t)get_uint (vptr, 10, (sizeof (size_t) > 4) ? 65536 : 2048, &r)) << 20;
+            if (r != SCPE_OK)
+                return SCPE_ARG;
+            continue;
+            }
+        if (vptr != NULL)
+            return SCPE_ARG;
+        if (MATCH_CMD (gbuf, "WRITEBACK") == 0)
+            writeback = TRUE;
+        else if (MATCH_CMD (gbuf, "WRITETHROUGH") == 0)
+            writeback = FALSE;
+        else if (MATCH_CMD (gbuf, "SHARED") == 0)
+            noshare = FALSE;
+        else if (MATCH_CMD (gbuf, "NOSHARED") == 0)
+            noshare = TRUE;
+        else if (MATCH_CMD (gbuf, "FLUSH") == 0)
+            flush = TRUE;
+        else
+            return SCPE_ARG;
+        }
+    }
+if ((size == disk_cache.size) && 
+    (writeback == disk_cache.writeback) && 
+    (noshare == disk_cache.noshare)) {
+    if (flush)
+        _disk_cache_units (&_disk_cache_flush_unit);
+    return SCPE_OK;
+    }
+_disk_cache_units (&_disk_cache_release);               /* write back and release everything */
+free (disk_cache.hash);
+disk_cache.hash = NULL;
+disk_cache.hash_mask = 0;
+disk_cache.size = 0;
+disk_cache.writeback = writeback;
+disk_cache.noshare = noshare;
+disk_cache.hits = disk_cache.misses = disk_cache.writes = 0;
+disk_cache.writebacks = disk_cache.evictions = 0;
+if (size) {
+    uint32 buckets = 1024;
+
+    while ((buckets < (1u << 24)) && (buckets < (size / 512)))
+        buckets <<= 1;
+    disk_cache.hash = (struct disk_cache_entry **)calloc (buckets, sizeof (*disk_cache.hash));
+    if (disk_cache.hash == NULL)
+        return SCPE_MEM;
+    disk_cache.hash_mask = buckets - 1;
+    disk_cache.size = size;
+    _disk_cache_units (&_disk_cache_join);
+    }
+return SCPE_OK;
+}
+
+static uint32 _disk_cache_hit_rate (uint32 hits, uint32 misses)
+{
+if ((hits == 0) && (misses == 0))
+    return 0;
+return (uint32)((((t_uint64)hits) * 100) / (((t_uint64)hits) + misses));
+}
+
+/* Include or exclude a unit from the sector cache */
+
+t_stat sim_disk_set_cache (UNIT *uptr, int32 val, char *cptr, void *desc)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+
+if ((cptr != NULL) && (*cptr != 0))
+    return SCPE_ARG;
+if (!(uptr->flags & UNIT_ATT) || (ctx == NULL))
+    return SCPE_UNATT;
+ctx->nocache = !val;
+if (val)
+    return _disk_cache_join (uptr);
+return _disk_cache_leave (uptr);
+}
+
+/* Show a unit's sector cache statistics */
+
+t_stat sim_disk_show_cache (FILE *st, UNIT *uptr, int32 val, void *desc)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+
+if ((ctx == NULL) || (ctx->cache == NULL)) {
+    fprintf (st, "not cached\n");
+    return SCPE_OK;
+    }
+fprintf (st, "cached%s, %u hits, %u misses (%u%% hit rate)\n", (ctx->cache->refs > 1) ? " (shared)" : "", 
+         ctx->cache_hits, ctx->cache_misses, _disk_cache_hit_rate (ctx->cache_hits, ctx->cache_misses));
+return SCPE_OK;
+}
+
+/* SHOW DISKCACHE */
+
+t_stat sim_disk_show_diskcache (FILE *st, DEVICE *dnotused, UNIT *unotused, int32 flag, char *cptr)
+{
+struct disk_cache_image *img;
+DEVICE *dptr;
+uint32 i, u, dirty = 0;
+
+if (disk_cache.size == 0) {
+    fprintf (st, "Disk cache disabled\n");
+    return SCPE_OK;
+    }
+for (img = disk_cache.images; img; img = img->next)
+    dirty += img->dirty;
+fprintf (st, "Disk cache: %uMB, %s, %s\n", (uint32)(disk_cache.size >> 20), 
+         disk_cache.writeback ? "write-back" : "write-through", disk_cache.noshare ? "not shared" : "shared");
+fprintf (st, "  %u sectors cached (%uKB), %u dirty\n", disk_cache.entries, (uint32)(disk_cache.used >> 10), dirty);
+fprintf (st, "  %u hits, %u misses (%u%% hit rate), %u sectors written\n", disk_cache.hits, disk_cache.misses, 
+         _disk_cache_hit_rate (disk_cache.hits, disk_cache.misses), disk_cache.writes);
+fprintf (st, "  %u sectors written back, %u evicted\n", disk_cache.writebacks, disk_cache.evictions);
+for (i = 0; (dptr = sim_devices[i]) != NULL; i++)
+    for (u = 0; u < dptr->numunits; u++) {
+        UNIT *uptr = &dptr->units[u];
+
+        if ((uptr->flags & UNIT_ATT) && 
+            (uptr->io_flush == _sim_disk_io_flush) && 
+            (uptr->disk_ctx != NULL)) {
+            fprintf (st, "  %s%d, %s: ", sim_dname (dptr), (int)u, uptr->filename);
+            sim_disk_show_cache (st, uptr, 0, NULL);
+            }
+        }
+return SCPE_OK;
+}
+
+/* Commit or discard a unit's copy-on-write overlay */
+
+t_stat sim_disk_set_overlay (UNIT *uptr, int32 val, char *cptr, void *desc)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+t_bool commit;
+t_stat r;
+#if defined (SIM_ASYNCH_IO)
+int asynch_io;
+#endif
+
+if ((cptr == NULL) || (*cptr == 0))
+    return SCPE_ARG;
+if (MATCH_CMD (cptr, "COMMIT") == 0)
+    commit = TRUE;
+else
+    if (MATCH_CMD (cptr, "DISCARD") == 0)
+        commit = FALSE;
+    else
+        return SCPE_ARG;
+if (!(uptr->flags & UNIT_ATT) || (ctx == NULL))
+    return SCPE_UNATT;
+if (ctx->overlay == NULL)
+    return SCPE_NOFNC;
+#if defined (SIM_ASYNCH_IO)
+asynch_io = ctx->asynch_io;
+if (asynch_io) {
+    _disk_cancel (uptr);                                /* let transfers finish */
+    _disk_completion_dispatch (uptr);                   /* and be delivered */
+    sim_disk_clr_async (uptr);
+    }
+#endif
+r = _disk_cache_flush (uptr);
+if (r == SCPE_OK)
+    r = _disk_overlay_flush (uptr);
+if ((r == SCPE_OK) && commit)
+    r = _disk_overlay_commit (uptr);
+if (r == SCPE_OK)
+    r = _disk_overlay_discard (uptr);
+_disk_cache_invalidate (uptr, commit);
+#if defined (SIM_ASYNCH_IO)
+if (asynch_io)
+    sim_disk_set_async (uptr, ctx->asynch_io_latency);
+#endif
+return r;
+}
+
+/* Show copy-on-write overlay */
+
+t_stat sim_disk_show_overlay (FILE *st, UNIT *uptr, int32 val, void *desc)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+struct disk_overlay *ovl;
+
+if ((ctx == NULL) || (ctx->overlay == NULL)) {
+    fprintf (st, "no overlay\n");
+    return SCPE_OK;
+    }
+ovl = ctx->overlay;
+fprintf (st, "overlay %s on %s, %u of %u blocks written (%uKB), %u copied up\n", ovl->path, uptr->filename, 
+         ovl->used, ovl->blocks, (uint32)((((t_uint64)ovl->used) * ovl->blksize) / 1024), ovl->copyups);
+return SCPE_OK;
+}
+
+/* Read Sectors */
+
+static t_stat _sim_disk_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects)
+{
+t_addr da;
+uint32 err, tbc;
+size_t i;
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+
+sim_debug (ctx->dbit, ctx->dptr, "_sim_disk_rdsect(unit=%d, lba=0x%X, sects=%d)\n", (int)(uptr-ctx->dptr->units), lba, sects);
+
+if (ctx->overlay)
+    return _disk_overlay_rw (uptr, FALSE, lba, buf, sectsread, sects);
+#if defined (DISK_MMAP_SUPPORT)
+if (ctx->map)
+    return _disk_mmap_rw (uptr, FALSE, lba, buf, sectsread, sects);
+#endif
+#if defined (HAVE_IO_URING)
+if (ctx->uring)
+    return _disk_uring_rw (uptr, FALSE, lba, buf, sectsread, sects, ctx->xfer_element_size);
+#endif
+
+da = ((t_addr)lba) * ctx->sector_size;
+tbc = sects * ctx->sector_size;
+if (sectsread)
+    *sectsread = 0;
+err = sim_fseek (uptr->fileref, da, SEEK_SET);          /* set pos */
+if (!err) {
+    i = sim_fread (buf, ctx->xfer_element_size, tbc/ctx->xfer_element_size, uptr->fileref);
+    if (i < tbc/ctx->xfer_element_size)                 /* fill */
+        memset (&buf[i*ctx->xfer_element_size], 0, tbc-(i*ctx->xfer_element_size));
+    err = ferror (uptr->fileref);
+    if ((!err) && (sectsread))
+        *sectsread = (t_seccnt)((i*ctx->xfer_element_size+ctx->sector_size-1)/ctx->sector_size);
+    }
+return err;
+}
+
+static t_stat _sim_disk_rdsect_fmt (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects)
+{
+t_stat r;
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+t_seccnt sread;
+
+sim_debug (ctx->dbit, ctx->dptr, "sim_disk_rdsect(unit=%d, lba=0x%X, sects=%d)\n", (int)(uptr-ctx->dptr->units), lba, sects);
+
+if ((sects == 1) &&                                     /* Single sector reads */
+    (lba >= (uptr->capac*ctx->capac_factor)/ctx->sector_size)) {/* beyond the end of the disk */
+    memset (buf, '\0', ctx->sector_size);               /* are bad block management efforts - zero buffer */
+    if (sectsread)
+        *sectsread = 1;
+    return SCPE_OK;                                     /* return success */
+    }
+
+if ((0 == (ctx->sector_size & (ctx->storage_sector_size - 1))) ||   /* Sector Aligned & whole sector transfers */
+    ((0 == ((lba*ctx->sector_size) & (ctx->storage_sector_size - 1))) &&
+     (0 == ((sects*ctx->sector_size) & (ctx->storage_sector_size - 1))))) {
+    switch (DK_GET_FMT (uptr)) {                        /* case on format */
+        case DKUF_F_STD:                                /* SIMH format */
+            return _sim_disk_rdsect (uptr, lba, buf, sectsread, sects);
+        case DKUF_F_VHD:                                /* VHD format */
+            r = sim_vhd_disk_rdsect (uptr, lba, buf, &sread, sects);
+            break;
+        case DKUF_F_DDC:                                /* DEDUP format */
+            r = sim_dedup_disk_rdsect (uptr, lba, buf, &sread, sects);
+            break;
+        case DKUF_F_RAW:                                /* Raw Physical Disk Access */
+            r = sim_os_disk_rdsect (uptr, lba, buf, &sread, sects);
+            break;
+        default:
+            return SCPE_NOFNC;
+        }
+    if (sectsread)
+        *sectsread = sread;
+    if (r != SCPE_OK)
+        return r;
+    sim_buf_swap_data (buf, ctx->xfer_element_size, (sread * ctx->sector_size) / ctx->xfer_element_size);
+    return r;
+    }
+else { /* Unaligned and/or partial sector transfers */
+    uint8 *tbuf = (uint8*) malloc (sects*ctx->sector_size + 2*ctx->storage_sector_size);
+    t_lba sspsts = ctx->storage_sector_size/ctx->sector_size; /* sim sectors in a storage sector */
+    t_lba tlba = lba & ~(sspsts - 1);
+    t_seccnt tsects = sects + (lba - tlba);
+
+    tsects = (tsects + (sspsts - 1)) & ~(sspsts - 1);
+    if (sectsread)
+        *sectsread = 0;
+    if (tbuf == NULL)
+        return SCPE_MEM;
+    switch (DK_GET_FMT (uptr)) {                        /* case on format */
+        case DKUF_F_STD:                                /* SIMH format */
+            r = _sim_disk_rdsect (uptr, tlba, tbuf, &sread, tsects);
+            break;
+        case DKUF_F_VHD:                                /* VHD format */
+            r = sim_vhd_disk_rdsect (uptr, tlba, tbuf, &sread, tsects);
+            if (r == SCPE_OK)
+                sim_buf_swap_data (tbuf, ctx->xfer_element_size, (sread * ctx->sector_size) / ctx->xfer_element_size);
+            break;
+        case DKUF_F_DDC:                                /* DEDUP format */
+            r = sim_dedup_disk_rdsect (uptr, tlba, tbuf, &sread, tsects);
+            if (r == SCPE_OK)
+                sim_buf_swap_data (tbuf, ctx->xfer_element_size, (sread * ctx->sector_size) / ctx->xfer_element_size);
+            break;
+        case DKUF_F_RAW:                                /* Raw Physical Disk Access */
+            r = sim_os_disk_rdsect (uptr, tlba, tbuf, &sread, tsects);
+            if (r == SCPE_OK)
+                sim_buf_swap_data (tbuf, ctx->xfer_element_size, (sread * ctx->sector_size) / ctx->xfer_element_size);
+            break;
+        default:
+            free (tbuf);
+            return SCPE_NOFNC;
+        }
+    if (r == SCPE_OK) {
+        memcpy (buf, tbuf + ((lba - tlba) * ctx->sector_size), sects * ctx->sector_size);
+        if (sectsread) {
+            *sectsread = sread - (lba - tlba);
+            if (*sectsread > sects)
+                *sectsread = sects;
+            }
+        }
+    free (tbuf);
+    return r;
+    }
+}
+
+t_stat sim_disk_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+
+if (ctx->cache &&                                       /* cached and within the disk? */
+    (((t_addr)lba) + sects <= (uptr->capac*ctx->capac_factor)/ctx->sector_size))
+    return _disk_cache_rdsect (uptr, lba, buf, sectsread, sects);
+return _sim_disk_rdsect_fmt (uptr, lba, buf, sectsread, sects);
+}
+
+t_stat sim_disk_rdsect_a (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects, DISK_PCALLBACK callback)
+{
+t_stat r = SCPE_OK;
+AIO_CALLSETUP
+    r = sim_disk_rdsect (uptr, lba, buf, sectsread, sects);
+AIO_CALL(DOP_RSEC, lba, buf, NULL, 0, sectsread, sects, callback);
+return r;
+}
+
+/* Write Sectors */
+
+static t_stat _sim_disk_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects)
+{
+t_addr da;
+uint32 err, tbc;
+size_t i;
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+
+sim_debug (ctx->dbit, ctx->dptr, "_sim_disk_wrsect(unit=%d, lba=0x%X, sects=%d)\n", (int)(uptr-ctx->dptr->units), lba, sects);
+
+if (ctx->overlay)
+    return _disk_overlay_rw (uptr, TRUE, lba, buf, sectswritten, sects);
+#if defined (DISK_MMAP_SUPPORT)
+if (ctx->map)
+    return _disk_mmap_rw (uptr, TRUE, lba, buf, sectswritten, sects);
+#endif
+#if defined (HAVE_IO_URING)
+if (ctx->uring)
+    return _disk_uring_rw (uptr, TRUE, lba, buf, sectswritten, sects, ctx->xfer_element_size);
+#endif
+
+da = ((t_addr)lba) * ctx->sector_size;
+tbc = sects * ctx->sector_size;
+if (sectswritten)
+    *sectswritten = 0;
+err = sim_fseek (uptr->fileref, da, SEEK_SET);          /* set pos */
+if (!err) {
+    i = sim_fwrite (buf, ctx->xfer_element_size, tbc/ctx->xfer_element_size, uptr->fileref);
+    err = ferror (uptr->fileref);
+    if ((!err) && (sectswritten))
+        *sectswritten = (t_seccnt)((i*ctx->xfer_element_size+ctx->sector_size-1)/ctx->sector_size);
+    }
+return err;
+}
+
+static t_stat _sim_disk_wrsect_fmt (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+uint32 f = DK_GET_FMT (uptr);
+t_stat r;
+uint8 *tbuf = NULL;
+
+sim_debug (ctx->dbit, ctx->dptr, "sim_disk_wrsect(unit=%d, lba=0x%X, sects=%d)\n", (int)(uptr-ctx->dptr->units), lba, sects);
+
+if (f == DKUF_F_STD)
+    return _sim_disk_wrsect (uptr, lba, buf, sectswritten, sects);
+if ((0 == (ctx->sector_size & (ctx->storage_sector_size - 1))) ||   /* Sector Aligned & whole sector transfers */
+    ((0 == ((lba*ctx->sector_size) & (ctx->storage_sector_size - 1))) &&
+     (0 == ((sects*ctx->sector_size) & (ctx->storage_sector_size - 1))))) {
+
+    if (sim_end || (ctx->xfer_element_size == sizeof (char)))
+        switch (DK_GET_FMT (uptr)) {                            /* case on format */
+            case DKUF_F_VHD:                                    /* VHD format */
+                return sim_vhd_disk_wrsect  (uptr, lba, buf, sectswritten, sects);
+            case DKUF_F_DDC:                                    /* DEDUP format */
+                return sim_dedup_disk_wrsect  (uptr, lba, buf, sectswritten, sects);
+            case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
+                return sim_os_disk_wrsect  (uptr, lba, buf, sectswritten, sects);
+            default:
+                return SCPE_NOFNC;
+            }
+
+    tbuf = (uint8*) malloc (sects * ctx->sector_size);
+    if (NULL == tbuf)
+        return SCPE_MEM;
+    sim_buf_copy_swapped (tbuf, buf, ctx->xfer_element_size, (sects * ctx->sector_size) / ctx->xfer_element_size);
+
+    switch (DK_GET_FMT (uptr)) {                            /* case on format */
+        case DKUF_F_VHD:                                    /* VHD format */
+            r = sim_vhd_disk_wrsect (uptr, lba, tbuf, sectswritten, sects);
+            break;
+        case DKUF_F_DDC:                                    /* DEDUP format */
+            r = sim_dedup_disk_wrsect (uptr, lba, tbuf, sectswritten, sects);
+            break;
+        case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
+            r = sim_os_disk_wrsect (uptr, lba, tbuf, sectswritten, sects);
+            break;
+        default:
+            r = SCPE_NOFNC;
+            break;
+        }
+    }
+else { /* Unaligned and/or partial sector transfers */
+    t_lba sspsts = ctx->storage_sector_size/ctx->sector_size; /* sim sectors in a storage sector */
+    t_lba tlba = lba & ~(sspsts - 1);
+    t_seccnt tsects = sects + (lba - tlba);
+
+    tbuf = (uint8*) malloc (sects*ctx->sector_size + 2*ctx->storage_sector_size);
+    tsects = (tsects + (sspsts - 1)) & ~(sspsts - 1);
+    if (sectswritten)
+        *sectswritten = 0;
+    if (tbuf == NULL)
+        return SCPE_MEM;
+    /* Partial Sector writes require a read-modify-write sequence for the partial sectors */
+    if ((lba & (sspsts - 1)) ||
+        (sects < sspsts))
+        switch (DK_GET_FMT (uptr)) {                            /* case on format */
+            case DKUF_F_VHD:                                    /* VHD format */
+                sim_vhd_disk_rdsect (uptr, tlba, tbuf, NULL, sspsts);
+                break;
+            case DKUF_F_DDC:                                    /* DEDUP format */
+                sim_dedup_disk_rdsect (uptr, tlba, tbuf, NULL, sspsts);
+                break;
+            case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
+                sim_os_disk_rdsect (uptr, tlba, tbuf, NULL, sspsts);
+                break;
+            default:
+                r = SCPE_NOFNC;
+                break;
+            }
+    if ((tsects > sspsts) &&
+        ((sects + lba - tlba) & (sspsts - 1)))
+        switch (DK_GET_FMT (uptr)) {                            /* case on format */
+            case DKUF_F_VHD:                                    /* VHD format */
+                sim_vhd_disk_rdsect (uptr, tlba + tsects - sspsts, 
+                                     tbuf + (tsects - sspsts) * ctx->sector_size, 
+                                     NULL, sspsts);
+                break;
+            case DKUF_F_DDC:                                    /* DEDUP format */
+                sim_dedup_disk_rdsect (uptr, tlba + tsects - sspsts, 
+                                       tbuf + (tsects - sspsts) * ctx->sector_size, 
+                                       NULL, sspsts);
+                break;
+            case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
+                sim_os_disk_rdsect (uptr, tlba + tsects - sspsts, 
+                                    tbuf + (tsects - sspsts) * ctx->sector_size, 
+                                    NULL, sspsts);
+                break;
+            default:
+                r = SCPE_NOFNC;
+                break;
+            }
+    sim_buf_copy_swapped (tbuf + (lba & (sspsts - 1)) * ctx->sector_size, 
+                          buf, ctx->xfer_element_size, (sects * ctx->sector_size) / ctx->xfer_element_size);
+    switch (DK_GET_FMT (uptr)) {                            /* case on format */
+        case DKUF_F_VHD:                                    /* VHD format */
+            r = sim_vhd_disk_wrsect (uptr, tlba, tbuf, sectswritten, tsects);
+            break;
+        case DKUF_F_DDC:                                    /* DEDUP format */
+            r = sim_dedup_disk_wrsect (uptr, tlba, tbuf, sectswritten, tsects);
+            break;
+        case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
+            r = sim_os_disk_wrsect (uptr, tlba, tbuf, sectswritten, tsects);
+            break;
+        default:
+            r = SCPE_NOFNC;
+            break;
+        }
+    if ((r == SCPE_OK) && sectswritten) {
+        *sectswritten -= (lba - tlba);
+        if (*sectswritten > sects)
+            *sectswritten = sects;
+        }
+    }
+free (tbuf);
+return r;
+}
+
+t_stat sim_disk_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+
+if (ctx->cache &&                                       /* cached and within the disk? */
+    (((t_addr)lba) + sects <= (uptr->capac*ctx->capac_factor)/ctx->sector_size))
+    return _disk_cache_wrsect (uptr, lba, buf, sectswritten, sects);
+return _sim_disk_wrsect_fmt (uptr, lba, buf, sectswritten, sects);
+}
+
+t_stat sim_disk_wrsect_a (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects, DISK_PCALLBACK callback)
+{
+t_stat r = SCPE_OK;
+AIO_CALLSETUP
+    r =  sim_disk_wrsect (uptr, lba, buf, sectswritten, sects);
+AIO_CALL(DOP_WSEC, lba, buf, NULL, 0, sectswritten, sects, callback);
+return r;
+}
+
+/* Scatter/gather transfers
+
+   The data of a transfer may be spread across several host memory 
+   segments, usually runs of the simulated machine's memory which the 
+   bus map has shown to be contiguous.  For SIMH format containers the 
+   data moves directly between the container and the segments.  Other 
+   formats, an overlay or io_uring go through a temporary buffer.
+*/
+
+static t_stat _sim_disk_sg (UNIT *uptr, t_bool write, t_lba lba, DISK_SG *sg, uint32 nsg, t_seccnt *sectsxfered, t_seccnt sects)
+{
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+size_t elem = ctx->xfer_element_size;
+size_t tbc = ((size_t)sects) * ctx->sector_size;
+size_t xfered = 0, len, i;
+t_addr da = ((t_addr)lba) * ctx->sector_size;
+t_bool direct;
+uint32 s;
+t_stat r = SCPE_OK;
+
+sim_debug (ctx->dbit, ctx->dptr, "_sim_disk_sg(unit=%d, %s, lba=0x%X, sects=%d, segments=%d)\n", (int)(uptr-ctx->dptr->units), write ? "write" : "read", lba, sects, nsg);
+
+if (sectsxfered)
+    *sectsxfered = 0;
+for (s = 0, len = 0; s < nsg; s++) {
+    if (sg[s].len % elem)                               /* whole elements only */
+        return SCPE_ARG;
+    len += sg[s].len;
+    }
+if (len != tbc)
+    return SCPE_ARG;
+direct = ((DK_GET_FMT (uptr) == DKUF_F_STD) &&
+          (ctx->overlay == NULL) &&
+          (ctx->cache == NULL) &&
+          ((da + tbc) <= (uptr->capac*ctx->capac_factor)));
+#if defined (HAVE_IO_URING)
+if (ctx->uring)
+    direct = FALSE;
+#endif
+if (!direct) {
+    uint8 *tbuf = (uint8 *)malloc (tbc);
+
+    if (tbuf == NULL)
+        return SCPE_MEM;
+    if (write) {
+        for (s = 0, len = 0; s < nsg; len += sg[s++].len)
+            memcpy (tbuf + len, sg[s].buf, sg[s].len);
+        r = sim_disk_wrsect (uptr, lba, tbuf, sectsxfered, sects);
+        }
+    else {
+        r = sim_disk_rdsect (uptr, lba, tbuf, sectsxfered, sects);
+        if (r == SCPE_OK)
+            for (s = 0, len = 0; s < nsg; len += sg[s++].len)
+                memcpy (sg[s].buf, tbuf + len, sg[s].len);
+        }
+    free (tbuf);
+    return r;
+    }
+#if defined (DISK_MMAP_SUPPORT)
+if (ctx->map) {
+    for (s = 0; (s < nsg) && (r == SCPE_OK); s++) {
+        r = _disk_mmap_xfer (uptr, write, da + xfered, (uint8 *)sg[s].buf, sg[s].len, &i);
+        xfered += i;
+        }
+    }
+else
+#endif
+    {
+    t_bool shortxfer = FALSE;
+
+    if (sim_fseek (uptr->fileref, da, SEEK_SET))
+        return SCPE_IOERR;
+    for (s = 0; s < nsg; s++) {
+        uint8 *buf = (uint8 *)sg[s].buf;
+        size_t n = sg[s].len/elem;
+
+        i = 0;
+        if (!shortxfer) {
+            if (write)
+                i = sim_fwrite (buf, elem, n, uptr->fileref);
+            else
+                i = sim_fread (buf, elem, n, uptr->fileref);
+            xfered += i*elem;
+            shortxfer = (i < n);
+            }
+        if ((!write) && (i < n))                        /* fill */
+            memset (&buf[i*elem], 0, sg[s].len - i*elem);
+        }
+    if (ferror (uptr->fileref))
+        r = SCPE_IOERR;
+    }
+if ((r == SCPE_OK) && sectsxfered)
+    *sectsxfered = (t_seccnt)((xfered + ctx->sector_size - 1) / ctx->sector_size);
+return r;
+}
+
+t_stat sim_disk_rdsect_sg (UNIT *uptr, t_lba lba, DISK_SG *sg, uint32 nsg, t_seccnt *sectsread, t_seccnt sects)
+{
+return _sim_disk_sg (uptr, FALSE, lba, sg, nsg, sectsread, sects);
+}
+
+t_stat sim_disk_rdsect_sg_a (UNIT *uptr, t_lba lba, DISK_SG *sg, uint32 nsg, t_seccnt *sectsread, t_seccnt sects, DISK_PCALLBACK callback)
+{
+t_stat r = SCPE_OK;
+AIO_CALLSETUP
+    r = sim_disk_rdsect_sg (uptr, lba, sg, nsg, sectsread, sects);
+AIO_CALL(DOP_RSG, lba, NULL, sg, nsg, sectsread, sects, callback);
+return r;
+}
+
+t_stat sim_disk_wrsect_sg (UNIT *uptr, t_lba lba, DISK_SG *sg, uint32 nsg, t_seccnt *sectswritten, t_seccnt sects)
+{
+return _sim_disk_sg (uptr, TRUE, lba, sg, nsg, sectswritten, sects);
+}
+
+t_stat sim_disk_wrsect_sg_a (UNIT *uptr, t_lba lba, DISK_SG *sg, uint32 nsg, t_seccnt *sectswritten, t_seccnt sects, DISK_PCALLBACK callback)
+{
+t_stat r = SCPE_OK;
+AIO_CALLSETUP
+    r = sim_disk_wrsect_sg (uptr, lba, sg, nsg, sectswritten, sects);
+AIO_CALL(DOP_WSG, lba, NULL, sg, nsg, sectswritten, sects, callback);
+return r;
+}
+
+t_stat sim_disk_unload (UNIT *uptr)
+{
+switch (DK_GET_FMT (uptr)) {                            /* case on format */
+    case DKUF_F_STD:                                    /* Simh */
+    case DKUF_F_VHD:                                    /* VHD format */
+    case DKUF_F_DDC:                                    /* DEDUP format */
+        return sim_disk_detach (uptr);
+    case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
+        return sim_os_disk_unload_raw (uptr->fileref);  /* remove/eject disk */
+        break;
+    default:
+        return SCPE_NOFNC;
+    }
+}
+
+/* 
+   This routine is called when the simulator stops and any time
+   the asynch mode is changed (enabled or disabled)
+*/
+static void _sim_disk_io_flush (UNIT *uptr)
+{
+uint32 f = DK_GET_FMT (uptr);
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+
+#if defined (SIM_ASYNCH_IO)
+sim_disk_clr_async (uptr);
+if (sim_asynch_enabled)
     sim_disk_set_async (uptr, ctx->asynch_io_latency);
 #endif
+_disk_cache_flush (uptr);                               /* write back cached sectors */
 switch (f) {                                            /* case on format */
     case DKUF_F_STD:                                    /* Simh */
+        if (ctx->overlay) {
+            _disk_overlay_flush (uptr);
+            break;
+            }
+#if defined (DISK_MMAP_SUPPORT)
+        if (ctx->map) {
+            msync (ctx->map, ctx->map_size, MS_SYNC);
+            break;
+            }
+#endif
         fflush (uptr->fileref);
         break;
     case DKUF_F_VHD:                                    /* Virtual Disk */
         sim_vhd_disk_flush (uptr->fileref);
         break;
+    case DKUF_F_DDC:                                    /* Deduplicating container */
+        sim_dedup_disk_flush (uptr->fileref);
+        break;
     case DKUF_F_RAW:                                    /* Physical */
         sim_os_disk_flush_raw (uptr->fileref);
         break;
@@ -851,18 +2912,44 @@ if (sim_switches & SWMASK ('D')) {                      /* create difference dis
         }
     return SCPE_ARG;
     }
+if (sim_switches & SWMASK ('S')) {                      /* base disk beneath a copy-on-write overlay? */
+    char gbuf[CBUFSIZE];
+    int32 saved_sim_quiet = sim_quiet;
+    t_stat r;
+
+    sim_switches = sim_switches & ~(SWMASK ('S') | SWMASK ('U') | SWMASK ('Y') | SWMASK ('P'));
+    cptr = get_glyph_nc (cptr, gbuf, 0);                /* get overlay spec */
+    if (*cptr == 0)                                     /* must be more */
+        return SCPE_2FARG;
+    sim_switches |= SWMASK ('R') | SWMASK ('E');
+    sim_quiet = TRUE;
+    r = sim_disk_attach (uptr, cptr, sector_size, xfer_element_size, dontautosize, dbit, dtype, pdp11tracksize, completion_delay);
+    sim_quiet = saved_sim_quiet;
+    if (r != SCPE_OK)
+        return r;
+    r = _disk_overlay_open (uptr, gbuf, (sim_switches & SWMASK ('O')));
+    if (r != SCPE_OK) {
+        sim_disk_detach (uptr);
+        return r;
+        }
+    uptr->flags = uptr->flags & ~UNIT_RO;               /* writes go to the overlay */
+    return SCPE_OK;
+    }
 if (sim_switches & SWMASK ('C')) {                      /* create vhd disk & copy contents? */
     char gbuf[CBUFSIZE];
     FILE *vhd;
     int saved_sim_switches = sim_switches;
     int32 saved_sim_quiet = sim_quiet;
     uint32 capac_factor;
+    t_bool dedup = (DK_GET_FMT (uptr) == DKUF_F_DDC);   /* importing into a deduplicating container? */
     t_stat r;
 
     sim_switches = sim_switches & ~(SWMASK ('C'));
     cptr = get_glyph_nc (cptr, gbuf, 0);                /* get spec */
     if (*cptr == 0)                                     /* must be more */
         return SCPE_2FARG;
+    if (dedup)                                          /* source format is determined when it is opened */
+        sim_disk_set_fmt (uptr, 0, "SIMH", NULL);
     sim_switches |= SWMASK ('R') | SWMASK ('E');
     sim_quiet = TRUE;
     /* First open the source of the copy operation */
@@ -870,12 +2957,17 @@ if (sim_switches & SWMASK ('C')) {                      /* create vhd disk & cop
     sim_quiet = saved_sim_quiet;
     if (r != SCPE_OK) {
         sim_switches = saved_sim_switches;
+        if (dedup)
+            sim_disk_set_fmt (uptr, 0, "DEDUP", NULL);
         return r;
         }
     if (!sim_quiet) 
         printf ("%s%d: creating new virtual disk '%s'\n", sim_dname (dptr), (int)(uptr-dptr->units), gbuf);
     capac_factor = ((dptr->dwidth / dptr->aincr) == 16) ? 2 : 1; /* capacity units (word: 2, byte: 1) */
-    vhd = sim_vhd_disk_create (gbuf, uptr->capac*capac_factor);
+    if (dedup)
+        vhd = sim_dedup_disk_create (gbuf, uptr->capac*capac_factor);
+    else
+        vhd = sim_vhd_disk_create (gbuf, uptr->capac*capac_factor);
     if (!vhd) {
         if (!sim_quiet)
             printf ("%s%d: can't create virtual disk '%s'\n", sim_dname (dptr), (int)(uptr-dptr->units), gbuf);
@@ -903,9 +2995,9 @@ if (sim_switches & SWMASK ('C')) {                      /* create vhd disk & cop
                 uint32 saved_unit_flags = uptr->flags;
                 FILE *save_unit_fileref = uptr->fileref;
 
-                sim_disk_set_fmt (uptr, 0, "VHD", NULL);
+                sim_disk_set_fmt (uptr, 0, dedup ? "DEDUP" : "VHD", NULL);
                 uptr->fileref = vhd;
-                r = sim_disk_wrsect (uptr, lba, copy_buf, NULL, sects);
+                r = _sim_disk_wrsect_fmt (uptr, lba, copy_buf, NULL, sects);
                 uptr->fileref = save_unit_fileref;
                 uptr->flags = saved_unit_flags;
                 }
@@ -916,12 +3008,21 @@ if (sim_switches & SWMASK ('C')) {                      /* create vhd disk & cop
             else
                 printf ("\n%s%d: Error copying: %s.\n", sim_dname (dptr), (int)(uptr-dptr->units), sim_error_text (r));
         free (copy_buf);
-        sim_vhd_disk_close (vhd);
+        if (dedup) {
+            if ((r == SCPE_OK) && !sim_quiet) {
+                printf ("%s%d: ", sim_dname (dptr), (int)(uptr-dptr->units));
+                sim_dedup_disk_info (stdout, vhd);
+                printf ("\n");
+                }
+            sim_dedup_disk_close (vhd);
+            }
+        else
+            sim_vhd_disk_close (vhd);
         sim_disk_detach (uptr);
         if (r == SCPE_OK) {
             created = TRUE;
             strcpy (cptr, gbuf);
-            sim_disk_set_fmt (uptr, 0, "VHD", NULL);
+            sim_disk_set_fmt (uptr, 0, dedup ? "DEDUP" : "VHD", NULL);
             sim_switches = saved_sim_switches;
             }
         else
@@ -949,6 +3050,13 @@ else if (sim_switches & SWMASK ('M')) {                 /* merge difference disk
 
 switch (DK_GET_FMT (uptr)) {                            /* case on format */
     case DKUF_F_STD:                                    /* SIMH format */
+        if (sim_dedup_disk_probe (cptr)) {
+            sim_disk_set_fmt (uptr, 0, "DEDUP", NULL);  /* set file format to DEDUP */
+            auto_format = TRUE;
+            open_function = sim_dedup_disk_open;
+            size_function = sim_dedup_disk_size;
+            break;
+            }
         if (NULL == (uptr->fileref = sim_vhd_disk_open (cptr, "rb"))) {
             open_function = sim_fopen;
             size_function = sim_fsize_ex;
@@ -964,6 +3072,11 @@ switch (DK_GET_FMT (uptr)) {                            /* case on format */
         create_function = sim_vhd_disk_create;
         size_function = sim_vhd_disk_size;
         break;
+    case DKUF_F_DDC:                                    /* DEDUP format */
+        open_function = sim_dedup_disk_open;
+        create_function = sim_dedup_disk_create;
+        size_function = sim_dedup_disk_size;
+        break;
     case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
         open_function = sim_os_disk_open_raw;
         size_function = sim_os_disk_size_raw;
@@ -1027,12 +3140,23 @@ if (DK_GET_FMT (uptr) == DKUF_F_VHD) {
     if ((created) && dtype)
         sim_vhd_disk_set_dtype (uptr->fileref, dtype);
     if (dtype && strcmp (dtype, sim_vhd_disk_get_dtype (uptr->fileref))) {
-        char cmd[32];
+        char cmd[CBUFSIZE];
 
         sprintf (cmd, "%s%d %s", dptr->name, (int)(uptr-dptr->units), sim_vhd_disk_get_dtype (uptr->fileref));
         set_cmd (0, cmd);
         }
     }
+if (DK_GET_FMT (uptr) == DKUF_F_DDC) {
+    if ((created) && dtype)
+        sim_dedup_disk_set_dtype (uptr->fileref, dtype);
+    if (dtype && *sim_dedup_disk_get_dtype (uptr->fileref) && 
+        strcmp (dtype, sim_dedup_disk_get_dtype (uptr->fileref))) {
+        char cmd[CBUFSIZE];
+
+        sprintf (cmd, "%s%d %s", dptr->name, (int)(uptr-dptr->units), sim_dedup_disk_get_dtype (uptr->fileref));
+        set_cmd (0, cmd);
+        }
+    }
 uptr->flags = uptr->flags | UNIT_ATT;
 uptr->pos = 0;
 
@@ -1089,6 +3213,18 @@ if (capac && (capac != (t_addr)-1)) {
             uptr->capac = capac/ctx->capac_factor;
     }
 
+if (sim_switches & (SWMASK ('U') | SWMASK ('Y') | SWMASK ('P'))) {/* alternate transfer engine? */
+    int engine = DISK_ENGINE_URING;
+
+    if (sim_switches & SWMASK ('Y'))
+        engine = DISK_ENGINE_DIRECT;
+    if (sim_switches & SWMASK ('P'))
+        engine = DISK_ENGINE_MMAP;
+    if ((_disk_engine_open (uptr, engine) != SCPE_OK) && !sim_quiet)
+        printf ("%s%d: %s transfers unavailable, using standard I/O\n", sim_dname (dptr), (int)(uptr-dptr->units), 
+                (engine == DISK_ENGINE_MMAP) ? "memory mapped" : "io_uring");
+    }
+_disk_cache_join (uptr);
 #if defined (SIM_ASYNCH_IO)
 sim_disk_set_async (uptr, completion_delay);
 #endif
@@ -1119,6 +3255,9 @@ switch (DK_GET_FMT (uptr)) {                            /* case on format */
     case DKUF_F_VHD:                                    /* Virtual Disk */
         close_function = sim_vhd_disk_close;
         break;
+    case DKUF_F_DDC:                                    /* Deduplicating container */
+        close_function = sim_dedup_disk_close;
+        break;
     case DKUF_F_RAW:                                    /* Physical */
         close_function = sim_os_disk_close_raw;
         break;
@@ -1137,6 +3276,9 @@ if (uptr->io_flush)
     uptr->io_flush (uptr);                              /* flush buffered data */
 
 sim_disk_clr_async (uptr);
+_disk_cache_leave (uptr);
+_disk_engine_close (uptr);
+_disk_overlay_close (uptr);
 
 uptr->flags &= ~(UNIT_ATT | UNIT_RO);
 uptr->dynflags &= ~UNIT_NO_FIO;
@@ -1157,13 +3299,15 @@ t_stat sim_disk_attach_help(FILE *st, DEVICE *dptr, UNIT *uptr, int32 flag, char
 {
 fprintf (st, "%s Disk Attach Help\n\n", dptr->name);
 
-fprintf (st, "Disk container files can be one of 3 different types:\n\n");
+fprintf (st, "Disk container files can be one of 4 different types:\n\n");
 fprintf (st, "    SIMH   A disk is an unstructured binary file of the size appropriate\n");
 fprintf (st, "           for the disk drive being simulated\n");
 fprintf (st, "    VHD    Virtual Disk format which is described in the \"Microsoft\n");
 fprintf (st, "           Virtual Hard Disk (VHD) Image Format Specification\".  The\n");
 fprintf (st, "           VHD implementation includes support for 1) Fixed (Preallocated)\n");
 fprintf (st, "           disks, 2) Dynamically Expanding disks, and 3) Differencing disks.\n");
+fprintf (st, "    DEDUP  A container which stores each distinct block of the disk once,\n");
+fprintf (st, "           compressed, and doesn't store blocks of zeros at all\n");
 fprintf (st, "    RAW    platform specific access to physical disk or CDROM drives\n\n");
 fprintf (st, "Virtual (VHD) Disks  supported conform to \"Virtual Hard Disk Image Format\n");
 fprintf (st, "Specification\", Version 1.0 October 11, 2006.\n");
@@ -1175,7 +3319,9 @@ fprintf (st, "2GB as different sectors are written to.  The VHD format contains
 fprintf (st, "which describes the drive size and the simh device type in use when the VHD\n");
 fprintf (st, "was created.  This metadata is therefore available whenever that VHD is\n");
 fprintf (st, "attached to an emulated disk device in the future so the device type and\n");
-fprintf (st, "size can be automatically be configured.\n\n");
+fprintf (st, "size can be automatically be configured.\n");
+fprintf (st, "DEDUP containers are useful for keeping many similar disk images.  An\n");
+fprintf (st, "existing disk is imported by SET %s FORMAT=DEDUP followed by ATTACH -C.\n\n", dptr->name);
 
 if (0 == (uptr-dptr->units)) {
     if (dptr->numunits > 1) {
@@ -1195,17 +3341,28 @@ fprintf (st, "    -R          Attach Read Only.\n");
 fprintf (st, "    -E          Must Exist (if not specified an attempt to create the indicated\n");
 fprintf (st, "                disk container will be attempted).\n");
 fprintf (st, "    -F          Open the indicated disk container in a specific format (default\n");
-fprintf (st, "                is to autodetect VHD defaulting to simh if the indicated\n");
-fprintf (st, "                container is not a VHD).\n");
-fprintf (st, "    -C          Create a VHD and copy its contents from another disk (simh, VHD,\n");
-fprintf (st, "                or RAW format).\n");
+fprintf (st, "                is to autodetect VHD or DEDUP defaulting to simh if the\n");
+fprintf (st, "                indicated container is neither).\n");
+fprintf (st, "    -C          Create a VHD (or a DEDUP container when the unit's format is\n");
+fprintf (st, "                DEDUP) and copy its contents from another disk (simh, VHD,\n");
+fprintf (st, "                DEDUP or RAW format).\n");
 fprintf (st, "    -X          When creating a VHD, create a fixed sized VHD (vs a Dynamically\n");
 fprintf (st, "                expanding one).\n");
 fprintf (st, "    -D          Create a Differencing VHD (relative to an already existing VHD\n");
 fprintf (st, "                disk)\n");
 fprintf (st, "    -M          Merge a Differencing VHD into its parent VHD disk\n");
 fprintf (st, "    -O          Override consistency checks when attaching differencing disks\n");
-fprintf (st, "                which have unexpected parent disk GUID or timestamps\n\n");
+fprintf (st, "                which have unexpected parent disk GUID or timestamps\n");
+fprintf (st, "    -U          Transfer with Linux io_uring (simh and RAW formats only)\n");
+fprintf (st, "    -Y          Transfer with Linux io_uring bypassing the host's page cache\n");
+fprintf (st, "                (O_DIRECT)\n");
+fprintf (st, "    -P          Transfer through a memory mapping of the container (simh\n");
+fprintf (st, "                format only)\n");
+fprintf (st, "    -S          Attach a simh format disk read only beneath a copy-on-write\n");
+fprintf (st, "                overlay file which receives all writes (the overlay is\n");
+fprintf (st, "                created if it doesn't exist).  SET <unit> OVERLAY=COMMIT\n");
+fprintf (st, "                writes the overlay's contents into the base disk and\n");
+fprintf (st, "                SET <unit> OVERLAY=DISCARD empties it\n\n");
 fprintf (st, "Examples:\n");
 fprintf (st, "  sim> show rq\n");
 fprintf (st, "    RQ, address=20001468-2000146B*, no vector, 4 units\n");
@@ -1291,6 +3448,7 @@ if (!(uptr->flags & UNIT_ATTABLE))                      /* not attachable? */
 switch (DK_GET_FMT (uptr)) {                            /* case on format */
     case DKUF_F_STD:                                    /* SIMH format */
     case DKUF_F_VHD:                                    /* VHD format */
+    case DKUF_F_DDC:                                    /* DEDUP format */
     case DKUF_F_RAW:                                    /* Raw Physical Disk Access */
         perror (msg);
     default:
@@ -1310,6 +3468,9 @@ switch (DK_GET_FMT (uptr)) {                            /* case on format */
     case DKUF_F_VHD:                                    /* VHD format */
         sim_vhd_disk_clearerr (uptr);
         break;
+    case DKUF_F_DDC:                                    /* DEDUP format */
+        sim_dedup_disk_clearerr (uptr);
+        break;
     default:
         ;
     }
@@ -1931,6 +4092,10 @@ ssize_t bytesread;
 
 sim_debug (ctx->dbit, ctx->dptr, "sim_os_disk_rdsect(unit=%d, lba=0x%X, sects=%d)\n", (int)(uptr-ctx->dptr->units), lba, sects);
 
+#if defined (HAVE_IO_URING)
+if (ctx->uring)
+    return _disk_uring_rw (uptr, FALSE, lba, buf, sectsread, sects, 1);
+#endif
 addr = ((off_t)lba) * ctx->sector_size;
 bytesread = pread((int)((long)uptr->fileref), buf, sects * ctx->sector_size, addr); 
 if (bytesread < 0) {
@@ -1951,6 +4116,10 @@ ssize_t byteswritten;
 
 sim_debug (ctx->dbit, ctx->dptr, "sim_os_disk_wrsect(unit=%d, lba=0x%X, sects=%d)\n", (int)(uptr-ctx->dptr->units), lba, sects);
 
+#if defined (HAVE_IO_URING)
+if (ctx->uring)
+    return _disk_uring_rw (uptr, TRUE, lba, buf, sectswritten, sects, 1);
+#endif
 addr = ((off_t)lba) * ctx->sector_size;
 byteswritten = pwrite((int)((long)uptr->fileref), buf, sects * ctx->sector_size, addr); 
 if (byteswritten < 0) {
@@ -2717,8 +4886,99 @@ struct VHD_IOData {
     FILE *File;
     char ParentVHDPath[512];
     struct VHD_IOData *Parent;
+    t_bool BATDirty;                /* BAT entries changed since last written */
+    uint32 BATDirtyLow;             /* lowest changed BAT entry */
+    uint32 BATDirtyHigh;            /* highest changed BAT entry */
+    uint8 *WriteRun;                /* data of coalesced pending writes */
+    size_t WriteRunSize;            /* bytes pending */
+    uint64 WriteRunPosition;        /* file position of pending data */
     };
 
+/* Sector writes to a dynamic or fixed VHD are gathered into a run while
+   each starts where the previous one ended, and the run is written with
+   a single host write when a non adjacent write arrives, when the disk 
+   is read, or when it is flushed or closed.  BAT entries changed as data
+   blocks are allocated are written back when the disk is flushed or 
+   closed rather than as each block is allocated. */
+
+#define VHD_WRITE_RUN_MAX   (1024*1024)     /* largest coalesced write */
+
+static t_stat VHDFlushWriteRun (VHDHANDLE hVHD)
+{
+t_stat r = SCPE_OK;
+
+if (hVHD->WriteRunSize) {
+    r = WriteFilePosition (hVHD->File,
+                           hVHD->WriteRun,
+                           hVHD->WriteRunSize,
+                           NULL,
+                           hVHD->WriteRunPosition);
+    hVHD->WriteRunSize = 0;
+    }
+return r;
+}
+
+static t_stat VHDWriteData (VHDHANDLE hVHD, void *buf, size_t bufsize, uint64 position)
+{
+if ((hVHD->WriteRunSize) &&
+    (((hVHD->WriteRunPosition + hVHD->WriteRunSize) != position) ||
+     ((hVHD->WriteRunSize + bufsize) > VHD_WRITE_RUN_MAX))) {
+    if (VHDFlushWriteRun (hVHD))
+        return SCPE_IOERR;
+    }
+if ((hVHD->WriteRun == NULL) && (bufsize < VHD_WRITE_RUN_MAX))
+    hVHD->WriteRun = (uint8 *)malloc (VHD_WRITE_RUN_MAX);
+if ((hVHD->WriteRun == NULL) || (bufsize >= VHD_WRITE_RUN_MAX))
+    return WriteFilePosition (hVHD->File, buf, bufsize, NULL, position);
+if (hVHD->WriteRunSize == 0)
+    hVHD->WriteRunPosition = position;
+memcpy (hVHD->WriteRun + hVHD->WriteRunSize, buf, bufsize);
+hVHD->WriteRunSize += bufsize;
+return SCPE_OK;
+}
+
+static void VHDMarkBATDirty (VHDHANDLE hVHD, uint32 BlockNumber)
+{
+if (!hVHD->BATDirty) {
+    hVHD->BATDirty = TRUE;
+    hVHD->BATDirtyLow = hVHD->BATDirtyHigh = BlockNumber;
+    return;
+    }
+if (BlockNumber < hVHD->BATDirtyLow)
+    hVHD->BATDirtyLow = BlockNumber;
+if (BlockNumber > hVHD->BATDirtyHigh)
+    hVHD->BATDirtyHigh = BlockNumber;
+}
+
+static t_stat VHDFlushBAT (VHDHANDLE hVHD)
+{
+size_t BATSize, Start, End;
+
+if (!hVHD->BATDirty)
+    return SCPE_OK;
+/* Write the whole 512 byte sectors which hold the changed entries */
+BATSize = 512*((sizeof(*hVHD->BAT)*NtoHl(hVHD->Dynamic.MaxTableEntries) + 511)/512);
+Start = (sizeof(*hVHD->BAT)*hVHD->BATDirtyLow) & ~((size_t)511);
+End = (sizeof(*hVHD->BAT)*(hVHD->BATDirtyHigh + 1) + 511) & ~((size_t)511);
+if (End > BATSize)
+    End = BATSize;
+hVHD->BATDirty = FALSE;
+return WriteFilePosition (hVHD->File,
+                          ((uint8 *)hVHD->BAT) + Start,
+                          End - Start,
+                          NULL,
+                          NtoHll(hVHD->Dynamic.TableOffset) + Start);
+}
+
+static t_stat VHDFlush (VHDHANDLE hVHD)
+{
+t_stat r = VHDFlushWriteRun (hVHD);
+
+if (VHDFlushBAT (hVHD))
+    r = SCPE_IOERR;
+return r;
+}
+
 static t_stat sim_vhd_disk_implemented (void)
 {
 return sim_taddr_64 ? SCPE_OK : SCPE_NOFNC;
@@ -2734,6 +4994,8 @@ memcpy (hVHD->Footer.DriveType, dtype, ((1+strlen (dtype)) < sizeof (hVHD->Foote
 hVHD->Footer.Checksum = 0;
 hVHD->Footer.Checksum = NtoHl (CalculateVhdFooterChecksum (&hVHD->Footer, sizeof(hVHD->Footer)));
 
+if (VHDFlushWriteRun (hVHD))
+    return SCPE_IOERR;
 if (NtoHl (hVHD->Footer.DiskType) == VHD_DT_Fixed) {
     if (WriteFilePosition(hVHD->File,
                           &hVHD->Footer,
@@ -2970,11 +5232,13 @@ VHDHANDLE hVHD = (VHDHANDLE)f;
 if (NULL != hVHD) {
     if (hVHD->Parent)
         sim_vhd_disk_close ((FILE *)hVHD->Parent);
-    free (hVHD->BAT);
     if (hVHD->File) {
+        VHDFlush (hVHD);
         fflush (hVHD->File);
         fclose (hVHD->File);
         }
+    free (hVHD->BAT);
+    free (hVHD->WriteRun);
     free (hVHD);
     return 0;
     }
@@ -2985,8 +5249,10 @@ static void sim_vhd_disk_flush (FILE *f)
 {
 VHDHANDLE hVHD = (VHDHANDLE)f;
 
-if ((NULL != hVHD) && (hVHD->File))
+if ((NULL != hVHD) && (hVHD->File)) {
+    VHDFlush (hVHD);
     fflush (hVHD->File);
+    }
 }
 
 static t_addr sim_vhd_disk_size (FILE *f)
@@ -3484,346 +5750,1120 @@ if (WriteFilePosition (hVHD->File,
     goto Cleanup_Return;
     }
 
-Cleanup_Return:
-free (RelativeParentVHDPath);
-free (FullParentVHDPath);
-free (RelativeParentVHDPathUnicode);
-free (FullParentVHDPathUnicode);
-free (FullVHDPath);
-sim_vhd_disk_close ((FILE *)hVHD);
-hVHD = NULL;
-if (Status) {
-    if (EEXIST != Status)
-        remove (szVHDPath);
-    }
-else {
-    hVHD = (VHDHANDLE)sim_vhd_disk_open (szVHDPath, "rb+");
-    if (!hVHD)
-        Status = errno;
+Cleanup_Return:
+free (RelativeParentVHDPath);
+free (FullParentVHDPath);
+free (RelativeParentVHDPathUnicode);
+free (FullParentVHDPathUnicode);
+free (FullVHDPath);
+sim_vhd_disk_close ((FILE *)hVHD);
+hVHD = NULL;
+if (Status) {
+    if (EEXIST != Status)
+        remove (szVHDPath);
+    }
+else {
+    hVHD = (VHDHANDLE)sim_vhd_disk_open (szVHDPath, "rb+");
+    if (!hVHD)
+        Status = errno;
+    }
+errno = Status;
+return hVHD;
+}
+
+static FILE *sim_vhd_disk_create (const char *szVHDPath, t_addr desiredsize)
+{
+return (FILE *)CreateVirtualDisk (szVHDPath, (uint32)(desiredsize/512), 0, (sim_switches & SWMASK ('X')));
+}
+
+static FILE *sim_vhd_disk_create_diff (const char *szVHDPath, const char *szParentVHDPath)
+{
+return (FILE *)CreateDifferencingVirtualDisk (szVHDPath, szParentVHDPath);
+}
+
+static t_stat
+ReadVirtualDiskSectors(VHDHANDLE hVHD,
+                       uint8 *buf,
+                       t_seccnt sects,
+                       t_seccnt *sectsread,
+                       uint32 SectorSize,
+                       t_lba lba)
+{
+uint64 BlockOffset = ((uint64)lba)*SectorSize;
+uint32 BlocksRead = 0;
+uint32 SectorsInRead;
+size_t BytesRead = 0;
+
+if (!hVHD || (hVHD->File == NULL)) {
+    errno = EBADF;
+    return SCPE_IOERR;
+    }
+if ((BlockOffset + sects*SectorSize) > (uint64)NtoHll (hVHD->Footer.CurrentSize)) {
+    errno = ERANGE;
+    return SCPE_IOERR;
+    }
+if (VHDFlushWriteRun (hVHD))                            /* make pending writes visible */
+    return SCPE_IOERR;
+if (NtoHl (hVHD->Footer.DiskType) == VHD_DT_Fixed) {
+    if (ReadFilePosition(hVHD->File,
+                         buf,
+                         sects*SectorSize,
+                         &BytesRead,
+                         BlockOffset)) {
+        if (sectsread)
+            *sectsread = (t_seccnt)(BytesRead/SectorSize);
+        return SCPE_IOERR;
+        }
+    if (sectsread)
+        *sectsread /= SectorSize;
+    return SCPE_OK;
+    }
+/* We are now dealing with a Dynamically expanding or differencing disk */
+while (sects) {
+    uint32 SectorsPerBlock = NtoHl (hVHD->Dynamic.BlockSize)/SectorSize;
+    uint64 BlockNumber = lba/SectorsPerBlock;
+    uint32 BitMapBytes = (7+(NtoHl (hVHD->Dynamic.BlockSize)/SectorSize))/8;
+    uint32 BitMapSectors = (BitMapBytes+SectorSize-1)/SectorSize;
+
+    SectorsInRead = SectorsPerBlock - lba%SectorsPerBlock;
+    if (SectorsInRead > sects)
+        SectorsInRead = sects;
+    if (hVHD->BAT[BlockNumber] == VHD_BAT_FREE_ENTRY) {
+        if (!hVHD->Parent)
+            memset (buf, 0, SectorSize*SectorsInRead);
+        else {
+            if (ReadVirtualDiskSectors(hVHD->Parent,
+                                       buf,
+                                       SectorsInRead,
+                                       NULL,
+                                       SectorSize,
+                                       lba)) {
+                if (sectsread)
+                    *sectsread = BlocksRead;
+                return FALSE;
+                }
+            }
+        }
+    else {
+        BlockOffset = SectorSize*((uint64)(NtoHl (hVHD->BAT[BlockNumber]) + lba%SectorsPerBlock + BitMapSectors));
+        if (ReadFilePosition(hVHD->File,
+                             buf,
+                             SectorsInRead*SectorSize,
+                             NULL,
+                             BlockOffset)) {
+            if (sectsread)
+                *sectsread = BlocksRead;
+            return SCPE_IOERR;
+            }
+        }
+    sects -= SectorsInRead;
+    buf = (uint8 *)(((char *)buf) + SectorSize*SectorsInRead);
+    lba += SectorsInRead;
+    BlocksRead += SectorsInRead;
+    }
+if (sectsread)
+    *sectsread = BlocksRead;
+return SCPE_OK;
+}
+
+static t_stat sim_vhd_disk_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects)
+{
+VHDHANDLE hVHD = (VHDHANDLE)uptr->fileref;
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+
+return ReadVirtualDiskSectors(hVHD, buf, sects, sectsread, ctx->sector_size, lba);
+}
+
+static t_stat sim_vhd_disk_clearerr (UNIT *uptr)
+{
+VHDHANDLE hVHD = (VHDHANDLE)uptr->fileref;
+
+clearerr (hVHD->File);
+return SCPE_OK;
+}
+
+static t_bool
+BufferIsZeros(void *Buffer, size_t BufferSize)
+{
+size_t i;
+char *c = (char *)Buffer;
+
+for (i=0; i<BufferSize; ++i)
+    if (c[i])
+        return FALSE;
+return TRUE;
+}
+
+static t_stat
+WriteVirtualDiskSectors(VHDHANDLE hVHD,
+                        uint8 *buf,
+                        t_seccnt sects,
+                        t_seccnt *sectswritten,
+                        uint32 SectorSize,
+                        t_lba lba)
+{
+uint64 BlockOffset = ((uint64)lba)*SectorSize;
+uint32 BlocksWritten = 0;
+uint32 SectorsInWrite;
+
+if (!hVHD || !hVHD->File) {
+    errno = EBADF;
+    return SCPE_IOERR;
+    }
+if ((BlockOffset + sects*SectorSize) > (uint64)NtoHll(hVHD->Footer.CurrentSize)) {
+    errno = ERANGE;
+    return SCPE_IOERR;
+    }
+if (NtoHl(hVHD->Footer.DiskType) == VHD_DT_Fixed) {
+    if (VHDWriteData (hVHD,
+                      buf,
+                      sects*SectorSize,
+                      BlockOffset)) {
+        if (sectswritten)
+            *sectswritten = 0;
+        return SCPE_IOERR;
+        }
+    if (sectswritten)
+        *sectswritten = sects;
+    return SCPE_OK;
+    }
+/* We are now dealing with a Dynamically expanding or differencing disk */
+while (sects) {
+    uint32 SectorsPerBlock = NtoHl(hVHD->Dynamic.BlockSize)/SectorSize;
+    uint64 BlockNumber = lba/SectorsPerBlock;
+    uint32 BitMapBytes = (7+(NtoHl(hVHD->Dynamic.BlockSize)/SectorSize))/8;
+    uint32 BitMapSectors = (BitMapBytes+SectorSize-1)/SectorSize;
+
+    if (BlockNumber >= NtoHl(hVHD->Dynamic.MaxTableEntries)) {
+        if (sectswritten)
+            *sectswritten = BlocksWritten;
+        return SCPE_EOF;
+        }
+    SectorsInWrite = 1;
+    if (hVHD->BAT[BlockNumber] == VHD_BAT_FREE_ENTRY) {
+        uint8 *BitMap = NULL;
+        uint32 BitMapBufferSize = VHD_DATA_BLOCK_ALIGNMENT;
+        uint8 *BitMapBuffer = NULL;
+        uint8 *BlockStart;
+        uint8 *BlockData;
+        uint32 BlockSectors = SectorsPerBlock;
+        t_lba BlockLba = (lba/SectorsPerBlock)*SectorsPerBlock;
+
+        if (!hVHD->Parent && BufferIsZeros(buf, SectorSize))
+            goto IO_Done;
+        /* Need to allocate a new Data Block.  The block's bitmap, its 
+           contents (from the parent disk, if any, merged with the sectors
+           being written) and the relocated footer are written together. */
+        BlockOffset = sim_fsize_ex (hVHD->File);
+        if (((int64)BlockOffset) == -1)
+            return SCPE_IOERR;
+        if (BitMapSectors*SectorSize > BitMapBufferSize)
+            BitMapBufferSize = BitMapSectors*SectorSize;
+        BitMapBuffer = (uint8 *)calloc(1, BitMapBufferSize + SectorSize*(BitMapSectors + SectorsPerBlock) + sizeof(hVHD->Footer));
+        if (BitMapBuffer == NULL)
+            return SCPE_MEM;
+        if (BitMapBufferSize > BitMapSectors*SectorSize)
+            BitMap = BitMapBuffer + BitMapBufferSize-BitMapBytes;
+        else
+            BitMap = BitMapBuffer;
+        memset(BitMap, 0xFF, BitMapBytes);
+        BlockOffset -= sizeof(hVHD->Footer);
+        if (0 == (BlockOffset & ~(VHD_DATA_BLOCK_ALIGNMENT-1)))
+            {  // Already aligned, so use padded BitMapBuffer
+            BlockStart = BitMapBuffer;
+            BlockData = BitMapBuffer + BitMapBufferSize;
+            BlockOffset += BitMapBufferSize - BitMapSectors*SectorSize;
+            }
+        else
+            {
+            // align the data portion of the block to the desired alignment
+            // compute the address of the data portion of the block
+            BlockOffset += BitMapSectors*SectorSize;
+            // round up this address to the desired alignment
+            BlockOffset += VHD_DATA_BLOCK_ALIGNMENT-1;
+            BlockOffset &= ~(VHD_DATA_BLOCK_ALIGNMENT-1);
+            BlockOffset -= BitMapSectors*SectorSize;
+            BlockStart = BitMap;
+            BlockData = BitMap + BitMapSectors*SectorSize;
+            }
+        if (hVHD->Parent)
+            { /* Need to populate data block contents from parent VHD */
+            if ((BlockLba + BlockSectors) > ((uint64)NtoHll (hVHD->Footer.CurrentSize))/SectorSize)
+                BlockSectors = (uint32)(((uint64)NtoHll (hVHD->Footer.CurrentSize))/SectorSize - BlockLba);
+            if (ReadVirtualDiskSectors(hVHD->Parent,
+                                       BlockData, 
+                                       BlockSectors,
+                                       NULL,
+                                       SectorSize,
+                                       BlockLba)) {
+                free (BitMapBuffer);
+                if (sectswritten)
+                    *sectswritten = BlocksWritten;
+                return SCPE_IOERR;
+                }
+            }
+        SectorsInWrite = SectorsPerBlock - lba%SectorsPerBlock;
+        if (SectorsInWrite > sects)
+            SectorsInWrite = sects;
+        memcpy (BlockData + SectorSize*(lba%SectorsPerBlock), buf, SectorSize*SectorsInWrite);
+        memcpy (BlockData + SectorSize*SectorsPerBlock, &hVHD->Footer, sizeof(hVHD->Footer));
+        if (WriteFilePosition(hVHD->File,
+                              BlockStart,
+                              (BlockData - BlockStart) + SectorSize*SectorsPerBlock + sizeof(hVHD->Footer),
+                              NULL,
+                              BlockOffset + BitMapSectors*SectorSize - (BlockData - BlockStart))) {
+            free (BitMapBuffer);
+            fclose (hVHD->File);
+            hVHD->File = NULL;
+            return SCPE_IOERR;
+            }
+        free (BitMapBuffer);
+        /* the BAT block address is the beginning of the block bitmap */
+        hVHD->BAT[BlockNumber] = NtoHl((uint32)(BlockOffset/SectorSize));
+        VHDMarkBATDirty (hVHD, (uint32)BlockNumber);
+        }
+    else {
+        BlockOffset = 512*((uint64)(NtoHl(hVHD->BAT[BlockNumber]) + lba%SectorsPerBlock + BitMapSectors));
+        SectorsInWrite = SectorsPerBlock - lba%SectorsPerBlock;
+        if (SectorsInWrite > sects)
+            SectorsInWrite = sects;
+        if (VHDWriteData (hVHD,
+                          buf,
+                          SectorsInWrite*SectorSize,
+                          BlockOffset)) {
+            if (sectswritten)
+                *sectswritten = BlocksWritten;
+            return SCPE_IOERR;
+            }
+        }
+IO_Done:
+    sects -= SectorsInWrite;
+    buf = (uint8 *)(((char *)buf) + SectorsInWrite*SectorSize);
+    lba += SectorsInWrite;
+    BlocksWritten += SectorsInWrite;
+    }
+if (sectswritten)
+    *sectswritten = BlocksWritten;
+return SCPE_OK;
+}
+
+static t_stat sim_vhd_disk_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects)
+{
+VHDHANDLE hVHD = (VHDHANDLE)uptr->fileref;
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+
+return WriteVirtualDiskSectors(hVHD, buf, sects, sectswritten, ctx->sector_size, lba);
+}
+#endif
+
+/*============================================================================*/
+/*                     Deduplicating disk container support                   */
+/*============================================================================*/
+
+/* Deduplicating disk containers
+
+   A DEDUP format container holds the simulated disk as fixed size blocks 
+   which are stored once however many times their contents appear.  Blocks 
+   of zeros aren't stored at all.  Each stored block is compressed (with 
+   sim_lz4_compress) when that makes it smaller.  The block 
+   index maps each logical block of the disk to the slot in the store 
+   holding its contents.  The index and the header are kept in memory and 
+   written back when the unit is flushed or detached.  A slot whose 
+   contents are no longer referenced is reused for later writes.
+
+   Container layout (integers are little endian):
+
+      0     "SIMHDDK1"
+      8     block size
+      12    blocks in the index
+      16    offset of the index
+      20    offset of the store
+      24    disk capacity in bytes (low and high 32 bits)
+      32    end of the store (low and high 32 bits)
+      64    drive type
+      512   block index, 0 for a block of zeros, otherwise slot offset/16
+      ...   store, starting on a 4096 byte boundary
+
+   Each slot in the store starts with a 16 byte header holding the stored 
+   length (0 for a free slot, the block size if not compressed), the size 
+   of the slot including the header, and a 64 bit hash of the block's 
+   contents.  Slots are contiguous, so the store can be walked when the 
+   container is opened to rebuild the list of free slots and the hash 
+   table used to find blocks whose contents are already stored.
+*/
+
+#if defined (DONT_DO_VHD_SUPPORT) && !defined (DONT_DO_DEDUP_SUPPORT)
+#define DONT_DO_DEDUP_SUPPORT  /* block hashes need 64 bit integers too */
+#endif
+
+#if !defined (DONT_DO_DEDUP_SUPPORT)
+
+#define DEDUP_MAGIC         "SIMHDDK1"
+#define DEDUP_HDR_SIZE      512                 /* header size */
+#define DEDUP_DTYPE         64                  /* offset of the drive type */
+#define DEDUP_BLKSIZE       4096                /* bytes per block */
+#define DEDUP_ALIGN         4096                /* store alignment */
+#define DEDUP_SLOT_HDR      16                  /* slot header size */
+#define DEDUP_SLOT_UNIT     16                  /* slot size and offset granularity */
+#define DEDUP_MIN_FREE      64                  /* smallest slot remainder kept free */
+
+struct dedup_chunk {
+    struct dedup_chunk  *hnext;             /* hash chain by contents */
+    struct dedup_chunk  *snext;             /* hash chain by slot */
+    uint32              slot;               /* slot offset/16 */
+    uint32              size;               /* slot size */
+    uint32              length;             /* stored length */
+    uint32              refs;               /* index entries using it */
+    t_uint64            hash;
+    };
+
+struct dedup_free {
+    t_addr              pos;                /* slot offset */
+    uint32              size;               /* slot size */
+    };
+
+typedef struct {
+    FILE                *file;
+    uint32              hdr[8];             /* block size, blocks, index, store, capacity (2), store end (2) */
+    char                dtype[32];          /* drive type */
+    uint32              blksize;
+    uint32              blocks;
+    t_addr              capac;              /* disk capacity in bytes */
+    t_addr              store;              /* offset of store */
+    t_addr              store_end;          /* end of last slot */
+    uint32              *index;             /* block index */
+    t_bool              dirty;              /* index or header changed since written */
+    struct dedup_chunk  **by_hash;
+    struct dedup_chunk  **by_slot;
+    uint32              hash_mask;
+    struct dedup_free   *free;              /* free slots */
+    uint32              nfree;
+    uint32              free_max;
+    struct dedup_free   *retired;           /* slots freed since the index was written */
+    uint32              nretired;
+    uint32              retired_max;
+    uint8               *blk;               /* block being written */
+    uint8               *cmp;               /* compressed block */
+    uint8               *tmp;               /* slot being read */
+    uint8               *rblk;              /* last block read */
+    uint32              rblk_no;            /* its block number (blocks if none) */
+    uint32              chunks;             /* distinct blocks stored */
+    uint32              compressed;         /* of which compressed */
+    uint32              dedups;             /* writes satisfied by a stored block */
+    } *DEDUPHANDLE;
+
+static uint32 _dedup_get32 (const uint8 *p)
+{
+return ((uint32)p[0]) | (((uint32)p[1]) << 8) | (((uint32)p[2]) << 16) | (((uint32)p[3]) << 24);
+}
+
+static t_uint64 _dedup_hash (const uint8 *data, uint32 len)
+{
+t_uint64 h = 14695981039346656037ull;
+uint32 i;
+
+for (i = 0; i + 4 <= len; i += 4)
+    h = (h ^ _dedup_get32 (data + i)) * 1099511628211ull;
+return h ^ (h >> 29);
+}
+
+static uint32 _dedup_bucket (DEDUPHANDLE hd, t_uint64 key)
+{
+return (uint32)((key ^ (key >> 32)) * 2654435761u) & hd->hash_mask;
+}
+
+static struct dedup_chunk *_dedup_find_slot (DEDUPHANDLE hd, uint32 slot)
+{
+struct dedup_chunk *c;
+
+for (c = hd->by_slot[_dedup_bucket (hd, slot)]; c; c = c->snext)
+    if (c->slot == slot)
+        return c;
+return NULL;
+}
+
+static void _dedup_link (DEDUPHANDLE hd, struct dedup_chunk *c)
+{
+uint32 h = _dedup_bucket (hd, c->hash);
+uint32 s = _dedup_bucket (hd, c->slot);
+
+c->hnext = hd->by_hash[h];
+hd->by_hash[h] = c;
+c->snext = hd->by_slot[s];
+hd->by_slot[s] = c;
+}
+
+static void _dedup_unlink (DEDUPHANDLE hd, struct dedup_chunk *c)
+{
+struct dedup_chunk **pc;
+
+for (pc = &hd->by_hash[_dedup_bucket (hd, c->hash)]; *pc != c; pc = &(*pc)->hnext)
+    ;
+*pc = c->hnext;
+for (pc = &hd->by_slot[_dedup_bucket (hd, c->slot)]; *pc != c; pc = &(*pc)->snext)
+    ;
+*pc = c->snext;
+}
+
+static t_stat _dedup_add_slot (struct dedup_free **list, uint32 *n, uint32 *max, t_addr pos, uint32 size)
+{
+if (*n == *max) {
+    uint32 nmax = *max ? 2 * *max : 256;
+    struct dedup_free *f = (struct dedup_free *)realloc (*list, nmax * sizeof (*f));
+
+    if (f == NULL)
+        return SCPE_MEM;
+    *list = f;
+    *max = nmax;
     }
-errno = Status;
-return hVHD;
+(*list)[*n].pos = pos;
+(*list)[*n].size = size;
+++*n;
+return SCPE_OK;
 }
 
-static FILE *sim_vhd_disk_create (const char *szVHDPath, t_addr desiredsize)
+static t_stat _dedup_add_free (DEDUPHANDLE hd, t_addr pos, uint32 size)
 {
-return (FILE *)CreateVirtualDisk (szVHDPath, (uint32)(desiredsize/512), 0, (sim_switches & SWMASK ('X')));
+return _dedup_add_slot (&hd->free, &hd->nfree, &hd->free_max, pos, size);
 }
 
-static FILE *sim_vhd_disk_create_diff (const char *szVHDPath, const char *szParentVHDPath)
+static t_stat _dedup_write_slot_hdr (DEDUPHANDLE hd, t_addr pos, uint32 length, uint32 size, t_uint64 hash);
+
+/* Return a slot to the free list, merging it with free neighbours */
+
+static void _dedup_free_slot (DEDUPHANDLE hd, t_addr pos, uint32 size)
 {
-return (FILE *)CreateDifferencingVirtualDisk (szVHDPath, szParentVHDPath);
+uint32 i;
+
+for (i = 0; i < hd->nfree; ) {
+    struct dedup_free *f = &hd->free[i];
+
+    if (((f->pos + f->size) == pos) || ((pos + size) == f->pos)) {
+        if ((t_uint64)f->size + size > 0x7FFFFFFF) {
+            ++i;
+            continue;
+            }
+        if (f->pos < pos)
+            pos = f->pos;
+        size += f->size;
+        *f = hd->free[--hd->nfree];
+        continue;
+        }
+    ++i;
+    }
+if (pos + size == hd->store_end) {                      /* trailing space goes back to the store */
+    hd->store_end = pos;
+    hd->dirty = TRUE;
+    return;
+    }
+_dedup_write_slot_hdr (hd, pos, 0, size, 0);
+_dedup_add_free (hd, pos, size);
 }
 
-static t_stat
-ReadVirtualDiskSectors(VHDHANDLE hVHD,
-                       uint8 *buf,
-                       t_seccnt sects,
-                       t_seccnt *sectsread,
-                       uint32 SectorSize,
-                       t_lba lba)
+static t_stat _dedup_write_slot_hdr (DEDUPHANDLE hd, t_addr pos, uint32 length, uint32 size, t_uint64 hash)
 {
-uint64 BlockOffset = ((uint64)lba)*SectorSize;
-uint32 BlocksRead = 0;
-uint32 SectorsInRead;
-size_t BytesRead = 0;
+uint32 sh[4];
+
+sh[0] = length;
+sh[1] = size;
+sh[2] = (uint32)hash;
+sh[3] = (uint32)(hash >> 32);
+if ((sim_fseek (hd->file, pos, SEEK_SET)) || 
+    (sim_fwrite (sh, sizeof (sh[0]), 4, hd->file) != 4))
+    return SCPE_IOERR;
+return SCPE_OK;
+}
 
-if (!hVHD || (hVHD->File == NULL)) {
-    errno = EBADF;
+/* Read a stored block into buf */
+
+static t_stat _dedup_read_slot (DEDUPHANDLE hd, uint32 slot, uint8 *buf)
+{
+t_addr pos = ((t_addr)slot) * DEDUP_SLOT_UNIT;
+size_t n;
+uint32 length;
+
+if (sim_fseek (hd->file, pos, SEEK_SET))
     return SCPE_IOERR;
-    }
-if ((BlockOffset + sects*SectorSize) > (uint64)NtoHll (hVHD->Footer.CurrentSize)) {
-    errno = ERANGE;
+n = fread (hd->tmp, 1, DEDUP_SLOT_HDR + hd->blksize, hd->file);
+if (n < DEDUP_SLOT_HDR)
     return SCPE_IOERR;
-    }
-if (NtoHl (hVHD->Footer.DiskType) == VHD_DT_Fixed) {
-    if (ReadFilePosition(hVHD->File,
-                         buf,
-                         sects*SectorSize,
-                         &BytesRead,
-                         BlockOffset)) {
-        if (sectsread)
-            *sectsread = (t_seccnt)(BytesRead/SectorSize);
+length = _dedup_get32 (hd->tmp);
+if ((length == 0) || (length > hd->blksize) || (n < DEDUP_SLOT_HDR + length))
+    return SCPE_IOERR;
+if (length == hd->blksize)
+    memcpy (buf, hd->tmp + DEDUP_SLOT_HDR, hd->blksize);
+else
+    if (!sim_lz4_decompress (hd->tmp + DEDUP_SLOT_HDR, length, buf, hd->blksize))
         return SCPE_IOERR;
-        }
-    if (sectsread)
-        *sectsread /= SectorSize;
+return SCPE_OK;
+}
+
+/* Get the contents of a logical block */
+
+static t_stat _dedup_read_block (DEDUPHANDLE hd, uint32 block, uint8 **data)
+{
+t_stat r;
+
+if (block == hd->rblk_no) {
+    *data = hd->rblk;
     return SCPE_OK;
     }
-/* We are now dealing with a Dynamically expanding or differencing disk */
-while (sects) {
-    uint32 SectorsPerBlock = NtoHl (hVHD->Dynamic.BlockSize)/SectorSize;
-    uint64 BlockNumber = lba/SectorsPerBlock;
-    uint32 BitMapBytes = (7+(NtoHl (hVHD->Dynamic.BlockSize)/SectorSize))/8;
-    uint32 BitMapSectors = (BitMapBytes+SectorSize-1)/SectorSize;
+hd->rblk_no = hd->blocks;
+if (hd->index[block] == 0)
+    memset (hd->rblk, 0, hd->blksize);
+else
+    if ((r = _dedup_read_slot (hd, hd->index[block], hd->rblk)) != SCPE_OK)
+        return r;
+hd->rblk_no = block;
+*data = hd->rblk;
+return SCPE_OK;
+}
 
-    SectorsInRead = SectorsPerBlock - lba%SectorsPerBlock;
-    if (SectorsInRead > sects)
-        SectorsInRead = sects;
-    if (hVHD->BAT[BlockNumber] == VHD_BAT_FREE_ENTRY) {
-        if (!hVHD->Parent)
-            memset (buf, 0, SectorSize*SectorsInRead);
-        else {
-            if (ReadVirtualDiskSectors(hVHD->Parent,
-                                       buf,
-                                       SectorsInRead,
-                                       NULL,
-                                       SectorSize,
-                                       lba)) {
-                if (sectsread)
-                    *sectsread = BlocksRead;
-                return FALSE;
-                }
+/* Find room for a slot, reusing a free slot if one is big enough */
+
+static t_stat _dedup_alloc_slot (DEDUPHANDLE hd, uint32 need, t_addr *pos, uint32 *size)
+{
+uint32 i;
+
+for (i = 0; i < hd->nfree; i++)
+    if (hd->free[i].size >= need) {
+        *pos = hd->free[i].pos;
+        *size = hd->free[i].size;
+        hd->free[i] = hd->free[--hd->nfree];
+        if (*size - need >= DEDUP_MIN_FREE) {           /* split off the rest */
+            if (_dedup_write_slot_hdr (hd, *pos + need, 0, *size - need, 0) != SCPE_OK)
+                return SCPE_IOERR;
+            _dedup_add_free (hd, *pos + need, *size - need);
+            *size = need;
             }
+        return SCPE_OK;
         }
-    else {
-        BlockOffset = SectorSize*((uint64)(NtoHl (hVHD->BAT[BlockNumber]) + lba%SectorsPerBlock + BitMapSectors));
-        if (ReadFilePosition(hVHD->File,
-                             buf,
-                             SectorsInRead*SectorSize,
-                             NULL,
-                             BlockOffset)) {
-            if (sectsread)
-                *sectsread = BlocksRead;
-            return SCPE_IOERR;
-            }
+if ((hd->store_end + need) / DEDUP_SLOT_UNIT > 0xFFFFFFFF)
+    return SCPE_IOERR;                                  /* store full */
+*pos = hd->store_end;
+*size = need;
+hd->store_end += need;
+hd->dirty = TRUE;
+return SCPE_OK;
+}
+
+/* Retire a slot the index no longer uses.  The index on disk may still
+   refer to it, so it isn't reused until _dedup_write_meta has written the
+   index; a slot that can't be remembered is simply leaked until the
+   container is next opened. */
+
+static void _dedup_retire_slot (DEDUPHANDLE hd, t_addr pos, uint32 size)
+{
+_dedup_add_slot (&hd->retired, &hd->nretired, &hd->retired_max, pos, size);
+}
+
+/* Drop an index reference to a stored block */
+
+static void _dedup_release (DEDUPHANDLE hd, uint32 slot)
+{
+struct dedup_chunk *c;
+
+if ((slot == 0) || ((c = _dedup_find_slot (hd, slot)) == NULL))
+    return;
+if (--c->refs)
+    return;
+_dedup_unlink (hd, c);
+if (c->length < hd->blksize)
+    --hd->compressed;
+--hd->chunks;
+_dedup_retire_slot (hd, ((t_addr)slot) * DEDUP_SLOT_UNIT, c->size);
+free (c);
+}
+
+/* Set the contents of a logical block to hd->blk */
+
+static t_stat _dedup_write_block (DEDUPHANDLE hd, uint32 block)
+{
+struct dedup_chunk *c;
+uint32 i, length, need, size, old = hd->index[block];
+t_uint64 hash;
+t_addr pos;
+t_stat r;
+
+if (hd->rblk_no == block)
+    hd->rblk_no = hd->blocks;
+for (i = 0; (i < hd->blksize) && (hd->blk[i] == 0); i++)
+    ;
+if (i == hd->blksize) {                                 /* all zeros? */
+    hd->index[block] = 0;
+    hd->dirty = TRUE;
+    _dedup_release (hd, old);
+    return SCPE_OK;
+    }
+hash = _dedup_hash (hd->blk, hd->blksize);
+for (c = hd->by_hash[_dedup_bucket (hd, hash)]; c; c = c->hnext) {
+    if (c->hash != hash)
+        continue;
+    if ((_dedup_read_slot (hd, c->slot, hd->tmp + DEDUP_SLOT_HDR + hd->blksize) == SCPE_OK) && 
+        (memcmp (hd->tmp + DEDUP_SLOT_HDR + hd->blksize, hd->blk, hd->blksize) == 0))
+        break;
+    }
+if (c) {                                                /* contents already stored */
+    if (c->slot != old) {
+        ++c->refs;
+        ++hd->dedups;
+        hd->index[block] = c->slot;
+        hd->dirty = TRUE;
+        _dedup_release (hd, old);
         }
-    sects -= SectorsInRead;
-    buf = (uint8 *)(((char *)buf) + SectorSize*SectorsInRead);
-    lba += SectorsInRead;
-    BlocksRead += SectorsInRead;
+    return SCPE_OK;
     }
-if (sectsread)
-    *sectsread = BlocksRead;
+length = sim_lz4_compress (hd->blk, hd->blksize, hd->cmp, hd->blksize - DEDUP_SLOT_UNIT);
+if (length == 0)                                        /* incompressible */
+    length = hd->blksize;
+need = (DEDUP_SLOT_HDR + length + DEDUP_SLOT_UNIT - 1) & ~(DEDUP_SLOT_UNIT - 1);
+c = (struct dedup_chunk *)calloc (1, sizeof (*c));
+if (c == NULL)
+    return SCPE_MEM;
+if ((r = _dedup_alloc_slot (hd, need, &pos, &size)) != SCPE_OK) {
+    free (c);
+    return r;
+    }
+if ((_dedup_write_slot_hdr (hd, pos, length, size, hash) != SCPE_OK) || 
+    (fwrite ((length == hd->blksize) ? hd->blk : hd->cmp, 1, length, hd->file) != length)) {
+    free (c);
+    _dedup_free_slot (hd, pos, size);
+    return SCPE_IOERR;
+    }
+c->slot = (uint32)(pos / DEDUP_SLOT_UNIT);
+c->size = size;
+c->length = length;
+c->refs = 1;
+c->hash = hash;
+_dedup_link (hd, c);
+++hd->chunks;
+if (length < hd->blksize)
+    ++hd->compressed;
+hd->index[block] = c->slot;
+hd->dirty = TRUE;
+_dedup_release (hd, old);
+return SCPE_OK;
+}
+
+static void _dedup_free_handle (DEDUPHANDLE hd)
+{
+uint32 i;
+
+if (hd->by_slot)
+    for (i = 0; i <= hd->hash_mask; i++)
+        while (hd->by_slot[i]) {
+            struct dedup_chunk *c = hd->by_slot[i];
+
+            hd->by_slot[i] = c->snext;
+            free (c);
+            }
+free (hd->by_slot);
+free (hd->by_hash);
+free (hd->index);
+free (hd->free);
+free (hd->retired);
+free (hd->blk);
+free (hd->cmp);
+free (hd->tmp);
+free (hd->rblk);
+free (hd);
+}
+
+/* Allocate a handle's tables and buffers for its header's geometry */
+
+static t_stat _dedup_setup (DEDUPHANDLE hd)
+{
+uint32 buckets = 1024;
+
+hd->blksize = hd->hdr[0];
+hd->blocks = hd->hdr[1];
+hd->store = hd->hdr[3];
+hd->capac = (t_addr)(((t_uint64)hd->hdr[5]) << 32 | hd->hdr[4]);
+hd->store_end = (t_addr)(((t_uint64)hd->hdr[7]) << 32 | hd->hdr[6]);
+if ((hd->blksize != DEDUP_BLKSIZE) || (hd->hdr[2] != DEDUP_HDR_SIZE) || 
+    (hd->store < DEDUP_HDR_SIZE + ((t_addr)hd->blocks) * sizeof (uint32)) || 
+    (hd->store_end < hd->store) || 
+    (((hd->capac + hd->blksize - 1) / hd->blksize) != hd->blocks))
+    return SCPE_IOERR;
+while ((buckets < (1u << 24)) && (buckets < hd->blocks))
+    buckets <<= 1;
+hd->hash_mask = buckets - 1;
+hd->by_hash = (struct dedup_chunk **)calloc (buckets, sizeof (*hd->by_hash));
+hd->by_slot = (struct dedup_chunk **)calloc (buckets, sizeof (*hd->by_slot));
+hd->index = (uint32 *)calloc (hd->blocks ? hd->blocks : 1, sizeof (*hd->index));
+hd->blk = (uint8 *)malloc (hd->blksize);
+hd->cmp = (uint8 *)malloc (hd->blksize);
+hd->tmp = (uint8 *)malloc (DEDUP_SLOT_HDR + 2*hd->blksize);
+hd->rblk = (uint8 *)malloc (hd->blksize);
+hd->rblk_no = hd->blocks;
+if ((!hd->by_hash) || (!hd->by_slot) || (!hd->index) || (!hd->blk) || (!hd->cmp) || (!hd->tmp) || (!hd->rblk))
+    return SCPE_MEM;
 return SCPE_OK;
 }
 
-static t_stat sim_vhd_disk_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects)
+static t_stat _dedup_write_meta (DEDUPHANDLE hd)
 {
-VHDHANDLE hVHD = (VHDHANDLE)uptr->fileref;
-struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
-
-return ReadVirtualDiskSectors(hVHD, buf, sects, sectsread, ctx->sector_size, lba);
+hd->hdr[6] = (uint32)hd->store_end;
+hd->hdr[7] = (uint32)(((t_uint64)hd->store_end) >> 32);
+if ((sim_fseek (hd->file, 0, SEEK_SET)) || 
+    (fwrite (DEDUP_MAGIC, 1, 8, hd->file) != 8) || 
+    (sim_fwrite (hd->hdr, sizeof (hd->hdr[0]), 8, hd->file) != 8) || 
+    (sim_fseek (hd->file, DEDUP_DTYPE, SEEK_SET)) || 
+    (fwrite (hd->dtype, 1, sizeof (hd->dtype), hd->file) != sizeof (hd->dtype)) || 
+    (sim_fseek (hd->file, DEDUP_HDR_SIZE, SEEK_SET)) || 
+    (sim_fwrite (hd->index, sizeof (*hd->index), hd->blocks, hd->file) != hd->blocks) || 
+    (fflush (hd->file) == EOF))
+    return SCPE_IOERR;
+hd->dirty = FALSE;
+while (hd->nretired) {                                  /* index written, slots can be reused */
+    --hd->nretired;
+    _dedup_free_slot (hd, hd->retired[hd->nretired].pos, hd->retired[hd->nretired].size);
+    }
+return SCPE_OK;
 }
 
-static t_stat sim_vhd_disk_clearerr (UNIT *uptr)
+static t_stat sim_dedup_disk_implemented (void)
 {
-VHDHANDLE hVHD = (VHDHANDLE)uptr->fileref;
-
-clearerr (hVHD->File);
 return SCPE_OK;
 }
 
-static t_bool
-BufferIsZeros(void *Buffer, size_t BufferSize)
+static t_bool sim_dedup_disk_probe (const char *filename)
 {
-size_t i;
-char *c = (char *)Buffer;
+FILE *f = sim_fopen (filename, "rb");
+char magic[8];
+t_bool r = FALSE;
 
-for (i=0; i<BufferSize; ++i)
-    if (c[i])
-        return FALSE;
-return TRUE;
+if (f == NULL)
+    return FALSE;
+r = ((fread (magic, 1, sizeof (magic), f) == sizeof (magic)) && 
+     (memcmp (magic, DEDUP_MAGIC, sizeof (magic)) == 0));
+fclose (f);
+return r;
 }
 
-static t_stat
-WriteVirtualDiskSectors(VHDHANDLE hVHD,
-                        uint8 *buf,
-                        t_seccnt sects,
-                        t_seccnt *sectswritten,
-                        uint32 SectorSize,
-                        t_lba lba)
+static FILE *sim_dedup_disk_open (const char *filename, const char *openmode)
 {
-uint64 BlockOffset = ((uint64)lba)*SectorSize;
-uint32 BlocksWritten = 0;
-uint32 SectorsInWrite;
-size_t BytesWritten = 0;
+DEDUPHANDLE hd = (DEDUPHANDLE)calloc (1, sizeof (*hd));
+char magic[8];
+uint8 *buf = NULL;
+size_t bufsize = 1024*1024, have = 0;
+t_addr bufpos = 0, pos;
+uint32 i;
 
-if (!hVHD || !hVHD->File) {
-    errno = EBADF;
-    return SCPE_IOERR;
-    }
-if ((BlockOffset + sects*SectorSize) > (uint64)NtoHll(hVHD->Footer.CurrentSize)) {
-    errno = ERANGE;
-    return SCPE_IOERR;
+if (hd == NULL)
+    return NULL;
+hd->file = sim_fopen (filename, openmode);
+if ((hd->file == NULL) || 
+    (fread (magic, 1, sizeof (magic), hd->file) != sizeof (magic)) || 
+    (memcmp (magic, DEDUP_MAGIC, sizeof (magic)) != 0) || 
+    (sim_fread (hd->hdr, sizeof (hd->hdr[0]), 8, hd->file) != 8) || 
+    (sim_fseek (hd->file, DEDUP_DTYPE, SEEK_SET)) || 
+    (fread (hd->dtype, 1, sizeof (hd->dtype), hd->file) != sizeof (hd->dtype)) || 
+    (_dedup_setup (hd) != SCPE_OK) || 
+    (sim_fseek (hd->file, DEDUP_HDR_SIZE, SEEK_SET)) || 
+    (sim_fread (hd->index, sizeof (*hd->index), hd->blocks, hd->file) != hd->blocks))
+    goto Error;
+hd->dtype[sizeof (hd->dtype) - 1] = '\0';
+for (i = 0; i < hd->blocks; i++) {                      /* count the references to each slot */
+    struct dedup_chunk *c;
+
+    if (hd->index[i] == 0)
+        continue;
+    if ((c = _dedup_find_slot (hd, hd->index[i])) == NULL) {
+        if ((c = (struct dedup_chunk *)calloc (1, sizeof (*c))) == NULL)
+            goto Error;
+        c->slot = hd->index[i];
+        c->snext = hd->by_slot[_dedup_bucket (hd, c->slot)];
+        hd->by_slot[_dedup_bucket (hd, c->slot)] = c;
+        }
+    ++c->refs;
     }
-if (NtoHl(hVHD->Footer.DiskType) == VHD_DT_Fixed) {
-    if (WriteFilePosition(hVHD->File,
-                          buf,
-                          sects*SectorSize,
-                          &BytesWritten,
-                          BlockOffset)) {
-        if (sectswritten)
-            *sectswritten = (t_seccnt)(BytesWritten/SectorSize);
-        return SCPE_IOERR;
+buf = (uint8 *)malloc (bufsize);
+if (buf == NULL)
+    goto Error;
+for (pos = hd->store; pos < hd->store_end; ) {          /* walk the store */
+    struct dedup_chunk *c;
+    uint8 *sh;
+
+    if ((pos < bufpos) || (pos + DEDUP_SLOT_HDR > bufpos + have)) {
+        bufpos = pos;
+        if (sim_fseek (hd->file, bufpos, SEEK_SET))
+            goto Error;
+        have = fread (buf, 1, bufsize, hd->file);
+        if (have < DEDUP_SLOT_HDR)
+            goto Error;
         }
-    if (sectswritten)
-        *sectswritten /= SectorSize;
-    return SCPE_OK;
+    sh = buf + (size_t)(pos - bufpos);
+    i = _dedup_get32 (sh + 4);                          /* slot size */
+    if ((i < DEDUP_SLOT_HDR) || (i % DEDUP_SLOT_UNIT) || (pos + i > hd->store_end))
+        goto Error;
+    c = _dedup_find_slot (hd, (uint32)(pos / DEDUP_SLOT_UNIT));
+    if (c) {
+        c->size = i;
+        c->length = _dedup_get32 (sh);
+        c->hash = (((t_uint64)_dedup_get32 (sh + 12)) << 32) | _dedup_get32 (sh + 8);
+        if ((c->length == 0) || (c->length > hd->blksize))
+            goto Error;
+        c->hnext = hd->by_hash[_dedup_bucket (hd, c->hash)];
+        hd->by_hash[_dedup_bucket (hd, c->hash)] = c;
+        ++hd->chunks;
+        if (c->length < hd->blksize)
+            ++hd->compressed;
+        }
+    else
+        if (_dedup_add_free (hd, pos, i) != SCPE_OK)
+            goto Error;
+    pos += i;
     }
-/* We are now dealing with a Dynamically expanding or differencing disk */
-while (sects) {
-    uint32 SectorsPerBlock = NtoHl(hVHD->Dynamic.BlockSize)/SectorSize;
-    uint64 BlockNumber = lba/SectorsPerBlock;
-    uint32 BitMapBytes = (7+(NtoHl(hVHD->Dynamic.BlockSize)/SectorSize))/8;
-    uint32 BitMapSectors = (BitMapBytes+SectorSize-1)/SectorSize;
+free (buf);
+buf = NULL;
+for (i = 0; i <= hd->hash_mask; i++) {                  /* every referenced slot found? */
+    struct dedup_chunk *c;
 
-    if (BlockNumber >= NtoHl(hVHD->Dynamic.MaxTableEntries)) {
-        if (sectswritten)
-            *sectswritten = BlocksWritten;
-        return SCPE_EOF;
-        }
-    SectorsInWrite = 1;
-    if (hVHD->BAT[BlockNumber] == VHD_BAT_FREE_ENTRY) {
-        uint8 *BitMap = NULL;
-        uint32 BitMapBufferSize = VHD_DATA_BLOCK_ALIGNMENT;
-        uint8 *BitMapBuffer = NULL;
-        void *BlockData = NULL;
-        uint8 *BATUpdateBufferAddress;
-        uint32 BATUpdateBufferSize;
-        uint64 BATUpdateStorageAddress;
+    for (c = hd->by_slot[i]; c; c = c->snext)
+        if (c->size == 0)
+            goto Error;
+    }
+return (FILE *)hd;
 
-        if (!hVHD->Parent && BufferIsZeros(buf, SectorSize))
-            goto IO_Done;
-        /* Need to allocate a new Data Block. */
-        BlockOffset = sim_fsize_ex (hVHD->File);
-        if (((int64)BlockOffset) == -1)
-            return SCPE_IOERR;
-        if (BitMapSectors*SectorSize > BitMapBufferSize)
-            BitMapBufferSize = BitMapSectors*SectorSize;
-        BitMapBuffer = (uint8 *)calloc(1, BitMapBufferSize + SectorSize*SectorsPerBlock);
-        if (BitMapBufferSize > BitMapSectors*SectorSize)
-            BitMap = BitMapBuffer + BitMapBufferSize-BitMapBytes;
-        else
-            BitMap = BitMapBuffer;
-        memset(BitMap, 0xFF, BitMapBytes);
-        BlockOffset -= sizeof(hVHD->Footer);
-        if (0 == (BlockOffset & ~(VHD_DATA_BLOCK_ALIGNMENT-1)))
-            {  // Already aligned, so use padded BitMapBuffer
-            if (WriteFilePosition(hVHD->File,
-                                  BitMapBuffer,
-                                  BitMapBufferSize + SectorSize*SectorsPerBlock,
-                                  NULL,
-                                  BlockOffset)) {
-                free (BitMapBuffer);
-                return SCPE_IOERR;
-                }
-            BlockOffset += BitMapBufferSize;
-            }
-        else
-            {
-            // align the data portion of the block to the desired alignment
-            // compute the address of the data portion of the block
-            BlockOffset += BitMapSectors*SectorSize;
-            // round up this address to the desired alignment
-            BlockOffset += VHD_DATA_BLOCK_ALIGNMENT-1;
-            BlockOffset &= ~(VHD_DATA_BLOCK_ALIGNMENT-1);
-            BlockOffset -= BitMapSectors*SectorSize;
-            if (WriteFilePosition(hVHD->File,
-                                  BitMap,
-                                  SectorSize * (BitMapSectors + SectorsPerBlock),
-                                  NULL,
-                                  BlockOffset)) {
-                free (BitMapBuffer);
-                return SCPE_IOERR;
-                }
-            BlockOffset += BitMapSectors*SectorSize;
-            }
-        free(BitMapBuffer);
-        BitMapBuffer = BitMap = NULL;
-        /* the BAT block address is the beginning of the block bitmap */
-        BlockOffset -= BitMapSectors*SectorSize;
-        hVHD->BAT[BlockNumber] = NtoHl((uint32)(BlockOffset/SectorSize));
-        BlockOffset += SectorSize * (SectorsPerBlock + BitMapSectors);
-        if (WriteFilePosition(hVHD->File,
-                              &hVHD->Footer,
-                              sizeof(hVHD->Footer),
-                              NULL,
-                              BlockOffset))
-            goto Fatal_IO_Error;
-        /* Write just the aligned sector which contains the updated BAT entry */
-        BATUpdateBufferAddress = (uint8 *)hVHD->BAT - (size_t)NtoHll(hVHD->Dynamic.TableOffset) + 
-            (size_t)((((size_t)&hVHD->BAT[BlockNumber+1]) - (size_t)hVHD->BAT + (size_t)NtoHll(hVHD->Dynamic.TableOffset)) & ~(VHD_DATA_BLOCK_ALIGNMENT-1));
-        if (BATUpdateBufferAddress < (uint8 *)hVHD->BAT) {
-            BATUpdateBufferAddress = (uint8 *)hVHD->BAT;
-            BATUpdateBufferSize = (((((size_t)&hVHD->BAT[BlockNumber+1]) - (size_t)hVHD->BAT) + 511)/512)*512;
-            BATUpdateStorageAddress = NtoHll(hVHD->Dynamic.TableOffset);
-            }
-        else {
-            BATUpdateBufferSize = VHD_DATA_BLOCK_ALIGNMENT;
-            BATUpdateStorageAddress = NtoHll(hVHD->Dynamic.TableOffset) + BATUpdateBufferAddress - ((uint8 *)hVHD->BAT);
-            }
-        if ((size_t)(BATUpdateBufferAddress - (uint8 *)hVHD->BAT + BATUpdateBufferSize) > 512*((sizeof(*hVHD->BAT)*NtoHl(hVHD->Dynamic.MaxTableEntries) + 511)/512))
-            BATUpdateBufferSize = 512*((sizeof(*hVHD->BAT)*NtoHl(hVHD->Dynamic.MaxTableEntries) + 511)/512) - (BATUpdateBufferAddress - ((uint8 *)hVHD->BAT));
-        if (WriteFilePosition(hVHD->File,
-                              BATUpdateBufferAddress,
-                              BATUpdateBufferSize,
-                              NULL,
-                              BATUpdateStorageAddress))
-            goto Fatal_IO_Error;
-        if (hVHD->Parent)
-            { /* Need to populate data block contents from parent VHD */
-            uint32 BlockSectors = SectorsPerBlock;
+Error:
+free (buf);
+if (hd->file)
+    fclose (hd->file);
+_dedup_free_handle (hd);
+return NULL;
+}
 
-            BlockData = malloc(SectorsPerBlock*SectorSize);
+static FILE *sim_dedup_disk_create (const char *filename, t_addr desiredsize)
+{
+DEDUPHANDLE hd;
+FILE *f;
 
-            if (((lba/SectorsPerBlock)*SectorsPerBlock + BlockSectors) > ((uint64)NtoHll (hVHD->Footer.CurrentSize))/SectorSize)
-                BlockSectors = (uint32)(((uint64)NtoHll (hVHD->Footer.CurrentSize))/SectorSize - (lba/SectorsPerBlock)*SectorsPerBlock);
-            if (ReadVirtualDiskSectors(hVHD->Parent,
-                                       (uint8*) BlockData, 
-                                       BlockSectors,
-                                       NULL,
-                                       SectorSize,
-                                       (lba/SectorsPerBlock)*SectorsPerBlock))
-                goto Fatal_IO_Error;
-            if (WriteVirtualDiskSectors(hVHD,
-                                        (uint8*) BlockData, 
-                                        BlockSectors,
-                                        NULL,
-                                        SectorSize,
-                                        (lba/SectorsPerBlock)*SectorsPerBlock))
-                goto Fatal_IO_Error;
-            free(BlockData);
-            }
-        continue;
-Fatal_IO_Error:
-        free (BitMap);
-        free (BlockData);
-        fclose (hVHD->File);
-        hVHD->File = NULL;
-        return SCPE_IOERR;
+f = sim_fopen (filename, "rb");
+if (f) {                                                /* don't overwrite an existing file */
+    fclose (f);
+    errno = EEXIST;
+    return NULL;
+    }
+hd = (DEDUPHANDLE)calloc (1, sizeof (*hd));
+if (hd == NULL)
+    return NULL;
+hd->hdr[0] = DEDUP_BLKSIZE;
+hd->hdr[1] = (uint32)((desiredsize + DEDUP_BLKSIZE - 1) / DEDUP_BLKSIZE);
+hd->hdr[2] = DEDUP_HDR_SIZE;
+hd->hdr[3] = (uint32)((DEDUP_HDR_SIZE + ((t_addr)hd->hdr[1]) * sizeof (uint32) + DEDUP_ALIGN - 1) & ~(DEDUP_ALIGN - 1));
+hd->hdr[4] = (uint32)desiredsize;
+hd->hdr[5] = (uint32)(((t_uint64)desiredsize) >> 32);
+hd->hdr[6] = hd->hdr[3];
+hd->hdr[7] = 0;
+if ((_dedup_setup (hd) != SCPE_OK) || 
+    ((hd->file = sim_fopen (filename, "wb+")) == NULL) || 
+    (_dedup_write_meta (hd) != SCPE_OK)) {
+    if (hd->file) {
+        fclose (hd->file);
+        remove (filename);
         }
+    _dedup_free_handle (hd);
+    return NULL;
+    }
+return (FILE *)hd;
+}
+
+static void sim_dedup_disk_flush (FILE *f)
+{
+DEDUPHANDLE hd = (DEDUPHANDLE)f;
+
+if (hd->dirty)
+    _dedup_write_meta (hd);
+fflush (hd->file);
+}
+
+static int sim_dedup_disk_close (FILE *f)
+{
+DEDUPHANDLE hd = (DEDUPHANDLE)f;
+int r = 0;
+
+while (hd->dirty && (r == 0))                           /* again if freeing slots shrank the store */
+    if (_dedup_write_meta (hd) != SCPE_OK)
+        r = EOF;
+if (fclose (hd->file) == EOF)
+    r = EOF;
+_dedup_free_handle (hd);
+return r;
+}
+
+static t_addr sim_dedup_disk_size (FILE *f)
+{
+return ((DEDUPHANDLE)f)->capac;
+}
+
+static t_stat sim_dedup_disk_set_dtype (FILE *f, const char *dtype)
+{
+DEDUPHANDLE hd = (DEDUPHANDLE)f;
+
+memset (hd->dtype, 0, sizeof (hd->dtype));
+strncpy (hd->dtype, dtype, sizeof (hd->dtype) - 1);
+hd->dirty = TRUE;
+return SCPE_OK;
+}
+
+static const char *sim_dedup_disk_get_dtype (FILE *f)
+{
+return ((DEDUPHANDLE)f)->dtype;
+}
+
+static t_stat sim_dedup_disk_clearerr (UNIT *uptr)
+{
+clearerr (((DEDUPHANDLE)uptr->fileref)->file);
+return SCPE_OK;
+}
+
+static t_stat sim_dedup_disk_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects)
+{
+DEDUPHANDLE hd = (DEDUPHANDLE)uptr->fileref;
+struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+t_addr da = ((t_addr)lba) * ctx->sector_size;
+size_t tbc = ((size_t)sects) * ctx->sector_size, done = 0;
+t_stat r;
+
+if (sectsread)
+    *sectsread = 0;
+while (done < tbc) {
+    uint32 block = (uint32)(da / hd->blksize);
+    uint32 offset = (uint32)(da % hd->blksize);
+    size_t len = hd->blksize - offset;
+    uint8 *data;
+
+    if (len > tbc - done)
+        len = tbc - done;
+    if (block >= hd->blocks)                            /* beyond the end of the disk */
+        memset (buf + done, 0, len);
     else {
-        BlockOffset = 512*((uint64)(NtoHl(hVHD->BAT[BlockNumber]) + lba%SectorsPerBlock + BitMapSectors));
-        SectorsInWrite = SectorsPerBlock - lba%SectorsPerBlock;
-        if (SectorsInWrite > sects)
-            SectorsInWrite = sects;
-        if (WriteFilePosition(hVHD->File,
-                              buf,
-                              SectorsInWrite*SectorSize,
-                              NULL,
-                              BlockOffset)) {
-            if (sectswritten)
-                *sectswritten = BlocksWritten;
-            return SCPE_IOERR;
-            }
+        if ((r = _dedup_read_block (hd, block, &data)) != SCPE_OK)
+            return r;
+        memcpy (buf + done, data + offset, len);
         }
-IO_Done:
-    sects -= SectorsInWrite;
-    buf = (uint8 *)(((char *)buf) + SectorsInWrite*SectorSize);
-    lba += SectorsInWrite;
-    BlocksWritten += SectorsInWrite;
+    done += len;
+    da += len;
     }
-if (sectswritten)
-    *sectswritten = BlocksWritten;
+if (sectsread)
+    *sectsread = sects;
 return SCPE_OK;
 }
 
-static t_stat sim_vhd_disk_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects)
+static t_stat sim_dedup_disk_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects)
 {
-VHDHANDLE hVHD = (VHDHANDLE)uptr->fileref;
+DEDUPHANDLE hd = (DEDUPHANDLE)uptr->fileref;
 struct disk_context *ctx = (struct disk_context *)uptr->disk_ctx;
+t_addr da = ((t_addr)lba) * ctx->sector_size;
+size_t tbc = ((size_t)sects) * ctx->sector_size, done = 0;
+t_stat r;
 
-return WriteVirtualDiskSectors(hVHD, buf, sects, sectswritten, ctx->sector_size, lba);
+if (sectswritten)
+    *sectswritten = 0;
+if (da + tbc > hd->capac)
+    return SCPE_IOERR;
+while (done < tbc) {
+    uint32 block = (uint32)(da / hd->blksize);
+    uint32 offset = (uint32)(da % hd->blksize);
+    size_t len = hd->blksize - offset;
+    uint8 *data;
+
+    if (len > tbc - done)
+        len = tbc - done;
+    if (len < hd->blksize) {                            /* partial block? */
+        if ((r = _dedup_read_block (hd, block, &data)) != SCPE_OK)
+            return r;
+        memcpy (hd->blk, data, hd->blksize);
+        }
+    memcpy (hd->blk + offset, buf + done, len);
+    if ((r = _dedup_write_block (hd, block)) != SCPE_OK)
+        return r;
+    done += len;
+    da += len;
+    if (sectswritten)
+        *sectswritten = (t_seccnt)(done / ctx->sector_size);
+    }
+return SCPE_OK;
+}
+
+/* Describe a deduplicating container's contents */
+
+static void sim_dedup_disk_info (FILE *st, FILE *f)
+{
+DEDUPHANDLE hd = (DEDUPHANDLE)f;
+uint32 i, zeros = 0;
+
+for (i = 0; i < hd->blocks; i++)
+    if (hd->index[i] == 0)
+        ++zeros;
+fprintf (st, "%u blocks: %u zero, %u distinct stored (%u compressed), store %uKB", hd->blocks, zeros, 
+         hd->chunks, hd->compressed, (uint32)((hd->store_end - hd->store) / 1024));
+}
+
+#else
+
+static t_stat sim_dedup_disk_implemented (void)
+{
+return SCPE_NOFNC;
+}
+
+static t_bool sim_dedup_disk_probe (const char *filename)
+{
+return FALSE;
+}
+
+static FILE *sim_dedup_disk_open (const char *filename, const char *openmode)
+{
+return NULL;
+}
+
+static FILE *sim_dedup_disk_create (const char *filename, t_addr desiredsize)
+{
+return NULL;
+}
+
+static int sim_dedup_disk_close (FILE *f)
+{
+return -1;
+}
+
+static void sim_dedup_disk_flush (FILE *f)
+{
+}
+
+static t_addr sim_dedup_disk_size (FILE *f)
+{
+return (t_addr)-1;
+}
+
+static t_stat sim_dedup_disk_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects)
+{
+return SCPE_IOERR;
+}
+
+static t_stat sim_dedup_disk_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects)
+{
+return SCPE_IOERR;
 }
+
+static t_stat sim_dedup_disk_clearerr (UNIT *uptr)
+{
+return SCPE_IOERR;
+}
+
+static t_stat sim_dedup_disk_set_dtype (FILE *f, const char *dtype)
+{
+return SCPE_NOFNC;
+}
+
+static const char *sim_dedup_disk_get_dtype (FILE *f)
+{
+return NULL;
+}
+
+static void sim_dedup_disk_info (FILE *st, FILE *f)
+{
+}
+
 #endif
@@ -45,6 +45,7 @@ typedef uint32          t_lba;                          /* disk logical block ad
 #define DKUF_F_STD       0                              /* SIMH format */
 #define DKUF_F_RAW       1                              /* Raw Physical Disk Access */
 #define DKUF_F_VHD       2                              /* VHD format */
+#define DKUF_F_DDC       3                              /* Deduplicating container format */
 #define DKUF_V_UF       (DKUF_V_FMT + DKUF_W_FMT)
 #define DKUF_WLK        (1u << DKUF_V_WLK)
 #define DKUF_FMT        (DKUF_M_FMT << DKUF_V_FMT)
@@ -53,6 +54,7 @@ typedef uint32          t_lba;                          /* disk logical block ad
 #define DK_F_STD        (DKUF_F_STD << DKUF_V_FMT)
 #define DK_F_RAW        (DKUF_F_RAW << DKUF_V_FMT)
 #define DK_F_VHD        (DKUF_F_VHD << DKUF_V_FMT)
+#define DK_F_DDC        (DKUF_F_DDC << DKUF_V_FMT)
 
 #define DK_GET_FMT(u)   (((u)->flags >> DKUF_V_FMT) & DKUF_M_FMT)
 
@@ -62,6 +64,13 @@ typedef uint32          t_lba;                          /* disk logical block ad
 
 typedef void (*DISK_PCALLBACK)(UNIT *unit, t_stat status);
 
+/* Host memory segment of a scatter/gather transfer */
+
+typedef struct {
+    void                *buf;                           /* host address */
+    size_t              len;                            /* byte count (whole transfer elements) */
+    } DISK_SG;
+
 /* Prototypes */
 
 t_stat sim_disk_attach (UNIT *uptr, char *cptr, size_t sector_size, size_t xfer_element_size, t_bool dontautosize, 
@@ -72,13 +81,27 @@ t_stat sim_disk_rdsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread,
 t_stat sim_disk_rdsect_a (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectsread, t_seccnt sects, DISK_PCALLBACK callback);
 t_stat sim_disk_wrsect (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects);
 t_stat sim_disk_wrsect_a (UNIT *uptr, t_lba lba, uint8 *buf, t_seccnt *sectswritten, t_seccnt sects, DISK_PCALLBACK callback);
+t_stat sim_disk_rdsect_sg (UNIT *uptr, t_lba lba, DISK_SG *sg, uint32 nsg, t_seccnt *sectsread, t_seccnt sects);
+t_stat sim_disk_rdsect_sg_a (UNIT *uptr, t_lba lba, DISK_SG *sg, uint32 nsg, t_seccnt *sectsread, t_seccnt sects, DISK_PCALLBACK callback);
+t_stat sim_disk_wrsect_sg (UNIT *uptr, t_lba lba, DISK_SG *sg, uint32 nsg, t_seccnt *sectswritten, t_seccnt sects);
+t_stat sim_disk_wrsect_sg_a (UNIT *uptr, t_lba lba, DISK_SG *sg, uint32 nsg, t_seccnt *sectswritten, t_seccnt sects, DISK_PCALLBACK callback);
 t_stat sim_disk_unload (UNIT *uptr);
 t_stat sim_disk_set_fmt (UNIT *uptr, int32 val, char *cptr, void *desc);
 t_stat sim_disk_show_fmt (FILE *st, UNIT *uptr, int32 val, void *desc);
 t_stat sim_disk_set_capac (UNIT *uptr, int32 val, char *cptr, void *desc);
 t_stat sim_disk_show_capac (FILE *st, UNIT *uptr, int32 val, void *desc);
-t_stat sim_disk_set_asynch (UNIT *uptr, int latency);
-t_stat sim_disk_clr_asynch (UNIT *uptr);
+t_stat sim_disk_set_async (UNIT *uptr, int latency);
+t_stat sim_disk_clr_async (UNIT *uptr);
+t_stat sim_disk_set_qdepth (UNIT *uptr, int32 val, char *cptr, void *desc);
+t_stat sim_disk_show_qdepth (FILE *st, UNIT *uptr, int32 val, void *desc);
+t_stat sim_disk_set_ioengine (UNIT *uptr, int32 val, char *cptr, void *desc);
+t_stat sim_disk_show_ioengine (FILE *st, UNIT *uptr, int32 val, void *desc);
+t_stat sim_disk_set_overlay (UNIT *uptr, int32 val, char *cptr, void *desc);
+t_stat sim_disk_show_overlay (FILE *st, UNIT *uptr, int32 val, void *desc);
+t_stat sim_disk_set_cache (UNIT *uptr, int32 val, char *cptr, void *desc);
+t_stat sim_disk_show_cache (FILE *st, UNIT *uptr, int32 val, void *desc);
+t_stat sim_disk_set_diskcache (int32 flag, char *cptr);
+t_stat sim_disk_show_diskcache (FILE *st, DEVICE *dnotused, UNIT *unotused, int32 flag, char *cptr);
 t_stat sim_disk_reset (UNIT *uptr);
 t_stat sim_disk_perror (UNIT *uptr, const char *msg);
 t_stat sim_disk_clearerr (UNIT *uptr);
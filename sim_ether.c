@@ -150,6 +150,12 @@
                       specified at open time.  This functionality is only 
                       available on *nix platforms since the vde api isn't 
                       available on Windows.
+  USE_SW_NETWORK    - Specifies that the integrated virtual switch should be 
+                      included.  This allows device names of the form sw:name 
+                      to be specified at open time.  Simulators attached to 
+                      the same switch name exchange frames over local 
+                      sockets with no host interface or privileges needed.  
+                      It is defined automatically on *nix platforms.
 
   NEED_PCAP_SENDPACKET
                     - Specifies that you are using an older version of libpcap
@@ -873,8 +879,16 @@ t_stat eth_clr_async (ETH_DEV *dev)
   {return SCPE_NOFNC;}
 t_stat eth_write (ETH_DEV* dev, ETH_PACK* packet, ETH_PCALLBACK routine)
   {return SCPE_NOFNC;}
+t_stat eth_write_begin (ETH_DEV* dev)
+  {return SCPE_NOFNC;}
+t_stat eth_write_end (ETH_DEV* dev)
+  {return SCPE_NOFNC;}
 int eth_read (ETH_DEV* dev, ETH_PACK* packet, ETH_PCALLBACK routine)
   {return SCPE_NOFNC;}
+ETH_PACK* eth_read_slot (ETH_DEV* dev)
+  {return NULL;}
+void eth_read_done (ETH_DEV* dev)
+  {}
 t_stat eth_filter (ETH_DEV* dev, int addr_count, ETH_MAC* const addresses,
                    ETH_BOOL all_multicast, ETH_BOOL promiscuous)
   {return SCPE_NOFNC;}
@@ -918,6 +932,25 @@ void eth_show_dev (FILE* st, ETH_DEV* dev)
 #include <libvdeplug.h>
 #endif /* USE_VDE_NETWORK */
 
+#ifdef USE_SW_NETWORK
+#include <stddef.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif /* USE_SW_NETWORK */
+
+/* Batches of writes go out with one sendmmsg on the packet socket */
+#if defined (USE_READER_THREAD) && (defined (__linux) || defined (__linux__)) && defined (_GNU_SOURCE) && \
+    defined (__GLIBC__) && ((__GLIBC__ > 2) || ((__GLIBC__ == 2) && (__GLIBC_MINOR__ >= 14)))
+#define HAVE_SENDMMSG 1
+#include <sys/socket.h>
+#define ETH_WRITE_BATCH 64                      /* packets per sendmmsg */
+#endif
+
 /* Allows windows to look up user-defined adapter names */
 #if defined(_WIN32)
 #include <winreg.h>
@@ -1428,7 +1461,7 @@ static void eth_get_nic_hw_addr(ETH_DEV* dev, char *devname)
         "egrep [0-9a-fA-F]?[0-9a-fA-F]:[0-9a-fA-F]?[0-9a-fA-F]:[0-9a-fA-F]?[0-9a-fA-F]:[0-9a-fA-F]?[0-9a-fA-F]:[0-9a-fA-F]?[0-9a-fA-F]:[0-9a-fA-F]?[0-9a-fA-F]",
         NULL};
 
-    if (0 == strncmp("vde:", devname, 4))
+    if ((0 == strncmp("vde:", devname, 4)) || (0 == strncmp("sw:", devname, 3)))
       return;
     memset(command, 0, sizeof(command));
     for (i=0; patterns[i] && (0 == dev->have_host_nic_phy_addr); ++i) {
@@ -1476,6 +1509,382 @@ _eth_callback(u_char* info, const struct pcap_pkthdr* header, const u_char* data
 static t_stat
 _eth_write(ETH_DEV* dev, ETH_PACK* packet, ETH_PCALLBACK routine);
 
+static t_bool
+_eth_write_start(ETH_DEV* dev, ETH_PACK* packet, int *loopback_self_frame);
+
+static void
+_eth_write_failed(ETH_DEV* dev, int loopback_self_frame);
+
+/* Receive ring
+
+   Slots are owned by the reader thread from fill up to head + size and by 
+   the simulator thread from head up to tail.  A barrier orders the slot 
+   contents against the index which hands them over. */
+
+#if !defined (USE_READER_THREAD)
+#define ETH_RING_SLOTS 1                            /* one frame per poll */
+#define ETH_RING_BARRIER(dev)
+#else
+#define ETH_RING_SLOTS ETH_RING_SIZE
+#if defined (__GNUC__)
+#define ETH_RING_BARRIER(dev) __sync_synchronize ()
+#else
+#define ETH_RING_BARRIER(dev)                           \
+    if (1) {                                            \
+      pthread_mutex_lock (&(dev)->lock);                \
+      pthread_mutex_unlock (&(dev)->lock);              \
+      }                                                 \
+    else (void)0
+#endif
+#endif
+
+static t_stat _eth_ring_init (ETH_RING* ring, uint32 size)
+{
+memset (ring, 0, sizeof (*ring));
+ring->slot = (ETH_PACK *) calloc (size, sizeof (*ring->slot));
+if (!ring->slot) {
+  /* failed to allocate memory, a ring of size 0 drops every frame */
+  char* msg = "Eth: failed to allocate receive ring[%d]\r\n";
+  printf(msg, size);
+  if (sim_log) fprintf(sim_log, msg, size);
+  return SCPE_MEM;
+  }
+ring->size = size;
+return SCPE_OK;
+}
+
+static void _eth_ring_free (ETH_RING* ring)
+{
+free (ring->slot);
+memset (ring, 0, sizeof (*ring));
+}
+
+/* Claim the next free slot for the reader, NULL when the ring is full */
+
+static ETH_PACK* _eth_ring_claim (ETH_RING* ring)
+{
+if ((ring->fill - ring->head) >= ring->size) {
+  ++ring->loss;
+  return NULL;
+  }
+return &ring->slot[ring->fill & (ring->size - 1)];
+}
+
+/* Hand the frames filled since the last call to the simulator thread */
+
+static int _eth_ring_publish (ETH_DEV* dev)
+{
+ETH_RING* ring = &dev->read_ring;
+
+if (ring->fill == ring->tail)
+  return 0;
+if ((ring->fill - ring->head) > ring->high)
+  ring->high = ring->fill - ring->head;
+ETH_RING_BARRIER (dev);                         /* slots before the index */
+ring->tail = ring->fill;
+++ring->batches;
+return 1;
+}
+
+#ifdef USE_SW_NETWORK
+/* Integrated virtual switch
+
+   A switch named sw:name is a directory ($TMPDIR/simh-sw-name, or the name 
+   itself when it contains a '/') holding one bound local datagram socket 
+   for each attached port.  No switch process exists: each port forwards 
+   its own frames.  A port learns which peer owns a source address from 
+   the frames it receives, sends unicast frames for learned addresses 
+   straight to their owner, and floods everything else to the ports found 
+   in the directory.  Sockets left behind by exited simulators are removed 
+   when they refuse a frame. */
+
+#define ETH_SW_MACS     256                     /* learned addresses (power of 2) */
+#define ETH_SW_PEERS    64                      /* other ports on a switch */
+#define ETH_SW_AGE      300                     /* seconds a learned address is kept */
+#define ETH_SW_RESCAN   1                       /* seconds between port list refreshes */
+#define ETH_SW_WAIT     10                      /* msec to wait for room at a busy port */
+
+typedef struct eth_sw ETH_SW;
+typedef char ETH_SW_PORT[sizeof(((struct sockaddr_un *)0)->sun_path)];
+
+struct eth_sw {
+  int           fd;                             /* this port's socket */
+  char          dir[sizeof(ETH_SW_PORT)];       /* switch directory */
+  ETH_SW_PORT   self;                           /* this port's socket path */
+  int           peer_count;
+  ETH_SW_PORT   peer[ETH_SW_PEERS];             /* other ports on the switch */
+  time_t        peer_scan;                      /* time of last directory scan */
+  struct {
+    ETH_MAC     mac;
+    time_t      seen;                           /* 0 when unused */
+    ETH_SW_PORT port;
+    } learned[ETH_SW_MACS];
+  uint32        unicast;                        /* frames sent to a learned port */
+  uint32        flooded;                        /* frames sent to all ports */
+  uint32        dropped;                        /* frames a peer had no room for */
+#if defined (USE_READER_THREAD)
+  pthread_mutex_t lock;                         /* reader learns, writer sends */
+#endif
+  };
+
+static int _eth_sw_hash (const u_char *mac)
+{
+return (mac[0] ^ mac[1] ^ mac[2] ^ (mac[3] << 1) ^ (mac[4] << 2) ^ mac[5]) & (ETH_SW_MACS - 1);
+}
+
+static int _eth_sw_find_peer (ETH_SW* sw, const char *port)
+{
+int i;
+
+for (i = 0; i < sw->peer_count; i++)
+  if (0 == strcmp (sw->peer[i], port))
+    return i;
+return -1;
+}
+
+static void _eth_sw_add_peer (ETH_SW* sw, const char *port)
+{
+if ((sw->peer_count < ETH_SW_PEERS) && (_eth_sw_find_peer (sw, port) < 0))
+  strcpy (sw->peer[sw->peer_count++], port);
+}
+
+/* Forget a port which no longer accepts frames (along with its addresses).
+   Called with the lock held. */
+
+static void _eth_sw_drop_peer (ETH_SW* sw, const char *port, int stale)
+{
+struct stat st;
+int i;
+ETH_SW_PORT name;
+
+strcpy (name, port);                            /* port may point into the tables */
+if (stale && (0 == lstat (name, &st)) && S_ISSOCK (st.st_mode))
+  unlink (name);
+for (i = 0; i < ETH_SW_MACS; i++)
+  if (sw->learned[i].seen && (0 == strcmp (sw->learned[i].port, name)))
+    sw->learned[i].seen = 0;
+if ((i = _eth_sw_find_peer (sw, name)) >= 0) {
+  memmove (&sw->peer[i], &sw->peer[i + 1], (sw->peer_count - i - 1) * sizeof (sw->peer[0]));
+  --sw->peer_count;
+  }
+}
+
+/* Refresh the list of ports from the switch directory */
+
+static void _eth_sw_scan (ETH_SW* sw)
+{
+DIR *d;
+struct dirent *e;
+struct stat st;
+ETH_SW_PORT port;
+
+sw->peer_scan = time (NULL);
+if (NULL == (d = opendir (sw->dir)))
+  return;
+sw->peer_count = 0;
+while (NULL != (e = readdir (d))) {
+  size_t dlen = strlen (sw->dir), nlen = strlen (e->d_name);
+
+  if ((e->d_name[0] == '.') || (dlen + 1 + nlen >= sizeof (port)))
+    continue;
+  memcpy (port, sw->dir, dlen);
+  port[dlen] = '/';
+  memcpy (&port[dlen + 1], e->d_name, nlen + 1);
+  if ((0 == strcmp (port, sw->self)) || 
+      (0 != lstat (port, &st)) || !S_ISSOCK (st.st_mode))
+    continue;
+  _eth_sw_add_peer (sw, port);
+  }
+closedir (d);
+}
+
+/* Send one frame to a port, 0 when it was taken (or dropped for lack of room).
+   The socket waits a moment for room at a busy port (the sender is normally
+   the writer thread) rather than dropping whenever its queue is full. */
+
+static int _eth_sw_sendto (ETH_SW* sw, const char *port, const u_char *msg, size_t len)
+{
+struct sockaddr_un sa;
+
+memset (&sa, 0, sizeof (sa));
+sa.sun_family = AF_UNIX;
+strcpy (sa.sun_path, port);
+if (sendto (sw->fd, msg, len, 0, (struct sockaddr *)&sa, sizeof (sa)) == (ssize_t)len)
+  return 0;
+if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == ENOBUFS) || (errno == EINTR)) {
+  ++sw->dropped;                                /* congested, like a real switch */
+  return 0;
+  }
+#if defined (USE_READER_THREAD)
+pthread_mutex_lock (&sw->lock);
+#endif
+_eth_sw_drop_peer (sw, port, (errno == ECONNREFUSED));
+#if defined (USE_READER_THREAD)
+pthread_mutex_unlock (&sw->lock);
+#endif
+return -1;
+}
+
+static int _eth_sw_send (ETH_SW* sw, const u_char *msg, size_t len)
+{
+time_t now = time (NULL);
+int i, h, count;
+ETH_SW_PORT port;
+
+if (!(msg[0] & 0x01)) {                         /* unicast to a learned port? */
+#if defined (USE_READER_THREAD)
+  pthread_mutex_lock (&sw->lock);
+#endif
+  h = _eth_sw_hash (msg);
+  port[0] = '\0';
+  if (sw->learned[h].seen && ((now - sw->learned[h].seen) < ETH_SW_AGE) &&
+      (0 == memcmp (sw->learned[h].mac, msg, sizeof (ETH_MAC))))
+    strcpy (port, sw->learned[h].port);
+#if defined (USE_READER_THREAD)
+  pthread_mutex_unlock (&sw->lock);
+#endif
+  if (port[0] && (0 == _eth_sw_sendto (sw, port, msg, len))) {
+    ++sw->unicast;
+    return 0;
+    }
+  }
+/* flood (ports found to be gone drop out of the list as we go) */
+#if defined (USE_READER_THREAD)
+pthread_mutex_lock (&sw->lock);
+#endif
+if ((now - sw->peer_scan) >= ETH_SW_RESCAN)
+  _eth_sw_scan (sw);
+count = sw->peer_count;
+#if defined (USE_READER_THREAD)
+pthread_mutex_unlock (&sw->lock);
+#endif
+for (i = count - 1; i >= 0; i--) {              /* backwards, since failures drop ports */
+#if defined (USE_READER_THREAD)
+  pthread_mutex_lock (&sw->lock);
+#endif
+  port[0] = '\0';
+  if (i < sw->peer_count)
+    strcpy (port, sw->peer[i]);
+#if defined (USE_READER_THREAD)
+  pthread_mutex_unlock (&sw->lock);
+#endif
+  if (port[0])
+    _eth_sw_sendto (sw, port, msg, len);
+  }
+++sw->flooded;
+return 0;
+}
+
+/* Receive one frame, learning which port its source address lives on */
+
+static int _eth_sw_recv (ETH_SW* sw, u_char *buf, size_t size)
+{
+struct sockaddr_un sa;
+socklen_t salen = sizeof (sa);
+int len;
+
+memset (&sa, 0, sizeof (sa));
+len = (int)recvfrom (sw->fd, buf, size, MSG_DONTWAIT, (struct sockaddr *)&sa, &salen);
+if ((len >= ETH_MIN_PACKET) && (salen > offsetof (struct sockaddr_un, sun_path)) && 
+    sa.sun_path[0] && !(buf[6] & 0x01)) {
+  int h = _eth_sw_hash (&buf[6]);
+
+  sa.sun_path[sizeof (sa.sun_path) - 1] = '\0';
+#if defined (USE_READER_THREAD)
+  pthread_mutex_lock (&sw->lock);
+#endif
+  memcpy (sw->learned[h].mac, &buf[6], sizeof (ETH_MAC));
+  strcpy (sw->learned[h].port, sa.sun_path);
+  sw->learned[h].seen = time (NULL);
+  _eth_sw_add_peer (sw, sa.sun_path);           /* a new port announces itself */
+#if defined (USE_READER_THREAD)
+  pthread_mutex_unlock (&sw->lock);
+#endif
+  }
+return len;
+}
+
+static ETH_SW* _eth_sw_open (const char *name, char *errbuf, size_t errsize)
+{
+static int ports = 0;                           /* ports opened by this process */
+struct sockaddr_un sa;
+struct timeval wait = {0, ETH_SW_WAIT*1000};
+ETH_SW* sw;
+const char *tmpdir = getenv ("TMPDIR");
+int size = 1024*1024;
+
+if (!*name || strchr (name, ' ')) {
+  strncpy (errbuf, "Invalid switch name", errsize-1);
+  return NULL;
+  }
+if (NULL == (sw = (ETH_SW*) calloc (1, sizeof (*sw)))) {
+  strncpy (errbuf, strerror (errno), errsize-1);
+  return NULL;
+  }
+if (strchr (name, '/'))
+  snprintf (sw->dir, sizeof (sw->dir), "%s", name);
+else
+  snprintf (sw->dir, sizeof (sw->dir), "%s/simh-sw-%s", (tmpdir && *tmpdir) ? tmpdir : "/tmp", name);
+if (strlen (sw->dir) + 24 >= sizeof (sw->self)) {
+  strncpy (errbuf, "Switch name too long", errsize-1);
+  free (sw);
+  return NULL;
+  }
+sprintf (sw->self, "%s/%d-%d", sw->dir, (int)getpid (), ports++);
+if (((0 != mkdir (sw->dir, 0700)) && (errno != EEXIST)) ||
+    (0 > (sw->fd = socket (AF_UNIX, SOCK_DGRAM, 0)))) {
+  strncpy (errbuf, strerror (errno), errsize-1);
+  free (sw);
+  return NULL;
+  }
+memset (&sa, 0, sizeof (sa));
+sa.sun_family = AF_UNIX;
+strcpy (sa.sun_path, sw->self);
+unlink (sw->self);                              /* left by an earlier process with our pid */
+if (0 != bind (sw->fd, (struct sockaddr *)&sa, sizeof (sa))) {
+  strncpy (errbuf, strerror (errno), errsize-1);
+  close (sw->fd);
+  unlink (sw->self);
+  free (sw);
+  return NULL;
+  }
+setsockopt (sw->fd, SOL_SOCKET, SO_SNDBUF, (char *)&size, sizeof (size));
+setsockopt (sw->fd, SOL_SOCKET, SO_RCVBUF, (char *)&size, sizeof (size));
+setsockopt (sw->fd, SOL_SOCKET, SO_SNDTIMEO, (char *)&wait, sizeof (wait));
+#if defined (USE_READER_THREAD)
+pthread_mutex_init (&sw->lock, NULL);
+#endif
+_eth_sw_scan (sw);
+return sw;
+}
+
+static void _eth_sw_close (ETH_SW* sw)
+{
+close (sw->fd);
+unlink (sw->self);
+rmdir (sw->dir);                                /* when this was the last port */
+#if defined (USE_READER_THREAD)
+pthread_mutex_destroy (&sw->lock);
+#endif
+free (sw);
+}
+
+static void _eth_sw_show (FILE* st, ETH_SW* sw)
+{
+int i, learned = 0;
+time_t now = time (NULL);
+
+for (i = 0; i < ETH_SW_MACS; i++)
+  if (sw->learned[i].seen && ((now - sw->learned[i].seen) < ETH_SW_AGE))
+    ++learned;
+fprintf(st, "  Switch Port:           %s\n", sw->self);
+fprintf(st, "  Switch Peers:          %d\n", sw->peer_count);
+fprintf(st, "  Switch Learned:        %d\n", learned);
+fprintf(st, "  Switch Sent:           %u unicast, %u flooded\n", sw->unicast, sw->flooded);
+fprintf(st, "  Switch Dropped:        %u\n", sw->dropped);
+}
+#endif /* USE_SW_NETWORK */
+
 #if defined (USE_READER_THREAD)
 #include <pthread.h>
 
@@ -1502,6 +1911,7 @@ switch (dev->eth_api) {
     break;
   case ETH_API_TAP:
   case ETH_API_VDE:
+  case ETH_API_SW:
     do_select = 1;
     select_fd = dev->fd_handle;
     break;
@@ -1551,14 +1961,15 @@ while (dev->handle) {
           u_char buf[ETH_MAX_JUMBO_FRAME];
 
           memset(&header, 0, sizeof(header));
-          len = read(dev->fd_handle, buf, sizeof(buf));
-          if (len > 0) {
-            status = 1;
+          /* the descriptor is non-blocking, so collect a batch of */
+          /* whatever has arrived before publishing it */
+          status = 0;
+          while ((status < (int)dev->read_ring.size) && 
+                 ((len = read(dev->fd_handle, buf, sizeof(buf))) > 0)) {
+            ++status;
             header.caplen = header.len = len;
             _eth_callback((u_char *)dev, &header, buf);
             }
-          else
-            status = 0;
           }
         break;
 #endif /* USE_TAP_NETWORK */
@@ -1581,17 +1992,30 @@ while (dev->handle) {
           }
         break;
 #endif /* USE_VDE_NETWORK */
+#ifdef USE_SW_NETWORK
+      case ETH_API_SW:
+        if (1) {
+          struct pcap_pkthdr header;
+          int len;
+          u_char buf[ETH_MAX_JUMBO_FRAME];
+
+          memset(&header, 0, sizeof(header));
+          /* the socket is non-blocking, so collect a batch like TAP */
+          status = 0;
+          while ((status < (int)dev->read_ring.size) && 
+                 ((len = _eth_sw_recv((ETH_SW*)dev->handle, buf, sizeof(buf))) > 0)) {
+            ++status;
+            header.caplen = header.len = len;
+            _eth_callback((u_char *)dev, &header, buf);
+            }
+          }
+        break;
+#endif /* USE_SW_NETWORK */
       }
-    if ((status > 0) && (dev->asynch_io)) {
-      int wakeup_needed;
-
-      pthread_mutex_lock (&dev->lock);
-      wakeup_needed = (dev->read_queue.count != 0);
-      pthread_mutex_unlock (&dev->lock);
-      if (wakeup_needed) {
-        sim_debug(dev->dbit, dev->dptr, "Queueing automatic poll\n");
-        sim_activate_abs (dev->dptr->units, dev->asynch_io_latency);
-        }
+    /* publish the whole batch at once, waking the simulator only once */
+    if ((status > 0) && _eth_ring_publish (dev) && (dev->asynch_io)) {
+      sim_debug(dev->dbit, dev->dptr, "Queueing automatic poll\n");
+      sim_activate_abs (dev->dptr->units, dev->asynch_io_latency);
       }
     }
   }
@@ -1600,6 +2024,63 @@ sim_debug(dev->dbit, dev->dptr, "Reader Thread Exiting\n");
 return NULL;
 }
 
+/* Send a list of write requests, returning the last request in *last */
+
+static t_stat
+_eth_write_list(ETH_DEV* dev, struct write_request *request, struct write_request **last)
+{
+t_stat r = SCPE_OK;
+
+++dev->write_batches;
+#if defined (HAVE_SENDMMSG)
+if ((dev->eth_api == ETH_API_PCAP) && (dev->handle)) {
+  int fd = pcap_fileno((pcap_t*)dev->handle);
+  struct mmsghdr msgs[ETH_WRITE_BATCH];
+  struct iovec iov[ETH_WRITE_BATCH];
+  int loopback_self_frame[ETH_WRITE_BATCH];
+
+  while (request) {
+    int i, n = 0;
+
+    /* gather the next group of packets */
+    memset(msgs, 0, sizeof(msgs));
+    for (; request && (n < ETH_WRITE_BATCH); request = request->next) {
+      *last = request;
+      ++dev->write_frames;
+      if (!_eth_write_start(dev, &request->packet, &loopback_self_frame[n])) {
+        r = SCPE_IOERR;
+        continue;
+        }
+      iov[n].iov_base = request->packet.msg;
+      iov[n].iov_len = request->packet.len;
+      msgs[n].msg_hdr.msg_iov = &iov[n];
+      msgs[n].msg_hdr.msg_iovlen = 1;
+      ++n;
+      }
+    /* and send them with as few system calls as possible */
+    for (i = 0; i < n; ) {
+      int sent = sendmmsg(fd, &msgs[i], n - i, 0);
+
+      if (sent <= 0) {                          /* this packet failed */
+        _eth_write_failed(dev, loopback_self_frame[i]);
+        r = SCPE_IOERR;
+        sent = 1;
+        }
+      i += sent;
+      }
+    }
+  return r;
+  }
+#endif
+for (; request; request = request->next) {
+  *last = request;
+  ++dev->write_frames;
+  if (_eth_write(dev, &request->packet, NULL) != SCPE_OK)
+    r = SCPE_IOERR;
+  }
+return r;
+}
+
 static void *
 _eth_writer(void *arg)
 {
@@ -1621,15 +2102,20 @@ pthread_mutex_lock (&dev->writer_lock);
 while (dev->handle) {
   pthread_cond_wait (&dev->writer_cond, &dev->writer_lock);
   while (NULL != (request = dev->write_requests)) {
-    /* Pull buffer off request list */
-    dev->write_requests = request->next;
+    struct write_request *last;
+    int count = dev->write_queue_size;
+
+    /* Pull the whole request list */
+    dev->write_requests = dev->write_requests_last = NULL;
+    dev->write_queue_size = 0;
     pthread_mutex_unlock (&dev->writer_lock);
 
-    dev->write_status = _eth_write(dev, &request->packet, NULL);
+    dev->write_status = _eth_write_list(dev, request, &last);
+    AIO_INFLIGHT_ADJUST (-count);
 
     pthread_mutex_lock (&dev->writer_lock);
-    /* Put buffer on free buffer list */
-    request->next = dev->write_buffers;
+    /* Put buffers on free buffer list */
+    last->next = dev->write_buffers;
     dev->write_buffers = request;
     }
   }
@@ -1652,9 +2138,7 @@ int wakeup_needed;
 
 dev->asynch_io = 1;
 dev->asynch_io_latency = latency;
-pthread_mutex_lock (&dev->lock);
-wakeup_needed = (dev->read_queue.count != 0);
-pthread_mutex_unlock (&dev->lock);
+wakeup_needed = (dev->read_ring.tail != dev->read_ring.head);
 if (wakeup_needed) {
   sim_debug(dev->dbit, dev->dptr, "Queueing automatic poll\n");
   sim_activate_abs (dev->dptr->units, dev->asynch_io_latency);
@@ -1823,6 +2307,22 @@ else
     strncpy(errbuf, "No support for vde: network devices", sizeof(errbuf)-1);
 #endif /* !defined(__linux) && !defined(USE_BSDTUNTAP) */
     }
+  else if (0 == strncmp("sw:", savname, 3)) {
+#if defined(USE_SW_NETWORK)
+    if (!strcmp(savname, "sw:name")) {
+      msg = "Eth: Must specify actual switch name (i.e. sw:lan0)\r\n";
+      printf (msg, errbuf);
+      if (sim_log) fprintf (sim_log, msg, errbuf);
+      return SCPE_OPENERR;
+      }
+    if (NULL != (dev->handle = (void*) _eth_sw_open(savname+3, errbuf, sizeof(errbuf)))) {
+      dev->eth_api = ETH_API_SW;
+      dev->fd_handle = ((ETH_SW*)dev->handle)->fd;
+      }
+#else
+    strncpy(errbuf, "No support for sw: network devices", sizeof(errbuf)-1);
+#endif /* USE_SW_NETWORK */
+    }
   else {
     dev->handle = (void*) pcap_open_live(savname, bufsz, ETH_PROMISC, PCAP_READ_TIMEOUT, errbuf);
     if (!dev->handle) { /* can't open device */
@@ -1863,6 +2363,7 @@ if (dev->eth_api == ETH_API_PCAP) {
   }
 #endif /* xBSD */
 
+_eth_ring_init (&dev->read_ring, ETH_RING_SLOTS); /* allocate receive ring */
 #if defined (USE_READER_THREAD)
 if (1) {
   pthread_attr_t attr;
@@ -1870,7 +2371,6 @@ if (1) {
 #if defined(_WIN32)
   pcap_setmintocopy (dev->handle, 0);
 #endif
-  ethq_init (&dev->read_queue, 200);         /* initialize FIFO queue */
   pthread_mutex_init (&dev->lock, NULL);
   pthread_mutex_init (&dev->writer_lock, NULL);
   pthread_mutex_init (&dev->self_lock, NULL);
@@ -1930,6 +2430,8 @@ pthread_join (dev->writer_thread, NULL);
 pthread_mutex_destroy (&dev->self_lock);
 pthread_mutex_destroy (&dev->writer_lock);
 pthread_cond_destroy (&dev->writer_cond);
+AIO_INFLIGHT_ADJUST (-dev->write_queue_size);           /* writes never sent */
+dev->write_queue_size = 0;
 if (1) {
   struct write_request *buffer;
    while (NULL != (buffer = dev->write_buffers)) {
@@ -1940,9 +2442,17 @@ if (1) {
     dev->write_requests = buffer->next;
     free(buffer);
     }
+  while (NULL != (buffer = dev->write_spare)) {
+    dev->write_spare = buffer->next;
+    free(buffer);
+    }
+  while (NULL != (buffer = dev->write_batch)) {
+    dev->write_batch = buffer->next;
+    free(buffer);
+    }
   }
-ethq_destroy (&dev->read_queue);         /* release FIFO queue */
 #endif
+_eth_ring_free (&dev->read_ring);             /* release receive ring */
 
 switch (dev->eth_api) {
   case ETH_API_PCAP:
@@ -1957,6 +2467,11 @@ switch (dev->eth_api) {
   case ETH_API_VDE:
     vde_close((VDECONN*)pcap);
     break;
+#endif
+#ifdef USE_SW_NETWORK
+  case ETH_API_SW:
+    _eth_sw_close((ETH_SW*)pcap);
+    break;
 #endif
   }
 printf (msg, dev->name);
@@ -1977,9 +2492,14 @@ fprintf (st, "   libpcap version 1.0.0\n");
 fprintf (st, "   ETH devices:\n");
 fprintf (st, "    eth0   en0      (No description available)\n");
 fprintf (st, "   eth1   tap:tapN (Integrated Tun/Tap support)\n");
+fprintf (st, "   eth2   sw:name  (Integrated virtual switch)\n");
 fprintf (st, "   sim> ATTACH %s eth0\n\n", dptr->name);
 fprintf (st, "or equivalently:\n\n");
 fprintf (st, "   sim> ATTACH %s en0\n\n", dptr->name);
+fprintf (st, "Simulators which attach to the same virtual switch name (i.e.\n");
+fprintf (st, "sw:lan0) are connected to each other without any host interface\n");
+fprintf (st, "or privileges:\n\n");
+fprintf (st, "   sim> ATTACH %s sw:lan0\n\n", dptr->name);
 return SCPE_OK;
 }
 
@@ -2115,38 +2635,69 @@ sim_debug(dev->dbit, dev->dptr, "Reflections = %d\n", dev->reflections);
 return dev->reflections;
 }
 
+/* Check and trace a packet about to be sent, recording a loopback self 
+   frame before it is sent (to avoid race conditions with the receiver).
+   Returns FALSE if the packet can't be sent. */
+
 static
-t_stat _eth_write(ETH_DEV* dev, ETH_PACK* packet, ETH_PCALLBACK routine)
+t_bool _eth_write_start(ETH_DEV* dev, ETH_PACK* packet, int *loopback_self_frame)
 {
-int status = 1;   /* default to failure */
+/* make sure packet is acceptable length */
+if ((packet->len < ETH_MIN_PACKET) || (packet->len > ETH_MAX_PACKET))
+  return FALSE;
 
-/* make sure device exists */
-if (!dev) return SCPE_UNATT;
+*loopback_self_frame = LOOPBACK_SELF_FRAME(packet->msg, packet->msg);
 
-/* make sure packet exists */
-if (!packet) return SCPE_ARG;
+eth_packet_trace (dev, packet->msg, packet->len, "writing");
 
-/* make sure packet is acceptable length */
-if ((packet->len >= ETH_MIN_PACKET) && (packet->len <= ETH_MAX_PACKET)) {
-  int loopback_self_frame = LOOPBACK_SELF_FRAME(packet->msg, packet->msg);
+/* record sending of loopback packet */
+if (*loopback_self_frame) {
+  if (dev->have_host_nic_phy_addr) {
+    memcpy(&packet->msg[6],  dev->host_nic_phy_hw_addr, sizeof(ETH_MAC));
+    memcpy(&packet->msg[18], dev->host_nic_phy_hw_addr, sizeof(ETH_MAC));
+  }
+#ifdef USE_READER_THREAD
+  pthread_mutex_lock (&dev->self_lock);
+#endif
+  dev->loopback_self_sent += dev->reflections;
+  dev->loopback_self_sent_total++;
+#ifdef USE_READER_THREAD
+  pthread_mutex_unlock (&dev->self_lock);
+#endif
+}
+return TRUE;
+}
 
-  eth_packet_trace (dev, packet->msg, packet->len, "writing");
+/* On error, correct loopback bookkeeping */
 
-  /* record sending of loopback packet (done before actual send to avoid race conditions with receiver) */
-  if (loopback_self_frame) {
-    if (dev->have_host_nic_phy_addr) {
-      memcpy(&packet->msg[6],  dev->host_nic_phy_hw_addr, sizeof(ETH_MAC));
-      memcpy(&packet->msg[18], dev->host_nic_phy_hw_addr, sizeof(ETH_MAC));
-    }
+static
+void _eth_write_failed(ETH_DEV* dev, int loopback_self_frame)
+{
+if (loopback_self_frame) {
 #ifdef USE_READER_THREAD
-    pthread_mutex_lock (&dev->self_lock);
+  pthread_mutex_lock (&dev->self_lock);
 #endif
-    dev->loopback_self_sent += dev->reflections;
-    dev->loopback_self_sent_total++;
+  dev->loopback_self_sent -= dev->reflections;
+  dev->loopback_self_sent_total--;
 #ifdef USE_READER_THREAD
-    pthread_mutex_unlock (&dev->self_lock);
+  pthread_mutex_unlock (&dev->self_lock);
 #endif
   }
+}
+
+static
+t_stat _eth_write(ETH_DEV* dev, ETH_PACK* packet, ETH_PCALLBACK routine)
+{
+int status = 1;   /* default to failure */
+int loopback_self_frame;
+
+/* make sure device exists */
+if (!dev) return SCPE_UNATT;
+
+/* make sure packet exists */
+if (!packet) return SCPE_ARG;
+
+if (_eth_write_start(dev, packet, &loopback_self_frame)) {
 
     /* dispatch write request (synchronous; no need to save write info to dev) */
   switch (dev->eth_api) {
@@ -2170,20 +2721,16 @@ if ((packet->len >= ETH_MIN_PACKET) && (packet->len <= ETH_MAX_PACKET)) {
           status = 1;
       break;
 #endif
-    }
-  /* On error, correct loopback bookkeeping */
-  if ((status != 0) && loopback_self_frame) {
-#ifdef USE_READER_THREAD
-    pthread_mutex_lock (&dev->self_lock);
-#endif
-    dev->loopback_self_sent -= dev->reflections;
-    dev->loopback_self_sent_total--;
-#ifdef USE_READER_THREAD
-    pthread_mutex_unlock (&dev->self_lock);
+#ifdef USE_SW_NETWORK
+    case ETH_API_SW:
+      status = (dev->handle) ? _eth_sw_send((ETH_SW*)dev->handle, packet->msg, packet->len) : 1;
+      break;
 #endif
     }
+  if (status != 0)
+    _eth_write_failed(dev, loopback_self_frame);
 
-  } /* if packet->len */
+  } /* if _eth_write_start */
 
 /* call optional write callback function */
 if (routine)
@@ -2192,21 +2739,52 @@ if (routine)
 return ((status == 0) ? SCPE_OK : SCPE_IOERR);
 }
 
+#ifdef USE_READER_THREAD
+/* Hand the collected batch of writes to the writer thread */
+
+static void _eth_write_submit(ETH_DEV* dev)
+{
+if (!dev->write_batch)
+  return;
+/* Append batch at the end of the write list (to make sure that */
+/* packets make it to the wire in the order they were presented here) */
+pthread_mutex_lock (&dev->writer_lock);
+if (dev->write_requests)
+  dev->write_requests_last->next = dev->write_batch;
+else
+  dev->write_requests = dev->write_batch;
+dev->write_requests_last = dev->write_batch_last;
+dev->write_queue_size += dev->write_batch_size;
+AIO_INFLIGHT_ADJUST (dev->write_batch_size);
+if (dev->write_queue_size > dev->write_queue_peak)
+  dev->write_queue_peak = dev->write_queue_size;
+pthread_mutex_unlock (&dev->writer_lock);
+dev->write_batch = dev->write_batch_last = NULL;
+dev->write_batch_size = 0;
+
+/* Awaken writer thread to perform actual write */
+pthread_cond_signal (&dev->writer_cond);
+}
+#endif
+
 t_stat eth_write(ETH_DEV* dev, ETH_PACK* packet, ETH_PCALLBACK routine)
 {
 #ifdef USE_READER_THREAD
 struct write_request *request;
-int write_queue_size = 1;
 
 /* make sure device exists */
 if (!dev) return SCPE_UNATT;
 
-/* Get a buffer */
-pthread_mutex_lock (&dev->writer_lock);
-if (NULL != (request = dev->write_buffers))
-  dev->write_buffers = request->next;
-pthread_mutex_unlock (&dev->writer_lock);
-if (NULL == request)
+/* Get a buffer (taking all free buffers at once when we run out) */
+if (NULL == dev->write_spare) {
+  pthread_mutex_lock (&dev->writer_lock);
+  dev->write_spare = dev->write_buffers;
+  dev->write_buffers = NULL;
+  pthread_mutex_unlock (&dev->writer_lock);
+  }
+if (NULL != (request = dev->write_spare))
+  dev->write_spare = request->next;
+else
   request = malloc(sizeof(*request));
 
 /* Copy buffer contents */
@@ -2216,28 +2794,18 @@ request->packet.status = packet->status;
 request->packet.crc_len = packet->crc_len;
 memcpy(request->packet.msg, packet->msg, packet->len);
 
-/* Insert buffer at the end of the write list (to make sure that */
-/* packets make it to the wire in the order they were presented here) */
-pthread_mutex_lock (&dev->writer_lock);
+/* Add buffer to the current batch */
 request->next = NULL;
-if (dev->write_requests) {
-  struct write_request *last_request = dev->write_requests;
-
-  ++write_queue_size;
-  while (last_request->next) {
-    last_request = last_request->next;
-    ++write_queue_size;
-    }
-  last_request->next = request;
-  }
+if (dev->write_batch)
+  dev->write_batch_last->next = request;
 else
-    dev->write_requests = request;
-if (write_queue_size > dev->write_queue_peak)
-  dev->write_queue_peak = write_queue_size;
-pthread_mutex_unlock (&dev->writer_lock);
+  dev->write_batch = request;
+dev->write_batch_last = request;
+++dev->write_batch_size;
 
-/* Awaken writer thread to perform actual write */
-pthread_cond_signal (&dev->writer_cond);
+/* Unless a batch is being collected, send it now */
+if (!dev->write_batching)
+  _eth_write_submit (dev);
 
 /* Return with a status from some prior write */
 if (routine)
@@ -2248,6 +2816,30 @@ return _eth_write(dev, packet, routine);
 #endif
 }
 
+/* Bracket a burst of eth_write calls (a device processing its transmit 
+   list) so that the burst reaches the writer thread in one handoff and 
+   goes to the wire with as few system calls as the transport allows.
+   Brackets may nest; the batch is sent by the outermost eth_write_end. */
+
+t_stat eth_write_begin(ETH_DEV* dev)
+{
+if (!dev) return SCPE_UNATT;
+#ifdef USE_READER_THREAD
+++dev->write_batching;
+#endif
+return SCPE_OK;
+}
+
+t_stat eth_write_end(ETH_DEV* dev)
+{
+if (!dev) return SCPE_UNATT;
+#ifdef USE_READER_THREAD
+if ((dev->write_batching > 0) && (--dev->write_batching == 0))
+  _eth_write_submit (dev);
+#endif
+return SCPE_OK;
+}
+
 static int
 _eth_hash_lookup(ETH_MULTIHASH hash, const u_char* data)
 {
@@ -2712,6 +3304,7 @@ switch (dev->eth_api) {
 #endif /* USE_BPF */
   case ETH_API_TAP:
   case ETH_API_VDE:
+  case ETH_API_SW:
     bpf_used = 0;
     to_me = 0;
     eth_packet_trace (dev, data, header->len, "received");
@@ -2769,33 +3362,37 @@ if (bpf_used ? to_me : (to_me && !from_me)) {
     }
 #if defined (USE_READER_THREAD)
   if (1) {
-    int crc_len = 0;
-    uint8 crc_data[4];
+    /* The frame is copied once, straight from the capture buffer into */
+    /* its receive ring slot, where any fixups are then made in place */
+    ETH_PACK* slot = _eth_ring_claim (&dev->read_ring);
     uint32 len = header->len;
-    u_char* moved_data = NULL;
 
-    if (header->len < ETH_MIN_PACKET) {   /* Pad runt packets before CRC append */
-      moved_data = malloc(ETH_MIN_PACKET);
-      memcpy(moved_data, data, len);
-      memset(moved_data + len, 0, ETH_MIN_PACKET-len);
+    if (!slot) {
+      eth_packet_trace (dev, data, len, "dropped (receive ring full)");
+      return;
+      }
+    memcpy(slot->msg, data, len);
+    if (len < ETH_MIN_PACKET) {           /* Pad runt packets before CRC append */
+      memset(&slot->msg[len], 0, ETH_MIN_PACKET-len);
       len = ETH_MIN_PACKET;
-      data = moved_data;
       }
+    slot->len = len;
+    slot->used = 0;
+    slot->status = 0;
 
     /* If necessary, fix IP header checksums for packets originated locally */
     /* but were presumed to be traversing a NIC which was going to handle that task */
     /* This must be done before any needed CRC calculation */
-    _eth_fix_ip_xsum_offload(dev, (u_char*)data, len);
+    _eth_fix_ip_xsum_offload(dev, slot->msg, len);
     
     if (dev->need_crc)
-      crc_len = eth_get_packet_crc32_data(data, len, crc_data);
+      slot->crc_len = eth_add_packet_crc32(slot->msg, len);
+    else
+      slot->crc_len = 0;
 
-    eth_packet_trace (dev, data, len, "rcvqd");
+    eth_packet_trace (dev, slot->msg, len, "rcvqd");
 
-    pthread_mutex_lock (&dev->lock);
-    ethq_insert_data(&dev->read_queue, 2, data, 0, len, crc_len, crc_data, 0);
-    pthread_mutex_unlock (&dev->lock);
-    free(moved_data);
+    ++dev->read_ring.fill;                /* published by the reader after the batch */
     }
 #else /* !USE_READER_THREAD */
   /* set data in passed read packet */
@@ -2890,22 +3487,42 @@ do {
         }
       break;
 #endif /* USE_VDE_NETWORK */
+#ifdef USE_SW_NETWORK
+    case ETH_API_SW:
+      if (1) {
+        struct pcap_pkthdr header;
+        int len;
+        u_char buf[ETH_MAX_JUMBO_FRAME];
+
+        memset(&header, 0, sizeof(header));
+        len = _eth_sw_recv((ETH_SW*)dev->handle, buf, sizeof(buf));
+        if (len > 0) {
+          status = 1;
+          header.caplen = header.len = len;
+          _eth_callback((u_char *)dev, &header, buf);
+          }
+        else
+          status = 0;
+        }
+      break;
+#endif /* USE_SW_NETWORK */
     }
   } while ((status) && (0 == packet->len));
 
 #else /* USE_READER_THREAD */
 
-  status = 0;
-  pthread_mutex_lock (&dev->lock);
-  if (dev->read_queue.count > 0) {
-    ETH_ITEM* item = &dev->read_queue.item[dev->read_queue.head];
-    packet->len = item->packet.len;
-    packet->crc_len = item->packet.crc_len;
-    memcpy(packet->msg, item->packet.msg, ((packet->len > packet->crc_len) ? packet->len : packet->crc_len));
-    status = 1;
-    ethq_remove(&dev->read_queue);
-  }
-  pthread_mutex_unlock (&dev->lock);  
+  if (1) {
+    ETH_PACK* slot = eth_read_slot (dev);
+
+    status = 0;
+    if (slot) {
+      packet->len = slot->len;
+      packet->crc_len = slot->crc_len;
+      memcpy(packet->msg, slot->msg, ((packet->len > packet->crc_len) ? packet->len : packet->crc_len));
+      status = 1;
+      eth_read_done (dev);
+      }
+    }
   if ((status) && (routine))
     routine(0);
 #endif
@@ -2913,6 +3530,42 @@ do {
 return status;
 }
 
+/* Received packets can also be processed in place.  eth_read_slot returns
+   the oldest received packet, which stays valid until it is released with 
+   eth_read_done, or NULL when nothing is waiting.  Without a reader thread 
+   the interface is polled for a single packet. */
+
+ETH_PACK* eth_read_slot(ETH_DEV* dev)
+{
+ETH_RING* ring;
+
+if (!dev || !dev->read_ring.size) return NULL;
+ring = &dev->read_ring;
+#if !defined (USE_READER_THREAD)
+if (ring->head == ring->tail) {
+  ETH_PACK* slot = _eth_ring_claim (ring);
+
+  slot->used = 0;
+  slot->status = 0;
+  if ((eth_read (dev, slot, NULL)) && (slot->len)) {
+    ++ring->fill;
+    _eth_ring_publish (dev);
+    }
+  }
+#endif
+if (ring->head == ring->tail)
+  return NULL;
+ETH_RING_BARRIER (dev);                         /* index before the slot */
+return &ring->slot[ring->head & (ring->size - 1)];
+}
+
+void eth_read_done(ETH_DEV* dev)
+{
+if (!dev || (dev->read_ring.head == dev->read_ring.tail)) return;
+ETH_RING_BARRIER (dev);                         /* slot before the index */
+++dev->read_ring.head;
+}
+
 t_stat eth_filter(ETH_DEV* dev, int addr_count, ETH_MAC* const addresses,
                   ETH_BOOL all_multicast, ETH_BOOL promiscuous)
 {
@@ -3100,11 +3753,8 @@ if (dev->eth_api == ETH_API_PCAP) {
       }
     pcap_freecode(&bpf);
     }
-#ifdef USE_READER_THREAD
-  pthread_mutex_lock (&dev->lock);
-  ethq_clear (&dev->read_queue); /* Empty FIFO Queue when filter list changes */
-  pthread_mutex_unlock (&dev->lock);
-#endif
+  /* Discard received packets when filter list changes */
+  dev->read_ring.head = dev->read_ring.tail;
   }
 #endif /* USE_BPF */
 
@@ -3207,6 +3857,13 @@ if (used < max) {
   ++used;
   }
 #endif
+#ifdef USE_SW_NETWORK
+if (used < max) {
+  sprintf(list[used].name, "%s", "sw:name");
+  sprintf(list[used].desc, "%s", "Integrated virtual switch");
+  ++used;
+  }
+#endif
 
 return used;
 }
@@ -3280,14 +3937,21 @@ if (dev->jumbo_fragmented)
   fprintf(st, "  Jumbo Fragmented:      %d\n", dev->jumbo_fragmented);
 if (dev->jumbo_truncated)
   fprintf(st, "  Jumbo Truncated:       %d\n", dev->jumbo_truncated);
+#ifdef USE_SW_NETWORK
+if ((dev->eth_api == ETH_API_SW) && dev->handle)
+  _eth_sw_show(st, (ETH_SW*)dev->handle);
+#endif
 #if defined(USE_READER_THREAD)
 fprintf(st, "  Asynch Interrupts:       %s\n", dev->asynch_io?"Enabled":"Disabled");
 if (dev->asynch_io)
   fprintf(st, "  Interrupt Latency:       %d uSec\n", dev->asynch_io_latency);
-fprintf(st, "  Read Queue: Count:       %d\n", dev->read_queue.count);
-fprintf(st, "  Read Queue: High:        %d\n", dev->read_queue.high);
-fprintf(st, "  Read Queue: Loss:        %d\n", dev->read_queue.loss);
+fprintf(st, "  Read Ring: Size:         %d\n", dev->read_ring.size);
+fprintf(st, "  Read Ring: Count:        %d\n", dev->read_ring.tail - dev->read_ring.head);
+fprintf(st, "  Read Ring: High:         %d\n", dev->read_ring.high);
+fprintf(st, "  Read Ring: Loss:         %d\n", dev->read_ring.loss);
+fprintf(st, "  Read Ring: Batches:      %d\n", dev->read_ring.batches);
 fprintf(st, "  Peak Write Queue Size:   %d\n", dev->write_queue_peak);
+fprintf(st, "  Write Batches:           %u (%u packets)\n", dev->write_batches, dev->write_frames);
 #endif
 }
 #endif /* USE_NETWORK */
@@ -90,6 +90,11 @@
 #undef USE_READER_THREAD
 #endif
 
+/* the integrated virtual switch only needs local domain sockets */
+#if !defined(_WIN32) && !defined(VMS) && !defined(__VMS)
+#define USE_SW_NETWORK 1
+#endif
+
 /* make common winpcap code a bit easier to read in this file */
 #if defined(_WIN32) || defined(VMS) || defined(__CYGWIN__)
 #define PCAP_READ_TIMEOUT -1
@@ -144,6 +149,7 @@
 #define ETH_CRC_SIZE           4                        /* ethernet CRC size */
 #define ETH_FRAME_SIZE (ETH_MAX_PACKET+ETH_CRC_SIZE)    /* ethernet maximum frame size */
 #define ETH_MIN_JUMBO_FRAME ETH_MAX_PACKET              /* Threshold size for Jumbo Frame Processing */
+#define ETH_RING_SIZE       1024                        /* receive ring slots (power of 2) */
 
 #define LOOPBACK_SELF_FRAME(phy_mac, msg)             \
     (((msg)[12] == 0x90) && ((msg)[13] == 0x00) &&    \
@@ -195,6 +201,22 @@ struct eth_queue {
   struct eth_item*    item;
 };
 
+/* Receive ring: the reader thread fills preallocated slots and publishes 
+   them a batch at a time by advancing tail, the simulator thread consumes 
+   them in place and releases them by advancing head.  With a single 
+   producer and a single consumer no lock is needed. */
+
+struct eth_ring {
+  uint32              size;                             /* slot count (power of 2) */
+  volatile uint32     head;                             /* next slot to consume */
+  volatile uint32     tail;                             /* end of published slots */
+  uint32              fill;                             /* end of slots being filled */
+  uint32              high;                             /* high water mark */
+  uint32              loss;                             /* frames dropped with ring full */
+  uint32              batches;                          /* batches published */
+  struct eth_packet*  slot;                             /* preallocated frames */
+};
+
 struct eth_list {
   char    name[ETH_DEV_NAME_MAX];
   char    desc[ETH_DEV_DESC_MAX];
@@ -208,6 +230,7 @@ typedef void (*ETH_PCALLBACK)(int status);
 typedef struct eth_list ETH_LIST;
 typedef struct eth_queue ETH_QUE;
 typedef struct eth_item ETH_ITEM;
+typedef struct eth_ring ETH_RING;
 
 struct eth_device {
   char*         name;                                   /* name of ethernet device */
@@ -217,6 +240,7 @@ struct eth_device {
 #define ETH_API_PCAP 0                                  /* Pcap API in use */
 #define ETH_API_TAP  1                                  /* tun/tap API in use */
 #define ETH_API_VDE  2                                  /* VDE API in use */
+#define ETH_API_SW   3                                  /* integrated virtual switch in use */
   ETH_PCALLBACK read_callback;                          /* read callback function */
   ETH_PCALLBACK write_callback;                         /* write callback function */
   ETH_PACK*     read_packet;                            /* read packet */
@@ -239,10 +263,10 @@ struct eth_device {
   uint32        dbit;                                   /* debugging bit */
   int           reflections;                            /* packet reflections on interface */
   int           need_crc;                               /* device needs CRC (Cyclic Redundancy Check) */
+  ETH_RING      read_ring;                              /* received frames */
 #if defined (USE_READER_THREAD)
   int           asynch_io;                              /* Asynchronous Interrupt scheduling enabled */
   int           asynch_io_latency;                      /* instructions to delay pending interrupt */
-  ETH_QUE       read_queue;
   pthread_mutex_t     lock;
   pthread_t     reader_thread;                          /* Reader Thread Id */
   pthread_t     writer_thread;                          /* Writer Thread Id */
@@ -253,8 +277,17 @@ struct eth_device {
       struct write_request *next;
       ETH_PACK packet;
       } *write_requests;
+  struct write_request *write_requests_last;            /* end of pending writes */
+  int write_queue_size;                                 /* pending writes */
   int write_queue_peak;
   struct write_request *write_buffers;
+  struct write_request *write_spare;                    /* free buffers held by eth_write */
+  struct write_request *write_batch;                    /* writes collected since eth_write_begin */
+  struct write_request *write_batch_last;
+  int write_batch_size;
+  int write_batching;                                   /* eth_write_begin nesting depth */
+  uint32 write_batches;                                 /* batches handled by the writer */
+  uint32 write_frames;                                  /* packets handled by the writer */
   t_stat write_status;
 #endif
 };
@@ -269,8 +302,12 @@ t_stat eth_close  (ETH_DEV* dev);                       /* close ethernet interf
 t_stat eth_attach_help(FILE *st, DEVICE *dptr, UNIT *uptr, int32 flag, char *cptr);
 t_stat eth_write  (ETH_DEV* dev, ETH_PACK* packet,      /* write sychronous packet; */
                    ETH_PCALLBACK routine);              /*  callback when done */
+t_stat eth_write_begin (ETH_DEV* dev);                  /* collect following writes into a batch */
+t_stat eth_write_end (ETH_DEV* dev);                    /* send collected batch */
 int eth_read      (ETH_DEV* dev, ETH_PACK* packet,      /* read single packet; */
                    ETH_PCALLBACK routine);              /*  callback when done*/
+ETH_PACK* eth_read_slot (ETH_DEV* dev);                 /* next received packet in place (or NULL) */
+void eth_read_done (ETH_DEV* dev);                      /* release packet from eth_read_slot */
 t_stat eth_filter (ETH_DEV* dev, int addr_count,        /* set filter on incoming packets */
                    ETH_MAC* const addresses,
                    ETH_BOOL all_multicast,
@@ -49,6 +49,8 @@
    sim_fsize_name_ex -       get file size as a t_addr of named file
    sim_buf_copy_swapped -    copy data swapping elements along the way
    sim_buf_swap_data -       swap data elements inplace in buffer
+   sim_lz4_compress  -       compress a buffer as an LZ4 block
+   sim_lz4_decompress -      expand an LZ4 block
 
    sim_fopen and sim_fseek are OS-dependent.  The other routines are not.
    sim_fsize is always a 32b routine (it is used only with small capacity random
@@ -169,6 +171,136 @@ free(sim_flip);
 return total;
 }
 
+/* LZ4 block format encoder and decoder
+
+   Data is compressed as a single LZ4 block (without the LZ4 frame 
+   format) with a small single pass match finder.  The result is 
+   readable by any LZ4 block decoder.
+*/
+
+#define LZ4_HASH_LOG  12
+
+static uint32 _sim_lz4_get32 (const uint8 *p)
+{
+return ((uint32)p[0]) | (((uint32)p[1]) << 8) | (((uint32)p[2]) << 16) | (((uint32)p[3]) << 24);
+}
+
+static uint8 *_sim_lz4_length (uint8 *op, uint8 *oend, uint32 len)
+{
+for (; len >= 255; len -= 255) {
+    if (op >= oend)
+        return NULL;
+    *op++ = 255;
+    }
+if (op >= oend)
+    return NULL;
+*op++ = (uint8)len;
+return op;
+}
+
+/* Compress, returning the compressed length or 0 if it doesn't fit in dstmax */
+
+uint32 sim_lz4_compress (const uint8 *src, uint32 srclen, uint8 *dst, uint32 dstmax)
+{
+int32 table[1 << LZ4_HASH_LOG];
+uint32 ip = 0, anchor = 0, i;
+uint8 *op = dst, *oend = dst + dstmax;
+
+for (i = 0; i < (1 << LZ4_HASH_LOG); i++)
+    table[i] = -1;
+while (srclen >= 13 && ip + 12 < srclen) {              /* last match starts 12 bytes before the end */
+    uint32 seq = _sim_lz4_get32 (src + ip);
+    uint32 h = (seq * 2654435761u) >> (32 - LZ4_HASH_LOG);
+    int32 ref = table[h];
+    uint32 mlen, llen;
+    uint8 *token;
+
+    table[h] = (int32)ip;
+    if ((ref < 0) || ((ip - ref) > 65535) || (_sim_lz4_get32 (src + ref) != seq)) {
+        ip++;
+        continue;
+        }
+    for (mlen = 4; (ip + mlen + 5 < srclen) && (src[ref + mlen] == src[ip + mlen]); mlen++)
+        ;                                               /* last 5 bytes are literals */
+    llen = ip - anchor;
+    if (op + 1 + llen + 2 > oend)
+        return 0;
+    token = op++;
+    *token = (uint8)(((llen < 15) ? llen : 15) << 4);
+    if ((llen >= 15) && ((op = _sim_lz4_length (op, oend, llen - 15)) == NULL))
+        return 0;
+    if (op + llen + 2 > oend)
+        return 0;
+    memcpy (op, src + anchor, llen);
+    op += llen;
+    *op++ = (uint8)(ip - ref);
+    *op++ = (uint8)((ip - ref) >> 8);
+    *token |= (uint8)(((mlen - 4) < 15) ? (mlen - 4) : 15);
+    if (((mlen - 4) >= 15) && ((op = _sim_lz4_length (op, oend, mlen - 4 - 15)) == NULL))
+        return 0;
+    ip += mlen;
+    anchor = ip;
+    }
+i = srclen - anchor;                                    /* final literals */
+if (op + 1 > oend)
+    return 0;
+*op++ = (uint8)(((i < 15) ? i : 15) << 4);
+if ((i >= 15) && ((op = _sim_lz4_length (op, oend, i - 15)) == NULL))
+    return 0;
+if (op + i > oend)
+    return 0;
+memcpy (op, src + anchor, i);
+op += i;
+return (uint32)(op - dst);
+}
+
+/* Decompress, returning TRUE if exactly dstlen bytes were produced */
+
+t_bool sim_lz4_decompress (const uint8 *src, uint32 srclen, uint8 *dst, uint32 dstlen)
+{
+uint32 ip = 0, op = 0, len, off;
+uint8 token, b;
+
+while (ip < srclen) {
+    token = src[ip++];
+    len = token >> 4;
+    if (len == 15)
+        do {
+            if (ip >= srclen)
+                return FALSE;
+            b = src[ip++];
+            len += b;
+            } while (b == 255);
+    if ((len > srclen - ip) || (len > dstlen - op))
+        return FALSE;
+    memcpy (dst + op, src + ip, len);
+    ip += len;
+    op += len;
+    if (ip == srclen)                                   /* last sequence has no match */
+        break;
+    if (ip + 2 > srclen)
+        return FALSE;
+    off = src[ip] | (src[ip + 1] << 8);
+    ip += 2;
+    if ((off == 0) || (off > op))
+        return FALSE;
+    len = token & 15;
+    if (len == 15)
+        do {
+            if (ip >= srclen)
+                return FALSE;
+            b = src[ip++];
+            len += b;
+            } while (b == 255);
+    len += 4;
+    if (len > dstlen - op)
+        return FALSE;
+    for (; len; len--, op++)                            /* matches may overlap */
+        dst[op] = dst[op - off];
+    }
+return (op == dstlen);
+}
+
 /* Forward Declaration */
 
 static t_addr _sim_ftell (FILE *st);
@@ -48,6 +48,8 @@ t_addr sim_fsize_ex (FILE *fptr);
 t_addr sim_fsize_name_ex (char *fname);
 void sim_buf_swap_data (void *bptr, size_t size, size_t count);
 void sim_buf_copy_swapped (void *dptr, void *bptr, size_t size, size_t count);
+uint32 sim_lz4_compress (const uint8 *src, uint32 srclen, uint8 *dst, uint32 dstmax);
+t_bool sim_lz4_decompress (const uint8 *src, uint32 srclen, uint8 *dst, uint32 dstlen);
 
 extern uint32 sim_taddr_64;
 extern int32 sim_end;
@@ -84,11 +84,16 @@
    sim_tape_show_capac  show tape capacity
    sim_tape_set_async   enable asynchronous operation
    sim_tape_clr_async   disable asynchronous operation
+   sim_tape_set_index   enable/disable record index
+   sim_tape_show_index  show record index statistics
+   sim_tape_set_stream  enable/disable streaming buffers
+   sim_tape_show_stream show streaming statistics
 */
 
 #include "sim_defs.h"
 #include "sim_tape.h"
 #include <ctype.h>
+#include <sys/stat.h>
 
 #if defined SIM_ASYNCH_IO
 #include <pthread.h>
@@ -106,6 +111,8 @@ static struct sim_tape_fmt fmts[MTUF_N_FMT] = {
     { "TPC",  UNIT_RO, sizeof (t_tpclnt) - 1 },
     { "P7B",  0,       0 },
 /*  { "TPF",  UNIT_RO, 0 }, */
+    { NULL,   0,       0 },
+    { "COMPRESSED", 0, sizeof (t_mtrlnt) - 1 },
     { NULL,   0,       0 }
     };
 
@@ -113,10 +120,24 @@ t_stat sim_tape_ioerr (UNIT *uptr);
 t_stat sim_tape_wrdata (UNIT *uptr, uint32 dat);
 uint32 sim_tape_tpc_map (UNIT *uptr, t_addr *map);
 t_addr sim_tape_tpc_fnd (UNIT *uptr, t_addr *map);
+t_stat sim_tape_rdlntf (UNIT *uptr, t_mtrlnt *bc);
+t_stat sim_tape_rdlntr (UNIT *uptr, t_mtrlnt *bc);
+
+struct tape_index;
+static struct tape_index *_sim_tape_index_load (UNIT *uptr);
+static void _sim_tape_index_save (UNIT *uptr);
+static void _sim_tape_index_free (struct tape_index *idx);
+struct tape_stream;
+static t_stat _sim_tape_stream_sync (UNIT *uptr);
+static t_stat _sim_tape_stream_free (UNIT *uptr);
+static t_stat _sim_tape_copy (UNIT *uptr, char *dest, uint32 f);
+static t_bool _sim_tape_cmp_probe (FILE *file);
 
 struct tape_context {
     DEVICE              *dptr;              /* Device for unit (access to debug flags) */
     uint32              dbit;               /* debugging bit */
+    struct tape_index   *index;             /* record index */
+    struct tape_stream  *stream;            /* streaming buffers */
 #if defined SIM_ASYNCH_IO
     int                 asynch_io;          /* Asynchronous Interrupt scheduling enabled */
     int                 asynch_io_latency;  /* instructions to delay pending interrupt */
@@ -169,6 +190,7 @@ if ((!callback) || !ctx->asynch_io)
         ctx->bpi = _bpi;                                                \
         ctx->objupdate = _obj;                                          \
         ctx->callback = _callback;                                      \
+        AIO_INFLIGHT_ADJUST (1);                                        \
         pthread_cond_signal (&ctx->io_cond);                            \
         pthread_mutex_unlock (&ctx->io_lock);                           \
         }                                                               \
@@ -274,7 +296,8 @@ struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
         pthread_mutex_lock (&ctx->io_lock);
         ctx->io_top = TOP_DONE;
         pthread_cond_signal (&ctx->io_done);
-        sim_activate (uptr, ctx->asynch_io_latency);
+        sim_aio_post (&sim_activate, uptr, ctx->asynch_io_latency, ctx->io_status);
+        AIO_INFLIGHT_ADJUST (-1);
     }
     pthread_mutex_unlock (&ctx->io_lock);
 
@@ -304,7 +327,7 @@ if (ctx->io_top != TOP_DONE)
 
 if (ctx->callback && ctx->io_top == TOP_DONE) {
     ctx->callback = NULL;
-    callback (uptr, ctx->io_status);
+    callback (uptr, uptr->a_status);                    /* status posted with the completion */
     }
 }
 
@@ -416,6 +439,7 @@ sim_tape_clr_async (uptr);
 if (sim_asynch_enabled)
     sim_tape_set_async (uptr, ctx->asynch_io_latency);
 #endif
+_sim_tape_stream_sync (uptr);
 fflush (uptr->fileref);
 }
 
@@ -443,11 +467,41 @@ if (sim_switches & SWMASK ('F')) {                      /* format spec? */
     if (sim_tape_set_fmt (uptr, 0, gbuf, NULL) != SCPE_OK)
         return SCPE_ARG;
     }
+if (sim_switches & SWMASK ('C')) {                      /* create new image & copy contents? */
+    int32 saved_sim_switches = sim_switches;
+    int32 saved_sim_quiet = sim_quiet;
+    uint32 f = (sim_switches & SWMASK ('F')) ? MT_GET_FMT (uptr) : MTUF_F_CMP;
+
+    if ((f != MTUF_F_STD) && (f != MTUF_F_CMP))         /* only SIMH images convert */
+        return SCPE_ARG;
+    cptr = get_glyph_nc (cptr, gbuf, 0);                /* get new image name */
+    if (*cptr == 0)                                     /* must be more */
+        return SCPE_2FARG;
+    sim_tape_set_fmt (uptr, 0, "SIMH", NULL);           /* source format is found when it is opened */
+    sim_switches = (sim_switches & ~(SWMASK ('C') | SWMASK ('F'))) | SWMASK ('R') | SWMASK ('E');
+    sim_quiet = TRUE;
+    r = sim_tape_attach_ex (uptr, cptr, dbit, completion_delay);    /* open the source */
+    sim_quiet = saved_sim_quiet;
+    sim_switches = saved_sim_switches & ~(SWMASK ('C') | SWMASK ('F'));
+    if (r != SCPE_OK)
+        return r;
+    r = _sim_tape_copy (uptr, gbuf, f);
+    sim_tape_detach (uptr);
+    if (r != SCPE_OK)
+        return r;
+    uptr->flags = (uptr->flags & ~MTUF_FMT) | (f << MTUF_V_FMT);
+    strcpy (cptr, gbuf);                                /* attach the new image */
+    }
 r = attach_unit (uptr, cptr);                           /* attach unit */
 if (r != SCPE_OK)                                       /* error? */
     return r;
 switch (MT_GET_FMT (uptr)) {                            /* case on format */
 
+    case MTUF_F_STD:                                    /* SIMH */
+        if (_sim_tape_cmp_probe (uptr->fileref))        /* compressed container? */
+            uptr->flags = (uptr->flags & ~MTUF_FMT) | MT_F_CMP;
+        break;
+
     case MTUF_F_TPC:                                    /* TPC */
         objc = sim_tape_tpc_map (uptr, NULL);           /* get # objects */
         if (objc == 0) {                                /* tape empty? */
@@ -470,6 +524,16 @@ switch (MT_GET_FMT (uptr)) {                            /* case on format */
 uptr->tape_ctx = ctx = (struct tape_context *)calloc(1, sizeof(struct tape_context));
 ctx->dptr = dptr;                                       /* save DEVICE pointer */
 ctx->dbit = dbit;                                       /* save debug bit */
+if (MT_GET_FMT (uptr) == MTUF_F_CMP) {                  /* containers are read through streaming buffers */
+    r = sim_tape_set_stream (uptr, 1, NULL, NULL);
+    if (r != SCPE_OK) {
+        sim_tape_detach (uptr);
+        return r;
+        }
+    }
+if ((MT_GET_FMT (uptr) == MTUF_F_STD) || (MT_GET_FMT (uptr) == MTUF_F_E11) || 
+    (MT_GET_FMT (uptr) == MTUF_F_CMP))
+    ctx->index = _sim_tape_index_load (uptr);           /* reuse a saved record index */
 
 sim_tape_rewind (uptr);
 
@@ -496,6 +560,8 @@ if (uptr->io_flush)
 
 sim_tape_clr_async (uptr);
 
+_sim_tape_stream_free (uptr);                           /* write buffered data */
+_sim_tape_index_save (uptr);                            /* keep record index */
 r = detach_unit (uptr);                                 /* detach unit */
 if (r != SCPE_OK)
     return r;
@@ -513,6 +579,7 @@ switch (f) {                                            /* case on format */
         }
 
 sim_tape_rewind (uptr);
+_sim_tape_index_free (((struct tape_context *)uptr->tape_ctx)->index);
 free (uptr->tape_ctx);
 uptr->tape_ctx = NULL;
 uptr->io_flush = NULL;
@@ -540,7 +607,11 @@ fprintf (st, "    -R          Attach Read Only.\n");
 fprintf (st, "    -E          Must Exist (if not specified an attempt to create the indicated\n");
 fprintf (st, "                virtual tape will be attempted).\n");
 fprintf (st, "    -F          Open the indicated tape container in a specific format (default\n");
-fprintf (st, "                is SIMH, alternatives are E11, TPC and P7B)\n");
+fprintf (st, "                is SIMH, alternatives are E11, TPC, P7B and COMPRESSED)\n");
+fprintf (st, "    -C          Create a new tape container from an existing SIMH or COMPRESSED\n");
+fprintf (st, "                one and attach it.  The new container is COMPRESSED, or in the\n");
+fprintf (st, "                format given with -F (SIMH or COMPRESSED).\n");
+fprintf (st, "                  sim> ATTACH -C %s new-container existing-container\n", dptr->name);
 return SCPE_OK;
 
 return SCPE_OK;
@@ -587,6 +658,1177 @@ if (ctx->dptr->dctrl & reason) {
     }
 }
 
+/* Compressed tape containers
+
+   A COMPRESSED format tape holds exactly the bytes of a SIMH format tape 
+   image, kept as independently compressed chunks of TAPE_STREAM_SIZE 
+   bytes so that any position can be read by expanding a single chunk.  
+   The container starts with a header:
+
+        0       "SIMHTCZ1"
+        8       chunk size
+        12      number of chunks
+        16      image size (low, high)
+        24      chunk index offset (low, high)
+        32      end of the chunk store (low, high)
+
+   Chunks are stored from offset TAPE_CMP_HDR on.  The chunk index, 
+   written after the store whenever the container is flushed, holds four 
+   words for each chunk: its offset in the container (low, high), its 
+   stored length and the length of image data it holds.  The stored 
+   length has TAPE_CMP_RAW set when the chunk couldn't be compressed.  
+   A chunk of zeros is not stored at all (stored length 0).
+
+   A container is always accessed through the unit's streaming buffers, 
+   whose chunks are the container's chunks: reading a chunk expands it 
+   and writing buffered data recompresses the chunks it changes.  A 
+   rewritten chunk is stored in place if it fits or is the last chunk 
+   in the store, and otherwise appended to the store.  Neither chunks nor 
+   a new index ever overwrite the index the header points to, and the 
+   header is rewritten only once a new index is completely written, so 
+   the container stays consistent if the simulator stops at any point.
+*/
+
+#define TAPE_STREAM_SIZE        (1024 * 1024)           /* chunk and write buffer size */
+
+#define TAPE_CMP_MAGIC          "SIMHTCZ1"
+#define TAPE_CMP_HDR            512                     /* header size */
+#define TAPE_CMP_RAW            0x80000000              /* chunk stored as is */
+
+struct tape_cmp {
+    FILE                *file;              /* container */
+    t_addr              size;               /* image size */
+    t_addr              store_end;          /* end of chunk store */
+    t_addr              index_at;           /* index the header points to */
+    t_addr              index_end;
+    uint32              n;                  /* chunks in the index */
+    uint32              max;
+    t_addr              *offset;            /* chunk offset in container */
+    uint32              *clen;              /* chunk stored length */
+    uint32              *dlen;              /* image data in chunk */
+    uint8               *cbuf;              /* compressed chunk */
+    uint8               *blk;               /* chunk being rewritten */
+    t_bool              dirty;              /* index changed since written */
+    t_addr              wasted;             /* container space no longer used */
+    };
+
+static void _sim_tape_cmp_free (struct tape_cmp *cmp)
+{
+if (cmp == NULL)
+    return;
+free (cmp->offset);
+free (cmp->clen);
+free (cmp->dlen);
+free (cmp->cbuf);
+free (cmp->blk);
+free (cmp);
+}
+
+/* Make the index hold at least n chunks */
+
+static t_bool _sim_tape_cmp_grow (struct tape_cmp *cmp, uint32 n)
+{
+if (n > cmp->max) {
+    uint32 max = cmp->max ? cmp->max : 64;
+    t_addr *o;
+    uint32 *c, *d;
+
+    while (max < n)
+        max = 2 * max;
+    o = (t_addr *)realloc (cmp->offset, max * sizeof (*o));
+    if (o)
+        cmp->offset = o;
+    c = o ? (uint32 *)realloc (cmp->clen, max * sizeof (*c)) : NULL;
+    if (c)
+        cmp->clen = c;
+    d = c ? (uint32 *)realloc (cmp->dlen, max * sizeof (*d)) : NULL;
+    if (d == NULL)
+        return FALSE;
+    cmp->dlen = d;
+    cmp->max = max;
+    }
+while (cmp->n < n) {
+    cmp->offset[cmp->n] = 0;
+    cmp->clen[cmp->n] = 0;
+    cmp->dlen[cmp->n] = 0;
+    cmp->n = cmp->n + 1;
+    }
+return TRUE;
+}
+
+/* Test for a compressed container */
+
+static t_bool _sim_tape_cmp_probe (FILE *file)
+{
+char magic[8];
+
+sim_fseek (file, 0, SEEK_SET);
+return ((sim_fread (magic, 1, sizeof (magic), file) == sizeof (magic)) && 
+        (memcmp (magic, TAPE_CMP_MAGIC, sizeof (magic)) == 0));
+}
+
+/* Open a container, which is initialized if the file is empty */
+
+static struct tape_cmp *_sim_tape_cmp_open (FILE *file)
+{
+struct tape_cmp *cmp = (struct tape_cmp *)calloc (1, sizeof (*cmp));
+char magic[8];
+uint32 hdr[8], rec[4], i;
+
+if (cmp == NULL)
+    return NULL;
+cmp->file = file;
+cmp->cbuf = (uint8 *)malloc (TAPE_STREAM_SIZE);
+cmp->blk = (uint8 *)malloc (TAPE_STREAM_SIZE);
+if ((cmp->cbuf == NULL) || (cmp->blk == NULL)) {
+    _sim_tape_cmp_free (cmp);
+    return NULL;
+    }
+cmp->store_end = TAPE_CMP_HDR;
+if (sim_fsize_ex (file) == 0) {                         /* new container? */
+    cmp->dirty = TRUE;
+    return cmp;
+    }
+sim_fseek (file, 0, SEEK_SET);
+if ((sim_fread (magic, 1, sizeof (magic), file) != sizeof (magic)) || 
+    (memcmp (magic, TAPE_CMP_MAGIC, sizeof (magic)) != 0) || 
+    (sim_fread (hdr, sizeof (hdr[0]), 8, file) != 8) || 
+    (hdr[0] != TAPE_STREAM_SIZE) || 
+    !_sim_tape_cmp_grow (cmp, hdr[1])) {
+    _sim_tape_cmp_free (cmp);
+    return NULL;
+    }
+cmp->size = (t_addr)((((t_uint64)hdr[3]) << 32) | hdr[2]);
+cmp->store_end = (t_addr)((((t_uint64)hdr[7]) << 32) | hdr[6]);
+cmp->index_at = (t_addr)((((t_uint64)hdr[5]) << 32) | hdr[4]);
+cmp->index_end = cmp->index_at + cmp->n * 4 * sizeof (rec[0]);
+sim_fseek (file, cmp->index_at, SEEK_SET);
+for (i = 0; i < cmp->n; i++) {
+    if (sim_fread (rec, sizeof (rec[0]), 4, file) != 4) {
+        _sim_tape_cmp_free (cmp);
+        return NULL;
+        }
+    cmp->offset[i] = (t_addr)((((t_uint64)rec[1]) << 32) | rec[0]);
+    cmp->clen[i] = rec[2];
+    cmp->dlen[i] = rec[3];
+    }
+return cmp;
+}
+
+/* Write the index and header */
+
+static t_bool _sim_tape_cmp_sync (struct tape_cmp *cmp)
+{
+uint32 hdr[8], rec[4], i;
+t_addr index_at, index_end;
+
+if ((cmp == NULL) || !cmp->dirty)
+    return TRUE;
+index_at = cmp->store_end;                              /* index follows the store */
+index_end = index_at + cmp->n * sizeof (rec);
+if ((index_at < cmp->index_end) && (cmp->index_at < index_end)) {
+    index_at = cmp->index_end;                          /* but past the one in use */
+    index_end = index_at + cmp->n * sizeof (rec);
+    }
+if (sim_fseek (cmp->file, index_at, SEEK_SET))
+    return FALSE;
+for (i = 0; i < cmp->n; i++) {
+    rec[0] = (uint32)cmp->offset[i];
+    rec[1] = (uint32)(((t_uint64)cmp->offset[i]) >> 32);
+    rec[2] = cmp->clen[i];
+    rec[3] = cmp->dlen[i];
+    if (sim_fwrite (rec, sizeof (rec[0]), 4, cmp->file) != 4)
+        return FALSE;
+    }
+if (fflush (cmp->file) != 0)                            /* index complete */
+    return FALSE;
+hdr[0] = TAPE_STREAM_SIZE;                              /* before the header points to it */
+hdr[1] = cmp->n;
+hdr[2] = (uint32)cmp->size;
+hdr[3] = (uint32)(((t_uint64)cmp->size) >> 32);
+hdr[4] = (uint32)index_at;
+hdr[5] = (uint32)(((t_uint64)index_at) >> 32);
+hdr[6] = (uint32)cmp->store_end;
+hdr[7] = (uint32)(((t_uint64)cmp->store_end) >> 32);
+if (sim_fseek (cmp->file, 0, SEEK_SET) ||
+    (sim_fwrite ((void *)TAPE_CMP_MAGIC, 1, 8, cmp->file) != 8) ||
+    (sim_fwrite (hdr, sizeof (hdr[0]), 8, cmp->file) != 8) ||
+    (fflush (cmp->file) != 0) || ferror (cmp->file))
+    return FALSE;
+cmp->index_at = index_at;
+cmp->index_end = index_end;
+cmp->dirty = FALSE;
+return TRUE;
+}
+
+/* Expand the chunk at pos (a multiple of the chunk size), returning the 
+   number of image bytes in it */
+
+static size_t _sim_tape_cmp_get (struct tape_cmp *cmp, FILE *file, t_addr pos, uint8 *buf, t_bool *err)
+{
+uint32 k = (uint32)(pos / TAPE_STREAM_SIZE);
+uint32 clen, dlen;
+size_t len;
+
+*err = FALSE;
+if (pos >= cmp->size)
+    return 0;
+len = (size_t)(((cmp->size - pos) < TAPE_STREAM_SIZE) ? (cmp->size - pos) : TAPE_STREAM_SIZE);
+clen = (k < cmp->n) ? (cmp->clen[k] & ~TAPE_CMP_RAW) : 0;
+dlen = (k < cmp->n) ? cmp->dlen[k] : 0;
+if (clen != 0) {
+    sim_fseek (file, cmp->offset[k], SEEK_SET);
+    if (cmp->clen[k] & TAPE_CMP_RAW)
+        *err = (sim_fread (buf, 1, dlen, file) != dlen);
+    else
+        *err = ((sim_fread (cmp->cbuf, 1, clen, file) != clen) || 
+                !sim_lz4_decompress (cmp->cbuf, clen, buf, dlen));
+    clearerr (file);
+    if (*err)
+        return 0;
+    }
+else
+    dlen = 0;
+if (dlen < len)                                         /* beyond the data written? */
+    memset (buf + dlen, 0, len - dlen);
+return len;
+}
+
+/* Write image data, recompressing each chunk it changes */
+
+static t_bool _sim_tape_cmp_write (struct tape_cmp *cmp, t_addr pos, uint8 *buf, size_t len)
+{
+while (len) {
+    uint32 k = (uint32)(pos / TAPE_STREAM_SIZE);
+    size_t off = (size_t)(pos % TAPE_STREAM_SIZE);
+    size_t n = ((TAPE_STREAM_SIZE - off) < len) ? (TAPE_STREAM_SIZE - off) : len;
+    t_addr size = ((pos + n) > cmp->size) ? (pos + n) : cmp->size;
+    uint32 dlen = (uint32)(((size - (t_addr)k * TAPE_STREAM_SIZE) < TAPE_STREAM_SIZE) ? 
+                           (size - (t_addr)k * TAPE_STREAM_SIZE) : TAPE_STREAM_SIZE);
+    uint32 old = 0, clen, i;
+    uint8 *data;
+    t_bool err;
+
+    if (!_sim_tape_cmp_grow (cmp, k + 1))
+        return FALSE;
+    if ((off == 0) && (n == dlen))                      /* whole chunk? */
+        data = buf;
+    else {
+        if ((_sim_tape_cmp_get (cmp, cmp->file, pos - off, cmp->blk, &err) == 0) && err)
+            return FALSE;
+        if (cmp->dlen[k] < dlen)                        /* extending the chunk? */
+            memset (cmp->blk + cmp->dlen[k], 0, dlen - cmp->dlen[k]);
+        memcpy (cmp->blk + off, buf, n);
+        data = cmp->blk;
+        }
+    for (i = 0; (i < dlen) && (data[i] == 0); i++)      /* all zeros? */
+        ;
+    if (i == dlen)
+        clen = 0;
+    else {
+        clen = sim_lz4_compress (data, dlen, cmp->cbuf, dlen - 1);
+        if (clen == 0)                                  /* incompressible? */
+            clen = dlen | TAPE_CMP_RAW;
+        }
+    if (cmp->clen[k] != 0) {                            /* replacing a stored chunk? */
+        old = cmp->clen[k] & ~TAPE_CMP_RAW;
+        if (cmp->offset[k] + old == cmp->store_end) {   /* last in store? */
+            cmp->store_end = cmp->offset[k];
+            old = 0;
+            }
+        else if ((clen & ~TAPE_CMP_RAW) > old) {        /* doesn't fit? */
+            cmp->wasted = cmp->wasted + old;
+            old = 0;
+            }
+        }
+    if (clen != 0) {
+        if (old == 0) {                                 /* append to store */
+            if ((cmp->store_end < cmp->index_end) &&    /* but not over the index */
+                (cmp->index_at < cmp->store_end + (clen & ~TAPE_CMP_RAW))) {
+                cmp->wasted = cmp->wasted + (cmp->index_at - cmp->store_end);
+                cmp->store_end = cmp->index_end;
+                }
+            cmp->offset[k] = cmp->store_end;
+            cmp->store_end = cmp->store_end + (clen & ~TAPE_CMP_RAW);
+            }
+        else                                            /* rewrite in place */
+            cmp->wasted = cmp->wasted + old - (clen & ~TAPE_CMP_RAW);
+        sim_fseek (cmp->file, cmp->offset[k], SEEK_SET);
+        if (sim_fwrite ((clen & TAPE_CMP_RAW) ? data : cmp->cbuf, 1, clen & ~TAPE_CMP_RAW, cmp->file) != (clen & ~TAPE_CMP_RAW))
+            return FALSE;
+        }
+    else
+        cmp->wasted = cmp->wasted + old;
+    cmp->clen[k] = clen;
+    cmp->dlen[k] = (clen != 0) ? dlen : 0;
+    cmp->size = size;
+    cmp->dirty = TRUE;
+    pos = pos + n;
+    buf = buf + n;
+    len = len - n;
+    }
+return TRUE;
+}
+
+/* Describe a container */
+
+static void _sim_tape_cmp_info (FILE *st, struct tape_cmp *cmp)
+{
+uint32 i, stored = 0;
+
+for (i = 0; i < cmp->n; i++)
+    if (cmp->clen[i] != 0)
+        stored = stored + 1;
+fprintf (st, "%uKB image in %uKB, %u of %u chunks stored, %uKB unused", 
+         (uint32)(cmp->size / 1024), (uint32)(cmp->store_end / 1024), stored, cmp->n, (uint32)(cmp->wasted / 1024));
+}
+
+/* Streaming buffers
+
+   When enabled (SET <unit> STREAM) a unit with a SIMH or E11 format tape 
+   reads the tape image in large chunks and writes it through a large 
+   buffer.  Forward reads are served from the chunk in memory.  In 
+   simulators built with asynchronous I/O support a thread reads the 
+   following chunk while the current one is being consumed.  Records and 
+   marks written sequentially are collected in the write buffer and 
+   written to the image in one host write when the buffer fills, a tape 
+   mark is written, the tape is rewound, another part of the image is 
+   accessed, the simulator stops or the unit is detached.
+
+   Chunks start at multiples of the chunk size and are read through a 
+   second, unbuffered, file handle so that the read-ahead thread never 
+   shares the unit's file position.  Writing erase gaps uses the unit's 
+   file after any buffered data has been written.  A COMPRESSED format 
+   unit always streams, through its container.
+*/
+
+#define TAPE_RA_IDLE            0                       /* no chunk read ahead */
+#define TAPE_RA_BUSY            1                       /* thread reading next chunk */
+#define TAPE_RA_READY           2                       /* next chunk available */
+
+struct tape_stream {
+    FILE                *rfile;             /* image opened for reading */
+    struct tape_cmp     *cmp;               /* compressed container */
+    uint8               *rbuf;              /* current chunk */
+    t_addr              rbase;              /* image offset of chunk */
+    size_t              rlen;               /* bytes in chunk */
+    t_bool              rerr;               /* read error after chunk */
+    uint8               *wbuf;              /* write buffer */
+    t_addr              wbase;              /* image offset of buffered data */
+    size_t              wlen;               /* bytes buffered */
+    uint32              fills;              /* chunks read on demand */
+    uint32              ahead;              /* chunks read ahead */
+    uint32              flushes;            /* host writes of buffered data */
+    t_uint64            rbytes;             /* bytes read from chunks */
+    t_uint64            wbytes;             /* bytes written through buffer */
+    int                 nstate;             /* read ahead state */
+#if defined SIM_ASYNCH_IO
+    uint8               *nbuf;              /* next chunk */
+    t_addr              nbase;
+    size_t              nlen;
+    t_bool              nerr;
+    t_bool              done;               /* thread should exit */
+    pthread_t           thread;             /* read ahead thread */
+    pthread_mutex_t     lock;
+    pthread_cond_t      cond;
+#endif
+    };
+
+/* Read a chunk of the image */
+
+static size_t _sim_tape_stream_get (struct tape_stream *ts, t_addr pos, uint8 *buf, t_bool *err)
+{
+size_t len;
+
+if (ts->cmp)                                            /* compressed? */
+    return _sim_tape_cmp_get (ts->cmp, ts->rfile, pos, buf, err);
+sim_fseek (ts->rfile, pos, SEEK_SET);
+len = sim_fread (buf, sizeof (uint8), TAPE_STREAM_SIZE, ts->rfile);
+*err = (ferror (ts->rfile) != 0);
+clearerr (ts->rfile);
+return len;
+}
+
+#if defined SIM_ASYNCH_IO
+static void *
+_tape_stream_io (void *arg)
+{
+struct tape_stream *ts = (struct tape_stream *)arg;
+t_addr pos;
+size_t len;
+t_bool err;
+
+pthread_mutex_lock (&ts->lock);
+while (1) {
+    while (!ts->done && (ts->nstate != TAPE_RA_BUSY))
+        pthread_cond_wait (&ts->cond, &ts->lock);
+    if (ts->done)
+        break;
+    pos = ts->nbase;
+    pthread_mutex_unlock (&ts->lock);
+    len = _sim_tape_stream_get (ts, pos, ts->nbuf, &err);
+    pthread_mutex_lock (&ts->lock);
+    ts->nlen = len;
+    ts->nerr = err;
+    ts->nstate = TAPE_RA_READY;
+    pthread_cond_broadcast (&ts->cond);
+    }
+pthread_mutex_unlock (&ts->lock);
+return NULL;
+}
+#endif
+
+/* Make the chunk holding pos current, from the read ahead chunk if it has it */
+
+static void _sim_tape_stream_fill (UNIT *uptr, struct tape_stream *ts, t_addr pos)
+{
+#if defined SIM_ASYNCH_IO
+uint8 *buf;
+#endif
+
+pos = pos - (pos % TAPE_STREAM_SIZE);                   /* chunk start */
+#if defined SIM_ASYNCH_IO
+pthread_mutex_lock (&ts->lock);
+while (ts->nstate == TAPE_RA_BUSY)
+    pthread_cond_wait (&ts->cond, &ts->lock);
+if ((ts->nstate == TAPE_RA_READY) && (pos >= ts->nbase) && (pos < ts->nbase + ts->nlen)) {
+    buf = ts->rbuf;                                     /* use next chunk */
+    ts->rbuf = ts->nbuf;
+    ts->nbuf = buf;
+    ts->rbase = ts->nbase;
+    ts->rlen = ts->nlen;
+    ts->rerr = ts->nerr;
+    ts->ahead = ts->ahead + 1;
+    }
+else {
+    pthread_mutex_unlock (&ts->lock);
+    fflush (uptr->fileref);                             /* image current for reading */
+    ts->rbase = pos;
+    ts->rlen = _sim_tape_stream_get (ts, pos, ts->rbuf, &ts->rerr);
+    ts->fills = ts->fills + 1;
+    pthread_mutex_lock (&ts->lock);
+    }
+if ((ts->rlen == TAPE_STREAM_SIZE) && !ts->rerr) {      /* more to come? */
+    ts->nbase = ts->rbase + ts->rlen;                   /* read it ahead */
+    ts->nstate = TAPE_RA_BUSY;
+    pthread_cond_broadcast (&ts->cond);
+    }
+else
+    ts->nstate = TAPE_RA_IDLE;
+pthread_mutex_unlock (&ts->lock);
+#else
+fflush (uptr->fileref);                                 /* image current for reading */
+ts->rbase = pos;
+ts->rlen = _sim_tape_stream_get (ts, pos, ts->rbuf, &ts->rerr);
+ts->fills = ts->fills + 1;
+#endif
+}
+
+/* Discard chunks which the image is about to be written over */
+
+static void _sim_tape_stream_invalidate (UNIT *uptr)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+struct tape_stream *ts = ctx ? ctx->stream : NULL;
+
+if ((ts == NULL) || ((ts->rlen == 0) && (ts->nstate == TAPE_RA_IDLE)))
+    return;
+#if defined SIM_ASYNCH_IO
+pthread_mutex_lock (&ts->lock);
+while (ts->nstate == TAPE_RA_BUSY)
+    pthread_cond_wait (&ts->cond, &ts->lock);
+ts->nstate = TAPE_RA_IDLE;
+pthread_mutex_unlock (&ts->lock);
+#endif
+ts->rbase = 0;
+ts->rlen = 0;
+ts->rerr = FALSE;
+}
+
+/* Write buffered data to the image */
+
+static t_stat _sim_tape_stream_flush (UNIT *uptr)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+struct tape_stream *ts = ctx ? ctx->stream : NULL;
+size_t len;
+
+if ((ts == NULL) || (ts->wlen == 0))
+    return MTSE_OK;
+len = ts->wlen;
+ts->wlen = 0;
+ts->wbase = ts->wbase + len;
+ts->flushes = ts->flushes + 1;
+if (ts->cmp) {                                          /* compressed? */
+    if (!_sim_tape_cmp_write (ts->cmp, ts->wbase - len, ts->wbuf, len) || 
+        (fflush (uptr->fileref) != 0))
+        return MTSE_IOERR;
+    return MTSE_OK;
+    }
+sim_fseek (uptr->fileref, ts->wbase - len, SEEK_SET);
+if ((sim_fwrite (ts->wbuf, sizeof (uint8), len, uptr->fileref) != len) || 
+    (fflush (uptr->fileref) != 0))
+    return MTSE_IOERR;
+return MTSE_OK;
+}
+
+/* Write buffered data and a container's index */
+
+static t_stat _sim_tape_stream_sync (UNIT *uptr)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+struct tape_stream *ts = ctx ? ctx->stream : NULL;
+t_stat r = _sim_tape_stream_flush (uptr);
+
+if ((ts != NULL) && !_sim_tape_cmp_sync (ts->cmp))
+    r = MTSE_IOERR;
+return r;
+}
+
+/* Size of the tape image */
+
+static t_addr _sim_tape_size (UNIT *uptr)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+
+_sim_tape_stream_flush (uptr);                          /* include buffered writes */
+if (ctx && ctx->stream && ctx->stream->cmp)
+    return ctx->stream->cmp->size;
+return sim_fsize_ex (uptr->fileref);
+}
+
+/* Read through the chunks; *got is short at the end of the image */
+
+static t_stat _sim_tape_stream_read (UNIT *uptr, t_addr pos, uint8 *buf, size_t len, size_t *got)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+struct tape_stream *ts = ctx->stream;
+size_t n;
+
+*got = 0;
+if (_sim_tape_stream_flush (uptr) != MTSE_OK)           /* reads see all writes */
+    return MTSE_IOERR;
+while (len) {
+    if ((pos < ts->rbase) || (pos >= ts->rbase + ts->rlen)) {   /* not in chunk? */
+        if ((ts->rlen != 0) && (ts->rlen < TAPE_STREAM_SIZE) && 
+            (pos == ts->rbase + ts->rlen))              /* just past a short chunk? */
+            return ts->rerr ? MTSE_IOERR : MTSE_OK;
+        _sim_tape_stream_fill (uptr, ts, pos);
+        if (ts->rlen == 0)                              /* nothing there? */
+            return ts->rerr ? MTSE_IOERR : MTSE_OK;
+        }
+    n = (size_t)(ts->rbase + ts->rlen - pos);
+    if (n > len)
+        n = len;
+    memcpy (buf, ts->rbuf + (size_t)(pos - ts->rbase), n);
+    buf = buf + n;
+    pos = pos + n;
+    len = len - n;
+    *got = *got + n;
+    ts->rbytes = ts->rbytes + n;
+    }
+return MTSE_OK;
+}
+
+/* Read a record length word through the chunks */
+
+static t_stat _sim_tape_stream_rdlnt (UNIT *uptr, t_addr pos, t_mtrlnt *bc)
+{
+size_t got;
+
+if (_sim_tape_stream_read (uptr, pos, (uint8 *)bc, sizeof (t_mtrlnt), &got) != MTSE_OK)
+    return MTSE_IOERR;
+if (got < sizeof (t_mtrlnt))                            /* end of image? */
+    return MTSE_EOM;
+if (sim_end == 0)                                       /* image is little endian */
+    sim_buf_swap_data (bc, sizeof (t_mtrlnt), 1);
+return MTSE_OK;
+}
+
+/* Write through the write buffer */
+
+static t_stat _sim_tape_stream_write (UNIT *uptr, t_addr pos, uint8 *buf, size_t len)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+struct tape_stream *ts = ctx->stream;
+size_t n;
+
+if ((ts->wlen != 0) && (pos != ts->wbase + ts->wlen) && /* not sequential? */
+    (_sim_tape_stream_flush (uptr) != MTSE_OK))
+    return MTSE_IOERR;
+_sim_tape_stream_invalidate (uptr);
+if (ts->wlen == 0)
+    ts->wbase = pos;
+while (len) {
+    if ((ts->wlen == TAPE_STREAM_SIZE) &&               /* buffer full? */
+        (_sim_tape_stream_flush (uptr) != MTSE_OK))
+        return MTSE_IOERR;
+    n = TAPE_STREAM_SIZE - ts->wlen;
+    if (n > len)
+        n = len;
+    memcpy (ts->wbuf + ts->wlen, buf, n);
+    buf = buf + n;
+    len = len - n;
+    ts->wlen = ts->wlen + n;
+    ts->wbytes = ts->wbytes + n;
+    }
+return MTSE_OK;
+}
+
+/* Write a record length word through the write buffer */
+
+static t_stat _sim_tape_stream_wrlnt (UNIT *uptr, t_addr pos, t_mtrlnt bc)
+{
+if (sim_end == 0)                                       /* image is little endian */
+    sim_buf_swap_data (&bc, sizeof (t_mtrlnt), 1);
+return _sim_tape_stream_write (uptr, pos, (uint8 *)&bc, sizeof (t_mtrlnt));
+}
+
+/* Stop streaming, writing any buffered data */
+
+static t_stat _sim_tape_stream_free (UNIT *uptr)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+struct tape_stream *ts = ctx ? ctx->stream : NULL;
+t_stat r;
+
+if (ts == NULL)
+    return MTSE_OK;
+r = _sim_tape_stream_sync (uptr);
+#if defined SIM_ASYNCH_IO
+if (ts->nbuf) {                                         /* thread started? */
+    pthread_mutex_lock (&ts->lock);
+    ts->done = TRUE;
+    pthread_cond_broadcast (&ts->cond);
+    pthread_mutex_unlock (&ts->lock);
+    pthread_join (ts->thread, NULL);
+    pthread_mutex_destroy (&ts->lock);
+    pthread_cond_destroy (&ts->cond);
+    free (ts->nbuf);
+    }
+#endif
+if (ts->rfile)
+    fclose (ts->rfile);
+_sim_tape_cmp_free (ts->cmp);
+free (ts->rbuf);
+free (ts->wbuf);
+free (ts);
+ctx->stream = NULL;
+return r;
+}
+
+/* Set/clear streaming */
+
+t_stat sim_tape_set_stream (UNIT *uptr, int32 val, char *cptr, void *desc)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+uint32 f = MT_GET_FMT (uptr);
+struct tape_stream *ts;
+
+if ((cptr != NULL) && (*cptr != 0))
+    return SCPE_ARG;
+if (!(uptr->flags & UNIT_ATT) || (ctx == NULL))
+    return SCPE_UNATT;
+if (!val) {
+    if (f == MTUF_F_CMP)                                /* containers always stream */
+        return SCPE_NOFNC;
+    if (_sim_tape_stream_free (uptr) != MTSE_OK)
+        return SCPE_IOERR;
+    return SCPE_OK;
+    }
+if ((f != MTUF_F_STD) && (f != MTUF_F_E11) && (f != MTUF_F_CMP))
+    return SCPE_NOFNC;
+if (ctx->stream)
+    return SCPE_OK;
+ctx->stream = ts = (struct tape_stream *)calloc (1, sizeof (*ts));
+if (ts == NULL)
+    return SCPE_MEM;
+ts->rbuf = (uint8 *)malloc (TAPE_STREAM_SIZE);
+ts->wbuf = (uint8 *)malloc (TAPE_STREAM_SIZE);
+if ((ts->rbuf == NULL) || (ts->wbuf == NULL)) {
+    _sim_tape_stream_free (uptr);
+    return SCPE_MEM;
+    }
+ts->rfile = sim_fopen (uptr->filename, "rb");
+if (ts->rfile == NULL) {
+    _sim_tape_stream_free (uptr);
+    return SCPE_OPENERR;
+    }
+setvbuf (ts->rfile, NULL, _IONBF, 0);                   /* chunks are read whole */
+if (f == MTUF_F_CMP) {
+    ts->cmp = _sim_tape_cmp_open (uptr->fileref);
+    if (ts->cmp == NULL) {
+        _sim_tape_stream_free (uptr);
+        return SCPE_FMT;
+        }
+    }
+#if defined SIM_ASYNCH_IO
+ts->nbuf = (uint8 *)malloc (TAPE_STREAM_SIZE);
+if (ts->nbuf == NULL) {
+    _sim_tape_stream_free (uptr);
+    return SCPE_MEM;
+    }
+pthread_mutex_init (&ts->lock, NULL);
+pthread_cond_init (&ts->cond, NULL);
+if (pthread_create (&ts->thread, NULL, _tape_stream_io, (void *)ts)) {
+    pthread_mutex_destroy (&ts->lock);
+    pthread_cond_destroy (&ts->cond);
+    free (ts->nbuf);
+    ts->nbuf = NULL;                                    /* no thread to stop */
+    _sim_tape_stream_free (uptr);
+    return SCPE_IERR;
+    }
+#endif
+return SCPE_OK;
+}
+
+/* Show streaming statistics */
+
+t_stat sim_tape_show_stream (FILE *st, UNIT *uptr, int32 val, void *desc)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+struct tape_stream *ts = ctx ? ctx->stream : NULL;
+
+if (ts == NULL) {
+    fprintf (st, "not streaming\n");
+    return SCPE_OK;
+    }
+fprintf (st, "streaming, %uKB buffers, %u chunks read ahead, %u read on demand, %u buffered writes, ", 
+         TAPE_STREAM_SIZE / 1024, ts->ahead, ts->fills, ts->flushes);
+fprintf (st, "%uKB read, %uKB written\n", (uint32)(ts->rbytes / 1024), (uint32)(ts->wbytes / 1024));
+if (ts->cmp) {
+    fprintf (st, "compressed, ");
+    _sim_tape_cmp_info (st, ts->cmp);
+    fprintf (st, "\n");
+    }
+return SCPE_OK;
+}
+
+/* Copy the attached image into a new SIMH or COMPRESSED image (ATTACH -C) */
+
+static t_stat _sim_tape_copy (UNIT *uptr, char *dest, uint32 f)
+{
+struct tape_cmp *cmp = NULL;
+FILE *file;
+uint8 *buf;
+t_addr pos = 0;
+size_t got;
+t_stat r;
+
+r = sim_tape_set_stream (uptr, 1, NULL, NULL);          /* source is read in chunks */
+if (r != SCPE_OK)
+    return r;
+file = sim_fopen (dest, "wb+");
+if (file == NULL)
+    return SCPE_OPENERR;
+buf = (uint8 *)malloc (TAPE_STREAM_SIZE);
+if ((f == MTUF_F_CMP) && (buf != NULL))
+    cmp = _sim_tape_cmp_open (file);
+if ((buf == NULL) || ((f == MTUF_F_CMP) && (cmp == NULL)))
+    r = SCPE_MEM;
+while (r == SCPE_OK) {
+    if (_sim_tape_stream_read (uptr, pos, buf, TAPE_STREAM_SIZE, &got) != MTSE_OK)
+        r = SCPE_IOERR;
+    else if (got == 0)                                  /* done? */
+        break;
+    else if (cmp ? !_sim_tape_cmp_write (cmp, pos, buf, got) : 
+                   (sim_fwrite (buf, sizeof (uint8), got, file) != got))
+        r = SCPE_IOERR;
+    pos = pos + got;
+    if (!sim_quiet && ((pos % (TAPE_STREAM_SIZE * 64)) == 0))
+        printf ("%s: Copied %dMB\r", sim_uname (uptr), (int)(pos / 1000000));
+    }
+if ((r == SCPE_OK) && cmp && !_sim_tape_cmp_sync (cmp))
+    r = SCPE_IOERR;
+if (!sim_quiet && (r == SCPE_OK)) {
+    printf ("%s: Copied %dMB to '%s'", sim_uname (uptr), (int)(pos / 1000000), dest);
+    if (cmp) {
+        printf (", ");
+        _sim_tape_cmp_info (stdout, cmp);
+        }
+    printf ("\n");
+    }
+_sim_tape_cmp_free (cmp);
+free (buf);
+if (fclose (file) != 0)
+    r = SCPE_IOERR;
+if (r != SCPE_OK)
+    remove (dest);
+return r;
+}
+
+/* Record index
+
+   When enabled (SET <unit> INDEX) a unit keeps an index of the records 
+   and tape marks on a SIMH or E11 format tape.  The index covers a prefix 
+   of the tape: for each object it holds where the object begins, where 
+   the tape is positioned after reading it forward and the object's length 
+   word.  The index is built lazily, a batch of objects at a time, as 
+   spacing reaches its end.  With it, spacing records moves 
+   directly to the target object and spacing files moves directly past the 
+   next tape mark, without reading the tape.  A position not in the index 
+   is handled by reading the tape as before.
+
+   Writing the tape discards the part of the index at and beyond the 
+   position written, and objects written at the end of the index are 
+   appended to it.
+
+   When the unit is detached the index is saved in a sidecar file (the 
+   tape file's name with .idx appended).  A sidecar file is loaded when 
+   the tape is attached again if the tape's size and modification time 
+   still match the ones saved with it.
+*/
+
+#define TAPE_INDEX_MAGIC        "SIMHTIX1"
+
+struct tape_index {
+    t_addr              *start;             /* object start */
+    t_addr              *end;               /* position after object */
+    t_mtrlnt            *bc;                /* object's length word */
+    uint32              n;                  /* objects in the index */
+    uint32              max;
+    uint32              *tmk;               /* indices of tape marks */
+    uint32              ntmk;
+    uint32              tmax;
+    t_bool              complete;           /* index reaches EOM */
+    t_bool              scanned;            /* extension stopped short of EOM */
+    t_bool              dirty;              /* changed since loaded */
+    uint32              hits;               /* spacing done from the index */
+    uint32              misses;             /* spacing done by reading */
+    uint32              scans;              /* objects found by scanning */
+    };
+
+static void _sim_tape_index_free (struct tape_index *idx)
+{
+if (idx == NULL)
+    return;
+free (idx->start);
+free (idx->end);
+free (idx->bc);
+free (idx->tmk);
+free (idx);
+}
+
+static t_stat _sim_tape_index_add (struct tape_index *idx, t_addr start, t_addr end, t_mtrlnt bc)
+{
+if (idx->n == idx->max) {
+    uint32 max = idx->max ? 2 * idx->max : 1024;
+    t_addr *s = (t_addr *)realloc (idx->start, max * sizeof (*s));
+    t_addr *e = s ? (t_addr *)realloc (idx->end, max * sizeof (*e)) : NULL;
+    t_mtrlnt *b = e ? (t_mtrlnt *)realloc (idx->bc, max * sizeof (*b)) : NULL;
+
+    if (s)
+        idx->start = s;
+    if (e)
+        idx->end = e;
+    if (b == NULL)
+        return SCPE_MEM;
+    idx->bc = b;
+    idx->max = max;
+    }
+if (bc == MTR_TMK) {
+    if (idx->ntmk == idx->tmax) {
+        uint32 max = idx->tmax ? 2 * idx->tmax : 64;
+        uint32 *t = (uint32 *)realloc (idx->tmk, max * sizeof (*t));
+
+        if (t == NULL)
+            return SCPE_MEM;
+        idx->tmk = t;
+        idx->tmax = max;
+        }
+    idx->tmk[idx->ntmk++] = idx->n;
+    }
+idx->start[idx->n] = start;
+idx->end[idx->n] = end;
+idx->bc[idx->n] = bc;
+++idx->n;
+idx->dirty = TRUE;
+return SCPE_OK;
+}
+
+/* Position following the indexed prefix of the tape */
+
+static t_addr _sim_tape_index_limit (struct tape_index *idx)
+{
+return idx->n ? idx->end[idx->n - 1] : 0;
+}
+
+/* Extend the index by reading a batch of objects forward from its end.  
+   Only objects which also read the same in reverse are indexed, so an 
+   overwritten (and no longer valid) part of a tape is left to be read.
+*/
+
+#define TAPE_INDEX_BATCH        4096
+
+static void _sim_tape_index_extend (UNIT *uptr, struct tape_index *idx)
+{
+uint32 f = MT_GET_FMT (uptr);
+t_addr saved_pos = uptr->pos;
+uint32 saved_flags = uptr->flags;
+t_addr size, start, end;
+uint32 objs = 0;
+t_mtrlnt bc, rbc;
+t_stat st;
+
+size = _sim_tape_size (uptr);
+uptr->pos = _sim_tape_index_limit (idx);
+while (objs < TAPE_INDEX_BATCH) {
+    st = sim_tape_rdlntf (uptr, &bc);
+    if (st == MTSE_EOM)
+        idx->complete = TRUE;
+    if (((st != MTSE_OK) && (st != MTSE_TMK)) || 
+        (uptr->pos > size)) {                           /* record runs past the end of the file? */
+        idx->scanned = TRUE;                            /* don't try again until written */
+        break;
+        }
+    end = uptr->pos;
+    start = end - ((st == MTSE_TMK) ? sizeof (t_mtrlnt) : 
+                   (2 * sizeof (t_mtrlnt) + ((f == MTUF_F_E11) ? MTR_L (bc) : ((MTR_L (bc) + 1) & ~1))));
+    if ((sim_tape_rdlntr (uptr, &rbc) != st) ||         /* reads the same in reverse? */
+        (rbc != bc) || (uptr->pos != start) || 
+        ((start != _sim_tape_index_limit (idx)) &&      /* and back over any gap before it */
+         (idx->n > 0) && 
+         ((sim_tape_rdlntr (uptr, &rbc) != ((idx->bc[idx->n - 1] == MTR_TMK) ? MTSE_TMK : MTSE_OK)) || 
+          (rbc != idx->bc[idx->n - 1]) || (uptr->pos != idx->start[idx->n - 1]))) || 
+        (_sim_tape_index_add (idx, start, end, bc) != SCPE_OK)) {
+        idx->scanned = TRUE;
+        break;
+        }
+    uptr->pos = end;
+    ++idx->scans;
+    ++objs;
+    }
+uptr->pos = saved_pos;
+uptr->flags = saved_flags;
+}
+
+/* Find the object at the current position, returning its index (n if the 
+   position is the end of the index) or -1 if the position isn't known */
+
+static int32 _sim_tape_index_find (UNIT *uptr)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+struct tape_index *idx = ctx ? ctx->index : NULL;
+uint32 lo, hi, mid;
+
+if (idx == NULL)
+    return -1;
+if ((!idx->complete) && (!idx->scanned) && (uptr->pos == _sim_tape_index_limit (idx)))
+    _sim_tape_index_extend (uptr, idx);
+lo = 0;
+hi = idx->n;
+while (lo < hi) {                                       /* first object starting at or after pos */
+    mid = (lo + hi) / 2;
+    if (idx->start[mid] < uptr->pos)
+        lo = mid + 1;
+    else
+        hi = mid;
+    }
+if ((lo < idx->n) && (idx->start[lo] == uptr->pos))
+    return (int32)lo;
+if ((lo > 0) && (idx->end[lo - 1] == uptr->pos))
+    return (int32)lo;
+if ((lo == 0) && (uptr->pos == 0))
+    return 0;
+++idx->misses;
+return -1;
+}
+
+/* First tape mark at or after object i (ntmk if none) */
+
+static uint32 _sim_tape_index_next_tmk (struct tape_index *idx, uint32 i)
+{
+uint32 lo = 0, hi = idx->ntmk, mid;
+
+while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (idx->tmk[mid] < i)
+        lo = mid + 1;
+    else
+        hi = mid;
+    }
+return lo;
+}
+
+/* Discard the index from the position about to be written */
+
+static void _sim_tape_index_write (UNIT *uptr)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+struct tape_index *idx = ctx ? ctx->index : NULL;
+
+if (idx == NULL)
+    return;
+while ((idx->n > 0) && (idx->end[idx->n - 1] > uptr->pos))
+    --idx->n;
+while ((idx->ntmk > 0) && (idx->tmk[idx->ntmk - 1] >= idx->n))
+    --idx->ntmk;
+idx->complete = idx->scanned = FALSE;
+idx->dirty = TRUE;
+}
+
+/* Record an object just written at pos */
+
+static void _sim_tape_index_written (UNIT *uptr, t_addr pos, t_mtrlnt bc)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+struct tape_index *idx = ctx ? ctx->index : NULL;
+
+if ((idx == NULL) || (_sim_tape_index_limit (idx) != pos))
+    return;
+if (bc == MTR_EOM)
+    idx->complete = TRUE;
+else
+    _sim_tape_index_add (idx, pos, uptr->pos, bc);
+}
+
+static char *_sim_tape_index_name (UNIT *uptr, char *name, size_t size)
+{
+if ((uptr->filename == NULL) || (strlen (uptr->filename) + 5 > size))
+    return NULL;
+sprintf (name, "%s.idx", uptr->filename);
+return name;
+}
+
+static t_bool _sim_tape_index_id (UNIT *uptr, uint32 *id)
+{
+struct stat statb;
+
+if ((uptr->filename == NULL) || (stat (uptr->filename, &statb)))
+    return FALSE;
+id[0] = (uint32)statb.st_size;
+id[1] = (uint32)(((t_uint64)statb.st_size) >> 32);
+id[2] = (uint32)statb.st_mtime;
+id[3] = (uint32)(((t_uint64)statb.st_mtime) >> 32);
+return TRUE;
+}
+
+/* Save the index in its sidecar file */
+
+static void _sim_tape_index_save (UNIT *uptr)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+struct tape_index *idx = ctx->index;
+char name[CBUFSIZE];
+uint32 hdr[8], rec[5], i;
+FILE *f;
+
+if ((idx == NULL) || (!idx->dirty) || (_sim_tape_index_name (uptr, name, sizeof (name)) == NULL))
+    return;
+fflush (uptr->fileref);
+memset (hdr, 0, sizeof (hdr));
+if (!_sim_tape_index_id (uptr, hdr))
+    return;
+hdr[4] = MT_GET_FMT (uptr);
+hdr[5] = idx->n;
+hdr[6] = idx->complete;
+f = sim_fopen (name, "wb");
+if (f == NULL)
+    return;
+fwrite (TAPE_INDEX_MAGIC, 1, 8, f);
+sim_fwrite (hdr, sizeof (hdr[0]), 8, f);
+for (i = 0; i < idx->n; i++) {
+    rec[0] = (uint32)idx->start[i];
+    rec[1] = (uint32)(((t_uint64)idx->start[i]) >> 32);
+    rec[2] = (uint32)idx->end[i];
+    rec[3] = (uint32)(((t_uint64)idx->end[i]) >> 32);
+    rec[4] = idx->bc[i];
+    sim_fwrite (rec, sizeof (rec[0]), 5, f);
+    }
+if (ferror (f)) {
+    fclose (f);
+    remove (name);
+    return;
+    }
+fclose (f);
+idx->dirty = FALSE;
+}
+
+/* Load the index from its sidecar file, if it describes the tape */
+
+static struct tape_index *_sim_tape_index_load (UNIT *uptr)
+{
+struct tape_index *idx;
+char name[CBUFSIZE], magic[8];
+uint32 hdr[8], id[4], rec[5], i;
+FILE *f;
+
+if ((_sim_tape_index_name (uptr, name, sizeof (name)) == NULL) || 
+    ((f = sim_fopen (name, "rb")) == NULL))
+    return NULL;
+idx = (struct tape_index *)calloc (1, sizeof (*idx));
+if ((idx == NULL) || 
+    (fread (magic, 1, 8, f) != 8) || 
+    (memcmp (magic, TAPE_INDEX_MAGIC, 8)) || 
+    (sim_fread (hdr, sizeof (hdr[0]), 8, f) != 8) || 
+    (!_sim_tape_index_id (uptr, id)) || 
+    (memcmp (hdr, id, sizeof (id))) || 
+    (hdr[4] != MT_GET_FMT (uptr))) {
+    fclose (f);
+    _sim_tape_index_free (idx);
+    return NULL;
+    }
+for (i = 0; i < hdr[5]; i++) {
+    if ((sim_fread (rec, sizeof (rec[0]), 5, f) != 5) || 
+        (_sim_tape_index_add (idx, (t_addr)((((t_uint64)rec[1]) << 32) | rec[0]), 
+                                   (t_addr)((((t_uint64)rec[3]) << 32) | rec[2]), rec[4]) != SCPE_OK)) {
+        fclose (f);
+        _sim_tape_index_free (idx);
+        return NULL;
+        }
+    }
+fclose (f);
+idx->complete = (hdr[6] != 0);
+idx->dirty = FALSE;
+return idx;
+}
+
+/* Set/clear record indexing */
+
+t_stat sim_tape_set_index (UNIT *uptr, int32 val, char *cptr, void *desc)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+uint32 f = MT_GET_FMT (uptr);
+char name[CBUFSIZE];
+
+if ((cptr != NULL) && (*cptr != 0))
+    return SCPE_ARG;
+if (!(uptr->flags & UNIT_ATT) || (ctx == NULL))
+    return SCPE_UNATT;
+if (val) {
+    if ((f != MTUF_F_STD) && (f != MTUF_F_E11) && (f != MTUF_F_CMP))
+        return SCPE_NOFNC;
+    if (ctx->index == NULL) {
+        ctx->index = (struct tape_index *)calloc (1, sizeof (*ctx->index));
+        if (ctx->index == NULL)
+            return SCPE_MEM;
+        ctx->index->dirty = TRUE;
+        }
+    return SCPE_OK;
+    }
+_sim_tape_index_free (ctx->index);
+ctx->index = NULL;
+if (_sim_tape_index_name (uptr, name, sizeof (name)))
+    remove (name);
+return SCPE_OK;
+}
+
+/* Show record index statistics */
+
+t_stat sim_tape_show_index (FILE *st, UNIT *uptr, int32 val, void *desc)
+{
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+struct tape_index *idx = ctx ? ctx->index : NULL;
+
+if (idx == NULL) {
+    fprintf (st, "not indexed\n");
+    return SCPE_OK;
+    }
+fprintf (st, "indexed, %u records, %u tape marks%s, %u spacing from index, %u by reading, %u objects scanned\n", 
+         idx->n - idx->ntmk, idx->ntmk, idx->complete ? " to EOM" : "", idx->hits, idx->misses, idx->scans);
+return SCPE_OK;
+}
+
 /* Read record length forward (internal routine)
 
    Inputs:
@@ -608,11 +1850,13 @@ if (ctx->dptr->dctrl & reason) {
 
 t_stat sim_tape_rdlntf (UNIT *uptr, t_mtrlnt *bc)
 {
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
 uint8 c;
 t_bool all_eof;
 uint32 f = MT_GET_FMT (uptr);
 t_mtrlnt sbc;
 t_tpclnt tpcbc;
+t_stat st;
 
 MT_CLR_PNU (uptr);
 if ((uptr->flags & UNIT_ATT) == 0)                      /* not attached? */
@@ -620,15 +1864,20 @@ if ((uptr->flags & UNIT_ATT) == 0)                      /* not attached? */
 sim_fseek (uptr->fileref, uptr->pos, SEEK_SET);         /* set tape pos */
 switch (f) {                                            /* switch on fmt */
 
-    case MTUF_F_STD: case MTUF_F_E11:
+    case MTUF_F_STD: case MTUF_F_E11: case MTUF_F_CMP:
         do {
-            sim_fread (bc, sizeof (t_mtrlnt), 1, uptr->fileref);    /* read rec lnt */
+            if (ctx->stream)                            /* streaming? */
+                st = _sim_tape_stream_rdlnt (uptr, uptr->pos, bc);
+            else {
+                sim_fread (bc, sizeof (t_mtrlnt), 1, uptr->fileref);    /* read rec lnt */
+                st = ferror (uptr->fileref) ? MTSE_IOERR : (feof (uptr->fileref) ? MTSE_EOM : MTSE_OK);
+                }
             sbc = MTR_L (*bc);                          /* save rec lnt */
-            if (ferror (uptr->fileref)) {               /* error? */
+            if (st == MTSE_IOERR) {                     /* error? */
                 MT_SET_PNU (uptr);                      /* pos not upd */
                 return sim_tape_ioerr (uptr);
                 }
-            if (feof (uptr->fileref) || (*bc == MTR_EOM)) {     /* eof or eom? */
+            if ((st == MTSE_EOM) || (*bc == MTR_EOM)) { /* eof or eom? */
                 MT_SET_PNU (uptr);                      /* pos not upd */
                 return MTSE_EOM;
                 }
@@ -641,7 +1890,7 @@ switch (f) {                                            /* switch on fmt */
                 }
             else if (*bc != MTR_GAP)
                 uptr->pos = uptr->pos + sizeof (t_mtrlnt) +     /* spc over record */
-                    ((f == MTUF_F_STD)? ((sbc + 1) & ~1): sbc);
+                    ((f == MTUF_F_E11)? sbc: ((sbc + 1) & ~1));
             }
         while ((*bc == MTR_GAP) || (*bc == MTR_FHGAP));
         break;
@@ -717,12 +1966,14 @@ return MTSE_OK;
 
 t_stat sim_tape_rdlntr (UNIT *uptr, t_mtrlnt *bc)
 {
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
 uint8 c;
 t_bool all_eof;
 uint32 f = MT_GET_FMT (uptr);
 t_addr ppos;
 t_mtrlnt sbc;
 t_tpclnt tpcbc;
+t_stat st;
 
 MT_CLR_PNU (uptr);
 if ((uptr->flags & UNIT_ATT) == 0)                      /* not attached? */
@@ -731,14 +1982,19 @@ if (sim_tape_bot (uptr))                                /* at BOT? */
     return MTSE_BOT;
 switch (f) {                                            /* switch on fmt */
 
-    case MTUF_F_STD: case MTUF_F_E11:
+    case MTUF_F_STD: case MTUF_F_E11: case MTUF_F_CMP:
         do {
-            sim_fseek (uptr->fileref, uptr->pos - sizeof (t_mtrlnt), SEEK_SET);
-            sim_fread (bc, sizeof (t_mtrlnt), 1, uptr->fileref);    /* read rec lnt */
+            if (ctx->stream)                            /* streaming? */
+                st = _sim_tape_stream_rdlnt (uptr, uptr->pos - sizeof (t_mtrlnt), bc);
+            else {
+                sim_fseek (uptr->fileref, uptr->pos - sizeof (t_mtrlnt), SEEK_SET);
+                sim_fread (bc, sizeof (t_mtrlnt), 1, uptr->fileref);    /* read rec lnt */
+                st = ferror (uptr->fileref) ? MTSE_IOERR : (feof (uptr->fileref) ? MTSE_EOM : MTSE_OK);
+                }
             sbc = MTR_L (*bc);
-            if (ferror (uptr->fileref))                 /* error? */
+            if (st == MTSE_IOERR)                       /* error? */
                 return sim_tape_ioerr (uptr);
-            if (feof (uptr->fileref))                   /* eof? */
+            if (st == MTSE_EOM)                         /* eof? */
                 return MTSE_EOM;
             uptr->pos = uptr->pos - sizeof (t_mtrlnt);  /* spc over rec lnt */
             if (*bc == MTR_EOM)                         /* eom? */
@@ -751,7 +2007,7 @@ switch (f) {                                            /* switch on fmt */
                 }
             else if (*bc != MTR_GAP) {
                 uptr->pos = uptr->pos - sizeof (t_mtrlnt) - /* spc over record */
-                    ((f == MTUF_F_STD)? ((sbc + 1) & ~1): sbc);
+                    ((f == MTUF_F_E11)? sbc: ((sbc + 1) & ~1));
                 sim_fseek (uptr->fileref, uptr->pos + sizeof (t_mtrlnt), SEEK_SET);
                 }
             else if (sim_tape_bot (uptr))               /* backed into BOT? */
@@ -842,8 +2098,18 @@ if (rbc > max) {                                        /* rec out of range? */
     uptr->pos = opos;
     return MTSE_INVRL;
     }
-i = (t_mtrlnt)sim_fread (buf, sizeof (uint8), rbc, uptr->fileref);/* read record */
-if (ferror (uptr->fileref)) {                           /* error? */
+if (ctx->stream) {                                      /* streaming? */
+    size_t got;
+
+    st = _sim_tape_stream_read (uptr, uptr->pos - sizeof (t_mtrlnt) - ((f == MTUF_F_E11) ? rbc : ((rbc + 1) & ~1)), 
+                                buf, rbc, &got);
+    i = (t_mtrlnt)got;
+    }
+else {
+    i = (t_mtrlnt)sim_fread (buf, sizeof (uint8), rbc, uptr->fileref);/* read record */
+    st = ferror (uptr->fileref) ? MTSE_IOERR : MTSE_OK;
+    }
+if (st == MTSE_IOERR) {                                 /* error? */
     MT_SET_PNU (uptr);
     uptr->pos = opos;
     return sim_tape_ioerr (uptr);
@@ -901,8 +2167,17 @@ if (MTSE_OK != (st = sim_tape_rdlntr (uptr, &tbc)))     /* read rec lnt */
 *bc = rbc = MTR_L (tbc);                                /* strip error flag */
 if (rbc > max)                                          /* rec out of range? */
     return MTSE_INVRL;
-i = (t_mtrlnt)sim_fread (buf, sizeof (uint8), rbc, uptr->fileref);/* read record */
-if (ferror (uptr->fileref))                             /* error? */
+if (ctx->stream) {                                      /* streaming? */
+    size_t got;
+
+    st = _sim_tape_stream_read (uptr, uptr->pos + sizeof (t_mtrlnt), buf, rbc, &got);
+    i = (t_mtrlnt)got;
+    }
+else {
+    i = (t_mtrlnt)sim_fread (buf, sizeof (uint8), rbc, uptr->fileref);/* read record */
+    st = ferror (uptr->fileref) ? MTSE_IOERR : MTSE_OK;
+    }
+if (st == MTSE_IOERR)                                   /* error? */
     return sim_tape_ioerr (uptr);
 for ( ; i < rbc; i++)                                   /* fill with 0's */
     buf[i] = 0;
@@ -953,20 +2228,32 @@ if (sim_tape_wrp (uptr))                                /* write prot? */
     return MTSE_WRP;
 if (sbc == 0)                                           /* nothing to do? */
     return MTSE_OK;
+_sim_tape_index_write (uptr);                           /* index is stale from here */
 sim_fseek (uptr->fileref, uptr->pos, SEEK_SET);         /* set pos */
 switch (f) {                                            /* case on format */
 
-    case MTUF_F_STD:                                    /* standard */
+    case MTUF_F_STD: case MTUF_F_CMP:                   /* standard */
         sbc = MTR_L ((bc + 1) & ~1);                    /* pad odd length */
     case MTUF_F_E11:                                    /* E11 */
-        sim_fwrite (&bc, sizeof (t_mtrlnt), 1, uptr->fileref);
-        sim_fwrite (buf, sizeof (uint8), sbc, uptr->fileref);
-        sim_fwrite (&bc, sizeof (t_mtrlnt), 1, uptr->fileref);
-        if (ferror (uptr->fileref)) {                   /* error? */
-            MT_SET_PNU (uptr);
-            return sim_tape_ioerr (uptr);
+        if (ctx->stream) {                              /* streaming? */
+            if ((_sim_tape_stream_wrlnt (uptr, uptr->pos, bc) != MTSE_OK) || 
+                (_sim_tape_stream_write (uptr, uptr->pos + sizeof (t_mtrlnt), buf, sbc) != MTSE_OK) || 
+                (_sim_tape_stream_wrlnt (uptr, uptr->pos + sizeof (t_mtrlnt) + sbc, bc) != MTSE_OK)) {
+                MT_SET_PNU (uptr);
+                return sim_tape_ioerr (uptr);
+                }
+            }
+        else {
+            sim_fwrite (&bc, sizeof (t_mtrlnt), 1, uptr->fileref);
+            sim_fwrite (buf, sizeof (uint8), sbc, uptr->fileref);
+            sim_fwrite (&bc, sizeof (t_mtrlnt), 1, uptr->fileref);
+            if (ferror (uptr->fileref)) {               /* error? */
+                MT_SET_PNU (uptr);
+                return sim_tape_ioerr (uptr);
+                }
             }
         uptr->pos = uptr->pos + sbc + (2 * sizeof (t_mtrlnt));  /* move tape */
+        _sim_tape_index_written (uptr, uptr->pos - sbc - (2 * sizeof (t_mtrlnt)), bc);
         break;
 
     case MTUF_F_P7B:                                    /* Pierce 7B */
@@ -997,18 +2284,33 @@ return r;
 
 t_stat sim_tape_wrdata (UNIT *uptr, uint32 dat)
 {
+struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+
 MT_CLR_PNU (uptr);
 if ((uptr->flags & UNIT_ATT) == 0)                      /* not attached? */
     return MTSE_UNATT;
 if (sim_tape_wrp (uptr))                                /* write prot? */
     return MTSE_WRP;
-sim_fseek (uptr->fileref, uptr->pos, SEEK_SET);         /* set pos */
-sim_fwrite (&dat, sizeof (t_mtrlnt), 1, uptr->fileref);
-if (ferror (uptr->fileref)) {                           /* error? */
-    MT_SET_PNU (uptr);
-    return sim_tape_ioerr (uptr);
+_sim_tape_index_write (uptr);                           /* index is stale from here */
+if (ctx->stream) {                                      /* streaming? */
+    if ((_sim_tape_stream_wrlnt (uptr, uptr->pos, dat) != MTSE_OK) || 
+        ((dat == MTR_TMK) &&                            /* tape mark ends a file */
+         (_sim_tape_stream_flush (uptr) != MTSE_OK))) {
+        MT_SET_PNU (uptr);
+        return sim_tape_ioerr (uptr);
+        }
+    }
+else {
+    sim_fseek (uptr->fileref, uptr->pos, SEEK_SET);     /* set pos */
+    sim_fwrite (&dat, sizeof (t_mtrlnt), 1, uptr->fileref);
+    if (ferror (uptr->fileref)) {                       /* error? */
+        MT_SET_PNU (uptr);
+        return sim_tape_ioerr (uptr);
+        }
     }
 uptr->pos = uptr->pos + sizeof (t_mtrlnt);              /* move tape */
+if ((dat == MTR_TMK) || (dat == MTR_EOM))
+    _sim_tape_index_written (uptr, uptr->pos - sizeof (t_mtrlnt), dat);
 return MTSE_OK;
 }
 
@@ -1193,6 +2495,9 @@ if (format != MTUF_F_STD)                               /* not SIMH fmt? */
     return MTSE_FMT;
 if (sim_tape_wrp (uptr))                                /* write protected? */
     return MTSE_WRP;
+if (_sim_tape_stream_flush (uptr) != MTSE_OK)           /* write buffered data */
+    return sim_tape_ioerr (uptr);
+_sim_tape_stream_invalidate (uptr);                     /* gap is written directly */
 
 file_size = sim_fsize (uptr->fileref);                  /* get file size */
 sim_fseek (uptr->fileref, uptr->pos, SEEK_SET);         /* position tape */
@@ -1341,9 +2646,17 @@ t_stat sim_tape_sprecf (UNIT *uptr, t_mtrlnt *bc)
 {
 struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
 t_stat st;
+int32 i;
 
 sim_debug (ctx->dbit, ctx->dptr, "sim_tape_sprecf(unit=%d)\n", uptr-ctx->dptr->units);
 
+if (((i = _sim_tape_index_find (uptr)) >= 0) && ((uint32)i < ctx->index->n)) {
+    ++ctx->index->hits;
+    MT_CLR_PNU (uptr);
+    *bc = MTR_L (ctx->index->bc[i]);
+    uptr->pos = ctx->index->end[i];
+    return (ctx->index->bc[i] == MTR_TMK) ? MTSE_TMK : MTSE_OK;
+    }
 st = sim_tape_rdlntf (uptr, bc);                        /* get record length */
 *bc = MTR_L (*bc);
 return st;
@@ -1380,12 +2693,33 @@ return r;
 t_stat sim_tape_sprecsf (UNIT *uptr, uint32 count, uint32 *skipped)
 {
 struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+struct tape_index *idx = ctx->index;
 t_stat st;
 t_mtrlnt tbc;
+int32 i;
 
 sim_debug (ctx->dbit, ctx->dptr, "sim_tape_sprecsf(unit=%d, count=%d)\n", uptr-ctx->dptr->units, count);
 
 *skipped = 0;
+while ((*skipped < count) && ((i = _sim_tape_index_find (uptr)) >= 0) && ((uint32)i < idx->n)) {
+    uint32 t = _sim_tape_index_next_tmk (idx, i);       /* next tape mark */
+    uint32 left = count - *skipped;
+
+    ++idx->hits;
+    MT_CLR_PNU (uptr);
+    if ((t < idx->ntmk) && ((idx->tmk[t] - i) < left)) {
+        *skipped += idx->tmk[t] - i;                    /* records before it */
+        uptr->pos = idx->end[idx->tmk[t]];
+        return MTSE_TMK;
+        }
+    if ((idx->n - i) >= left) {
+        *skipped = count;
+        uptr->pos = idx->end[i + left - 1];
+        return MTSE_OK;
+        }
+    *skipped += idx->n - i;                             /* rest is beyond the index */
+    uptr->pos = idx->end[idx->n - 1];
+    }
 while (*skipped < count) {                              /* loopo */
     st = sim_tape_sprecf (uptr, &tbc);                  /* spc rec */
     if (st != MTSE_OK)
@@ -1427,6 +2761,7 @@ t_stat sim_tape_sprecr (UNIT *uptr, t_mtrlnt *bc)
 {
 struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
 t_stat st;
+int32 i;
 
 sim_debug (ctx->dbit, ctx->dptr, "sim_tape_sprecr(unit=%d)\n", uptr-ctx->dptr->units);
 
@@ -1435,6 +2770,12 @@ if (MT_TST_PNU (uptr)) {
     *bc = 0;
     return MTSE_OK;
     }
+if ((i = _sim_tape_index_find (uptr)) > 0) {
+    ++ctx->index->hits;
+    *bc = MTR_L (ctx->index->bc[i - 1]);
+    uptr->pos = ctx->index->start[i - 1];
+    return (ctx->index->bc[i - 1] == MTR_TMK) ? MTSE_TMK : MTSE_OK;
+    }
 st = sim_tape_rdlntr (uptr, bc);                        /* get record length */
 *bc = MTR_L (*bc);
 return st;
@@ -1472,12 +2813,31 @@ return r;
 t_stat sim_tape_sprecsr (UNIT *uptr, uint32 count, uint32 *skipped)
 {
 struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+struct tape_index *idx = ctx->index;
 t_stat st;
 t_mtrlnt tbc;
+int32 i;
 
 sim_debug (ctx->dbit, ctx->dptr, "sim_tape_sprecsr(unit=%d, count=%d)\n", uptr-ctx->dptr->units, count);
 
 *skipped = 0;
+if (count && (!MT_TST_PNU (uptr)) && ((i = _sim_tape_index_find (uptr)) > 0)) {
+    uint32 t = _sim_tape_index_next_tmk (idx, i);       /* tape marks before t precede pos */
+
+    ++idx->hits;
+    if ((t > 0) && ((i - 1 - idx->tmk[t - 1]) < count)) {
+        *skipped = i - 1 - idx->tmk[t - 1];             /* records after it */
+        uptr->pos = idx->start[idx->tmk[t - 1]];
+        return MTSE_TMK;
+        }
+    if ((uint32)i >= count) {
+        *skipped = count;
+        uptr->pos = idx->start[i - count];
+        return MTSE_OK;
+        }
+    *skipped = i;                                       /* rest is before the index */
+    uptr->pos = idx->start[0];
+    }
 while (*skipped < count) {                              /* loopo */
     st = sim_tape_sprecr (uptr, &tbc);                  /* spc rec rev */
     if (st != MTSE_OK)
@@ -1705,13 +3065,15 @@ return r;
 t_stat sim_tape_rewind (UNIT *uptr)
 {
 struct tape_context *ctx = (struct tape_context *)uptr->tape_ctx;
+t_stat r;
 
 if (uptr->flags & UNIT_ATT) {
     sim_debug (ctx->dbit, ctx->dptr, "sim_tape_rewind(unit=%d)\n", uptr-ctx->dptr->units);
     }
+r = _sim_tape_stream_flush (uptr);                      /* write buffered data */
 uptr->pos = 0;
 MT_CLR_PNU (uptr);
-return MTSE_OK;
+return (r == MTSE_OK) ? MTSE_OK : sim_tape_ioerr (uptr);
 }
 
 t_stat sim_tape_rewind_a (UNIT *uptr, TAPE_PCALLBACK callback)
@@ -1846,8 +3208,16 @@ if (cptr == NULL)
     return SCPE_ARG;
 for (f = 0; f < MTUF_N_FMT; f++) {
     if (fmts[f].name && (strcmp (cptr, fmts[f].name) == 0)) {
+        if ((uptr->flags & UNIT_ATT) &&                 /* can't change to or from a container */
+            ((f == MTUF_F_CMP) || (MT_GET_FMT (uptr) == MTUF_F_CMP)))
+            return SCPE_ALATT;
         uptr->flags = (uptr->flags & ~MTUF_FMT) |
             (f << MTUF_V_FMT) | fmts[f].uflags;
+        if (uptr->tape_ctx) {                           /* index no longer describes the tape */
+            _sim_tape_index_free (((struct tape_context *)uptr->tape_ctx)->index);
+            ((struct tape_context *)uptr->tape_ctx)->index = NULL;
+            _sim_tape_stream_free (uptr);
+            }
         return SCPE_OK;
         }
     }
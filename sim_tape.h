@@ -76,6 +76,7 @@ typedef uint16          t_tpclnt;                       /* magtape rec lnt */
 #define MTUF_F_TPC       2                              /* TPC format */
 #define MTUF_F_P7B       3                              /* P7B format */
 #define MUTF_F_TDF       4                              /* TDF format */
+#define MTUF_F_CMP       5                              /* compressed SIMH format */
 #define MTUF_V_UF       (MTUF_V_FMT + MTUF_W_FMT)
 #define MTUF_PNU        (1u << MTUF_V_PNU)
 #define MTUF_WLK        (1u << MTUF_V_WLK)
@@ -87,6 +88,7 @@ typedef uint16          t_tpclnt;                       /* magtape rec lnt */
 #define MT_F_TPC        (MTUF_F_TPC << MTUF_V_FMT)
 #define MT_F_P7B        (MTUF_F_P7B << MTUF_V_FMT)
 #define MT_F_TDF        (MTUF_F_TDF << MTUF_V_FMT)
+#define MT_F_CMP        (MTUF_F_CMP << MTUF_V_FMT)
 
 #define MT_SET_PNU(u)   (u)->flags = (u)->flags | MTUF_PNU
 #define MT_CLR_PNU(u)   (u)->flags = (u)->flags & ~MTUF_PNU
@@ -167,6 +169,10 @@ t_stat sim_tape_set_fmt (UNIT *uptr, int32 val, char *cptr, void *desc);
 t_stat sim_tape_show_fmt (FILE *st, UNIT *uptr, int32 val, void *desc);
 t_stat sim_tape_set_capac (UNIT *uptr, int32 val, char *cptr, void *desc);
 t_stat sim_tape_show_capac (FILE *st, UNIT *uptr, int32 val, void *desc);
+t_stat sim_tape_set_index (UNIT *uptr, int32 val, char *cptr, void *desc);
+t_stat sim_tape_show_index (FILE *st, UNIT *uptr, int32 val, void *desc);
+t_stat sim_tape_set_stream (UNIT *uptr, int32 val, char *cptr, void *desc);
+t_stat sim_tape_show_stream (FILE *st, UNIT *uptr, int32 val, void *desc);
 t_stat sim_tape_set_asynch (UNIT *uptr, int latency);
 t_stat sim_tape_clr_asynch (UNIT *uptr);
 void sim_tape_data_trace (UNIT *uptr, const uint8 *data, size_t len, const char* txt, int detail, uint32 reason);
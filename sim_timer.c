@@ -68,10 +68,12 @@
    sim_os_msec  -           return elapsed time in msec
    sim_os_sleep -           sleep specified number of seconds
    sim_os_ms_sleep -        sleep specified number of milliseconds
-   sim_idle_ms_sleep -      sleep specified number of milliseconds
+   sim_idle_us_sleep -      sleep specified number of microseconds
                             or until awakened by an asynchronous
                             event
    sim_timespec_diff        subtract two timespec values
+   sim_clock_gettime        host time of day plus fast-forwarded time
+   sim_get_time             time () equivalent of sim_clock_gettime
    sim_timer_activate_after schedule unit for specific time
 
 
@@ -94,6 +96,13 @@ static uint32 sim_idle_rate_ms = 0;
 static uint32 sim_os_sleep_min_ms = 0;
 static uint32 sim_idle_stable = SIM_IDLE_STDFLT;
 static t_bool sim_idle_idled = FALSE;
+static uint32 sim_idle_sleeps = 0;                  /* idle sleeps taken */
+static uint32 sim_idle_early = 0;                   /* sleeps cut short by asynch events */
+static uint32 sim_idle_oversleep_us = 0;            /* average usecs slept past the request */
+static double sim_idle_slept_us = 0;                /* total usecs slept */
+static t_bool sim_ffwd_enab = FALSE;                /* fast forward idle time */
+static uint32 sim_ffwd_jumps = 0;                   /* idle periods skipped */
+static double sim_ffwd_us = 0;                      /* simulated usecs skipped */
 static uint32 sim_throt_ms_start = 0;
 static uint32 sim_throt_ms_stop = 0;
 static uint32 sim_throt_type = 0;
@@ -500,36 +509,54 @@ else
     return 0;
 }
 
-#if defined(SIM_ASYNCH_IO)
-uint32 sim_idle_ms_sleep (unsigned int msec)
+/* Sleep for the indicated number of microseconds, or until awakened by 
+   the completion of an asynchronous event.  The time actually slept, in
+   microseconds, is returned. */
+
+uint32 sim_idle_us_sleep (uint32 usec)
 {
-uint32 start_time = sim_os_msec();
-struct timespec done_time;
+struct timespec start_time, done_time, stop_time;
+#if defined(SIM_ASYNCH_IO)
 t_bool timedout = FALSE;
+#endif
 
-clock_gettime(CLOCK_REALTIME, &done_time);
-done_time.tv_sec += (msec/1000);
-done_time.tv_nsec += 1000000*(msec%1000);
-if (done_time.tv_nsec > 1000000000) {
+clock_gettime(CLOCK_REALTIME, &start_time);
+#if defined(SIM_ASYNCH_IO)
+done_time = start_time;
+done_time.tv_sec += (usec/1000000);
+done_time.tv_nsec += 1000*(usec%1000000);
+if (done_time.tv_nsec >= 1000000000) {
   done_time.tv_sec += done_time.tv_nsec/1000000000;
   done_time.tv_nsec = done_time.tv_nsec%1000000000;
   }
 pthread_mutex_lock (&sim_asynch_lock);
 sim_idle_wait = TRUE;
-if (!pthread_cond_timedwait (&sim_asynch_wake, &sim_asynch_lock, &done_time))
-  sim_asynch_check = 0;                 /* force check of asynch queue now */
+AIO_MEMORY_BARRIER;
+if (AIO_RING_PENDING)                   /* completion posted before we got here? */
+  sim_asynch_check = 0;
 else
-  timedout = TRUE;
+  if (!pthread_cond_timedwait (&sim_asynch_wake, &sim_asynch_lock, &done_time))
+    sim_asynch_check = 0;               /* force check of asynch queue now */
+  else
+    timedout = TRUE;
 sim_idle_wait = FALSE;
 pthread_mutex_unlock (&sim_asynch_lock);
-if (!timedout)
+if (!timedout) {
     AIO_UPDATE_QUEUE;
-return sim_os_msec() - start_time;
-}
-#define SIM_IDLE_MS_SLEEP sim_idle_ms_sleep
+    }
+#elif defined (_WIN32) || defined (VMS) || defined (__OS2__) || (defined (__MWERKS__) && defined (macintosh))
+sim_os_ms_sleep ((usec + 500)/1000);
 #else
-#define SIM_IDLE_MS_SLEEP sim_os_ms_sleep
+done_time.tv_sec = usec/1000000;
+done_time.tv_nsec = 1000*(usec%1000000);
+(void) nanosleep (&done_time, NULL);
 #endif
+clock_gettime(CLOCK_REALTIME, &stop_time);
+sim_timespec_diff (&stop_time, &stop_time, &start_time);
+if (stop_time.tv_sec < 0)               /* time running backwards? */
+    return 0;
+return (uint32)(stop_time.tv_sec*1000000 + stop_time.tv_nsec/1000);
+}
 
 /* OS independent clock calibration package */
 
@@ -601,7 +628,9 @@ new_rtime = sim_os_msec ();                             /* wall time */
 sim_debug (DBG_TRC, &sim_timer_dev, "sim_rtcn_calb(ticksper=%d, tmr=%d) rtime=%d\n", ticksper, tmr, new_rtime);
 if (sim_idle_idled) {
     rtc_rtime[tmr] = new_rtime;                         /* save wall time */
-    rtc_vtime[tmr] = rtc_vtime[tmr] + 1000;             /* adv sim time */
+    if (sim_ffwd_enab)                                  /* skipped time isn't owed */
+        rtc_vtime[tmr] = new_rtime;
+    else rtc_vtime[tmr] = rtc_vtime[tmr] + 1000;        /* adv sim time */
     rtc_gtime[tmr] = sim_gtime();                       /* save instruction time */
     sim_idle_idled = FALSE;                             /* reset idled flag */
     sim_debug (DBG_CAL, &sim_timer_dev, "skipping calibration due to idling - result: %d\n", rtc_currd[tmr]);
@@ -728,6 +757,18 @@ for (tmr=0; tmr<SIM_NTIMERS; ++tmr) {
     if (rtc_clock_skew_max[tmr] != 0.0)
         fprintf (st, "  Peak Clock Skew:         %.0fms\n",   rtc_clock_skew_max[tmr]);
     }
+if (sim_idle_sleeps) {
+    fprintf (st, "Idle:\n");
+    fprintf (st, "  Sleeps:                  %u\n",   sim_idle_sleeps);
+    fprintf (st, "  Woken Early:             %u\n",   sim_idle_early);
+    fprintf (st, "  Time Slept:              %.3f seconds\n", sim_idle_slept_us/1000000.0);
+    fprintf (st, "  Average Oversleep:       %uus\n", sim_idle_oversleep_us);
+    }
+if (sim_ffwd_enab || sim_ffwd_jumps) {
+    fprintf (st, "Fast Forward:              %s\n", sim_ffwd_enab ? "Enabled" : "Disabled");
+    fprintf (st, "  Idle Periods Skipped:    %u\n",   sim_ffwd_jumps);
+    fprintf (st, "  Time Skipped:            %.3f seconds\n", sim_ffwd_us/1000000.0);
+    }
 return SCPE_OK;
 }
 
@@ -739,6 +780,11 @@ REG sim_timer_reg[] = {
     { DRDATAD (OS_SLEEP_MIN_MS,  sim_os_sleep_min_ms,    32, "Minimum Sleep Resolution"), PV_RSPC|REG_RO},
     { DRDATAD (IDLE_STABLE,      sim_idle_stable,        32, "Idle Stable"), PV_RSPC},
     { FLDATAD (IDLE_IDLED,       sim_idle_idled,          0, ""), REG_RO},
+    { DRDATAD (IDLE_SLEEPS,      sim_idle_sleeps,        32, "Idle Sleeps"), PV_RSPC|REG_RO},
+    { DRDATAD (IDLE_EARLY,       sim_idle_early,         32, "Idle Sleeps Woken Early"), PV_RSPC|REG_RO},
+    { DRDATAD (IDLE_OVERSLEEP,   sim_idle_oversleep_us,  32, "Idle Average Oversleep Microseconds"), PV_RSPC|REG_RO},
+    { FLDATAD (FFWD_ENAB,        sim_ffwd_enab,           0, "Fast Forward Enabled"), REG_RO},
+    { DRDATAD (FFWD_JUMPS,       sim_ffwd_jumps,         32, "Fast Forward Idle Periods Skipped"), PV_RSPC|REG_RO},
     { DRDATAD (TMR,              sim_calb_tmr,           32, ""), PV_RSPC|REG_RO},
     { DRDATAD (THROT_MS_START,   sim_throt_ms_start,     32, ""), PV_RSPC|REG_RO},
     { DRDATAD (THROT_MS_STOP,    sim_throt_ms_stop,      32, ""), PV_RSPC|REG_RO},
@@ -798,20 +844,52 @@ DEVICE sim_timer_dev = {
    Inputs:
         tmr =   calibrated timer to use
 
-   Must solve the linear equation
+   The wall clock time until the next event is computed from the pending
+   instruction count and the current calibration of the timer.  The sleep
+   requested is shortened by the average amount the host has been
+   oversleeping, so that wakeups land when the event is due, and an
+   asynchronous event completion ends the sleep early.  No oversleep
+   counts for more than the wait itself, and the average decays whenever
+   a wait is too short to take, so a single long stall of the host can't
+   keep idling off.  The instruction
+   count is then advanced by the time actually slept.
+
+   With SET CLOCK FASTFORWARD there is no sleep at all: the instruction
+   count jumps straight to the next event, and the simulated time that
+   was skipped is added to the time of day seen through sim_clock_gettime.
+*/
 
-        ms_to_wait = w * ms_per_wait
+#define SIM_IDLE_MIN_US 100                             /* shortest sleep worth taking */
 
-   Or
-        w = ms_to_wait / ms_per_wait
-*/
+static t_bool sim_idle_ffwd (uint32 tmr)
+{
+double cyc_us = (((double) rtc_currd[tmr]) * rtc_hz[tmr]) / 1000000.0;
+
+if (cyc_us <= 0.0)                                      /* timer not calibrated? */
+    cyc_us = sim_timer_inst_per_sec () / 1000000.0;
+sim_debug (DBG_IDL, &sim_timer_dev, "fast forwarding %d instructions to event on %s\n", sim_interval, sim_uname(sim_clock_queue));
+sim_ffwd_us = sim_ffwd_us + sim_interval / cyc_us;      /* account skipped time */
+++sim_ffwd_jumps;
+sim_interval = 0;                                       /* event is now due */
+sim_idle_idled = TRUE;                                  /* skip calibrating this second */
+return TRUE;
+}
 
 t_bool sim_idle (uint32 tmr, t_bool sin_cyc)
 {
-static uint32 cyc_ms = 0;
-uint32 w_ms, w_idle, act_ms;
-int32 act_cyc;
-
+double cyc_us, w_us, act_cyc;
+uint32 req_us, act_us;
+
+if (sim_ffwd_enab && sim_idle_enab &&                   /* fast forwarding? */
+    (sim_clock_queue != QUEUE_LIST_END) &&              /* to an idle-able event */
+    (sim_clock_queue->flags & UNIT_IDLE) &&
+    (rtc_elapsed[tmr] >= sim_idle_stable)               /* once the timer is stable */
+#if defined (SIM_ASYNCH_IO)
+    && !AIO_RING_PENDING                                /* with no completions to deliver */
+    && (sim_asynch_inflight == 0)                       /* and no I/O still in progress */
+#endif
+    )
+    return sim_idle_ffwd (tmr);
 //sim_idle_idled = TRUE;                                  /* record idle attempt */
 if ((!sim_idle_enab)                             ||     /* idling disabled */
     ((sim_clock_queue == QUEUE_LIST_END) &&             /* or clock queue empty? */
@@ -828,40 +906,114 @@ if ((!sim_idle_enab)                             ||     /* idling disabled */
     return FALSE;
     }
 sim_debug (DBG_TRC, &sim_timer_dev, "sim_idle(tmr=%d, sin_cyc=%d)\n", tmr, sin_cyc);
-if (cyc_ms == 0)                                        /* not computed yet? */
-    cyc_ms = (rtc_currd[tmr] * rtc_hz[tmr]) / 1000;     /* cycles per msec */
-if ((sim_idle_rate_ms == 0) || (cyc_ms == 0)) {         /* not possible? */
+cyc_us = (((double) rtc_currd[tmr]) * rtc_hz[tmr]) / 1000000.0;/* cycles per usec */
+if ((sim_idle_rate_ms == 0) || (cyc_us <= 0.0)) {       /* not possible? */
     if (sin_cyc)
         sim_interval = sim_interval - 1;
-    sim_debug (DBG_IDL, &sim_timer_dev, "not possible %d - %d\n", sim_idle_rate_ms, cyc_ms);
+    sim_debug (DBG_IDL, &sim_timer_dev, "not possible %d - %.3f\n", sim_idle_rate_ms, cyc_us);
     return FALSE;
     }
-w_ms = (uint32) sim_interval / cyc_ms;                  /* ms to wait */
-w_idle = w_ms / sim_idle_rate_ms;                       /* intervals to wait */
-if (w_idle == 0) {                                      /* none? */
+w_us = ((double) sim_interval) / cyc_us;                /* usecs to wait */
+if (w_us > 10000000.0)                                  /* bound to something sane */
+    w_us = 10000000.0;
+if (w_us <= (double) (sim_idle_oversleep_us + SIM_IDLE_MIN_US)) {/* too short? */
     if (sin_cyc)
         sim_interval = sim_interval - 1;
+    sim_idle_oversleep_us = (7*sim_idle_oversleep_us)/8;/* let the average recover */
     sim_debug (DBG_IDL, &sim_timer_dev, "no wait\n");
     return FALSE;
     }
+req_us = (uint32) w_us - sim_idle_oversleep_us;         /* allow for oversleeping */
 if (sim_clock_queue == QUEUE_LIST_END)
-    sim_debug (DBG_IDL, &sim_timer_dev, "sleeping for %d ms - pending event in %d instructions\n", w_ms, sim_interval);
+    sim_debug (DBG_IDL, &sim_timer_dev, "sleeping for %u us - pending event in %d instructions\n", req_us, sim_interval);
 else
-    sim_debug (DBG_IDL, &sim_timer_dev, "sleeping for %d ms - pending event on %s in %d instructions\n", w_ms, sim_uname(sim_clock_queue), sim_interval);
-act_ms = SIM_IDLE_MS_SLEEP (w_ms);                      /* wait */
-act_cyc = act_ms * cyc_ms;
-if (act_ms < w_ms)                                      /* awakened early? */
-    act_cyc += (cyc_ms * sim_idle_rate_ms) / 2;         /* account for half an interval's worth of cycles */
-if (sim_interval > act_cyc)
-    sim_interval = sim_interval - act_cyc;              /* count down sim_interval */
+    sim_debug (DBG_IDL, &sim_timer_dev, "sleeping for %u us - pending event on %s in %d instructions\n", req_us, sim_uname(sim_clock_queue), sim_interval);
+act_us = sim_idle_us_sleep (req_us);                    /* wait */
+sim_idle_idled = TRUE;                                  /* skip calibrating this second */
+++sim_idle_sleeps;
+sim_idle_slept_us += act_us;
+if (act_us < req_us)                                    /* awakened early? */
+    ++sim_idle_early;
+else {                                                  /* track average oversleep */
+    uint32 over_us = act_us - req_us;
+
+    if (over_us > (uint32) w_us)                        /* one bad oversleep counts */
+        over_us = (uint32) w_us;                        /* no more than the wait itself */
+    sim_idle_oversleep_us = (7*sim_idle_oversleep_us + over_us)/8;
+    act_us = (uint32) w_us;                             /* woke on schedule, event due */
+    }
+act_cyc = act_us * cyc_us;
+if ((double) sim_interval > act_cyc)
+    sim_interval = sim_interval - (int32) act_cyc;      /* count down sim_interval */
 else sim_interval = 0;                                  /* or fire immediately */
 if (sim_clock_queue == QUEUE_LIST_END)
-    sim_debug (DBG_IDL, &sim_timer_dev, "slept for %d ms - pending event in %d instructions\n", act_ms, sim_interval);
+    sim_debug (DBG_IDL, &sim_timer_dev, "slept for %u us - pending event in %d instructions\n", act_us, sim_interval);
 else
-    sim_debug (DBG_IDL, &sim_timer_dev, "slept for %d ms - pending event on %s in %d instructions\n", act_ms, sim_uname(sim_clock_queue), sim_interval);
+    sim_debug (DBG_IDL, &sim_timer_dev, "slept for %u us - pending event on %s in %d instructions\n", act_us, sim_uname(sim_clock_queue), sim_interval);
 return TRUE;
 }
 
+/* Set clock options
+
+   SET CLOCK FASTFORWARD        skip idle time rather than waiting for it
+   SET CLOCK NOFASTFORWARD      idle in real time (the default)
+*/
+
+t_stat sim_set_clock (int32 flag, char *cptr)
+{
+char gbuf[CBUFSIZE];
+
+if ((cptr == NULL) || (*cptr == 0))
+    return SCPE_2FARG;
+while (*cptr) {
+    cptr = get_glyph (cptr, gbuf, ',');
+    if (strcmp (gbuf, "FASTFORWARD") == 0) {
+        sim_ffwd_enab = TRUE;
+        if (!sim_idle_enab) {
+            printf ("Fast forward takes effect when idling is enabled\n");
+            if (sim_log)
+                fprintf (sim_log, "Fast forward takes effect when idling is enabled\n");
+            }
+        }
+    else if (strcmp (gbuf, "NOFASTFORWARD") == 0)
+        sim_ffwd_enab = FALSE;
+    else return SCPE_ARG;
+    }
+return SCPE_OK;
+}
+
+/* Time of day, including any time skipped by fast forwarding */
+
+int sim_clock_gettime (struct timespec *now)
+{
+int r = clock_gettime (CLOCK_REALTIME, now);
+double secs;
+
+if ((r == 0) && (sim_ffwd_us != 0)) {
+    secs = floor (sim_ffwd_us / 1000000.0);
+    now->tv_sec = now->tv_sec + (time_t) secs;
+    now->tv_nsec = now->tv_nsec + (long) ((sim_ffwd_us - secs*1000000.0) * 1000.0);
+    if (now->tv_nsec >= 1000000000) {
+        now->tv_nsec = now->tv_nsec - 1000000000;
+        now->tv_sec = now->tv_sec + 1;
+        }
+    }
+return r;
+}
+
+time_t sim_get_time (time_t *now)
+{
+struct timespec ts;
+time_t t;
+
+if (sim_clock_gettime (&ts))
+    t = (time_t) -1;
+else t = (time_t) ts.tv_sec;
+if (now)
+    *now = t;
+return t;
+}
+
 /* Set idling - implicitly disables throttling */
 
 t_stat sim_set_idle (UNIT *uptr, int32 val, char *cptr, void *desc)
@@ -106,6 +106,10 @@ void sim_throt_cancel (void);
 uint32 sim_os_msec (void);
 void sim_os_sleep (unsigned int sec);
 uint32 sim_os_ms_sleep (unsigned int msec);
+uint32 sim_idle_us_sleep (uint32 usec);
+t_stat sim_set_clock (int32 flag, char *cptr);
+int sim_clock_gettime (struct timespec *now);
+time_t sim_get_time (time_t *now);
 uint32 sim_os_ms_sleep_init (void);
 void sim_start_timer_services (void);
 void sim_stop_timer_services (void);
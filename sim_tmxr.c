@@ -66,8 +66,10 @@
    tmxr_poll_conn -                     poll for connection
    tmxr_reset_ln -                      reset line (drops Telnet/tcp and serial connections)
    tmxr_getc_ln -                       get character for line
+   tmxr_get_block_ln -                  get available characters for line
    tmxr_poll_rx -                       poll receive
    tmxr_putc_ln -                       put character for line
+   tmxr_put_block_ln -                  put block of characters for line
    tmxr_poll_tx -                       poll transmit
    tmxr_send_buffered_data -            transmit buffered data
    tmxr_set_modem_control_passthru -    enable modem control on a multiplexer
@@ -373,6 +375,108 @@
 
 /* Local routines */
 
+#if defined(TMXR_USE_EPOLL)
+#include <sys/epoll.h>
+
+/* Poll thread registrations.
+
+   Every descriptor the poll thread watches stays registered with one epoll
+   instance while it is open.  The table, indexed by descriptor, names the 
+   unit to activate when the descriptor becomes ready and the line slot which 
+   registered it.  The owning slot lets a registration be dropped correctly 
+   even after its descriptor was closed and the number reused by another 
+   line.  Registrations change only on the simulator thread, under 
+   sim_tmxr_poll_lock, whenever _tmxr_poll_sync is called after a line's 
+   descriptors change.  Each sync adds every open descriptor again, since a 
+   close silently drops the registration and a reconnect usually gets the 
+   same descriptor number back. */
+
+static int tmxr_epoll_fd = -1;
+static struct tmxr_poll_fd {
+    UNIT                *uptr;                          /* unit to activate */
+    TMXR                *mp;                            /* owning multiplexer */
+    int                 slot;                           /* owning slot (-1 for mux master) */
+    } *tmxr_poll_fds = NULL;
+static int tmxr_poll_fds_size = 0;
+
+static void _tmxr_poll_update (int *reg, int fd, UNIT *uptr, TMXR *mp, int slot, t_bool adding)
+{
+struct epoll_event ev;
+
+memset (&ev, 0, sizeof (ev));
+if (uptr == NULL)                                       /* nothing to activate? */
+    fd = 0;                                             /* then don't watch */
+if (!adding) {                                          /* removing stale registration? */
+    if ((*reg) && (*reg != fd)) {
+        struct tmxr_poll_fd *p = &tmxr_poll_fds[*reg];
+
+        if ((p->mp == mp) && (p->slot == slot)) {       /* still ours? */
+            epoll_ctl (tmxr_epoll_fd, EPOLL_CTL_DEL, *reg, &ev);/* (may have gone with its close) */
+            p->uptr = NULL;
+            p->mp = NULL;
+            }
+        *reg = 0;
+        }
+    return;
+    }
+if (fd == 0)
+    return;
+if (fd >= tmxr_poll_fds_size) {                         /* grow table */
+    int size = tmxr_poll_fds_size ? tmxr_poll_fds_size : 64;
+    struct tmxr_poll_fd *fds;
+
+    while (size <= fd)
+        size *= 2;
+    fds = (struct tmxr_poll_fd *)realloc (tmxr_poll_fds, size * sizeof (*fds));
+    if (fds == NULL)
+        return;
+    memset (fds + tmxr_poll_fds_size, 0, (size - tmxr_poll_fds_size) * sizeof (*fds));
+    tmxr_poll_fds = fds;
+    tmxr_poll_fds_size = size;
+    }
+ev.events = EPOLLIN | EPOLLPRI;                         /* (again, even if unchanged) */
+ev.data.fd = fd;
+if ((0 != epoll_ctl (tmxr_epoll_fd, EPOLL_CTL_ADD, fd, &ev)) &&
+    ((errno != EEXIST) || (0 != epoll_ctl (tmxr_epoll_fd, EPOLL_CTL_MOD, fd, &ev))))
+    return;
+*reg = fd;
+tmxr_poll_fds[fd].uptr = uptr;                          /* (the line's unit may have changed) */
+tmxr_poll_fds[fd].mp = mp;
+tmxr_poll_fds[fd].slot = slot;
+}
+
+/* Bring the registrations of a multiplexer's descriptors up to date */
+
+static void _tmxr_poll_sync (TMXR *mp)
+{
+int i, pass;
+UNIT *uptr = mp->uptr;
+
+if ((tmxr_epoll_fd < 0) && 
+    ((tmxr_epoll_fd = epoll_create (FD_SETSIZE)) < 0))  /* (size is only a hint) */
+    return;
+pthread_mutex_lock (&sim_tmxr_poll_lock);
+for (pass = 0; pass < 2; ++pass) {                      /* drop all stale before adding any */
+    _tmxr_poll_update (&mp->poll_fd, 
+                       (uptr && (uptr->dynflags & UNIT_TM_POLL)) ? (int)mp->master : 0, 
+                       uptr, mp, -1, pass);
+    for (i = 0; i < mp->lines; ++i) {
+        TMLN *lp = mp->ldsc + i;
+        UNIT *luptr = lp->uptr ? lp->uptr : uptr;
+        int slot = i * TMXR_POLL_LN_FDS;
+
+        _tmxr_poll_update (&lp->poll_fd[0], (int)lp->sock, luptr, mp, slot, pass);
+        _tmxr_poll_update (&lp->poll_fd[1], (int)lp->serport, luptr, mp, slot + 1, pass);
+        _tmxr_poll_update (&lp->poll_fd[2], (int)lp->connecting, uptr, mp, slot + 2, pass);
+        _tmxr_poll_update (&lp->poll_fd[3], (int)lp->master, uptr, mp, slot + 3, pass);
+        }
+    }
+pthread_mutex_unlock (&sim_tmxr_poll_lock);
+}
+#else
+#define _tmxr_poll_sync(mp) (void)0
+#endif /* TMXR_USE_EPOLL */
+
 
 /* Initialize the line state.
 
@@ -383,8 +487,24 @@
    Because a line break is represented by a flag in the "receive break status"
    array, we must zero that array in order to clear any pending break
    indications.
+
+   The receive buffers (and the transmit buffer of an unbuffered line) are
+   sized here from the multiplexer's BUFSIZE setting, so a changed size
+   takes effect as each line is next initialized.
 */
 
+static void tmxr_size_rx_buffer (TMLN *lp)
+{
+int32 size = lp->mp->bufsize ? lp->mp->bufsize : TMXR_MAXBUF;
+
+if (lp->rxbsz != size) {
+    lp->rxb = (char *)realloc (lp->rxb, size);
+    lp->rbr = (char *)realloc (lp->rbr, size);
+    lp->rxbsz = size;
+    lp->rxbpr = lp->rxbpi = 0;
+    }
+}
+
 static void tmxr_init_line (TMLN *lp)
 {
 lp->tsta = 0;                                           /* init telnet state */
@@ -393,11 +513,12 @@ lp->dstb = 0;                                           /* default bin mode */
 lp->rxbpr = lp->rxbpi = lp->rxcnt = 0;                  /* init receive indexes */
 if (!lp->txbfd)                                         /* if not buffered */
     lp->txbpr = lp->txbpi = lp->txcnt = 0;              /*   init transmit indexes */
-memset (lp->rbr, 0, TMXR_MAXBUF);                       /* clear break status array */
+tmxr_size_rx_buffer (lp);
+memset (lp->rbr, 0, lp->rxbsz);                         /* clear break status array */
 lp->txdrp = 0;
 if (!lp->mp->buffered) {
     lp->txbfd = 0;
-    lp->txbsz = TMXR_MAXBUF;
+    lp->txbsz = lp->mp->bufsize ? lp->mp->bufsize : TMXR_MAXBUF;
     lp->txb = (char *)realloc (lp->txb, lp->txbsz);
     }
 return;
@@ -535,26 +656,6 @@ else {                                                  /* Telnet connection */
 }
 
 
-/* Remove a character from the read buffer.
-
-   The character at position "p" in the read buffer associated with line "lp" is
-   removed by moving all of the following received characters down one position.
-   The receive break status array is adjusted accordingly.
-*/
-
-static void tmxr_rmvrc (TMLN *lp, int32 p)
-{
-for ( ; p < lp->rxbpi; p++) {                           /* work from "p" through end of buffer */
-    lp->rxb[p] = lp->rxb[p + 1];                        /* slide following character down */
-    lp->rbr[p] = lp->rbr[p + 1];                        /* adjust break status too */
-    }
-
-lp->rbr[p] = 0;                                         /* clear potential break from vacated slot */
-lp->rxbpi = lp->rxbpi - 1;                              /* drop buffer insert index */
-return;
-}
-
-
 /* Find a line descriptor indicated by unit or number.
 
    If "uptr" is NULL, then the line descriptor is determined by the line number
@@ -666,6 +767,8 @@ if (mp->port)                                           /* copy port */
     sprintf (growstring(&tptr, 13 + strlen (mp->port)), "%s%s", mp->port, mp->notelnet ? ";notelnet" : "");
 if (mp->buffered)
     sprintf (growstring(&tptr, 32), ",Buffered=%d", mp->buffered);
+if (mp->bufsize)
+    sprintf (growstring(&tptr, 32), ",BufSize=%d", mp->bufsize);
 if (mp->logfiletmpl[0])                                 /* logfile info */
     sprintf (growstring(&tptr, 7 + strlen (mp->logfiletmpl)), ",Log=%s", mp->logfiletmpl);
 while ((*tptr == ',') || (*tptr == ' '))
@@ -756,6 +859,7 @@ if (mp->last_poll_time == 0) {                          /* first poll initializa
             sim_cancel (uptr);
             }
         }
+    _tmxr_poll_sync (mp);                               /* master is now polled */
     }
 
 if ((poll_time - mp->last_poll_time) < TMXR_CONNECT_POLL_INTERVAL)
@@ -809,6 +913,7 @@ if (mp->master) {
                 }
             tmxr_report_connection (mp, lp);
             lp->cnms = sim_os_msec ();                  /* time of connection */
+            _tmxr_poll_sync (mp);                       /* poll the new socket */
             return i;
             }
         }                                               /* end if newsock */
@@ -828,6 +933,7 @@ for (i = 0; i < mp->lines; i++) {                       /* check each line in se
                 lp->ipad = realloc (lp->ipad, 1+strlen (lp->destination));
                 strcpy (lp->ipad, lp->destination);
                 lp->cnms = sim_os_msec ();
+                _tmxr_poll_sync (mp);
                 break;
             case -1:                                /* failed connection */
                 tmxr_reset_ln (lp);                 /* retry */
@@ -860,6 +966,7 @@ for (i = 0; i < mp->lines; i++) {                       /* check each line in se
                 if (lp->connecting) {
                     sim_close_sock (lp->connecting, 0); /* abort our as yet unconnnected socket */
                     lp->connecting = 0;
+                    _tmxr_poll_sync (mp);
                     }
                 }
             if (lp->conn == 0) {                        /* is the line available? */
@@ -873,6 +980,7 @@ for (i = 0; i < mp->lines; i++) {                       /* check each line in se
                     }
                 tmxr_report_connection (mp, lp);
                 lp->cnms = sim_os_msec ();              /* time of connection */
+                _tmxr_poll_sync (mp);                   /* poll the new socket */
                 return i;
                 }
             else {
@@ -949,6 +1057,7 @@ if ((lp->destination) && (!lp->serport)) {
     lp->connecting = sim_connect_sock (lp->destination, "localhost", NULL);
     }
 tmxr_init_line (lp);                                /* initialize line state */
+_tmxr_poll_sync (lp->mp);                           /* stop polling what was closed */
 /* Revise the unit's connect string to reflect the current attachments */
 lp->mp->uptr->filename = _mux_attach_string (lp->mp->uptr->filename, lp->mp);
 /* No connections or listeners exist, then we're equivalent to being fully detached.  We should reflect that */
@@ -1151,6 +1260,44 @@ return val;
 }
 
 
+/* Get available characters from specific line
+
+   Inputs:
+        *lp     =       pointer to terminal line descriptor
+        *vals   =       pointer to array receiving characters
+        max     =       size of array
+   Output:
+        count of characters stored
+
+   Each stored value has the form returned by tmxr_getc_ln (valid + char,
+   with SCPE_BREAK ORed in where a line break was detected), so a device
+   can fill its silo with one call rather than one call per character.
+*/
+
+int32 tmxr_get_block_ln (TMLN *lp, int32 *vals, int32 max)
+{
+int32 i, n = 0;
+
+tmxr_debug_trace_line (lp, "tmxr_get_block_ln()");
+if (lp->conn && lp->rcve) {                             /* conn & enb? */
+    n = lp->rxbpi - lp->rxbpr;                          /* # input chrs */
+    if (n > max)
+        n = max;
+    for (i = 0; i < n; i++) {
+        vals[i] = TMXR_VALID | (lp->rxb[lp->rxbpr + i] & 0377);
+        if (lp->rbr[lp->rxbpr + i]) {                   /* break? */
+            lp->rbr[lp->rxbpr + i] = 0;                 /* clear status */
+            vals[i] |= SCPE_BREAK;                      /* indicate to caller */
+            }
+        }
+    lp->rxbpr = lp->rxbpr + n;                          /* adv pointer */
+    }
+if (lp->rxbpi == lp->rxbpr)                             /* empty? zero ptrs */
+    lp->rxbpi = lp->rxbpr = 0;
+return n;
+}
+
+
 /* Poll for input
 
    Inputs:
@@ -1160,7 +1307,7 @@ return val;
 
 void tmxr_poll_rx (TMXR *mp)
 {
-int32 i, nbytes, j;
+int32 i, nbytes, j, k;
 TMLN *lp;
 
 tmxr_debug_trace (mp, "tmxr_poll_rx()");
@@ -1170,12 +1317,23 @@ for (i = 0; i < mp->lines; i++) {                       /* loop thru lines */
         continue;
 
     nbytes = 0;
-    if (lp->rxbpi == 0)                                 /* need input? */
-        nbytes = tmxr_read (lp,                         /* yes, read */
-            TMXR_MAXBUF - TMXR_GUARD);                  /* leave spc for Telnet cruft */
-    else if (lp->tsta)                                  /* in Telnet seq? */
+    if (lp->rxb == NULL)                                /* no buffer yet? */
+        tmxr_size_rx_buffer (lp);
+    if (lp->rxbpr &&                                    /* consumed data at front */
+        ((lp->rxbsz - lp->rxbpi) <= TMXR_GUARD)) {      /* and little room at end? */
+        j = lp->rxbpi - lp->rxbpr;                      /* slide remaining data down */
+        memmove (lp->rxb, lp->rxb + lp->rxbpr, j);
+        memmove (lp->rbr, lp->rbr + lp->rxbpr, j);
+        memset (lp->rbr + j, 0, lp->rxbpr);             /* clear vacated break status */
+        lp->rxbpi = j;
+        lp->rxbpr = 0;
+        }
+    if (lp->rxbpi < (lp->rxbsz - TMXR_GUARD))           /* room for input? */
+        nbytes = tmxr_read (lp,                         /* yes, read all that fits */
+            lp->rxbsz - TMXR_GUARD - lp->rxbpi);        /* leave spc for Telnet cruft */
+    else if (lp->tsta && (lp->rxbpi < lp->rxbsz))       /* in Telnet seq? */
         nbytes = tmxr_read (lp,                         /* yes, read to end */
-            TMXR_MAXBUF - lp->rxbpi);
+            lp->rxbsz - lp->rxbpi);
 
     if (nbytes < 0) {                                   /* line error? */
         if (!lp->txbfd) 
@@ -1187,11 +1345,15 @@ for (i = 0; i < mp->lines; i++) {                       /* loop thru lines */
 
         tmxr_debug (TMXR_DBG_RCV, lp, "Received", &(lp->rxb[lp->rxbpi]), nbytes);
 
-        j = lp->rxbpi;                                  /* start of data */
+        j = k = lp->rxbpi;                              /* start of data */
         lp->rxbpi = lp->rxbpi + nbytes;                 /* adv pointers */
         lp->rxcnt = lp->rxcnt + nbytes;
 
-/* Examine new data, remove TELNET cruft before making input available */
+/* Examine new data, remove TELNET cruft before making input available.
+   Characters are examined at j and those which are kept are copied down 
+   to k, so removing a character is just not copying it. */
+
+#define RXBUF_KEEP(lp, j, k) (lp->rxb[k] = lp->rxb[j], lp->rbr[k++] = lp->rbr[j++])
 
         if (!lp->notelnet) {                            /* Are we looking for telnet interpretation? */
             for (; j < lp->rxbpi; ) {                   /* loop thru char */
@@ -1201,25 +1363,25 @@ for (i = 0; i < mp->lines; i++) {                       /* loop thru lines */
                 case TNS_NORM:                          /* normal */
                     if (tmp == TN_IAC) {                /* IAC? */
                         lp->tsta = TNS_IAC;             /* change state */
-                        tmxr_rmvrc (lp, j);             /* remove char */
+                        j = j + 1;                      /* remove char */
                         break;
                         }
                     if ((tmp == TN_CR) && lp->dstb)     /* CR, no bin */
                         lp->tsta = TNS_CRPAD;           /* skip pad char */
-                    j = j + 1;                          /* advance j */
+                    RXBUF_KEEP (lp, j, k);              /* keep char */
                     break;
 
                 case TNS_IAC:                           /* IAC prev */
                     if (tmp == TN_IAC) {                /* IAC + IAC */
                         lp->tsta = TNS_NORM;            /* treat as normal */
-                        j = j + 1;                      /* advance j */
-                        break;                          /* keep IAC */
+                        RXBUF_KEEP (lp, j, k);          /* keep IAC */
+                        break;
                         }
                     if (tmp == TN_BRK) {                /* IAC + BRK? */
                         lp->tsta = TNS_NORM;            /* treat as normal */
                         lp->rxb[j] = 0;                 /* char is null */
                         lp->rbr[j] = 1;                 /* flag break */
-                        j = j + 1;                      /* advance j */
+                        RXBUF_KEEP (lp, j, k);          /* keep it */
                         break;
                         }
                     switch (tmp) {
@@ -1247,7 +1409,7 @@ for (i = 0; i < mp->lines; i++) {                       /* loop thru lines */
                         lp->tsta = TNS_NORM;            /* ignore */
                         break;
                         }
-                    tmxr_rmvrc (lp, j);                 /* remove char */
+                    j = j + 1;                          /* remove char */
                     break;
 
                 case TNS_WILL: case TNS_WONT:           /* IAC+WILL/WONT prev */
@@ -1256,7 +1418,7 @@ for (i = 0; i < mp->lines; i++) {                       /* loop thru lines */
                             lp->dstb = 0;
                         else lp->dstb = 1;
                         }
-                    tmxr_rmvrc (lp, j);                 /* remove it */
+                    j = j + 1;                          /* remove it */
                     lp->tsta = TNS_NORM;                /* next normal */
                     break;
 
@@ -1278,18 +1440,21 @@ for (i = 0; i < mp->lines; i++) {                       /* loop thru lines */
                     lp->tsta = TNS_NORM;                /* next normal */
                     if ((tmp == TN_LF) ||               /* CR + LF ? */
                         (tmp == TN_NUL))                /* CR + NUL? */
-                        tmxr_rmvrc (lp, j);             /* remove it */
+                        j = j + 1;                      /* remove it */
                     break;
 
                 case TNS_DO:                            /* pending DO request */
                 case TNS_SKIP: default:                 /* skip char */
-                    tmxr_rmvrc (lp, j);                 /* remove char */
+                    j = j + 1;                          /* remove char */
                     lp->tsta = TNS_NORM;                /* next normal */
                     break;
                     }                                   /* end case state */
                 }                                       /* end for char */
-            if (nbytes != (lp->rxbpi-lp->rxbpr)) {
-                tmxr_debug (TMXR_DBG_RCV, lp, "Remaining", &(lp->rxb[lp->rxbpi]), lp->rxbpi-lp->rxbpr);
+            if (k != lp->rxbpi) {                       /* anything removed? */
+                memset (lp->rbr + k, 0, lp->rxbpi - k); /* clear vacated break status */
+                j = lp->rxbpi - nbytes;                 /* start of data */
+                lp->rxbpi = k;                          /* drop buffer insert index */
+                tmxr_debug (TMXR_DBG_RCV, lp, "Remaining", &(lp->rxb[j]), k - j);
                 }
             }
         }                                               /* end else nbytes */
@@ -1307,7 +1472,7 @@ return;
 
 int32 tmxr_rqln (TMLN *lp)
 {
-return (lp->rxbpi - lp->rxbpr + ((lp->rxbpi < lp->rxbpr)? TMXR_MAXBUF: 0));
+return (lp->rxbpi - lp->rxbpr + ((lp->rxbpi < lp->rxbpr)? lp->rxbsz: 0));
 }
 
 
@@ -1353,6 +1518,78 @@ if ((lp->txbfd) || (TXBUF_AVAIL(lp) > 1)) {             /* room for char (+ IAC)
 return SCPE_STALL;                                      /* char not sent */
 }
 
+/* Store block of characters in line buffer
+
+   Inputs:
+        *lp     =       pointer to line descriptor
+        *buf    =       characters
+        len     =       count of characters
+        *sent   =       pointer to count of characters stored (may be NULL)
+   Outputs:
+        status  =       ok, connection lost, or stall
+
+   Characters are copied into the transmit buffer a run at a time rather
+   than one call per character.  If the buffer fills, the characters which
+   were stored are reported in *sent, the line is disabled and SCPE_STALL
+   is returned, leaving the remainder for the caller to retry.
+*/
+
+t_stat tmxr_put_block_ln (TMLN *lp, const uint8 *buf, int32 len, int32 *sent)
+{
+int32 n = 0, run;
+uint8 *iac;
+
+if (sent)
+    *sent = 0;
+if ((lp->conn == FALSE) &&                              /* no conn & not buffered? */
+    (!lp->txbfd)) {
+    lp->txdrp += len;                                   /* lost */
+    return SCPE_LOST;
+    }
+tmxr_debug_trace_line (lp, "tmxr_put_block_ln()");
+while (n < len) {
+    if (lp->txbfd) {                                    /* buffered line? */
+        if ((TN_IAC == (char) buf[n]) && (!lp->notelnet))
+            TXBUF_CHAR (lp, TN_IAC);                    /* stuff extra IAC char */
+        TXBUF_CHAR (lp, buf[n]);                        /* keeps the newest data */
+        ++n;
+        continue;
+        }
+    if ((TN_IAC == (char) buf[n]) && (!lp->notelnet)) { /* char == IAC in telnet session? */
+        if (TXBUF_AVAIL(lp) <= 2)                       /* room for both? */
+            break;
+        TXBUF_CHAR (lp, TN_IAC);                        /* stuff extra IAC char */
+        TXBUF_CHAR (lp, buf[n]);
+        ++n;
+        continue;
+        }
+    run = TXBUF_AVAIL(lp) - 1;                          /* room (putc keeps one free) */
+    if (run > len - n)
+        run = len - n;
+    if (run > lp->txbsz - lp->txbpi)                    /* up to the end of the buffer */
+        run = lp->txbsz - lp->txbpi;
+    if ((!lp->notelnet) &&                              /* stop at next IAC */
+        (NULL != (iac = (uint8 *)memchr (buf + n, TN_IAC & 0377, run))))
+        run = (int32)(iac - (buf + n));
+    if (run <= 0)
+        break;
+    memcpy (lp->txb + lp->txbpi, buf + n, run);
+    lp->txbpi = (lp->txbpi + run) % lp->txbsz;
+    n = n + run;
+    }
+if ((!lp->txbfd) && (TXBUF_AVAIL (lp) <= TMXR_GUARD))   /* near full? */
+    lp->xmte = 0;                                       /* disable line */
+if (lp->txlog && n)                                     /* log if available */
+    fwrite (buf, 1, n, lp->txlog);
+if (sent)
+    *sent = n;
+if (n < len) {                                          /* no room for the rest? */
+    lp->xmte = 0;                                       /* dsbl line */
+    return SCPE_STALL;
+    }
+return SCPE_OK;
+}
+
 /* Poll for output
 
    Inputs:
@@ -1488,8 +1725,18 @@ if (lp->serport) {                          /* close current serial connection *
 
 */
 
+static t_stat _tmxr_open_master (TMXR *mp, char *cptr);
+
 t_stat tmxr_open_master (TMXR *mp, char *cptr)
 {
+t_stat r = _tmxr_open_master (mp, cptr);
+
+_tmxr_poll_sync (mp);                                   /* poll whatever is now open */
+return r;
+}
+
+static t_stat _tmxr_open_master (TMXR *mp, char *cptr)
+{
 int32 i, line, nextline = -1;
 char tbuf[CBUFSIZE], listen[CBUFSIZE], destination[CBUFSIZE], 
      logfiletmpl[CBUFSIZE], buffered[CBUFSIZE], hostport[CBUFSIZE], 
@@ -1498,6 +1745,7 @@ SOCKET sock;
 SERHANDLE serport;
 char *tptr = cptr;
 t_bool nolog, notelnet, listennotelnet, unbuffered;
+int32 bufsize;
 TMLN *lp;
 t_stat r = SCPE_ARG;
 
@@ -1511,6 +1759,7 @@ while (*tptr) {
     memset(port,        '\0', sizeof(port));
     memset(option,      '\0', sizeof(option));
     nolog = notelnet = listennotelnet = unbuffered = FALSE;
+    bufsize = 0;
     while (*tptr) {
         tptr = get_glyph_nc (tptr, tbuf, ',');
         if (!tbuf[0])
@@ -1553,6 +1802,14 @@ while (*tptr) {
                     }
                 continue;
                 }
+            if (0 == MATCH_CMD (gbuf, "BUFSIZE")) {
+                if ((NULL == cptr) || ('\0' == *cptr))
+                    return SCPE_2FARG;
+                bufsize = (int32) get_uint (cptr, 10, TMXR_MAXBUFSIZE, &r);
+                if ((r != SCPE_OK) || (bufsize < TMXR_MAXBUF))
+                    return SCPE_ARG;
+                continue;
+                }
             if (0 == MATCH_CMD (gbuf, "NOLOG")) {
                 if ((NULL != cptr) && ('\0' != *cptr))
                     return SCPE_2MARG;
@@ -1630,12 +1887,14 @@ while (*tptr) {
                     }
                 }
             }
+        if (bufsize)                                /* line buffer size for next init */
+            mp->bufsize = bufsize;
         if (unbuffered) {
             if (mp->buffered) {
                 mp->buffered = 0;
                 for (i = 0; i < mp->lines; i++) { /* default line buffers */
                     lp = mp->ldsc + i;
-                    lp->txbsz = TMXR_MAXBUF;
+                    lp->txbsz = mp->bufsize ? mp->bufsize : TMXR_MAXBUF;
                     lp->txb = (char *)realloc(lp->txb, lp->txbsz);
                     lp->txbfd = lp->txbpi = lp->txbpr = 0;
                     }
@@ -1748,6 +2007,8 @@ while (*tptr) {
     else {                                                  /* line specific attach */
         lp = &mp->ldsc[line];
         lp->mp = mp;
+        if (bufsize)                                        /* buffer size is mux wide */
+            return SCPE_ARG;
         if (logfiletmpl[0]) {
             sim_close_logfile (&lp->txlogref);
             lp->txlog = NULL;
@@ -1763,7 +2024,7 @@ while (*tptr) {
                 }
             }
         if (unbuffered) {
-            lp->txbsz = TMXR_MAXBUF;
+            lp->txbsz = mp->bufsize ? mp->bufsize : TMXR_MAXBUF;
             lp->txb = (char *)realloc (lp->txb, lp->txbsz);
             lp->txbfd = lp->txbpi = lp->txbpr = 0;
             }
@@ -1865,6 +2126,7 @@ t_stat tmxr_set_line_unit (TMXR *mp, int line, UNIT *uptr_poll)
 if ((line < 0) || (line >= mp->lines))
     return SCPE_ARG;
 mp->ldsc[line].uptr = uptr_poll;
+_tmxr_poll_sync (mp);                                   /* activate the new unit */
 return SCPE_OK;
 }
 
@@ -1943,13 +2205,19 @@ _tmxr_poll(void *arg)
 {
 int sched_policy;
 struct sched_param sched_priority;
+#if !defined(TMXR_USE_EPOLL)
 struct timeval timeout;
+SOCKET *sockets = NULL;
+#else
+struct epoll_event *events = NULL;
+#endif
 int timeout_usec;
 DEVICE *dptr = tmxr_open_devices[0]->dptr;
 UNIT **units = NULL;
+TMXR **muxes = NULL;
 UNIT **activated = NULL;
-SOCKET *sockets = NULL;
 int wait_count = 0;
+struct timespec dispatch_time;
 
 /* Boost Priority for this I/O thread vs the CPU instruction execution 
    thread which, in general, won't be readily yielding the processor when 
@@ -1961,18 +2229,26 @@ pthread_setschedparam (pthread_self(), sched_policy, &sched_priority);
 sim_debug (TMXR_DBG_ASY, dptr, "_tmxr_poll() - starting\n");
 
 units = calloc(FD_SETSIZE, sizeof(*units));
+muxes = calloc(FD_SETSIZE, sizeof(*muxes));
 activated = calloc(FD_SETSIZE, sizeof(*activated));
+#if !defined(TMXR_USE_EPOLL)
 sockets = calloc(FD_SETSIZE, sizeof(*sockets));
+#else
+events = calloc(FD_SETSIZE, sizeof(*events));
+#endif
 timeout_usec = 1000000;
 pthread_mutex_lock (&sim_tmxr_poll_lock);
 pthread_cond_signal (&sim_tmxr_startup_cond);   /* Signal we're ready to go */
 while (sim_asynch_enabled) {
     int i, j, status, select_errno;
-    fd_set readfds, errorfds;
-    int socket_count;
-    SOCKET max_socket_fd;
+    int ready_count;
     TMXR *mp;
     DEVICE *d;
+#if !defined(TMXR_USE_EPOLL)
+    int socket_count;
+    fd_set readfds, errorfds;
+    SOCKET max_socket_fd;
+#endif
 
     if ((tmxr_open_device_count == 0) || (!sim_is_running)) {
         for (j=0; j<wait_count; ++j) {
@@ -1985,16 +2261,34 @@ while (sim_asynch_enabled) {
         }
     /* If we started something we should wait for, let it finish before polling again */
     if (wait_count) {
+        struct timespec now;
+        double usecs;
+
         sim_debug (TMXR_DBG_ASY, dptr, "_tmxr_poll() - waiting for %d units\n", wait_count);
         pthread_cond_wait (&sim_tmxr_poll_cond, &sim_tmxr_poll_lock);
         sim_debug (TMXR_DBG_ASY, dptr, "_tmxr_poll() - continuing with timeout of %dms\n", timeout_usec/1000);
+        clock_gettime (CLOCK_REALTIME, &now);
+        usecs = (now.tv_sec - dispatch_time.tv_sec)*1000000.0 + (now.tv_nsec - dispatch_time.tv_nsec)/1000.0;
+        if (usecs < 0.0)
+            usecs = 0.0;
+        for (i=0; i<tmxr_open_device_count; ++i) {
+            mp = tmxr_open_devices[i];
+            if (mp->poll_pending) {
+                mp->poll_pending = FALSE;
+                mp->poll_latency += usecs;
+                if (usecs > mp->poll_latency_max)
+                    mp->poll_latency_max = (uint32)usecs;
+                }
+            }
         }
+#if !defined(TMXR_USE_EPOLL)
     FD_ZERO (&readfds);
     FD_ZERO (&errorfds);
     for (i=max_socket_fd=socket_count=0; i<tmxr_open_device_count; ++i) {
         mp = tmxr_open_devices[i];
         if ((mp->master) && (mp->uptr->dynflags&UNIT_TM_POLL)) {
             units[socket_count] = mp->uptr;
+            muxes[socket_count] = mp;
             sockets[socket_count] = mp->master;
             FD_SET (mp->master, &readfds);
             FD_SET (mp->master, &errorfds);
@@ -2007,6 +2301,7 @@ while (sim_asynch_enabled) {
                 units[socket_count] = mp->ldsc[j].uptr;
                 if (units[socket_count] == NULL)
                     units[socket_count] = mp->uptr;
+                muxes[socket_count] = mp;
                 sockets[socket_count] = mp->ldsc[j].sock;
                 FD_SET (mp->ldsc[j].sock, &readfds);
                 FD_SET (mp->ldsc[j].sock, &errorfds);
@@ -2019,6 +2314,7 @@ while (sim_asynch_enabled) {
                 units[socket_count] = mp->ldsc[j].uptr;
                 if (units[socket_count] == NULL)
                     units[socket_count] = mp->uptr;
+                muxes[socket_count] = mp;
                 sockets[socket_count] = mp->ldsc[j].serport;
                 FD_SET (mp->ldsc[j].serport, &readfds);
                 FD_SET (mp->ldsc[j].serport, &errorfds);
@@ -2029,6 +2325,7 @@ while (sim_asynch_enabled) {
 #endif
             if (mp->ldsc[j].connecting) {
                 units[socket_count] = mp->uptr;
+                muxes[socket_count] = mp;
                 sockets[socket_count] = mp->ldsc[j].connecting;
                 FD_SET (mp->ldsc[j].connecting, &readfds);
                 FD_SET (mp->ldsc[j].connecting, &errorfds);
@@ -2038,6 +2335,7 @@ while (sim_asynch_enabled) {
                 }
             if (mp->ldsc[j].master) {
                 units[socket_count] = mp->uptr;
+                muxes[socket_count] = mp;
                 sockets[socket_count] = mp->ldsc[j].master;
                 FD_SET (mp->ldsc[j].master, &readfds);
                 FD_SET (mp->ldsc[j].master, &errorfds);
@@ -2060,11 +2358,48 @@ while (sim_asynch_enabled) {
     else
         status = select (1+(int)max_socket_fd, &readfds, NULL, &errorfds, &timeout);
     select_errno = errno;
-    wait_count=0;
     pthread_mutex_lock (&sim_tmxr_poll_lock);
+    /* Collect the units of the ready descriptors */
+    ready_count = 0;
+    if (status > 0)
+        for (i=0; i<socket_count; ++i)
+            if (FD_ISSET(sockets[i], &readfds) || 
+                FD_ISSET(sockets[i], &errorfds)) {
+                units[ready_count] = units[i];
+                muxes[ready_count] = muxes[i];
+                ++ready_count;
+                }
+#else /* TMXR_USE_EPOLL */
+    /* Descriptors stay registered as lines come and go, so just wait */
+    pthread_mutex_unlock (&sim_tmxr_poll_lock);
+    if (timeout_usec > 1000000)
+        timeout_usec = 1000000;
+    select_errno = 0;
+    if (tmxr_epoll_fd < 0) {
+        sim_os_ms_sleep (timeout_usec/1000);
+        status = 0;
+        }
+    else
+        status = epoll_wait (tmxr_epoll_fd, events, FD_SETSIZE, timeout_usec/1000);
+    select_errno = errno;
+    pthread_mutex_lock (&sim_tmxr_poll_lock);
+    /* Collect the units of the ready descriptors (skipping any 
+       which were unregistered while we waited) */
+    ready_count = 0;
+    for (i=0; i<status; ++i) {
+        int fd = events[i].data.fd;
+
+        if ((fd < tmxr_poll_fds_size) && (tmxr_poll_fds[fd].uptr)) {
+            units[ready_count] = tmxr_poll_fds[fd].uptr;
+            muxes[ready_count] = tmxr_poll_fds[fd].mp;
+            ++ready_count;
+            }
+        }
+#endif /* TMXR_USE_EPOLL */
+    wait_count=0;
     switch (status) {
         case 0:     /* timeout */
-            for (i=max_socket_fd=socket_count=0; i<tmxr_open_device_count; ++i) {
+            for (i=0; i<tmxr_open_device_count; ++i) {
                 mp = tmxr_open_devices[i];
                 if (mp->master) {
                     if (!mp->uptr->a_polling_now) {
@@ -2113,44 +2448,53 @@ while (sim_asynch_enabled) {
             break;
         default:
             wait_count = 0;
-            for (i=0; i<socket_count; ++i) {
-                if (FD_ISSET(sockets[i], &readfds) || 
-                    FD_ISSET(sockets[i], &errorfds)) {
-                    /* More than one socket can be associated with the 
-                       same unit.  Only activate one time */
-                    for (j=0; j<wait_count; ++j)
-                        if (activated[j] == units[i])
-                            break;
-                    if (j == wait_count) {
-                        activated[j] = units[i];
-                        ++wait_count;
-                        if (!activated[j]->a_polling_now) {
-                            activated[j]->a_polling_now = TRUE;
-                            activated[j]->a_poll_waiter_count = 1;
-                            d = find_dev_from_unit(activated[j]);
-                            sim_debug (TMXR_DBG_ASY, d, "_tmxr_poll() - Activating for data %s\n", sim_uname(activated[j]));
-                            pthread_mutex_unlock (&sim_tmxr_poll_lock);
-                            _sim_activate (activated[j], 0);
-                            pthread_mutex_lock (&sim_tmxr_poll_lock);
-                            }
-                        else {
-                            d = find_dev_from_unit(activated[j]);
-                            sim_debug (TMXR_DBG_ASY, d, "_tmxr_poll() - Already Activated %s%d %d times\n", sim_uname(activated[j]), activated[j]->a_poll_waiter_count);
-                            ++activated[j]->a_poll_waiter_count;
-                            }
+            for (i=0; i<ready_count; ++i) {
+                if (!muxes[i]->poll_pending) {      /* count each mux once per pass */
+                    muxes[i]->poll_pending = TRUE;
+                    ++muxes[i]->poll_wakeups;
+                    }
+                ++muxes[i]->poll_ready;
+                /* More than one socket can be associated with the 
+                   same unit.  Only activate one time */
+                for (j=0; j<wait_count; ++j)
+                    if (activated[j] == units[i])
+                        break;
+                if (j == wait_count) {
+                    activated[j] = units[i];
+                    ++wait_count;
+                    if (!activated[j]->a_polling_now) {
+                        activated[j]->a_polling_now = TRUE;
+                        activated[j]->a_poll_waiter_count = 1;
+                        d = find_dev_from_unit(activated[j]);
+                        sim_debug (TMXR_DBG_ASY, d, "_tmxr_poll() - Activating for data %s\n", sim_uname(activated[j]));
+                        pthread_mutex_unlock (&sim_tmxr_poll_lock);
+                        _sim_activate (activated[j], 0);
+                        pthread_mutex_lock (&sim_tmxr_poll_lock);
+                        }
+                    else {
+                        d = find_dev_from_unit(activated[j]);
+                        sim_debug (TMXR_DBG_ASY, d, "_tmxr_poll() - Already Activated %s%d %d times\n", sim_uname(activated[j]), activated[j]->a_poll_waiter_count);
+                        ++activated[j]->a_poll_waiter_count;
                         }
                     }
                 }
-            if (wait_count)
+            if (wait_count) {
                 timeout_usec = 10000; /* Wait 10ms next time */
+                clock_gettime (CLOCK_REALTIME, &dispatch_time);
+                }
             break;
         }
     sim_tmxr_poll_count += wait_count;
     }
 pthread_mutex_unlock (&sim_tmxr_poll_lock);
 free(units);
+free(muxes);
 free(activated);
+#if !defined(TMXR_USE_EPOLL)
 free(sockets);
+#else
+free(events);
+#endif
 
 sim_debug (TMXR_DBG_ASY, dptr, "_tmxr_poll() - exiting\n");
 
@@ -2570,6 +2914,7 @@ if (r != SCPE_OK) {                                     /* error? */
     return r;
     }
 mp->uptr = uptr;                                        /* save unit for polling */
+_tmxr_poll_sync (mp);
 uptr->filename = _mux_attach_string (uptr->filename, mp);/* save */
 uptr->flags = uptr->flags | UNIT_ATT;                   /* no more errors */
 if ((mp->lines > 1) ||
@@ -2624,6 +2969,11 @@ else {
             }
         tmxr_show_summ(st, NULL, 0, mp);
         fprintf(st, ", sessions=%d\n", mp->sessions);
+#if defined(SIM_ASYNCH_IO) && defined(SIM_ASYNCH_MUX)
+        if (mp->poll_wakeups)
+            fprintf(st, "Poll wakeups=%u, ready descriptors=%u, dispatch latency avg=%.0fus max=%uus\n", 
+                        mp->poll_wakeups, mp->poll_ready, mp->poll_latency/mp->poll_wakeups, mp->poll_latency_max);
+#endif
         for (j = 0; j < mp->lines; j++) {
             lp = mp->ldsc + j;
             if (mp->lines > 1) {
@@ -2695,6 +3045,7 @@ if (mp->master)
 mp->master = 0;
 free (mp->port);
 mp->port = NULL;
+_tmxr_poll_sync (mp);                                   /* nothing left to poll */
 _tmxr_remove_from_open_list (mp);
 return SCPE_OK;
 }
@@ -2792,6 +3143,10 @@ if (single_line) {          /* Single Line Multiplexer */
     fprintf (st, "Line buffering can be disabled for the %s device with:\n\n", dptr->name);
     fprintf (st, "   sim> ATTACH %s NoBuffer\n\n", dptr->name);
     fprintf (st, "The default buffer size is 32k bytes, the max buffer size is 1024k bytes\n\n");
+    fprintf (st, "The receive buffer, and the transmit buffer when line buffering is not\n");
+    fprintf (st, "enabled, hold 256 bytes by default.  Larger buffers, which help when\n");
+    fprintf (st, "pasting or transferring files over the line, can be configured with:\n\n");
+    fprintf (st, "   sim> ATTACH %s BufSize=bytes\n\n", dptr->name);
     fprintf (st, "The outbound traffic the %s device can be logged to a file with:\n", dptr->name);
     fprintf (st, "   sim> ATTACH %s Log=LogFileName\n\n", dptr->name);
     fprintf (st, "File logging can be disabled for the %s device with:\n\n", dptr->name);
@@ -2816,6 +3171,10 @@ else {
         fprintf (st, "Line buffering for all lines on the %s device can be disabled with:\n\n", dptr->name);
     fprintf (st, "   sim> ATTACH %s NoBuffer\n\n", dptr->name);
     fprintf (st, "The default buffer size is 32k bytes, the max buffer size is 1024k bytes\n\n");
+    fprintf (st, "The receive buffers, and the transmit buffers when line buffering is not\n");
+    fprintf (st, "enabled, hold 256 bytes by default.  Larger buffers for all lines, which\n");
+    fprintf (st, "help when pasting or transferring files over a line, can be configured with:\n\n");
+    fprintf (st, "   sim> ATTACH %s BufSize=bytes\n\n", dptr->name);
     fprintf (st, "The outbound traffic for the lines of the %s device can be logged to files\n", dptr->name);
     fprintf (st, "with:\n\n");
     fprintf (st, "   sim> ATTACH %s Log=LogFileName\n\n", dptr->name);
@@ -3012,7 +3371,9 @@ else {
             tmxr_tqln (lp), lp->txcnt);
     fprintf (st, "\n");
     }
-if (lp->txbfd)
+if (lp->rxbsz > TMXR_MAXBUF)
+    fprintf (st, "  input buffer size = %d\n", lp->rxbsz);
+if (lp->txbfd || (lp->txbsz > TMXR_MAXBUF))
     fprintf (st, "  output buffer size = %d\n", lp->txbsz);
 if (lp->txcnt || lp->txbpi)
     fprintf (st, "  bytes in buffer = %d\n", 
@@ -60,7 +60,8 @@ typedef int SERHANDLE;
 
 #define TMXR_V_VALID    15
 #define TMXR_VALID      (1 << TMXR_V_VALID)
-#define TMXR_MAXBUF     256                             /* buffer size */
+#define TMXR_MAXBUF     256                             /* default line buffer size */
+#define TMXR_MAXBUFSIZE (1024*1024)                     /* largest line buffer size */
 #define TMXR_GUARD      12                              /* buffer guard */
 
 #define TMXR_DTR_DROP_TIME 500                          /* milliseconds to drop DTR for 'pseudo' modem control */
@@ -93,6 +94,15 @@ typedef int SERHANDLE;
 typedef struct tmln TMLN;
 typedef struct tmxr TMXR;
 
+/* On Linux the asynchronous poll thread keeps its descriptors registered 
+   with epoll, updating them as lines connect and disconnect, rather than 
+   rebuilding a select set on every pass */
+
+#if defined(SIM_ASYNCH_IO) && defined(SIM_ASYNCH_MUX) && (defined(__linux) || defined(__linux__))
+#define TMXR_USE_EPOLL  1
+#endif
+#define TMXR_POLL_LN_FDS 4                              /* sock, serport, connecting, master */
+
 struct tmln {
     int                 conn;                           /* line connected flag */
     SOCKET              sock;                           /* connection socket */
@@ -115,12 +125,13 @@ struct tmln {
     int32               txdrp;                          /* xmt drop count */
     int32               txbsz;                          /* xmt buffer size */
     int32               txbfd;                          /* xmt buffered flag */
+    int32               rxbsz;                          /* rcv buffer size */
     int32               modembits;                      /* modem bits which are currently set */
     FILE                *txlog;                         /* xmt log file */
     FILEREF             *txlogref;                      /* xmt log file reference */
     char                *txlogname;                     /* xmt log file name */
-    char                rxb[TMXR_MAXBUF];               /* rcv buffer */
-    char                rbr[TMXR_MAXBUF];               /* rcv break */
+    char                *rxb;                           /* rcv buffer */
+    char                *rbr;                           /* rcv break */
     char                *txb;                           /* xmt buffer */
     TMXR                *mp;                            /* back pointer to mux */
     char                *serconfig;                     /* line config */
@@ -130,6 +141,9 @@ struct tmln {
     char                *destination;                   /* Outgoing destination address:port */
     UNIT                *uptr;                          /* input polling unit (default to mp->uptr) */
     UNIT                *o_uptr;                        /* output polling unit (default to lp->uptr)*/
+#if defined(TMXR_USE_EPOLL)
+    int                 poll_fd[TMXR_POLL_LN_FDS];      /* descriptors registered with the poll thread */
+#endif
     };
 
 struct tmxr {
@@ -143,17 +157,28 @@ struct tmxr {
     char                logfiletmpl[FILENAME_MAX];      /* template logfile name */
     int32               txcount;                        /* count of transmit bytes */
     int32               buffered;                       /* Buffered Line Behavior and Buffer Size Flag */
+    int32               bufsize;                        /* line buffer size (0 = TMXR_MAXBUF) */
     int32               sessions;                       /* count of tcp connections received */
     uint32              last_poll_time;                 /* time of last connection poll */
     t_bool              notelnet;                       /* default telnet capability for incoming connections */
     t_bool              modem_control;                  /* multiplexer supports modem control behaviors */
+#if defined(TMXR_USE_EPOLL)
+    int                 poll_fd;                        /* master registered with the poll thread */
+#endif
+    uint32              poll_wakeups;                   /* asynch poll passes finding lines ready */
+    uint32              poll_ready;                     /* ready descriptors dispatched */
+    double              poll_latency;                   /* total usecs from dispatch to service */
+    uint32              poll_latency_max;               /* longest usecs from dispatch to service */
+    t_bool              poll_pending;                   /* dispatched units not yet serviced */
     };
 
 int32 tmxr_poll_conn (TMXR *mp);
 t_stat tmxr_reset_ln (TMLN *lp);
 int32 tmxr_getc_ln (TMLN *lp);
+int32 tmxr_get_block_ln (TMLN *lp, int32 *vals, int32 max);
 void tmxr_poll_rx (TMXR *mp);
 t_stat tmxr_putc_ln (TMLN *lp, int32 chr);
+t_stat tmxr_put_block_ln (TMLN *lp, const uint8 *buf, int32 len, int32 *sent);
 void tmxr_poll_tx (TMXR *mp);
 int32 tmxr_send_buffered_data (TMLN *lp);
 t_stat tmxr_open_master (TMXR *mp, char *cptr);